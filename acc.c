@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		acc.c
+ *
+ * @brief 		Code file for the config space access backends
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * A backend is a struct pcie_acc_ops plus an opaque context. open() resolves a
+ * BDF to a handle once so that each later read() is a direct access with no
+ * lookup. Three backends are provided:
+ *
+ * Backend 			Context 					Handle
+ * PCIE_ACC_MEM 	struct pcie_acc_mem* 		Pointer to the image
+ * PCIE_ACC_SNAP 	struct pcie_snap* 			Pointer to the image in the mapping
+ * PCIE_ACC_SYSFS 	Root directory or NULL 		File descriptor of the sysfs config file
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* open()
+ */
+#include <fcntl.h>
+
+/* intptr_t
+ */
+#include <stdint.h>
+
+/* snprintf()
+ */
+#include <stdio.h>
+
+/* close()
+ * pread()
+ */
+#include <unistd.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_ACC_SYSFS_ROOT 	"/sys/bus/pci/devices"
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+static int pcie_acc_mem_open(void *ctx, __u32 bdf, void **hdl);
+static int pcie_acc_snap_open(void *ctx, __u32 bdf, void **hdl);
+static int pcie_acc_img_read(void *ctx, void *hdl, unsigned off, unsigned len, __u32 *v);
+static int pcie_acc_sysfs_open(void *ctx, __u32 bdf, void **hdl);
+static int pcie_acc_sysfs_read(void *ctx, void *hdl, unsigned off, unsigned len, __u32 *v);
+static void pcie_acc_sysfs_close(void *ctx, void *hdl);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+const struct pcie_acc_ops PCIE_ACC_MEM = {
+	.name 	= "mem",
+	.open 	= pcie_acc_mem_open,
+	.read 	= pcie_acc_img_read,
+	.close 	= NULL,
+};
+
+const struct pcie_acc_ops PCIE_ACC_SNAP = {
+	.name 	= "snap",
+	.open 	= pcie_acc_snap_open,
+	.read 	= pcie_acc_img_read,
+	.close 	= NULL,
+};
+
+const struct pcie_acc_ops PCIE_ACC_SYSFS = {
+	.name 	= "sysfs",
+	.open 	= pcie_acc_sysfs_open,
+	.read 	= pcie_acc_sysfs_read,
+	.close 	= pcie_acc_sysfs_close,
+};
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Resolve a BDF to an image in a struct pcie_acc_mem
+ */
+static int pcie_acc_mem_open(void *ctx, __u32 bdf, void **hdl)
+{
+	struct pcie_acc_mem *m = ctx;
+	unsigned i;
+
+	for (i = 0 ; i < m->num ; i++)
+	{
+		if (m->bdfs[i] == bdf) {
+			*hdl = &m->images[(size_t) i * PCLN_CFG];
+			return 0;
+		}
+	}
+	errno = ENODEV;
+	return -1;
+}
+
+/**
+ * Resolve a BDF to an image in an open snapshot
+ */
+static int pcie_acc_snap_open(void *ctx, __u32 bdf, void **hdl)
+{
+	struct pcie_cfg_hdr *ph;
+
+	ph = pcie_snap_find(ctx, bdf);
+	if (ph == NULL) {
+		errno = ENODEV;
+		return -1;
+	}
+	*hdl = ph;
+	return 0;
+}
+
+/**
+ * Read a register from an in memory image
+ */
+static int pcie_acc_img_read(void *ctx, void *hdl, unsigned off, unsigned len, __u32 *v)
+{
+	(void) ctx;
+
+	if ((len != 1 && len != 2 && len != 4) || off > PCLN_CFG - len) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*v = pcie_le((__u8*) hdl + off, len);
+	return 0;
+}
+
+/**
+ * Open the sysfs config file of a BDF
+ */
+static int pcie_acc_sysfs_open(void *ctx, __u32 bdf, void **hdl)
+{
+	char path[256];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%04x:%02x:%02x.%x/config",
+			(ctx != NULL) ? (const char*) ctx : PCIE_ACC_SYSFS_ROOT,
+			PCIE_BDF_SEG(bdf), PCIE_BDF_BUS(bdf), PCIE_BDF_DEV(bdf), PCIE_BDF_FN(bdf));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	*hdl = (void*) (intptr_t) fd;
+	return 0;
+}
+
+/**
+ * Read a register through the sysfs config file
+ */
+static int pcie_acc_sysfs_read(void *ctx, void *hdl, unsigned off, unsigned len, __u32 *v)
+{
+	__u8 buf[4];
+	ssize_t rv;
+
+	(void) ctx;
+
+	if ((len != 1 && len != 2 && len != 4) || off > PCLN_CFG - len) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	rv = pread((int) (intptr_t) hdl, buf, len, off);
+	if (rv != (ssize_t) len) {
+		if (rv >= 0)
+			errno = EIO;
+		return -1;
+	}
+	*v = pcie_le(buf, len);
+	return 0;
+}
+
+/**
+ * Close the sysfs config file
+ */
+static void pcie_acc_sysfs_close(void *ctx, void *hdl)
+{
+	(void) ctx;
+
+	close((int) (intptr_t) hdl);
+}
+
+/**
+ * Read one register of a device through a backend
+ *
+ * Convenience wrapper that opens, reads and closes. Callers that read the same
+ * device repeatedly should keep the handle from ops->open() instead.
+ *
+ * @param ops 	struct pcie_acc_ops* backend
+ * @param ctx 	Backend context
+ * @param bdf 	BDF of the device. See PCIE_BDF()
+ * @param off 	Offset of the register in config space
+ * @param len 	Width of the register in bytes: 1, 2 or 4
+ * @param v 	__u32* to receive the value
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_acc_read(const struct pcie_acc_ops *ops, void *ctx, __u32 bdf, unsigned off, unsigned len, __u32 *v)
+{
+	void *hdl;
+	int rv;
+
+	if (ops == NULL || v == NULL || (len != 1 && len != 2 && len != 4) || off + len > PCLN_CFG) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (ops->open(ctx, bdf, &hdl) != 0)
+		return -1;
+
+	rv = ops->read(ctx, hdl, off, len, v);
+
+	if (ops->close != NULL)
+		ops->close(ctx, hdl);
+
+	return rv;
+}
@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		batch.c
+ *
+ * @brief 		Code file for decoding arrays of PCIe Config space images
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ * 
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* pthread_create()
+ * pthread_join()
+ */
+#include <pthread.h>
+
+/* sysconf()
+ */
+#include <unistd.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_BATCH_CHUNK 		64 		//!< Images claimed by a worker at a time
+#define PCIE_BATCH_MAX_THREADS 	256 	//!< Upper bound on worker threads
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * State shared by the workers of one pcie_decode_batch() call
+ */
+struct pcie_batch
+{
+	__u8 *images; 			//!< First image. Images are PCLN_CFG bytes apart
+	size_t num; 			//!< Number of images
+	struct pcie_dec *out; 	//!< Output array with num entries
+	size_t next; 			//!< Index of the next unclaimed image. Updated atomically
+};
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Decode the header fields and class name of one config space image
+ *
+ * Leaves d->idx untouched
+ *
+ * @param d 		struct pcie_dec* to fill in 
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ */
+void pcie_decode_hdr(struct pcie_dec *d, __u8 *cfgspace)
+{
+	d->vendor 		= pcie_get_hdr_vendor(cfgspace);
+	d->device 		= pcie_get_hdr_device(cfgspace);
+	d->subvendor 	= pcie_get_hdr_subvendor(cfgspace);
+	d->subsystem 	= pcie_get_hdr_subsystem(cfgspace);
+	d->command 		= pcie_get_hdr_command(cfgspace);
+	d->status 		= pcie_get_hdr_status(cfgspace);
+	d->rev 			= pcie_get_hdr_rev(cfgspace);
+	d->pi 			= pcie_get_hdr_pi(cfgspace);
+	d->subclass 	= pcie_get_hdr_subclass(cfgspace);
+	d->baseclass 	= pcie_get_hdr_baseclass(cfgspace);
+	d->type 		= pcie_get_hdr_type(cfgspace);
+	d->class_name 	= pcie_class_name(d->baseclass, d->subclass, d->pi);
+}
+
+/**
+ * Decode the header, Capability index and class name of one config space image
+ *
+ * @param d 		struct pcie_dec* to fill in 
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @return 			0 upon success, -1 if a parameter is NULL
+ */
+int pcie_decode(struct pcie_dec *d, __u8 *cfgspace)
+{
+	if (d == NULL || cfgspace == NULL)
+		return -1;
+
+	pcie_decode_hdr(d, cfgspace);
+
+	return pcie_cap_index_build(&d->idx, cfgspace);
+}
+
+/**
+ * Worker thread: claim chunks of images until none remain
+ */
+static void *pcie_batch_worker(void *arg)
+{
+	struct pcie_batch *b = arg;
+	size_t i, start, end;
+
+	for (;;)
+	{
+		start = __atomic_fetch_add(&b->next, PCIE_BATCH_CHUNK, __ATOMIC_RELAXED);
+		if (start >= b->num)
+			break;
+
+		end = start + PCIE_BATCH_CHUNK;
+		if (end > b->num)
+			end = b->num;
+
+		for (i = start ; i < end ; i++)
+			pcie_decode(&b->out[i], &b->images[i * PCLN_CFG]);
+	}
+
+	return NULL;
+}
+
+/**
+ * Decode an array of config space images across a set of worker threads 
+ *
+ * Images are handed out to workers in chunks of PCIE_BATCH_CHUNK so that 
+ * uneven per image cost balances across threads. The calling thread also acts 
+ * as a worker. Nothing is allocated per image; results are written to out[i] 
+ * for image i.  
+ *
+ * @param images 	__u8* to num contiguous images of PCLN_CFG bytes each 
+ * @param num 		Number of images
+ * @param out 		struct pcie_dec* array with at least num entries
+ * @param threads 	Number of threads to use. 0 = one per online CPU
+ * @return 			0 upon success, -1 if a parameter is NULL
+ */
+int pcie_decode_batch(__u8 *images, size_t num, struct pcie_dec *out, unsigned threads)
+{
+	pthread_t tid[PCIE_BATCH_MAX_THREADS];
+	struct pcie_batch b;
+	unsigned i, started;
+	long ncpu;
+
+	if (images == NULL || out == NULL)
+		return -1;
+
+	if (threads == 0) {
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (ncpu > 0) ? (unsigned) ncpu : 1;
+	}
+	if (threads > PCIE_BATCH_MAX_THREADS)
+		threads = PCIE_BATCH_MAX_THREADS;
+
+	// No point starting more threads than there are chunks of work
+	if (threads > (num + PCIE_BATCH_CHUNK - 1) / PCIE_BATCH_CHUNK)
+		threads = (num + PCIE_BATCH_CHUNK - 1) / PCIE_BATCH_CHUNK;
+
+	b.images = images;
+	b.num = num;
+	b.out = out;
+	b.next = 0;
+
+	// If a thread fails to start its share is picked up by the others
+	started = 0;
+	for (i = 1 ; i < threads ; i++)
+		if (pthread_create(&tid[started], NULL, pcie_batch_worker, &b) == 0)
+			started++;
+
+	pcie_batch_worker(&b);
+
+	for (i = 0 ; i < started ; i++)
+		pthread_join(tid[i], NULL);
+
+	return 0;
+}
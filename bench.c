@@ -0,0 +1,612 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		bench.c
+ *
+ * @brief 		Microbenchmarks for the PCI Utility Functions library
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Usage: bench [-n images] [-s seed] [-t ms] [-j threads] [filter]
+ *
+ * The corpus is built with pcie_gen, so every run uses the same images for a
+ * given seed and image count and results are comparable between builds. Each
+ * benchmark is repeated with a doubling op count until it runs for at least
+ * the target time, then the mean cost per op and the throughput are reported.
+ * Only benchmarks whose name contains filter are run.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* printf()
+ * fprintf()
+ */
+#include <stdio.h>
+
+/* malloc()
+ * free()
+ * mkstemp()
+ * strtoul()
+ * strtoull()
+ */
+#include <stdlib.h>
+
+/* memset()
+ * memcpy()
+ * strstr()
+ */
+#include <string.h>
+
+/* clock_gettime()
+ */
+#include <time.h>
+
+/* getopt()
+ * close()
+ * unlink()
+ */
+#include <unistd.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define BENCH_IMAGES 	4096 		//!< Default number of images in the corpus
+#define BENCH_SEED 		0x5043 		//!< Default corpus seed
+#define BENCH_MS 		200 		//!< Default minimum run time of a benchmark in ms
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * State shared by all benchmarks
+ */
+struct bench_ctx
+{
+	__u8 *images; 			//!< Corpus of num images of PCLN_CFG bytes each
+	__u8 *work; 			//!< Private copy of the corpus for benchmarks that modify images
+	__u32 *bdfs; 			//!< BDF of each image
+	size_t num; 			//!< Number of images
+	struct pcie_dec *dec; 	//!< Output array for the batch decode benchmarks
+	__u32 *vals; 			//!< Output array for the batch field benchmark
+	struct pcie_dcache dcache; 	//!< Decode cache for the dcache benchmarks
+	struct pcie_pack pack; 	//!< Packed copy of the corpus for the pack benchmark
+	struct pcie_sym sym; 	//!< Reverse name lookup table for the sym benchmark
+	struct pcie_col col; 	//!< Columnar copy of the corpus for the col benchmark
+	__u64 *bits; 			//!< Row bitmap for the col benchmark
+	unsigned threads; 		//!< Threads for the parallel batch decode. 0 = one per CPU
+};
+
+/**
+ * One benchmark
+ */
+struct bench
+{
+	const char *name; 		//!< Name used in the report and by the filter
+	const char *unit; 		//!< What one op is, e.g. "lookups" or "devices"
+	size_t (*fn)(struct bench_ctx *c, size_t ops); //!< Run ops ops and return a checksum
+};
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Checksums are stored here so that the work cannot be optimized out
+ */
+static volatile size_t bench_sink;
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Monotonic time in ns
+ */
+static __u64 bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Build the corpus with the library generator
+ */
+static int bench_corpus(struct bench_ctx *c, size_t num, __u64 seed)
+{
+	struct pcie_gen *g;
+
+	c->num = num;
+	c->images = malloc(num * PCLN_CFG);
+	c->work = malloc(num * PCLN_CFG);
+	c->bdfs = malloc(num * sizeof(*c->bdfs));
+	c->dec = malloc(num * sizeof(*c->dec));
+	c->vals = malloc(num * sizeof(*c->vals));
+	g = malloc(sizeof(*g));
+	if (c->images == NULL || c->work == NULL || c->bdfs == NULL || c->dec == NULL || c->vals == NULL || g == NULL) {
+		free(g);
+		return -1;
+	}
+
+	pcie_gen_init(g, seed, 0);
+	pcie_gen_next(g, c->images, c->bdfs, num);
+	memcpy(c->work, c->images, num * PCLN_CFG);
+	free(g);
+
+	c->bits = malloc((num + 63) / 64 * sizeof(*c->bits));
+	if (c->bits == NULL || pcie_col_init(&c->col, num) != 0)
+		return -1;
+	pcie_col_load(&c->col, c->images, c->bdfs, num);
+	return pcie_dcache_init(&c->dcache, num);
+}
+
+/**
+ * Pack the corpus into an unlinked temporary file
+ */
+static int bench_pack(struct bench_ctx *c)
+{
+	char path[] = "/tmp/pcie_bench_XXXXXX";
+	int fd, rv;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		return -1;
+	close(fd);
+
+	rv = pcie_pack_write(path, c->bdfs, c->images, c->num, 0);
+	if (rv == 0)
+		rv = pcie_pack_open(&c->pack, path);
+	unlink(path);
+	return rv;
+}
+
+/**
+ * Capability name lookups. One op is one call
+ */
+static size_t bench_pcap(struct bench_ctx *c, size_t ops)
+{
+	size_t i, sum = 0;
+	const char *s;
+
+	(void) c;
+	for (i = 0 ; i < ops ; i++) {
+		s = pcap(i % (PCAP_MAX + 2));
+		sum += (s != NULL) ? (size_t) s[0] : 0;
+	}
+	return sum;
+}
+
+/**
+ * Extended Capability name lookups. One op is one call
+ */
+static size_t bench_pcec(struct bench_ctx *c, size_t ops)
+{
+	size_t i, sum = 0;
+	const char *s;
+
+	(void) c;
+	for (i = 0 ; i < ops ; i++) {
+		s = pcec(i % (PCEC_MAX + 2));
+		sum += (s != NULL) ? (size_t) s[0] : 0;
+	}
+	return sum;
+}
+
+/**
+ * Sub Class name lookups through the per Class functions. One op is one call
+ */
+static size_t bench_subclass(struct bench_ctx *c, size_t ops)
+{
+	size_t i, sum = 0;
+	const char *s;
+
+	(void) c;
+	for (i = 0 ; i < ops ; i++) {
+		switch (i & 3) {
+			case 0: s = pcms(i % 0x0A); break;
+			case 1: s = pcnc(i % 0x0A); break;
+			case 2: s = pcbd(i % 0x0C); break;
+			default: s = pcsb(i % 0x0C); break;
+		}
+		sum += (s != NULL) ? (size_t) s[0] : 0;
+	}
+	return sum;
+}
+
+/**
+ * Class name lookups from the class code of each image. One op is one call
+ */
+static size_t bench_class_name(struct bench_ctx *c, size_t ops)
+{
+	struct pcie_cfg_hdr *ph;
+	size_t i, sum = 0;
+	const char *s;
+
+	for (i = 0 ; i < ops ; i++) {
+		ph = (struct pcie_cfg_hdr*) &c->images[(i % c->num) * PCLN_CFG];
+		s = pcie_class_name(ph->baseclass, ph->subclass, ph->pi);
+		sum += (s != NULL) ? (size_t) s[0] : 0;
+	}
+	return sum;
+}
+
+/**
+ * Format the header of an image into a buffer. One op is one device
+ */
+static size_t bench_fmt(struct bench_ctx *c, size_t ops)
+{
+	char buf[PCLN_FMT_HDR];
+	size_t i, sum = 0;
+
+	for (i = 0 ; i < ops ; i++)
+		sum += pcie_fmt_cfgspace(buf, sizeof(buf), &c->images[(i % c->num) * PCLN_CFG], 2);
+	return sum;
+}
+
+/**
+ * Print the header of an image to a null sink. One op is one device
+ */
+static size_t bench_prnt(struct bench_ctx *c, size_t ops)
+{
+	struct pcie_sink s;
+	size_t i;
+
+	pcie_sink_null(&s);
+	for (i = 0 ; i < ops ; i++)
+		pcie_wr_cfgspace(pcie_sink_wr, &s, &c->images[(i % c->num) * PCLN_CFG], 2);
+	return s.total;
+}
+
+/**
+ * Print the header of an image to a memory sink that is reset after each
+ * pass over the corpus. One op is one device
+ */
+static size_t bench_prnt_mem(struct bench_ctx *c, size_t ops)
+{
+	struct pcie_sink s;
+	size_t i, sum;
+
+	pcie_sink_mem(&s);
+	for (i = 0 ; i < ops ; i++) {
+		if (i % c->num == 0)
+			s.pos = 0;
+		pcie_wr_cfgspace(pcie_sink_wr, &s, &c->images[(i % c->num) * PCLN_CFG], 2);
+	}
+	sum = s.total;
+	pcie_sink_free(&s);
+	return sum;
+}
+
+/**
+ * Walk both Capability chains of an image. One op is one device
+ */
+static size_t bench_cap_index(struct bench_ctx *c, size_t ops)
+{
+	struct pcie_cap_index idx;
+	size_t i, sum = 0;
+
+	for (i = 0 ; i < ops ; i++) {
+		pcie_cap_index_build(&idx, &c->images[(i % c->num) * PCLN_CFG]);
+		sum += idx.ncap + idx.necap;
+	}
+	return sum;
+}
+
+/**
+ * Validate both Capability chains of an image. One op is one device
+ */
+static size_t bench_cap_validate(struct bench_ctx *c, size_t ops)
+{
+	size_t i, sum = 0;
+
+	for (i = 0 ; i < ops ; i++)
+		sum += pcie_cap_validate(&c->images[(i % c->num) * PCLN_CFG], NULL);
+	return sum;
+}
+
+/**
+ * Extract the Status register of a batch of images with the scalar accessor.
+ * One op is one device
+ */
+static size_t bench_field(struct bench_ctx *c, size_t ops)
+{
+	size_t done, i, n, sum = 0;
+
+	for (done = 0 ; done < ops ; done += n) {
+		n = (ops - done < c->num) ? ops - done : c->num;
+		for (i = 0 ; i < n ; i++)
+			c->vals[i] = pcie_get_hdr_status(&c->images[i * PCLN_CFG]);
+		sum += c->vals[n - 1] & PCIE_STATUS_ERRORS;
+	}
+	return sum;
+}
+
+/**
+ * Extract the Status register of a batch of images with the batch accessor.
+ * One op is one device
+ */
+static size_t bench_field_batch(struct bench_ctx *c, size_t ops)
+{
+	size_t done, n, sum = 0;
+
+	for (done = 0 ; done < ops ; done += n) {
+		n = (ops - done < c->num) ? ops - done : c->num;
+		pcie_get_hdr_status_n(c->images, n, NULL, c->vals);
+		sum += c->vals[n - 1] & PCIE_STATUS_ERRORS;
+	}
+	return sum;
+}
+
+/**
+ * Decode a batch of images. One op is one device
+ */
+static size_t bench_batch(struct bench_ctx *c, size_t ops, unsigned threads)
+{
+	size_t done, n, sum = 0;
+
+	for (done = 0 ; done < ops ; done += n) {
+		n = (ops - done < c->num) ? ops - done : c->num;
+		pcie_decode_batch(c->images, n, c->dec, threads);
+		sum += c->dec[n - 1].idx.ncap;
+	}
+	return sum;
+}
+
+static size_t bench_batch_1(struct bench_ctx *c, size_t ops)
+{
+	return bench_batch(c, ops, 1);
+}
+
+static size_t bench_batch_n(struct bench_ctx *c, size_t ops)
+{
+	return bench_batch(c, ops, c->threads);
+}
+
+/**
+ * Decode images through the decode cache. One op is one device
+ *
+ * If toggle is set the Interrupt Disable bit of the Command register is 
+ * flipped before each decode so that every lookup after the first takes the 
+ * header only path. The bit is flipped in the private copy of the corpus so 
+ * that the other benchmarks keep seeing the original images
+ */
+static size_t bench_dcache(struct bench_ctx *c, size_t ops, int toggle)
+{
+	const struct pcie_dec *d;
+	size_t i, k, sum = 0;
+	__u8 *p;
+
+	for (i = 0 ; i < ops ; i++) {
+		k = i % c->num;
+		p = &(toggle ? c->work : c->images)[k * PCLN_CFG];
+		if (toggle)
+			p[0x05] ^= 0x04;
+		if (pcie_dcache_decode(&c->dcache, c->bdfs[k], p, &d) >= 0)
+			sum += d->idx.ncap;
+	}
+	return sum;
+}
+
+static size_t bench_dcache_hit(struct bench_ctx *c, size_t ops)
+{
+	return bench_dcache(c, ops, 0);
+}
+
+static size_t bench_dcache_hdr(struct bench_ctx *c, size_t ops)
+{
+	return bench_dcache(c, ops, 1);
+}
+
+/**
+ * Rebuild images from the packed copy of the corpus. One op is one device
+ */
+static size_t bench_pack_cfg(struct bench_ctx *c, size_t ops)
+{
+	__u8 img[PCLN_CFG];
+	size_t i, sum = 0;
+
+	if (c->pack.num == 0)
+		return 0;
+
+	for (i = 0 ; i < ops ; i++)
+		if (pcie_pack_cfg(&c->pack, i % c->pack.num, img) == 0)
+			sum += img[0];
+	return sum;
+}
+
+/**
+ * Columnar scan for Mass Storage NVM functions with Bus Master disabled. One
+ * op is one row
+ */
+static size_t bench_col_scan(struct bench_ctx *c, size_t ops)
+{
+	static const struct pcie_col_pred q[] = {
+		{ PCCL_BASECLASS, 	0, 	0xFF, 	PCBC_MSC },
+		{ PCCL_SUBCLASS, 	0, 	0xFF, 	PCMS_NVM },
+		{ PCCL_COMMAND, 	0, 	0x0004, 0 },
+	};
+	struct pcie_col col;
+	size_t done, n, sum = 0;
+	long k;
+
+	if (c->col.num == 0)
+		return 0;
+
+	// Scan exactly ops rows: whole passes, then a prefix of the store
+	col = c->col;
+	for (done = 0 ; done < ops ; done += n) {
+		n = (ops - done < c->col.num) ? ops - done : c->col.num;
+		col.num = n;
+		k = pcie_col_scan(&col, q, 3, c->bits);
+		sum += (k > 0) ? k : 0;
+	}
+	return sum;
+}
+
+/**
+ * Link downtraining and payload scan of the corpus. One op is one device
+ */
+static size_t bench_link_scan(struct bench_ctx *c, size_t ops)
+{
+	size_t done, n, sum = 0;
+	long k;
+
+	if (c->num == 0)
+		return 0;
+
+	// Scan exactly ops devices: whole passes, then a prefix of the corpus
+	for (done = 0 ; done < ops ; done += n) {
+		n = (ops - done < c->num) ? ops - done : c->num;
+		k = pcie_link_scan(c->bdfs, c->images, n, NULL, 0);
+		sum += (k > 0) ? k : 0;
+	}
+	return sum;
+}
+
+/**
+ * VF enumeration of the corpus. One op is one device
+ */
+static size_t bench_sriov_scan(struct bench_ctx *c, size_t ops)
+{
+	size_t done, n, sum = 0;
+	long k;
+
+	if (c->num == 0)
+		return 0;
+
+	// Scan exactly ops devices: whole passes, then a prefix of the corpus
+	for (done = 0 ; done < ops ; done += n) {
+		n = (ops - done < c->num) ? ops - done : c->num;
+		k = pcie_sriov_scan(c->bdfs, c->images, n, NULL, 0);
+		sum += (k > 0) ? k : 0;
+	}
+	return sum;
+}
+
+/**
+ * Reverse lookups of filter terms. One op is one name
+ */
+static size_t bench_sym_find(struct bench_ctx *c, size_t ops)
+{
+	static const struct { unsigned ns; const char *name; size_t len; } q[] = {
+		{ PCSY_ECAP, 	"AER", 								3 },
+		{ PCSY_ECAP, 	"pcec_doe", 						8 },
+		{ PCSY_CLASS, 	"Non-Volatile Memory Subsystem", 	29 },
+		{ PCSY_CAP, 	"NOPE", 							4 },
+	};
+	const struct pcie_sym_ent *e;
+	size_t i, sum = 0;
+
+	for (i = 0 ; i < ops ; i++) {
+		e = pcie_sym_find(&c->sym, q[i & 3].ns, q[i & 3].name, q[i & 3].len);
+		sum += (e != NULL) ? e->val : 0;
+	}
+	return sum;
+}
+
+/**
+ * Run one benchmark until it takes at least ms and report the result
+ */
+static void bench_run(struct bench_ctx *c, const struct bench *b, unsigned ms)
+{
+	__u64 t0, dt, target;
+	size_t ops;
+
+	target = (__u64) ms * 1000000ULL;
+
+	// Warm up caches and the lazily selected code paths
+	bench_sink = b->fn(c, 16);
+
+	for (ops = 64 ; ; ops *= 2)
+	{
+		t0 = bench_now();
+		bench_sink = b->fn(c, ops);
+		dt = bench_now() - t0;
+		if (dt >= target || ops >= ((size_t) 1 << 40))
+			break;
+	}
+
+	printf("%-20s %12zu ops %10.1f ns/op %14.0f %s/sec\n", b->name, ops,
+			(double) dt / ops, ops * 1e9 / dt, b->unit);
+}
+
+static const struct bench BENCHES[] =
+{
+	{ "pcap", 			"lookups", 	bench_pcap },
+	{ "pcec", 			"lookups", 	bench_pcec },
+	{ "subclass", 		"lookups", 	bench_subclass },
+	{ "class_name", 	"lookups", 	bench_class_name },
+	{ "sym_find", 		"lookups", 	bench_sym_find },
+	{ "fmt_cfgspace", 	"devices", 	bench_fmt },
+	{ "prnt_cfgspace", 	"devices", 	bench_prnt },
+	{ "prnt_mem", 		"devices", 	bench_prnt_mem },
+	{ "field", 			"devices", 	bench_field },
+	{ "field_batch", 	"devices", 	bench_field_batch },
+	{ "cap_index", 		"devices", 	bench_cap_index },
+	{ "cap_validate", 	"devices", 	bench_cap_validate },
+	{ "decode_batch_1", "devices", 	bench_batch_1 },
+	{ "decode_batch_n", "devices", 	bench_batch_n },
+	{ "dcache_hit", 	"devices", 	bench_dcache_hit },
+	{ "dcache_hdr", 	"devices", 	bench_dcache_hdr },
+	{ "pack_cfg", 		"devices", 	bench_pack_cfg },
+	{ "col_scan", 		"devices", 	bench_col_scan },
+	{ "link_scan", 		"devices", 	bench_link_scan },
+	{ "sriov_scan", 	"devices", 	bench_sriov_scan },
+};
+
+int main(int argc, char **argv)
+{
+	struct bench_ctx c;
+	const char *filter;
+	size_t num;
+	__u64 seed;
+	unsigned i, ms;
+	int opt;
+
+	memset(&c, 0, sizeof(c));
+	num = BENCH_IMAGES;
+	seed = BENCH_SEED;
+	ms = BENCH_MS;
+
+	while ((opt = getopt(argc, argv, "n:s:t:j:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': num = strtoul(optarg, NULL, 0); 		break;
+			case 's': seed = strtoull(optarg, NULL, 0); 	break;
+			case 't': ms = strtoul(optarg, NULL, 0); 		break;
+			case 'j': c.threads = strtoul(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "Usage: %s [-n images] [-s seed] [-t ms] [-j threads] [filter]\n", argv[0]);
+				return 1;
+		}
+	}
+	filter = (optind < argc) ? argv[optind] : NULL;
+
+	if (num == 0 || bench_corpus(&c, num, seed) != 0 || pcie_sym_init(&c.sym) != 0) {
+		fprintf(stderr, "Unable to allocate a corpus of %zu images\n", num);
+		return 1;
+	}
+
+	printf("corpus: %zu images, seed 0x%llx\n", c.num, (unsigned long long) seed);
+	if (bench_pack(&c) == 0)
+		printf("packed: %llu bytes, %u templates\n", (unsigned long long) c.pack.hdr->file_len, c.pack.ntmpl);
+	for (i = 0 ; i < sizeof(BENCHES) / sizeof(BENCHES[0]) ; i++)
+		if (filter == NULL || strstr(BENCHES[i].name, filter) != NULL)
+			bench_run(&c, &BENCHES[i], ms);
+
+	free(c.images);
+	free(c.work);
+	free(c.bdfs);
+	free(c.dec);
+	free(c.vals);
+	pcie_dcache_free(&c.dcache);
+	pcie_pack_close(&c.pack);
+	pcie_sym_free(&c.sym);
+	pcie_col_free(&c.col);
+	free(c.bits);
+	return 0;
+}
@@ -0,0 +1,377 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		cap.c
+ *
+ * @brief 		Code file for PCIe Capability list operations
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ * 
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* memset()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Return the offset of the Capabilities Pointer for this header type
+ *
+ * Type 0 and Type 1 headers hold the pointer at 0x34, CardBus at 0x14
+ */
+static unsigned pcie_cap_ptr(__u8 *cfgspace)
+{
+	if (pcie_get_type_type(cfgspace) == 2)
+		return pcie_get_hdr2_cap(cfgspace);
+	return pcie_get_hdr_cap(cfgspace);
+}
+
+/**
+ * Build an index of all Capabilities and Extended Capabilities 
+ *
+ * Both chains are walked once and the offset of every entry is recorded, 
+ * including duplicate IDs such as multiple Vendor Specific or DVSEC entries. 
+ * Entries with the same ID are linked through pcie_cap_ent.dup so that they 
+ * can be visited in chain order after a single table lookup.  
+ *
+ * @param idx 		struct pcie_cap_index* to fill in 
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @return 			0 upon success, -1 if a parameter is NULL
+ */
+int pcie_cap_index_build(struct pcie_cap_index *idx, __u8 *cfgspace)
+{
+	struct pcie_cap_ent *e;
+	__u8 last_cap[PCAP_MAX];
+	__u8 last_ecap[PCEC_MAX];
+	unsigned off, steps, id;
+	__u8 *p;
+
+	if (idx == NULL || cfgspace == NULL)
+		return -1;
+
+	memset(idx, 0, sizeof(*idx));
+
+	// Capabilities: 0x40 - 0xFF
+	if (pcie_get_status_cap(cfgspace))
+	{
+		off = pcie_cap_ptr(cfgspace) & PCIE_CAP_OFFSET_MASK;
+		for (steps = 0 ; off != 0 ; steps++)
+		{
+			if (off < PCLN_HDR) {
+				idx->flags |= PCIF_CAPS_BAD;
+				break;
+			}
+			if (steps >= PCLN_CAPS) {
+				idx->flags |= PCIF_CAPS_TRUNC;
+				break;
+			}
+
+			p = &cfgspace[off];
+			id = pcie_get_cap_id(p);
+			e = &idx->caps[idx->ncap];
+			e->id = id;
+			e->offset = off;
+
+			if (id < PCAP_MAX)
+			{
+				if (idx->cap[id] == 0)
+					idx->cap[id] = idx->ncap + 1;
+				else 
+					idx->caps[last_cap[id]].dup = idx->ncap + 1;
+				last_cap[id] = idx->ncap;
+			}
+
+			idx->ncap++;
+			off = pcie_get_cap_next(p) & PCIE_CAP_OFFSET_MASK;
+		}
+	}
+
+	// Extended Capabilities: 0x100 - 0xFFF
+	off = PCIE_ECAP_START;
+	for (steps = 0 ; off != 0 ; steps++)
+	{
+		if (off < PCIE_ECAP_START || off > (PCLN_CFG - sizeof(struct pcie_ecap))) {
+			idx->flags |= PCIF_ECAPS_BAD;
+			break;
+		}
+
+		p = &cfgspace[off];
+		id = pcie_get_ecap_id(p);
+
+		// An empty or absent Extended Capability region reads as all 0 or all 1
+		if (id == 0 || id == 0xFFFF) {
+			if (off != PCIE_ECAP_START)
+				idx->flags |= PCIF_ECAPS_BAD;
+			break;
+		}
+
+		if (steps >= PCLN_ECAPS) {
+			idx->flags |= PCIF_ECAPS_TRUNC;
+			break;
+		}
+
+		e = &idx->ecaps[idx->necap];
+		e->id = id;
+		e->offset = off;
+		e->ver = pcie_get_ecap_ver(p);
+
+		if (id < PCEC_MAX)
+		{
+			if (idx->ecap[id] == 0)
+				idx->ecap[id] = idx->necap + 1;
+			else 
+				idx->ecaps[last_ecap[id]].dup = idx->necap + 1;
+			last_ecap[id] = idx->necap;
+		}
+
+		idx->necap++;
+		off = pcie_get_ecap_next(p) & PCIE_CAP_OFFSET_MASK_EXT;
+	}
+
+	return 0;
+}
+
+/**
+ * Validate the Capability and Extended Capability chains of an image
+ *
+ * Each chain is walked at most once through every possible entry location and
+ * a bitmap of visited locations stops it at the first repeat, so the cost is
+ * bounded by PCLN_CAPS + PCLN_ECAPS + 1 reads whatever the image holds. No
+ * byte outside the image is read.
+ *
+ * An image that returns 0 is indexed by pcie_cap_index_build() without
+ * setting any enum _PCIF flag, so this can be used to screen images before a
+ * full decode.
+ *
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @param chk 		struct pcie_cap_check* to fill in. May be NULL
+ * @return 			Bitmask of enum _PCCV. 0 if both chains are well formed
+ */
+unsigned pcie_cap_validate(__u8 *cfgspace, struct pcie_cap_check *chk)
+{
+	struct pcie_cap_check c;
+	__u64 seen, eseen[PCLN_CFG / 4 / 64];
+	unsigned off, prev, bit, id;
+
+	memset(&c, 0, sizeof(c));
+
+	// Capabilities: 48 possible locations, one bit each
+	if (pcie_get_status_cap(cfgspace))
+	{
+		seen = 0;
+		prev = 0;
+		off = pcie_cap_ptr(cfgspace) & PCIE_CAP_OFFSET_MASK;
+		while (off != 0)
+		{
+			if (off < PCLN_HDR) {
+				c.err |= PCCV_CAP_RANGE;
+				break;
+			}
+
+			bit = (off - PCLN_HDR) / 4;
+			if (seen & (1ULL << bit)) {
+				c.err |= PCCV_CAP_LOOP;
+				break;
+			}
+			seen |= 1ULL << bit;
+
+			c.ncap++;
+			prev = off;
+			off = pcie_get_cap_next(&cfgspace[off]) & PCIE_CAP_OFFSET_MASK;
+		}
+		if (c.err)
+			c.cap_bad = prev;
+	}
+
+	// Extended Capabilities: 960 possible locations
+	memset(eseen, 0, sizeof(eseen));
+	prev = 0;
+	off = PCIE_ECAP_START;
+	while (off != 0)
+	{
+		if (off < PCIE_ECAP_START) {
+			c.err |= PCCV_ECAP_RANGE;
+			break;
+		}
+
+		id = pcie_get_ecap_id(&cfgspace[off]);
+		if (id == 0 || id == 0xFFFF) {
+			if (off != PCIE_ECAP_START)
+				c.err |= PCCV_ECAP_EMPTY;
+			break;
+		}
+
+		bit = off / 4;
+		if (eseen[bit / 64] & (1ULL << (bit % 64))) {
+			c.err |= PCCV_ECAP_LOOP;
+			break;
+		}
+		if (c.necap == PCLN_ECAPS) {
+			c.err |= PCCV_ECAP_LONG;
+			break;
+		}
+		eseen[bit / 64] |= 1ULL << (bit % 64);
+
+		c.necap++;
+		prev = off;
+		off = pcie_get_ecap_next(&cfgspace[off]) & PCIE_CAP_OFFSET_MASK_EXT;
+	}
+	if (c.err & (PCCV_ECAP_RANGE | PCCV_ECAP_LOOP | PCCV_ECAP_LONG | PCCV_ECAP_EMPTY))
+		c.ecap_bad = prev;
+
+	if (chk != NULL)
+		*chk = c;
+	return c.err;
+}
+
+/**
+ * Validate the Capability chains of an array of images
+ *
+ * @param images 	__u8* to num contiguous images of PCLN_CFG bytes each
+ * @param num 		Number of images
+ * @param err 		__u32* array of num entries to receive the enum _PCCV bitmask
+ * 					of each image. May be NULL
+ * @return 			Number of images with at least one error
+ */
+size_t pcie_cap_validate_batch(__u8 *images, size_t num, __u32 *err)
+{
+	size_t i, bad;
+	unsigned e;
+
+	bad = 0;
+	for (i = 0 ; i < num ; i++)
+	{
+		e = pcie_cap_validate(&images[i * PCLN_CFG], NULL);
+		if (err != NULL)
+			err[i] = e;
+		bad += (e != 0);
+	}
+	return bad;
+}
+
+/**
+ * Return the first index entry for a Capability ID 
+ *
+ * @param idx 	struct pcie_cap_index* built by pcie_cap_index_build()
+ * @param id 	Capability ID (enum _PCAP)
+ * @return 		struct pcie_cap_ent* or NULL if the Capability is not present 
+ */
+const struct pcie_cap_ent *pcie_cap_first(const struct pcie_cap_index *idx, unsigned id)
+{
+	unsigned i;
+
+	if (id < PCAP_MAX)
+		return idx->cap[id] ? &idx->caps[idx->cap[id] - 1] : NULL;
+
+	for (i = 0 ; i < idx->ncap ; i++)
+		if (idx->caps[i].id == id)
+			return &idx->caps[i];
+	return NULL;
+}
+
+/**
+ * Return the next index entry with the same Capability ID 
+ *
+ * @param idx 	struct pcie_cap_index* built by pcie_cap_index_build()
+ * @param e 	struct pcie_cap_ent* returned by pcie_cap_first() or pcie_cap_next()
+ * @return 		struct pcie_cap_ent* or NULL if there are no more entries 
+ */
+const struct pcie_cap_ent *pcie_cap_next(const struct pcie_cap_index *idx, const struct pcie_cap_ent *e)
+{
+	unsigned i;
+
+	if (e->id < PCAP_MAX)
+		return e->dup ? &idx->caps[e->dup - 1] : NULL;
+
+	for (i = (e - idx->caps) + 1 ; i < idx->ncap ; i++)
+		if (idx->caps[i].id == e->id)
+			return &idx->caps[i];
+	return NULL;
+}
+
+/**
+ * Return the first index entry for an Extended Capability ID 
+ *
+ * @param idx 	struct pcie_cap_index* built by pcie_cap_index_build()
+ * @param id 	Extended Capability ID (enum _PCEC)
+ * @return 		struct pcie_cap_ent* or NULL if the Extended Capability is not present 
+ */
+const struct pcie_cap_ent *pcie_ecap_first(const struct pcie_cap_index *idx, unsigned id)
+{
+	unsigned i;
+
+	if (id < PCEC_MAX)
+		return idx->ecap[id] ? &idx->ecaps[idx->ecap[id] - 1] : NULL;
+
+	for (i = 0 ; i < idx->necap ; i++)
+		if (idx->ecaps[i].id == id)
+			return &idx->ecaps[i];
+	return NULL;
+}
+
+/**
+ * Return the next index entry with the same Extended Capability ID 
+ *
+ * @param idx 	struct pcie_cap_index* built by pcie_cap_index_build()
+ * @param e 	struct pcie_cap_ent* returned by pcie_ecap_first() or pcie_ecap_next()
+ * @return 		struct pcie_cap_ent* or NULL if there are no more entries 
+ */
+const struct pcie_cap_ent *pcie_ecap_next(const struct pcie_cap_index *idx, const struct pcie_cap_ent *e)
+{
+	unsigned i;
+
+	if (e->id < PCEC_MAX)
+		return e->dup ? &idx->ecaps[e->dup - 1] : NULL;
+
+	for (i = (e - idx->ecaps) + 1 ; i < idx->necap ; i++)
+		if (idx->ecaps[i].id == e->id)
+			return &idx->ecaps[i];
+	return NULL;
+}
+
+/**
+ * Return the offset of the first Capability with the specified ID
+ *
+ * @param idx 	struct pcie_cap_index* built by pcie_cap_index_build()
+ * @param id 	Capability ID (enum _PCAP)
+ * @return 		Offset into config space or 0 if not present
+ */
+unsigned pcie_cap_find(const struct pcie_cap_index *idx, unsigned id)
+{
+	const struct pcie_cap_ent *e;
+
+	e = pcie_cap_first(idx, id);
+	return e ? e->offset : 0;
+}
+
+/**
+ * Return the offset of the first Extended Capability with the specified ID
+ *
+ * @param idx 	struct pcie_cap_index* built by pcie_cap_index_build()
+ * @param id 	Extended Capability ID (enum _PCEC)
+ * @return 		Offset into config space or 0 if not present
+ */
+unsigned pcie_ecap_find(const struct pcie_cap_index *idx, unsigned id)
+{
+	const struct pcie_cap_ent *e;
+
+	e = pcie_ecap_first(idx, id);
+	return e ? e->offset : 0;
+}
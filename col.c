@@ -0,0 +1,430 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		col.c
+ *
+ * @brief 		Code file for the columnar fleet store
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * A struct pcie_col holds the header fields of many functions as one array
+ * per field (struct of arrays), so a query touches only the bytes of the
+ * fields it tests instead of a 4 KB image per function. One million rows of
+ * the three class bytes and the Command register are 5 MB.
+ *
+ * pcie_col_scan() evaluates predicates 64 rows at a time. Each predicate on
+ * a block is a few vector loads, a compare and a movemask that yield one bit
+ * per row, and the predicates of a block are combined before moving on so
+ * that the result is written once. A block stops being tested as soon as no
+ * row in it is left.
+ *
+ * Columns are padded with zero rows to a multiple of 64 so the kernels never
+ * handle a partial block. Bits of padding rows are cleared in the result.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* offsetof()
+ */
+#include <stddef.h>
+
+/* posix_memalign()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memset()
+ * memcpy()
+ */
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+/* _mm256_cmpeq_epi8()
+ * _mm256_movemask_epi8()
+ */
+#include <immintrin.h>
+#endif
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_COL_BLOCK 	64 		//!< Rows per predicate kernel call and per word of the result
+#define PCIE_COL_ALIGN 	64 		//!< Alignment of every column
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Location and width of a column in struct pcie_col
+ */
+struct pcie_col_def
+{
+	size_t off; 		//!< offsetof() the column pointer
+	unsigned width; 	//!< Bytes per row: 1, 2, 4 or 8
+};
+
+/**
+ * Predicate kernel: return bit n set if (col[n] & mask) == val, for 64 rows
+ */
+typedef __u64 (*pcie_col_fn)(const void *col, __u64 mask, __u64 val);
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#define PCIE_COL_DEF(member) 	{ offsetof(struct pcie_col, member), sizeof(*((struct pcie_col*) 0)->member) }
+
+/**
+ * enum _PCCL -> column
+ */
+static const struct pcie_col_def PCIE_COL_DEFS[PCCL_MAX] =
+{
+	[PCCL_BDF] 			= PCIE_COL_DEF(bdf),
+	[PCCL_VENDOR] 		= PCIE_COL_DEF(vendor),
+	[PCCL_DEVICE] 		= PCIE_COL_DEF(device),
+	[PCCL_COMMAND] 		= PCIE_COL_DEF(command),
+	[PCCL_STATUS] 		= PCIE_COL_DEF(status),
+	[PCCL_BASECLASS] 	= PCIE_COL_DEF(baseclass),
+	[PCCL_SUBCLASS] 	= PCIE_COL_DEF(subclass),
+	[PCCL_PI] 			= PCIE_COL_DEF(pi),
+	[PCCL_TYPE] 		= PCIE_COL_DEF(type),
+	[PCCL_CAPS] 		= PCIE_COL_DEF(caps),
+	[PCCL_ECAPS] 		= PCIE_COL_DEF(ecaps),
+};
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Predicate kernels - portable versions
+ *
+ * Written without branches so that the compiler can vectorize them for the
+ * baseline instruction set of the target
+ */
+#define PCIE_COL_SCALAR(bits, type) \
+	static __u64 pcie_col_eq##bits##_scalar(const void *col, __u64 mask, __u64 val) \
+	{ \
+		const type *x = col; \
+		__u64 m = 0; \
+		unsigned i; \
+		for (i = 0 ; i < PCIE_COL_BLOCK ; i++) \
+			m |= (__u64) ((x[i] & (type) mask) == (type) val) << i; \
+		return m; \
+	}
+
+PCIE_COL_SCALAR(8, __u8)
+PCIE_COL_SCALAR(16, __u16)
+PCIE_COL_SCALAR(32, __u32)
+PCIE_COL_SCALAR(64, __u64)
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * Predicate kernel for 8-bit columns - AVX2 version
+ */
+__attribute__((target("avx2")))
+static __u64 pcie_col_eq8_avx2(const void *col, __u64 mask, __u64 val)
+{
+	const __m256i *x = col;
+	__m256i m = _mm256_set1_epi8((char) mask);
+	__m256i v = _mm256_set1_epi8((char) val);
+	__u64 lo = (__u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(_mm256_load_si256(&x[0]), m), v));
+	__u64 hi = (__u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(_mm256_load_si256(&x[1]), m), v));
+
+	return lo | (hi << 32);
+}
+
+/**
+ * Predicate kernel for 16-bit columns - AVX2 version
+ *
+ * Compare results are narrowed to bytes with a pack, which works within each
+ * 128-bit lane, so the 64-bit quarters are put back in row order before the
+ * movemask
+ */
+__attribute__((target("avx2")))
+static __u64 pcie_col_eq16_avx2(const void *col, __u64 mask, __u64 val)
+{
+	const __m256i *x = col;
+	__m256i m = _mm256_set1_epi16((short) mask);
+	__m256i v = _mm256_set1_epi16((short) val);
+	__m256i e[4], p;
+	__u64 r = 0;
+	unsigned i;
+
+	for (i = 0 ; i < 4 ; i++)
+		e[i] = _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_load_si256(&x[i]), m), v);
+
+	for (i = 0 ; i < 2 ; i++) {
+		p = _mm256_permute4x64_epi64(_mm256_packs_epi16(e[2 * i], e[2 * i + 1]), 0xD8);
+		r |= (__u64) (__u32) _mm256_movemask_epi8(p) << (32 * i);
+	}
+	return r;
+}
+
+/**
+ * Predicate kernel for 32-bit columns - AVX2 version
+ */
+__attribute__((target("avx2")))
+static __u64 pcie_col_eq32_avx2(const void *col, __u64 mask, __u64 val)
+{
+	const __m256i *x = col;
+	__m256i m = _mm256_set1_epi32((int) mask);
+	__m256i v = _mm256_set1_epi32((int) val);
+	__u64 r = 0;
+	unsigned i;
+
+	for (i = 0 ; i < 8 ; i++)
+		r |= (__u64) _mm256_movemask_ps(_mm256_castsi256_ps(
+				_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_load_si256(&x[i]), m), v))) << (8 * i);
+	return r;
+}
+
+/**
+ * Predicate kernel for 64-bit columns - AVX2 version
+ */
+__attribute__((target("avx2")))
+static __u64 pcie_col_eq64_avx2(const void *col, __u64 mask, __u64 val)
+{
+	const __m256i *x = col;
+	__m256i m = _mm256_set1_epi64x((long long) mask);
+	__m256i v = _mm256_set1_epi64x((long long) val);
+	__u64 r = 0;
+	unsigned i;
+
+	for (i = 0 ; i < 16 ; i++)
+		r |= (__u64) _mm256_movemask_pd(_mm256_castsi256_pd(
+				_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_load_si256(&x[i]), m), v))) << (4 * i);
+	return r;
+}
+
+#endif
+
+/**
+ * Select the fastest predicate kernel for a column width supported by this CPU
+ */
+static pcie_col_fn pcie_col_kernel(unsigned width)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("avx2"))
+	{
+		switch (width)
+		{
+			case 1: return pcie_col_eq8_avx2;
+			case 2: return pcie_col_eq16_avx2;
+			case 4: return pcie_col_eq32_avx2;
+			default: return pcie_col_eq64_avx2;
+		}
+	}
+#endif
+	switch (width)
+	{
+		case 1: return pcie_col_eq8_scalar;
+		case 2: return pcie_col_eq16_scalar;
+		case 4: return pcie_col_eq32_scalar;
+		default: return pcie_col_eq64_scalar;
+	}
+}
+
+/**
+ * Return the array of a column
+ */
+static inline void *pcie_col_ptr(const struct pcie_col *c, unsigned col)
+{
+	void *p;
+
+	memcpy(&p, (const char*) c + PCIE_COL_DEFS[col].off, sizeof(p));
+	return p;
+}
+
+/**
+ * Allocate a store for up to max rows
+ *
+ * @param c 	struct pcie_col* to initialize. Release with pcie_col_free()
+ * @param max 	Maximum number of rows
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_col_init(struct pcie_col *c, size_t max)
+{
+	size_t cap, off, len;
+	unsigned i;
+	void *mem, *p;
+
+	memset(c, 0, sizeof(*c));
+
+	cap = (max + PCIE_COL_BLOCK - 1) / PCIE_COL_BLOCK * PCIE_COL_BLOCK;
+	if (cap == 0 || cap < max || cap > ((size_t) -1) / 64) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Each column is a multiple of 64 rows, so every one stays aligned
+	len = 0;
+	for (i = 0 ; i < PCCL_MAX ; i++)
+		len += cap * PCIE_COL_DEFS[i].width;
+
+	if (posix_memalign(&mem, PCIE_COL_ALIGN, len) != 0) {
+		errno = ENOMEM;
+		return -1;
+	}
+	memset(mem, 0, len);
+
+	off = 0;
+	for (i = 0 ; i < PCCL_MAX ; i++) {
+		p = (char*) mem + off;
+		memcpy((char*) c + PCIE_COL_DEFS[i].off, &p, sizeof(p));
+		off += cap * PCIE_COL_DEFS[i].width;
+	}
+
+	c->mem = mem;
+	c->cap = cap;
+	return 0;
+}
+
+/**
+ * Release a store
+ */
+void pcie_col_free(struct pcie_col *c)
+{
+	if (c == NULL)
+		return;
+
+	free(c->mem);
+	memset(c, 0, sizeof(*c));
+}
+
+/**
+ * Append the header fields of a config space image as a new row
+ *
+ * The Capability bitmaps have bit n set when Capability ID n, or Extended
+ * Capability ID n, is present. IDs of 64 and above are not recorded.
+ *
+ * @param c 		struct pcie_col* initialized with pcie_col_init()
+ * @param bdf 		BDF of the function
+ * @param cfgspace 	__u8* to a config space image (PCLN_CFG bytes)
+ * @return 			Row number upon success, -1 if the store is full with errno set
+ */
+long pcie_col_add(struct pcie_col *c, __u32 bdf, __u8 *cfgspace)
+{
+	struct pcie_cap_index idx;
+	__u64 caps, ecaps;
+	size_t n;
+	unsigned i;
+
+	if (c->num >= c->cap) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	pcie_cap_index_build(&idx, cfgspace);
+	caps = 0;
+	ecaps = 0;
+	for (i = 0 ; i < PCAP_MAX && i < 64 ; i++)
+		caps |= (__u64) (idx.cap[i] != 0) << i;
+	for (i = 0 ; i < PCEC_MAX && i < 64 ; i++)
+		ecaps |= (__u64) (idx.ecap[i] != 0) << i;
+
+	n = c->num++;
+	c->bdf[n] = bdf;
+	c->vendor[n] = pcie_get_hdr_vendor(cfgspace);
+	c->device[n] = pcie_get_hdr_device(cfgspace);
+	c->command[n] = pcie_get_hdr_command(cfgspace);
+	c->status[n] = pcie_get_hdr_status(cfgspace);
+	c->baseclass[n] = pcie_get_hdr_baseclass(cfgspace);
+	c->subclass[n] = pcie_get_hdr_subclass(cfgspace);
+	c->pi[n] = pcie_get_hdr_pi(cfgspace);
+	c->type[n] = pcie_get_hdr_type(cfgspace);
+	c->caps[n] = caps;
+	c->ecaps[n] = ecaps;
+	return n;
+}
+
+/**
+ * Append rows for an array of config space images
+ *
+ * @param c 		struct pcie_col* initialized with pcie_col_init()
+ * @param images 	__u8* to num images of PCLN_CFG bytes each
+ * @param bdfs 		__u32* BDF of each image
+ * @param num 		Number of images
+ * @return 			Number of rows added. Less than num if the store filled up
+ */
+size_t pcie_col_load(struct pcie_col *c, __u8 *images, const __u32 *bdfs, size_t num)
+{
+	size_t i;
+
+	for (i = 0 ; i < num ; i++)
+		if (pcie_col_add(c, bdfs[i], &images[i * PCLN_CFG]) < 0)
+			break;
+	return i;
+}
+
+/**
+ * Find the rows that match every predicate
+ *
+ * A row matches predicate p if (column & p->mask) == p->val, or the opposite
+ * when p->neg is set. For example, "Mass Storage NVM functions with Bus
+ * Master disabled" is
+ *
+ *   { PCCL_BASECLASS, 0, 0xFF, PCBC_MSC }
+ *   { PCCL_SUBCLASS, 0, 0xFF, PCMS_NVM }
+ *   { PCCL_COMMAND, 0, 0x0004, 0 }
+ *
+ * and "has AER" is { PCCL_ECAPS, 0, 1ULL << PCEC_AER, 1ULL << PCEC_AER }.
+ * With no predicates every row matches.
+ *
+ * @param c 	struct pcie_col* to scan
+ * @param p 	struct pcie_col_pred* array of npred predicates
+ * @param npred Number of predicates
+ * @param bits 	__u64* to (c->num + 63) / 64 words that receive one bit per
+ * 				row, row n in bit n % 64 of word n / 64
+ * @return 		Number of matching rows, or -1 upon error with errno set
+ */
+long pcie_col_scan(const struct pcie_col *c, const struct pcie_col_pred *p, unsigned npred, __u64 *bits)
+{
+	pcie_col_fn fn[PCIE_COL_PRED_MAX];
+	const char *col[PCIE_COL_PRED_MAX];
+	unsigned width[PCIE_COL_PRED_MAX];
+	size_t b, nblk;
+	unsigned i;
+	long cnt;
+	__u64 w;
+
+	if (npred > PCIE_COL_PRED_MAX || (npred > 0 && p == NULL) || (c->num > 0 && bits == NULL)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (i = 0 ; i < npred ; i++)
+	{
+		if (p[i].col >= PCCL_MAX) {
+			errno = EINVAL;
+			return -1;
+		}
+		width[i] = PCIE_COL_DEFS[p[i].col].width;
+		col[i] = pcie_col_ptr(c, p[i].col);
+		fn[i] = pcie_col_kernel(width[i]);
+	}
+
+	cnt = 0;
+	nblk = (c->num + PCIE_COL_BLOCK - 1) / PCIE_COL_BLOCK;
+	for (b = 0 ; b < nblk ; b++)
+	{
+		w = ~0ULL;
+		for (i = 0 ; i < npred && w != 0 ; i++)
+			w &= fn[i](col[i] + b * PCIE_COL_BLOCK * width[i], p[i].mask, p[i].val) ^ (p[i].neg ? ~0ULL : 0);
+
+		// Padding rows of the last block
+		if (b == nblk - 1 && c->num % PCIE_COL_BLOCK != 0)
+			w &= (1ULL << (c->num % PCIE_COL_BLOCK)) - 1;
+
+		bits[b] = w;
+		cnt += __builtin_popcountll(w);
+	}
+	return cnt;
+}
@@ -0,0 +1,357 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		dcache.c
+ *
+ * @brief 		Code file for the incremental decode cache
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Periodic scans of a host mostly see the same config space images again. The
+ * cache keeps the decoded result of each BDF together with a mask of the 64
+ * byte blocks the Capability walks read and a 64-bit fingerprint of the header
+ * block plus those blocks. Nothing else in the image can change the result,
+ * so nothing else is hashed. When an image comes back its fingerprint is
+ * computed over the same blocks and compared once:
+ *
+ * - equal: the previous result is returned as is
+ * - different, but the walked blocks and the Capability Pointer are not: the
+ *   header fields are decoded again and the index is kept
+ * - otherwise the image is decoded in full and the walked blocks recorded
+ *
+ * The fingerprint is four CRC32C lanes where the CPU has an instruction for
+ * it and four multiply / xor-shift lanes elsewhere, folded into 64 bits. A
+ * change confined to one register always gets a new fingerprint; larger
+ * changes collide with a chance of about 2^-64. It is not meant to resist
+ * images crafted to collide, and is only compared against fingerprints
+ * computed by the same process.
+ *
+ * The table is an open addressing hash table with linear probing like the
+ * Device Serial Number index. It does not grow and entries are never removed:
+ * size it for the expected number of BDFs with pcie_dcache_init(). A cache is
+ * used by one thread at a time.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* calloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memset()
+ * memcpy()
+ */
+#include <string.h>
+
+#if defined(__x86_64__)
+/* _mm_crc32_u64()
+ */
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+/* __crc32cd()
+ */
+#include <arm_acle.h>
+#endif
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_DCACHE_BLOCK 	64 		//!< Bytes per bit of the walked block mask
+#define PCIE_DCACHE_MUL 	0x9E3779B97F4A7C15ULL 	//!< Odd multiplier of the fingerprint lanes
+
+/**
+ * One step of a fingerprint lane. Invertible in h for a fixed w and in w for a
+ * fixed h
+ */
+#define PCIE_DCACHE_STEP(h, w) 	do { (h) = ((h) ^ (w)) * PCIE_DCACHE_MUL; (h) ^= (h) >> 29; } while (0)
+
+#if defined(__x86_64__)
+#define PCIE_DCACHE_CRC(c, w) 	_mm_crc32_u64(c, w)
+#define PCIE_DCACHE_TARGET 		__attribute__((target("sse4.2")))
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define PCIE_DCACHE_CRC(c, w) 	((__u64) __crc32cd((__u32) (c), w))
+#define PCIE_DCACHE_TARGET
+#endif
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Fingerprint the blocks of an image selected by a mask - portable version
+ *
+ * Word n of each block goes to lane n % 4 so that the multiplies of the four
+ * lanes overlap rather than form one dependency chain.
+ */
+static __u64 pcie_dcache_fp_mul(const __u8 *cfgspace, __u64 mask)
+{
+	__u64 h0, h1, h2, h3, w0, w1, w2, w3;
+	const __u8 *p;
+	unsigned i;
+
+	h0 = mask;
+	h1 = mask ^ 0x243F6A8885A308D3ULL;
+	h2 = mask ^ 0x13198A2E03707344ULL;
+	h3 = mask ^ 0xA4093822299F31D0ULL;
+
+	for ( ; mask != 0 ; mask &= mask - 1)
+	{
+		p = &cfgspace[__builtin_ctzll(mask) * PCIE_DCACHE_BLOCK];
+		for (i = 0 ; i < PCIE_DCACHE_BLOCK ; i += 32)
+		{
+			memcpy(&w0, &p[i], 8);
+			memcpy(&w1, &p[i + 8], 8);
+			memcpy(&w2, &p[i + 16], 8);
+			memcpy(&w3, &p[i + 24], 8);
+			PCIE_DCACHE_STEP(h0, w0);
+			PCIE_DCACHE_STEP(h1, w1);
+			PCIE_DCACHE_STEP(h2, w2);
+			PCIE_DCACHE_STEP(h3, w3);
+		}
+	}
+
+	PCIE_DCACHE_STEP(h0, h1);
+	PCIE_DCACHE_STEP(h0, h2);
+	PCIE_DCACHE_STEP(h0, h3);
+	return h0;
+}
+
+#if defined(PCIE_DCACHE_CRC)
+
+/**
+ * Fingerprint the blocks of an image selected by a mask - CRC32C version
+ *
+ * Word n of each block goes to lane n % 4 so that the CRC instruction latency
+ * of one lane is hidden behind the others. Lanes 0 and 1 form the low half of
+ * the result and lanes 2 and 3, mixed, are xored into it, so a change seen by
+ * only one pair of lanes cannot cancel out.
+ */
+PCIE_DCACHE_TARGET
+static __u64 pcie_dcache_fp_crc(const __u8 *cfgspace, __u64 mask)
+{
+	__u64 c0, c1, c2, c3, w0, w1, w2, w3;
+	const __u8 *p;
+	unsigned i;
+
+	c0 = c1 = c2 = c3 = (__u32) mask;
+
+	for ( ; mask != 0 ; mask &= mask - 1)
+	{
+		p = &cfgspace[__builtin_ctzll(mask) * PCIE_DCACHE_BLOCK];
+		for (i = 0 ; i < PCIE_DCACHE_BLOCK ; i += 32)
+		{
+			memcpy(&w0, &p[i], 8);
+			memcpy(&w1, &p[i + 8], 8);
+			memcpy(&w2, &p[i + 16], 8);
+			memcpy(&w3, &p[i + 24], 8);
+			c0 = PCIE_DCACHE_CRC(c0, w0);
+			c1 = PCIE_DCACHE_CRC(c1, w1);
+			c2 = PCIE_DCACHE_CRC(c2, w2);
+			c3 = PCIE_DCACHE_CRC(c3, w3);
+		}
+	}
+
+	return (c0 | c1 << 32) ^ pcie_mix64(c2 | c3 << 32);
+}
+
+#endif
+
+/**
+ * Fingerprint the 64 byte blocks of an image selected by a mask with the
+ * fastest version supported by this CPU
+ *
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @param mask 		Blocks to hash. Bit n = [n*64, n*64+63]
+ * @return 			64-bit fingerprint
+ */
+static __u64 pcie_dcache_fp(const __u8 *cfgspace, __u64 mask)
+{
+#if defined(__x86_64__)
+	if (__builtin_cpu_supports("sse4.2"))
+		return pcie_dcache_fp_crc(cfgspace, mask);
+#elif defined(PCIE_DCACHE_CRC)
+	return pcie_dcache_fp_crc(cfgspace, mask);
+#endif
+	return pcie_dcache_fp_mul(cfgspace, mask);
+}
+
+/**
+ * Return the offset the Capability walk starts at, or 0 if there is none
+ */
+static unsigned pcie_dcache_capptr(__u8 *cfgspace)
+{
+	if (!pcie_get_status_cap(cfgspace))
+		return 0;
+	if (pcie_get_type_type(cfgspace) == 2)
+		return pcie_get_hdr2_cap(cfgspace) & PCIE_CAP_OFFSET_MASK;
+	return pcie_get_hdr_cap(cfgspace) & PCIE_CAP_OFFSET_MASK;
+}
+
+/**
+ * Return a mask of the blocks pcie_cap_index_build() read to build an index
+ *
+ * Those are the blocks holding an entry of either chain, the first Extended
+ * Capability and the entry the Extended Capability walk stopped at. The header
+ * block is not included.
+ */
+static __u64 pcie_dcache_walked(const struct pcie_cap_index *idx, __u8 *cfgspace)
+{
+	__u64 mask;
+	unsigned i, off;
+
+	mask = 1ULL << (PCIE_ECAP_START / PCIE_DCACHE_BLOCK);
+
+	for (i = 0 ; i < idx->ncap ; i++)
+		mask |= 1ULL << (idx->caps[i].offset / PCIE_DCACHE_BLOCK);
+
+	for (i = 0 ; i < idx->necap ; i++)
+		mask |= 1ULL << (idx->ecaps[i].offset / PCIE_DCACHE_BLOCK);
+
+	if (idx->necap > 0) {
+		off = pcie_get_ecap_next(&cfgspace[idx->ecaps[idx->necap - 1].offset]) & PCIE_CAP_OFFSET_MASK_EXT;
+		if (off >= PCIE_ECAP_START && off <= PCLN_CFG - sizeof(struct pcie_ecap))
+			mask |= 1ULL << (off / PCIE_DCACHE_BLOCK);
+	}
+
+	return mask;
+}
+
+/**
+ * Allocate an empty cache
+ *
+ * @param c 	struct pcie_dcache* to initialize. Release with pcie_dcache_free()
+ * @param max 	Number of BDFs the cache must be able to hold
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_dcache_init(struct pcie_dcache *c, __u64 max)
+{
+	__u64 n;
+
+	if (c == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(c, 0, sizeof(*c));
+
+	n = 16;
+	while (PCIE_HASH_LOAD(n) < max) {
+		if (n >> 62) {
+			errno = ENOMEM;
+			return -1;
+		}
+		n <<= 1;
+	}
+
+	c->ent = calloc(n, sizeof(*c->ent));
+	c->dec = calloc(PCIE_HASH_LOAD(n), sizeof(*c->dec));
+	if (c->ent == NULL || c->dec == NULL) {
+		free(c->ent);
+		free(c->dec);
+		c->ent = NULL;
+		c->dec = NULL;
+		return -1;
+	}
+
+	c->mask = n - 1;
+	return 0;
+}
+
+/**
+ * Release a cache. Results returned by pcie_dcache_decode() become invalid
+ */
+void pcie_dcache_free(struct pcie_dcache *c)
+{
+	if (c == NULL)
+		return;
+
+	free(c->ent);
+	free(c->dec);
+	memset(c, 0, sizeof(*c));
+}
+
+/**
+ * Decode a config space image, reusing the previous result for the same BDF
+ * as far as the image allows
+ *
+ * The result is identical to what pcie_decode() would produce for the image.
+ * It stays valid until the next call for the same BDF or pcie_dcache_free().
+ *
+ * @param c 		struct pcie_dcache* initialized with pcie_dcache_init()
+ * @param bdf 		BDF of the device. See PCIE_BDF()
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @param out 		Receives a pointer to the decoded result
+ * @return 			enum _PCCH upon success, -1 upon error with errno set
+ */
+int pcie_dcache_decode(struct pcie_dcache *c, __u32 bdf, __u8 *cfgspace, const struct pcie_dec **out)
+{
+	struct pcie_dcache_ent *e;
+	struct pcie_dec *d;
+	__u64 i, fp;
+	int rv;
+
+	if (c == NULL || c->ent == NULL || cfgspace == NULL || out == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	i = pcie_mix64(bdf) & c->mask;
+	while (c->ent[i].used && c->ent[i].bdf != bdf)
+		i = (i + 1) & c->mask;
+	e = &c->ent[i];
+
+	if (!e->used)
+	{
+		if (c->num >= PCIE_HASH_LOAD(c->mask + 1)) {
+			errno = ENOSPC;
+			return -1;
+		}
+		e->used = 1;
+		e->bdf = bdf;
+		e->dec = c->num++;
+		rv = PCCH_NEW;
+	}
+	else
+	{
+		// Only the header and the blocks the last walk read can change the result
+		fp = pcie_dcache_fp(cfgspace, e->walked | 1);
+
+		if (fp == e->fp)
+			rv = PCCH_HIT;
+		else if (pcie_dcache_fp(cfgspace, e->walked) == e->fp_caps && pcie_dcache_capptr(cfgspace) == e->capptr)
+			rv = PCCH_HDR;
+		else
+			rv = PCCH_WALK;
+	}
+
+	d = &c->dec[e->dec];
+	if (rv == PCCH_HDR) {
+		pcie_decode_hdr(d, cfgspace);
+		e->fp = fp;
+	}
+	else if (rv != PCCH_HIT) {
+		pcie_decode(d, cfgspace);
+		e->capptr = pcie_dcache_capptr(cfgspace);
+		e->walked = pcie_dcache_walked(&d->idx, cfgspace);
+		e->fp = pcie_dcache_fp(cfgspace, e->walked | 1);
+		e->fp_caps = pcie_dcache_fp(cfgspace, e->walked);
+	}
+
+	c->stat[rv]++;
+	*out = d;
+	return rv;
+}
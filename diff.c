@@ -0,0 +1,362 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		diff.c
+ *
+ * @brief 		Code file for comparing PCIe Config space images
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ * 
+ * Images are compared in 64 byte blocks. Each block produces a 64-bit mask 
+ * with one bit per differing byte so that identical blocks cost a couple of
+ * vector compares and changed bytes can be visited with a count trailing 
+ * zeros loop rather than a byte by byte scan. 
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* memcpy()
+ * memset()
+ */
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+/* _mm_cmpeq_epi8()
+ * _mm256_cmpeq_epi8()
+ */
+#include <immintrin.h>
+#endif
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_DIFF_BLOCK 	64 		//!< Bytes compared per block
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Return a mask of differing bytes in a 64 byte block - portable version 
+ */
+static __u64 pcie_diff_block_scalar(const __u8 *a, const __u8 *b)
+{
+	__u64 x, y, mask;
+	unsigned i, j;
+
+	mask = 0;
+	for (i = 0 ; i < PCIE_DIFF_BLOCK ; i += 8)
+	{
+		memcpy(&x, &a[i], 8);
+		memcpy(&y, &b[i], 8);
+		if (x == y)
+			continue;
+		for (j = 0 ; j < 8 ; j++)
+			if (a[i + j] != b[i + j])
+				mask |= 1ULL << (i + j);
+	}
+	return mask;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * Return a mask of differing bytes in a 64 byte block - SSE2 version 
+ */
+__attribute__((target("sse2")))
+static __u64 pcie_diff_block_sse2(const __u8 *a, const __u8 *b)
+{
+	__u64 eq;
+	unsigned i;
+
+	eq = 0;
+	for (i = 0 ; i < PCIE_DIFF_BLOCK ; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*) &a[i]);
+		__m128i y = _mm_loadu_si128((const __m128i*) &b[i]);
+		eq |= (__u64) (__u16) _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) << i;
+	}
+	return ~eq;
+}
+
+/**
+ * Return a mask of differing bytes in a 64 byte block - AVX2 version 
+ */
+__attribute__((target("avx2")))
+static __u64 pcie_diff_block_avx2(const __u8 *a, const __u8 *b)
+{
+	__m256i x0 = _mm256_loadu_si256((const __m256i*) &a[0]);
+	__m256i y0 = _mm256_loadu_si256((const __m256i*) &b[0]);
+	__m256i x1 = _mm256_loadu_si256((const __m256i*) &a[32]);
+	__m256i y1 = _mm256_loadu_si256((const __m256i*) &b[32]);
+	__u64 lo = (__u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x0, y0));
+	__u64 hi = (__u32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x1, y1));
+
+	return ~(lo | (hi << 32));
+}
+
+#endif
+
+/**
+ * Select the fastest block compare supported by this CPU
+ */
+static __u64 (*pcie_diff_block_fn(void))(const __u8 *, const __u8 *)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("avx2"))
+		return pcie_diff_block_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return pcie_diff_block_sse2;
+#endif
+	return pcie_diff_block_scalar;
+}
+
+/**
+ * Return a mask of the 64 byte blocks that differ between two images 
+ *
+ * Bit n is set if any byte in [n*64, n*64+63] differs. 
+ *
+ * @param a 	__u8* to a config space image (PCLN_CFG bytes)
+ * @param b 	__u8* to a config space image (PCLN_CFG bytes)
+ * @return 		Bitmask of differing blocks. 0 if the images are identical
+ */
+__u64 pcie_cfg_diff_blocks(__u8 *a, __u8 *b)
+{
+	__u64 (*block)(const __u8 *, const __u8 *);
+	__u64 mask;
+	unsigned i;
+
+	block = pcie_diff_block_fn();
+
+	mask = 0;
+	for (i = 0 ; i < PCLN_CFG / PCIE_DIFF_BLOCK ; i++)
+		if (block(&a[i * PCIE_DIFF_BLOCK], &b[i * PCIE_DIFF_BLOCK]))
+			mask |= 1ULL << i;
+	return mask;
+}
+
+/**
+ * Sort index entries by offset. Lists are short so insertion sort is used
+ */
+static void pcie_diff_sort(const struct pcie_cap_ent **list, unsigned num)
+{
+	const struct pcie_cap_ent *e;
+	unsigned i, j;
+
+	for (i = 1 ; i < num ; i++) 
+	{
+		e = list[i];
+		for (j = i ; j > 0 && list[j - 1]->offset > e->offset ; j--)
+			list[j] = list[j - 1];
+		list[j] = e;
+	}
+}
+
+/**
+ * Return the register set describing a Capability, or NULL if there is none
+ */
+static const struct pcie_regset *pcie_diff_regset(unsigned ext, unsigned id)
+{
+	if (ext)
+		return (id == PCEC_DSN) ? &PCIE_REGS_DSN : &PCIE_REGS_ECAP;
+
+	switch (id)
+	{
+		case PCAP_PM: 	return &PCIE_REGS_PM;
+		case PCAP_MSI: 	return &PCIE_REGS_MSI;
+		case PCAP_MSIX: return &PCIE_REGS_MSIX;
+	}
+	return NULL;
+}
+
+/**
+ * Return the length in bytes of a Capability whose layout is known, or 0
+ */
+static unsigned pcie_diff_cap_len(const __u8 *cfgspace, unsigned ext, unsigned id, unsigned off)
+{
+	const __u8 *p = &cfgspace[off];
+
+	if (ext)
+		return (id == PCEC_DSN) ? 12 : 0;
+
+	switch (id)
+	{
+		case PCAP_PM: 	return 8;
+		case PCAP_MSI: 	return 10 + 4 * pcie_get_msi_bit64(p) + 10 * pcie_get_msi_maskable(p);
+		case PCAP_MSIX: return 12;
+		case PCAP_EXP: 	return 0x3C;
+	}
+	return 0;
+}
+
+/**
+ * Describe the register that contains a config space offset 
+ *
+ * Registers with metadata are reported at their natural width. Anything else 
+ * is reported as the dword containing it. Offsets beyond the header are 
+ * attributed to the nearest Capability that starts at or below them, as long 
+ * as they fall before the end of that Capability's known layout, the start of
+ * the next Capability and the end of the region. Other offsets are reported
+ * with cap_id 0. 
+ */
+static void pcie_diff_locate(struct pcie_diff *d, unsigned off, const __u8 *cfgspace, const struct pcie_regset *hdr, 
+	const struct pcie_cap_ent **caps, unsigned ncap, const struct pcie_cap_ent **ecaps, unsigned necap)
+{
+	const struct pcie_cap_ent **list, *e;
+	const struct pcie_regset *set;
+	const struct pcie_reg *r;
+	unsigned i, num, end, len;
+
+	memset(d, 0, sizeof(*d));
+
+	if (off < PCLN_HDR) 
+	{
+		r = pcie_reg_at(hdr, off);
+		d->offset = r->off;
+		d->len = r->len;
+		d->name = r->name;
+		d->reg = r;
+		return;
+	}
+
+	d->offset = off & ~3u;
+	d->len = 4;
+
+	if (off < PCIE_ECAP_START) {
+		list = caps;
+		num = ncap;
+		end = PCIE_ECAP_START;
+	}
+	else {
+		list = ecaps;
+		num = necap;
+		end = PCLN_CFG;
+		d->ext = 1;
+	}
+
+	e = NULL;
+	for (i = 0 ; i < num && list[i]->offset <= off ; i++)
+		e = list[i];
+
+	if (e == NULL)
+		return;
+
+	if (i < num)
+		end = list[i]->offset;
+	len = pcie_diff_cap_len(cfgspace, d->ext, e->id, e->offset);
+	if (len != 0 && e->offset + len < end)
+		end = e->offset + len;
+	if (off >= end)
+		return;
+
+	d->cap_id = e->id;
+	d->cap_off = e->offset;
+	d->name = d->ext ? pcec(e->id) : pcap(e->id);
+
+	set = pcie_diff_regset(d->ext, e->id);
+	r = set ? pcie_reg_at(set, off - e->offset) : NULL;
+	if (r != NULL) {
+		d->offset = e->offset + r->off;
+		d->len = r->len;
+		d->reg = r;
+	}
+}
+
+/**
+ * Compare two config space images and report every changed register 
+ *
+ * Changed bytes are located with wide vector compares (AVX2 or SSE2 when the 
+ * CPU supports them) and mapped through the register metadata to the header 
+ * field or Capability register that contains them. Capabilities are located by walking the 
+ * chains of the first image. Several changed bytes in the same register 
+ * produce one report. 
+ *
+ * @param a 	__u8* to the reference image (PCLN_CFG bytes)
+ * @param b 	__u8* to the image to compare against it (PCLN_CFG bytes)
+ * @param out 	struct pcie_diff* array to receive reports. May be NULL if max is 0
+ * @param max 	Number of entries in out
+ * @return 		Number of changed registers, which may exceed max, or -1 if a or 
+ * 				b is NULL
+ */
+int pcie_cfg_diff(__u8 *a, __u8 *b, struct pcie_diff *out, unsigned max)
+{
+	__u64 (*block)(const __u8 *, const __u8 *);
+	const struct pcie_regset *hdr;
+	const struct pcie_cap_ent *caps[PCLN_CAPS];
+	const struct pcie_cap_ent *ecaps[PCLN_ECAPS];
+	struct pcie_cap_index idx;
+	struct pcie_diff d, *last;
+	unsigned i, blk, off, ncap, necap, indexed;
+	__u64 mask;
+	int num;
+
+	if (a == NULL || b == NULL)
+		return -1;
+
+	block = pcie_diff_block_fn();
+	hdr = pcie_reg_hdr(a);
+
+	num = 0;
+	last = NULL;
+	indexed = 0;
+	ncap = 0;
+	necap = 0;
+
+	for (blk = 0 ; blk < PCLN_CFG / PCIE_DIFF_BLOCK ; blk++)
+	{
+		mask = block(&a[blk * PCIE_DIFF_BLOCK], &b[blk * PCIE_DIFF_BLOCK]);
+
+		while (mask)
+		{
+			off = blk * PCIE_DIFF_BLOCK + __builtin_ctzll(mask);
+			mask &= mask - 1;
+
+			// Byte is in the register already reported
+			if (last != NULL && off < (unsigned) last->offset + last->len) {
+				last->mask |= (__u32) (a[off] ^ b[off]) << (8 * (off - last->offset));
+				continue;
+			}
+
+			// Only walk the Capability chains once something beyond the header changed
+			if (!indexed && off >= PCLN_HDR) 
+			{
+				pcie_cap_index_build(&idx, a);
+				for (i = 0 ; i < idx.ncap ; i++)
+					caps[ncap++] = &idx.caps[i];
+				for (i = 0 ; i < idx.necap ; i++)
+					ecaps[necap++] = &idx.ecaps[i];
+				pcie_diff_sort(caps, ncap);
+				pcie_diff_sort(ecaps, necap);
+				indexed = 1;
+			}
+
+			pcie_diff_locate(&d, off, a, hdr, caps, ncap, ecaps, necap);
+
+			// A 3 byte register is loaded as 4 bytes: drop the byte after it
+			d.old = pcie_le(&a[d.offset], d.len) & PCIE_MASK(8 * d.len);
+			d.cur = pcie_le(&b[d.offset], d.len) & PCIE_MASK(8 * d.len);
+			d.mask = (__u32) (a[off] ^ b[off]) << (8 * (off - d.offset));
+
+			if ((unsigned) num < max) {
+				out[num] = d;
+				last = &out[num];
+			}
+			else {
+				// Out of room but keep counting whole registers
+				last = &d;
+			}
+			num++;
+		}
+	}
+
+	return num;
+}
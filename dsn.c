@@ -0,0 +1,242 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		dsn.c
+ *
+ * @brief 		Code file for the Device Serial Number index
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * The index is an open addressing hash table with linear probing over a power
+ * of two number of 16 byte slots. A serial number may be inserted more than
+ * once, e.g. once per snapshot a device appears in, and a lookup returns every
+ * location it was seen at.
+ *
+ * One thread may insert while any number of threads look up without locks. A
+ * slot is filled by writing the location first and then publishing the serial
+ * number with a release store. Readers load the serial number with an acquire
+ * load, so a slot is either seen as empty or with its location complete. Slots
+ * are never moved or removed, which is why the table does not grow: size it
+ * for the expected number of entries with pcie_dsn_init().
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* calloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memset()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Return the Device Serial Number of a config space image
+ *
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @return 			64-bit serial number or 0 if the image has no DSN Capability
+ */
+__u64 pcie_dsn(__u8 *cfgspace)
+{
+	struct pcie_cap_index idx;
+	unsigned off;
+	__u8 *p;
+
+	pcie_cap_index_build(&idx, cfgspace);
+	off = pcie_ecap_find(&idx, PCEC_DSN);
+	if (off == 0 || off > PCLN_CFG - sizeof(struct pcie_ecap) - sizeof(struct pcie_ecap_dsn))
+		return 0;
+
+	p = &cfgspace[off];
+	return ((__u64) pcie_get_dsn_hi(p) << 32) | pcie_get_dsn_lo(p);
+}
+
+/**
+ * Allocate an empty index
+ *
+ * @param idx 	struct pcie_dsn_index* to initialize. Release with pcie_dsn_free()
+ * @param max 	Number of entries the index must be able to hold
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_dsn_init(struct pcie_dsn_index *idx, __u64 max)
+{
+	__u64 n;
+
+	if (idx == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(idx, 0, sizeof(*idx));
+
+	n = 16;
+	while (PCIE_HASH_LOAD(n) < max) {
+		if (n >> 62) {
+			errno = ENOMEM;
+			return -1;
+		}
+		n <<= 1;
+	}
+
+	idx->slot = calloc(n, sizeof(*idx->slot));
+	if (idx->slot == NULL)
+		return -1;
+
+	idx->mask = n - 1;
+	return 0;
+}
+
+/**
+ * Release an index. No readers may be active
+ */
+void pcie_dsn_free(struct pcie_dsn_index *idx)
+{
+	if (idx == NULL)
+		return;
+
+	free(idx->slot);
+	memset(idx, 0, sizeof(*idx));
+}
+
+/**
+ * Add a location for a serial number
+ *
+ * Must not be called from more than one thread at a time. May run
+ * concurrently with pcie_dsn_find()
+ *
+ * @param idx 	struct pcie_dsn_index*
+ * @param dsn 	Serial number. 0 is not a valid serial number
+ * @param snap 	Caller assigned identifier of the snapshot or host
+ * @param bdf 	BDF of the device. See PCIE_BDF()
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_dsn_insert(struct pcie_dsn_index *idx, __u64 dsn, __u32 snap, __u32 bdf)
+{
+	struct pcie_dsn_slot *s;
+	__u64 i;
+
+	if (idx == NULL || idx->slot == NULL || dsn == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (idx->num >= PCIE_HASH_LOAD(idx->mask + 1)) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	i = pcie_mix64(dsn) & idx->mask;
+	while (idx->slot[i].dsn != 0)
+		i = (i + 1) & idx->mask;
+
+	s = &idx->slot[i];
+	s->snap = snap;
+	s->bdf = bdf;
+	__atomic_store_n(&s->dsn, dsn, __ATOMIC_RELEASE);
+
+	idx->num++;
+	return 0;
+}
+
+/**
+ * Extract and add the serial numbers of every device in a snapshot
+ *
+ * Devices without a DSN Capability are skipped
+ *
+ * @param idx 	struct pcie_dsn_index*
+ * @param snap 	struct pcie_snap* opened with pcie_snap_open()
+ * @param id 	Caller assigned identifier stored with each entry
+ * @return 		Number of serial numbers added, or -1 upon error with errno set
+ */
+int pcie_dsn_insert_snap(struct pcie_dsn_index *idx, struct pcie_snap *snap, __u32 id)
+{
+	unsigned i;
+	__u64 dsn;
+	__u8 *cfg;
+	int num;
+
+	if (snap == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	num = 0;
+	for (i = 0 ; i < snap->num ; i++)
+	{
+		// Index entries that do not reference a valid image are skipped
+		cfg = pcie_snap_cfg(snap, i);
+		if (cfg == NULL)
+			continue;
+
+		dsn = pcie_dsn(cfg);
+		if (dsn == 0)
+			continue;
+		if (pcie_dsn_insert(idx, dsn, id, snap->ent[i].bdf) != 0)
+			return -1;
+		num++;
+	}
+	return num;
+}
+
+/**
+ * Find every location recorded for a serial number
+ *
+ * Lock free. Safe to call from any number of threads while one thread inserts
+ *
+ * @param idx 	struct pcie_dsn_index*
+ * @param dsn 	Serial number
+ * @param out 	struct pcie_dsn_slot* array to receive the matches in insertion
+ * 				order. May be NULL if max is 0
+ * @param max 	Number of entries in out
+ * @return 		Number of matches, which may exceed max
+ */
+unsigned pcie_dsn_find(const struct pcie_dsn_index *idx, __u64 dsn, struct pcie_dsn_slot *out, unsigned max)
+{
+	const struct pcie_dsn_slot *s;
+	unsigned num;
+	__u64 i, k;
+
+	if (idx == NULL || idx->slot == NULL || dsn == 0)
+		return 0;
+
+	num = 0;
+	i = pcie_mix64(dsn) & idx->mask;
+	for (;;)
+	{
+		s = &idx->slot[i];
+		k = __atomic_load_n(&s->dsn, __ATOMIC_ACQUIRE);
+		if (k == 0)
+			break;
+		if (k == dsn) {
+			if (num < max) {
+				out[num].dsn = k;
+				out[num].snap = s->snap;
+				out[num].bdf = s->bdf;
+			}
+			num++;
+		}
+		i = (i + 1) & idx->mask;
+	}
+	return num;
+}
@@ -0,0 +1,441 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		emit.c
+ *
+ * @brief 		Code file for streaming JSON and CBOR output of decoded config space
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ * 
+ * Output is written straight into a caller supplied buffer as each value is 
+ * decoded. No document tree is built. When a sink is supplied the buffer is
+ * flushed to it whenever it fills, so memory use is bounded by the buffer size
+ * no matter how many devices are emitted. CBOR maps and arrays use
+ * the indefinite length encoding so that counts need not be known in advance.
+ *
+ * Each device is emitted as:
+ *
+ * { "bdf": "0000:01:00.0", "vendor": 32902, ... one key per header register,
+ *   "class": { "base": "...", "name": "..." },
+ *   "caps": [ { "id": 1, "off": 64, "name": "..." }, ... ],
+ *   "ecaps": [ { "id": 1, "ver": 2, "off": 256, "name": "..." }, ... ] }
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* memset()
+ * strlen()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_EMIT_MAX_DEPTH 	32 		//!< Nesting depth tracked for JSON separators
+
+/* CBOR major types (RFC 8949) */
+#define CBOR_UINT 				0x00
+#define CBOR_TEXT 				0x60
+#define CBOR_ARRAY_INDEF 		0x9F
+#define CBOR_MAP_INDEF 			0xBF
+#define CBOR_NULL 				0xF6
+#define CBOR_BREAK 				0xFF
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Write the buffered bytes to the sink
+ */
+static int pcie_emit_flush(struct pcie_emit *e)
+{
+	if (e->out == NULL || e->pos == 0)
+		return 0;
+
+	if (pcie_sink_write(e->out, e->buf, e->pos) != 0)
+		e->err = -1;
+	e->pos = 0;
+	return e->err;
+}
+
+/**
+ * Append bytes to the output
+ *
+ * In buffer mode bytes that do not fit are counted in total but dropped, and
+ * the emitter is marked as failed. Without a staging buffer bytes are written
+ * straight to the sink 
+ */
+static void pcie_emit_raw(struct pcie_emit *e, const void *data, size_t n)
+{
+	const char *p = data;
+	size_t i;
+
+	e->total += n;
+
+	if (e->len == 0 && n != 0) {
+		if (e->out == NULL || e->err || pcie_sink_write(e->out, p, n) != 0)
+			e->err = -1;
+		return;
+	}
+
+	for (i = 0 ; i < n ; i++)
+	{
+		if (e->pos >= e->len) {
+			if (e->out == NULL || e->err || pcie_emit_flush(e) != 0) {
+				e->err = -1;
+				return;
+			}
+		}
+		e->buf[e->pos++] = p[i];
+	}
+}
+
+/**
+ * Append a CBOR head: major type plus argument in the shortest encoding
+ */
+static void cbor_head(struct pcie_emit *e, __u8 major, __u64 v)
+{
+	__u8 b[9];
+	unsigned n, i;
+
+	if (v < 24) {
+		b[0] = major | v;
+		n = 1;
+	}
+	else if (v <= 0xFF) {
+		b[0] = major | 24;
+		n = 2;
+	}
+	else if (v <= 0xFFFF) {
+		b[0] = major | 25;
+		n = 3;
+	}
+	else if (v <= 0xFFFFFFFF) {
+		b[0] = major | 26;
+		n = 5;
+	}
+	else {
+		b[0] = major | 27;
+		n = 9;
+	}
+
+	// Argument is big endian
+	for (i = 1 ; i < n ; i++)
+		b[i] = v >> (8 * (n - 1 - i));
+
+	pcie_emit_raw(e, b, n);
+}
+
+/**
+ * Append a JSON string with quotes and escapes 
+ */
+static void json_str(struct pcie_emit *e, const char *s)
+{
+	static const char hex[] = "0123456789abcdef";
+	char esc[6] = { '\\', 'u', '0', '0', 0, 0 };
+	const char *p;
+
+	pcie_emit_raw(e, "\"", 1);
+	for (p = s ; *p ; p++) 
+	{
+		if (*p == '"' || *p == '\\') {
+			pcie_emit_raw(e, "\\", 1);
+			pcie_emit_raw(e, p, 1);
+		}
+		else if ((unsigned char) *p < 0x20) {
+			esc[4] = hex[(*p >> 4) & 0xF];
+			esc[5] = hex[*p & 0xF];
+			pcie_emit_raw(e, esc, 6);
+		}
+		else 
+			pcie_emit_raw(e, p, 1);
+	}
+	pcie_emit_raw(e, "\"", 1);
+}
+
+/**
+ * Start a value: emit the JSON separator and key if any 
+ *
+ * @param key 	Map key or NULL for an array element / top level value 
+ */
+static void pcie_emit_key(struct pcie_emit *e, const char *key)
+{
+	if (e->fmt == PCEM_CBOR) {
+		if (key != NULL) {
+			cbor_head(e, CBOR_TEXT, strlen(key));
+			pcie_emit_raw(e, key, strlen(key));
+		}
+		return;
+	}
+
+	if (e->depth > 0 && e->depth <= PCIE_EMIT_MAX_DEPTH) {
+		if (e->first & (1u << (e->depth - 1)))
+			e->first &= ~(1u << (e->depth - 1));
+		else
+			pcie_emit_raw(e, ",", 1);
+	}
+
+	if (key != NULL) {
+		json_str(e, key);
+		pcie_emit_raw(e, ":", 1);
+	}
+}
+
+/**
+ * Open a map or array 
+ */
+static void pcie_emit_open(struct pcie_emit *e, const char *key, int array)
+{
+	__u8 b;
+
+	pcie_emit_key(e, key);
+
+	if (e->fmt == PCEM_CBOR) {
+		b = array ? CBOR_ARRAY_INDEF : CBOR_MAP_INDEF;
+		pcie_emit_raw(e, &b, 1);
+	}
+	else
+		pcie_emit_raw(e, array ? "[" : "{", 1);
+
+	e->depth++;
+	if (e->depth <= PCIE_EMIT_MAX_DEPTH)
+		e->first |= 1u << (e->depth - 1);
+}
+
+/**
+ * Close the innermost map or array 
+ */
+static void pcie_emit_close(struct pcie_emit *e, int array)
+{
+	__u8 b = CBOR_BREAK;
+
+	if (e->depth > 0)
+		e->depth--;
+
+	if (e->fmt == PCEM_CBOR) 
+		pcie_emit_raw(e, &b, 1);
+	else 
+		pcie_emit_raw(e, array ? "]" : "}", 1);
+}
+
+/**
+ * Emit an unsigned integer value 
+ */
+static void pcie_emit_uint(struct pcie_emit *e, const char *key, __u64 v)
+{
+	char tmp[20];
+	unsigned i;
+
+	pcie_emit_key(e, key);
+
+	if (e->fmt == PCEM_CBOR) {
+		cbor_head(e, CBOR_UINT, v);
+		return;
+	}
+
+	i = sizeof(tmp);
+	do {
+		tmp[--i] = '0' + (v % 10);
+		v /= 10;
+	} while (v);
+	pcie_emit_raw(e, &tmp[i], sizeof(tmp) - i);
+}
+
+/**
+ * Emit a string value. NULL is emitted as null 
+ */
+static void pcie_emit_str(struct pcie_emit *e, const char *key, const char *s)
+{
+	__u8 n = CBOR_NULL;
+
+	pcie_emit_key(e, key);
+
+	if (e->fmt == PCEM_CBOR) {
+		if (s == NULL) {
+			pcie_emit_raw(e, &n, 1);
+			return;
+		}
+		cbor_head(e, CBOR_TEXT, strlen(s));
+		pcie_emit_raw(e, s, strlen(s));
+		return;
+	}
+
+	if (s == NULL)
+		pcie_emit_raw(e, "null", 4);
+	else 
+		json_str(e, s);
+}
+
+/**
+ * pcie_reg_decode() callback: emit one header register as "name": value
+ */
+static int pcie_emit_reg(void *ctx, const struct pcie_reg *r, __u32 v)
+{
+	struct pcie_emit *e = ctx;
+
+	if (r->access != PCRA_RSVD)
+		pcie_emit_uint(e, r->name, v);
+
+	// Keep going on overflow so total reports the full size needed
+	return 0;
+}
+
+/**
+ * Initialize an emitter that flushes to a sink
+ *
+ * @param e 	struct pcie_emit* to initialize 
+ * @param fmt 	Output format (enum _PCEM)
+ * @param buf 	char* to the output buffer. When out is not NULL this is a staging buffer
+ * 				and may be NULL, in which case every value is written to out directly
+ * @param len 	Size of buf in bytes 
+ * @param out 	struct pcie_sink* to flush to, or NULL to write only into buf 
+ */
+void pcie_emit_init_sink(struct pcie_emit *e, unsigned fmt, char *buf, size_t len, struct pcie_sink *out)
+{
+	memset(e, 0, sizeof(*e));
+	e->fmt = fmt;
+	e->buf = buf;
+	e->len = (buf != NULL) ? len : 0;
+	e->out = out;
+}
+
+/**
+ * Initialize an emitter 
+ *
+ * @param e 	struct pcie_emit* to initialize 
+ * @param fmt 	Output format (enum _PCEM)
+ * @param buf 	char* to the output buffer. When fd >= 0 this is a staging buffer
+ * 				and may be NULL, in which case every value is written to fd directly
+ * @param len 	Size of buf in bytes 
+ * @param fd 	File descriptor to flush to, or -1 to write only into buf 
+ */
+void pcie_emit_init(struct pcie_emit *e, unsigned fmt, char *buf, size_t len, int fd)
+{
+	pcie_emit_init_sink(e, fmt, buf, len, NULL);
+	if (fd >= 0) {
+		pcie_sink_fd(&e->fd, fd, NULL, 0);
+		e->out = &e->fd;
+	}
+}
+
+/**
+ * Start a stream of devices. Emits the opening of the top level array 
+ *
+ * @return 	0 upon success, -1 upon error 
+ */
+int pcie_emit_begin(struct pcie_emit *e)
+{
+	pcie_emit_open(e, NULL, 1);
+	return e->err;
+}
+
+/**
+ * Emit one decoded device 
+ *
+ * May be called between pcie_emit_begin() and pcie_emit_end() any number of 
+ * times, or on its own to emit a single object. 
+ *
+ * @param e 		struct pcie_emit* initialized with pcie_emit_init()
+ * @param bdf 		BDF of the device. See PCIE_BDF()
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @return 			0 upon success, -1 upon error 
+ */
+int pcie_emit_dev(struct pcie_emit *e, __u32 bdf, __u8 *cfgspace)
+{
+	static const char hex[] = "0123456789abcdef";
+	struct pcie_cap_index idx;
+	struct pcie_cfg_hdr *ph;
+	char sbdf[13];
+	unsigned i;
+
+	if (e == NULL || cfgspace == NULL)
+		return -1;
+
+	ph = (struct pcie_cfg_hdr*) cfgspace;
+
+	// ssss:bb:dd.f
+	for (i = 0 ; i < 4 ; i++)
+		sbdf[i] = hex[(PCIE_BDF_SEG(bdf) >> (12 - 4 * i)) & 0xF];
+	sbdf[4] = ':';
+	sbdf[5] = hex[PCIE_BDF_BUS(bdf) >> 4];
+	sbdf[6] = hex[PCIE_BDF_BUS(bdf) & 0xF];
+	sbdf[7] = ':';
+	sbdf[8] = hex[PCIE_BDF_DEV(bdf) >> 4];
+	sbdf[9] = hex[PCIE_BDF_DEV(bdf) & 0xF];
+	sbdf[10] = '.';
+	sbdf[11] = hex[PCIE_BDF_FN(bdf)];
+	sbdf[12] = 0;
+
+	pcie_emit_open(e, NULL, 0);
+	pcie_emit_str(e, "bdf", sbdf);
+
+	pcie_reg_decode(pcie_reg_hdr(cfgspace), cfgspace, PCIE_REG_ALL, pcie_emit_reg, e);
+
+	pcie_emit_open(e, "class", 0);
+	pcie_emit_str(e, "base", pcbc(ph->baseclass));
+	pcie_emit_str(e, "name", pcie_class_name(ph->baseclass, ph->subclass, ph->pi));
+	pcie_emit_close(e, 0);
+
+	pcie_cap_index_build(&idx, cfgspace);
+
+	pcie_emit_open(e, "caps", 1);
+	for (i = 0 ; i < idx.ncap ; i++) {
+		pcie_emit_open(e, NULL, 0);
+		pcie_emit_uint(e, "id", idx.caps[i].id);
+		pcie_emit_uint(e, "off", idx.caps[i].offset);
+		pcie_emit_str(e, "name", pcap(idx.caps[i].id));
+		pcie_emit_close(e, 0);
+	}
+	pcie_emit_close(e, 1);
+
+	pcie_emit_open(e, "ecaps", 1);
+	for (i = 0 ; i < idx.necap ; i++) {
+		pcie_emit_open(e, NULL, 0);
+		pcie_emit_uint(e, "id", idx.ecaps[i].id);
+		pcie_emit_uint(e, "ver", idx.ecaps[i].ver);
+		pcie_emit_uint(e, "off", idx.ecaps[i].offset);
+		pcie_emit_str(e, "name", pcec(idx.ecaps[i].id));
+		pcie_emit_close(e, 0);
+	}
+	pcie_emit_close(e, 1);
+
+	pcie_emit_close(e, 0);
+
+	return e->err;
+}
+
+/**
+ * End a stream of devices. Closes the top level array and flushes 
+ *
+ * @return 	0 upon success, -1 upon error 
+ */
+int pcie_emit_end(struct pcie_emit *e)
+{
+	pcie_emit_close(e, 1);
+	if (e->fmt == PCEM_JSON)
+		pcie_emit_raw(e, "\n", 1);
+	return pcie_emit_finish(e);
+}
+
+/**
+ * Flush any buffered output to the sink
+ *
+ * @return 	0 upon success, -1 if any error occurred while emitting
+ */
+int pcie_emit_finish(struct pcie_emit *e)
+{
+	pcie_emit_flush(e);
+	if (e->out != NULL && pcie_sink_flush(e->out) != 0)
+		e->err = -1;
+	return e->err;
+}
@@ -0,0 +1,401 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		exp.c
+ *
+ * @brief 		Code file for the PCI Express Capability and the link scanner
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * pcie_link_scan() decodes the PCI Express Capability of every function in a
+ * batch once, builds the topology tree, and then compares each function with
+ * the other end of its link and with its upstream bridge:
+ *
+ * Function type 					Other end of the link
+ * Endpoint, Upstream Port, 		The bridge it sits behind, if that is a Root
+ * PCI Express to PCI Bridge 		Port or a Downstream Port
+ * Root Port, Downstream Port, 		The first upstream facing function on its
+ * PCI to PCI Express Bridge 		secondary bus
+ *
+ * Links that are down (width 0), such as empty slots, are not flagged. Every
+ * input is taken from config space, so a snapshot can be scanned as well as a
+ * live system.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* malloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memset()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_EXP_LEN_V1 		0x24 	//!< Length of a version 1 PCI Express Capability
+#define PCIE_EXP_LEN_V2 		0x3C 	//!< Length of a version 2 PCI Express Capability
+#define PCIE_EXP_SIZE(x) 		(128u << ((x) > 5 ? 5 : (x))) 	//!< Encoded payload / read request size. Reserved values read as 4096
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Link Speed encoding -> name
+ */
+static const char *STR_SPEED[] =
+{
+	NULL, 			// 0
+	"2.5GT/s", 		// 1
+	"5GT/s", 		// 2
+	"8GT/s", 		// 3
+	"16GT/s", 		// 4
+	"32GT/s", 		// 5
+	"64GT/s", 		// 6
+};
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Return the name of a Link Speed, e.g. "16GT/s"
+ *
+ * @param speed 	Link Speed encoding as in the Max Link Speed field: 1 = 2.5GT/s
+ * @return 			const char* name or NULL if the encoding is reserved
+ */
+const char *pcie_exp_speed(unsigned speed)
+{
+	if (speed >= sizeof(STR_SPEED) / sizeof(STR_SPEED[0]))
+		return NULL;
+	return STR_SPEED[speed];
+}
+
+/**
+ * Decode a PCI Express Capability
+ *
+ * @param e 		struct pcie_exp* to fill in
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @param off 		Offset of the Capability, or 0 to find it
+ * @return 			0 upon success, -1 if the Capability is not present
+ */
+int pcie_exp_decode(struct pcie_exp *e, __u8 *cfgspace, unsigned off)
+{
+	struct pcie_cap_index idx;
+	unsigned ver, type;
+	__u8 *p;
+
+	if (e == NULL || cfgspace == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (off == 0) {
+		pcie_cap_index_build(&idx, cfgspace);
+		off = pcie_cap_find(&idx, PCAP_EXP);
+	}
+	if (off < PCLN_HDR || off + PCIE_EXP_LEN_V1 > 0x100) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	p = &cfgspace[off];
+	ver = pcie_get_exp_ver(p);
+	type = pcie_get_exp_type(p);
+
+	memset(e, 0, sizeof(*e));
+
+	e->off 			= off;
+	e->ver 			= ver;
+	e->type 		= type;
+	e->slot 		= pcie_get_exp_slot(p);
+	e->irq 			= pcie_get_exp_irq(p);
+
+	e->devcap 		= pcie_get_exp_devcap(p);
+	e->devctl 		= pcie_get_exp_devctl(p);
+	e->devsta 		= pcie_get_exp_devsta(p);
+	e->flr 			= pcie_get_exp_flr(p);
+	e->mps_sup 		= PCIE_EXP_SIZE(pcie_get_exp_mps_sup(p));
+	e->mps 			= PCIE_EXP_SIZE(pcie_get_exp_mps(p));
+	e->mrrs 		= PCIE_EXP_SIZE(pcie_get_exp_mrrs(p));
+	e->relaxed 		= pcie_get_exp_relaxed(p);
+	e->nosnoop 		= pcie_get_exp_nosnoop(p);
+	e->ext_tag 		= pcie_get_exp_ext_tag(p);
+	e->err_report 	= pcie_get_exp_err_report(p);
+
+	// Integrated functions have no link
+	if (type != PCPT_RCIEP && type != PCPT_RCEC)
+	{
+		e->link 		= 1;
+		e->lnkcap 		= pcie_get_exp_lnkcap(p);
+		e->lnkctl 		= pcie_get_exp_lnkctl(p);
+		e->lnksta 		= pcie_get_exp_lnksta(p);
+		e->max_speed 	= pcie_get_exp_max_speed(p);
+		e->max_width 	= pcie_get_exp_max_width(p);
+		e->speed 		= pcie_get_exp_speed(p);
+		e->width 		= pcie_get_exp_width(p);
+		e->aspm_sup 	= pcie_get_exp_aspm_sup(p);
+		e->aspm 		= pcie_get_exp_aspm(p);
+		e->port 		= pcie_get_exp_port(p);
+		e->training 	= pcie_get_exp_training(p);
+		e->dllla 		= pcie_get_exp_dllla(p);
+	}
+
+	if (e->slot)
+	{
+		e->sltcap 		= pcie_get_exp_sltcap(p);
+		e->sltctl 		= pcie_get_exp_sltctl(p);
+		e->sltsta 		= pcie_get_exp_sltsta(p);
+		e->slot_num 	= pcie_get_exp_slot_num(p);
+	}
+
+	if (type == PCPT_RP || type == PCPT_RCEC)
+	{
+		e->rootctl 		= pcie_get_exp_rootctl(p);
+		e->rootcap 		= pcie_get_exp_rootcap(p);
+		e->rootsta 		= pcie_get_exp_rootsta(p);
+	}
+
+	if (ver >= 2 && off + PCIE_EXP_LEN_V2 <= 0x100)
+	{
+		e->devcap2 		= pcie_get_exp_devcap2(p);
+		e->devctl2 		= pcie_get_exp_devctl2(p);
+		e->devsta2 		= pcie_get_exp_devsta2(p);
+		if (e->link) {
+			e->lnkcap2 		= pcie_get_exp_lnkcap2(p);
+			e->lnkctl2 		= pcie_get_exp_lnkctl2(p);
+			e->lnksta2 		= pcie_get_exp_lnksta2(p);
+			e->speeds 		= pcie_get_exp_speeds(p);
+			e->target_speed = pcie_get_exp_target_speed(p);
+		}
+	}
+
+	// Before the Supported Link Speeds Vector every speed up to the max was supported
+	if (e->link && e->speeds == 0 && e->max_speed > 0 && e->max_speed <= 7)
+		e->speeds = (1u << e->max_speed) - 1;
+
+	return 0;
+}
+
+/**
+ * Return 1 for the types whose link is on their upstream side
+ */
+static inline int pcie_exp_upstream(unsigned type)
+{
+	return type == PCPT_EP || type == PCPT_LEG_EP || type == PCPT_UP || type == PCPT_PCIE_PCI;
+}
+
+/**
+ * Return 1 for the types whose link is on their downstream side
+ */
+static inline int pcie_exp_downstream(unsigned type)
+{
+	return type == PCPT_RP || type == PCPT_DOWN || type == PCPT_PCI_PCIE;
+}
+
+/**
+ * Find the node at the other end of the link of a node
+ *
+ * @param t 	struct pcie_topo* of the batch
+ * @param e 	struct pcie_exp* array in node order. off is 0 for functions
+ * 				without the Capability
+ * @param i 	Node index
+ * @return 		Node index or -1 if not in the batch
+ */
+static int pcie_link_peer(struct pcie_topo *t, struct pcie_exp *e, int i)
+{
+	int j;
+
+	if (pcie_exp_upstream(e[i].type)) {
+		j = t->node[i].parent;
+		return (j >= 0 && e[j].off != 0 && pcie_exp_downstream(e[j].type)) ? j : -1;
+	}
+
+	if (pcie_exp_downstream(e[i].type))
+		for (j = t->node[i].child ; j >= 0 ; j = t->node[j].next)
+			if (e[j].off != 0 && pcie_exp_upstream(e[j].type))
+				return j;
+
+	return -1;
+}
+
+/**
+ * Check the link and payload settings of one function
+ *
+ * @return 	1 if the function is flagged, else 0
+ */
+static int pcie_link_check(struct pcie_topo *t, struct pcie_exp *e, int i, struct pcie_link *l)
+{
+	struct pcie_exp *x = &e[i];
+	unsigned speed, width, path;
+	int peer, up;
+
+	memset(l, 0, sizeof(*l));
+
+	l->bdf 			= t->node[i].bdf;
+	l->up 			= ~0u;
+	l->type 		= x->type;
+	l->speed 		= x->speed;
+	l->max_speed 	= x->max_speed;
+	l->width 		= x->width;
+	l->max_width 	= x->max_width;
+	l->mps 			= x->mps;
+	l->mrrs 		= x->mrrs;
+
+	if (x->link && x->width != 0)
+	{
+		if (x->speed < x->max_speed)
+			l->flags |= PCLK_SPEED;
+		if (x->width < x->max_width)
+			l->flags |= PCLK_WIDTH;
+
+		peer = pcie_link_peer(t, e, i);
+		if (peer >= 0)
+		{
+			l->peer_speed = e[peer].max_speed;
+			l->peer_width = e[peer].max_width;
+
+			// A link trains to the best both ends support
+			speed = (x->max_speed < l->peer_speed) ? x->max_speed : l->peer_speed;
+			width = (x->max_width < l->peer_width) ? x->max_width : l->peer_width;
+			if (l->flags != 0 && x->speed >= speed && x->width >= width)
+				l->flags |= PCLK_PARTNER;
+		}
+	}
+
+	up = t->node[i].parent;
+	if (up >= 0 && e[up].off != 0)
+	{
+		l->up = t->node[up].bdf;
+		l->up_mps = e[up].mps;
+		if (x->mps != e[up].mps)
+			l->flags |= PCLK_MPS;
+
+		// Bridges forward reads on behalf of others so only their targets count
+		path = (x->mps < e[up].mps) ? x->mps : e[up].mps;
+		if (t->node[i].type == 0 && x->mrrs < path)
+			l->flags |= PCLK_MRRS;
+	}
+
+	return l->flags != 0;
+}
+
+/**
+ * Find the functions in a batch with a degraded link or payload settings
+ *
+ * A function is flagged when its link runs below its own Max Link Speed or
+ * Maximum Link Width, when its Max Payload Size differs from that of the
+ * bridge it sits behind, or when it is an endpoint whose Max Read Request
+ * Size is below the Max Payload Size of that path. PCLK_PARTNER is added
+ * when the other end of the link supports no more than what was negotiated,
+ * which separates a narrower peer from a link that trained down.
+ *
+ * The upstream bridge of a function must be in the same batch for the
+ * payload checks. Functions without a PCI Express Capability are skipped.
+ *
+ * @param bdfs 		__u32* array of num BDFs. See PCIE_BDF()
+ * @param images 	__u8* to num contiguous images of PCLN_CFG bytes each
+ * @param num 		Number of images
+ * @param out 		struct pcie_link* array of max entries to receive the
+ * 					flagged functions in input order. May be NULL if max is 0
+ * @param max 		Number of entries in out
+ * @return 			Number of flagged functions, which may be more than max,
+ * 					or -1 upon error with errno set
+ */
+long pcie_link_scan(__u32 *bdfs, __u8 *images, unsigned num, struct pcie_link *out, unsigned max)
+{
+	struct pcie_topo t;
+	struct pcie_exp *e;
+	struct pcie_link l;
+	unsigned i;
+	long cnt;
+
+	if ((num > 0 && (bdfs == NULL || images == NULL)) || (out == NULL && max > 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	e = malloc((num > 0 ? num : 1) * sizeof(*e));
+	if (e == NULL)
+		return -1;
+
+	if (pcie_topo_build(&t, bdfs, images, num) != 0) {
+		free(e);
+		return -1;
+	}
+
+	for (i = 0 ; i < num ; i++)
+		if (pcie_exp_decode(&e[i], &images[(size_t) i * PCLN_CFG], 0) != 0)
+			memset(&e[i], 0, sizeof(e[i]));
+
+	cnt = 0;
+	for (i = 0 ; i < num ; i++)
+	{
+		if (e[i].off == 0 || !pcie_link_check(&t, e, i, &l))
+			continue;
+		if (cnt < max)
+			out[cnt] = l;
+		cnt++;
+	}
+
+	pcie_topo_free(&t);
+	free(e);
+	return cnt;
+}
+
+/**
+ * Scan the functions of a snapshot with pcie_link_scan()
+ *
+ * @param snap 	struct pcie_snap* opened with pcie_snap_open()
+ * @param out 	struct pcie_link* array of max entries. May be NULL if max is 0
+ * @param max 	Number of entries in out
+ * @return 		Number of flagged functions or -1 upon error with errno set
+ */
+long pcie_link_scan_snap(struct pcie_snap *snap, struct pcie_link *out, unsigned max)
+{
+	__u32 *bdfs;
+	__u8 *images;
+	unsigned i;
+	long rv;
+
+	if (snap == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (snap->num == 0)
+		return 0;
+
+	// Images are stored back to back in index order
+	images = pcie_snap_cfg(snap, 0);
+	for (i = 0 ; images != NULL && i < snap->num ; i++)
+		if (pcie_snap_cfg(snap, i) != images + (size_t) i * PCLN_CFG)
+			images = NULL;
+	if (images == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	bdfs = malloc(snap->num * sizeof(*bdfs));
+	if (bdfs == NULL)
+		return -1;
+	for (i = 0 ; i < snap->num ; i++)
+		bdfs[i] = snap->ent[i].bdf;
+
+	rv = pcie_link_scan(bdfs, images, snap->num, out, max);
+
+	free(bdfs);
+	return rv;
+}
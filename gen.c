@@ -0,0 +1,686 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		gen.c
+ *
+ * @brief 		Code file for the synthetic config space generator
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * The generator lays out one PCI Segment at a time the way firmware numbers
+ * buses: a depth first walk from bus 0. Bus 0 holds a host bridge and a set
+ * of Root Ports. Each Root Port leads either to an endpoint directly or to a
+ * switch: an Upstream Port whose bus holds Downstream Ports, each leading to
+ * an endpoint. Endpoints have 1 to 4 functions.
+ *
+ * The layout of a segment is planned up front in a 256 entry bus table so that
+ * images can then be produced in ascending BDF order, one call at a time,
+ * which is the order a snapshot file stores them in. When a segment is full
+ * the next one is planned. The output depends only on the seed and flags, not
+ * on how the calls are split up.
+ *
+ * As in a real fleet most functions are copies of a few device models. Each 
+ * seed gives PCLN_GEN_MODELS models: one each for the host bridge, Root Port,
+ * Upstream Port and Downstream Port, and the rest for endpoints. A model fixes
+ * the IDs, class, link and interrupt capabilities and the Capability chains.
+ * Only per instance fields such as BARs, bus numbers, port numbers, link 
+ * training state and the Device Serial Number differ between its functions.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* malloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memset()
+ * memcpy()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_GEN_CHUNK 		256 	//!< Images generated per write by pcie_gen_snap()
+#define PCIE_GEN_BAD_RATE 	64 		//!< Default: 1 in N images has a malformed chain with PCGN_BAD
+#define PCIE_GEN_MIN(a, b) 	(((a) < (b)) ? (a) : (b))
+
+/* PCI Express Capability register offsets and Device/Port Types */
+#define PCIE_EXP_FLAGS 		0x02
+#define PCIE_EXP_DEVCAP 	0x04
+#define PCIE_EXP_DEVCTL 	0x08
+#define PCIE_EXP_LNKCAP 	0x0C
+#define PCIE_EXP_LNKSTA 	0x12
+#define PCIE_EXP_LEN 		0x3C
+#define PCIE_EXP_TYPE_EP 	0x0
+#define PCIE_EXP_TYPE_RP 	0x4
+#define PCIE_EXP_TYPE_UP 	0x5
+#define PCIE_EXP_TYPE_DOWN 	0x6
+
+/* Models used for each kind of function. Endpoints use the rest */
+#define PCIE_GEN_MODEL_HOST 	0
+#define PCIE_GEN_MODEL_RP 		1
+#define PCIE_GEN_MODEL_UP 		2
+#define PCIE_GEN_MODEL_DOWN 	3
+#define PCIE_GEN_MODEL_EP 		4
+
+_Static_assert(PCAP_MAX <= 64 && PCEC_MAX <= 64, "Capability IDs present are tracked in a 64-bit mask");
+_Static_assert(PCLN_GEN_MODELS > PCIE_GEN_MODEL_EP, "Endpoints need at least one model");
+
+/* ENUMERATIONS ==============================================================*/
+
+/**
+ * What lives on a planned bus
+ */
+enum _PCIE_GEN_BUS
+{
+	PCIE_GEN_NONE = 0, 		//!< Bus not used
+	PCIE_GEN_ROOT, 			//!< Host bridge at device 0 and Root Ports at devices 1..num-1
+	PCIE_GEN_UP, 			//!< Switch Upstream Port at device 0
+	PCIE_GEN_DOWN, 			//!< Switch Downstream Ports at devices 0..num-1
+	PCIE_GEN_EP, 			//!< Endpoint with functions 0..num-1 at device 0
+};
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Vendor IDs used for generated devices
+ */
+static const __u16 PCIE_GEN_VENDORS[] = {
+	0x8086, 0x10DE, 0x15B3, 0x144D, 0x1022, 0x1AF4, 0x14E4, 0x1000, 0x1D0F, 0x19E5,
+};
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * xorshift64* PRNG
+ *
+ * @param s 	__u64* PRNG state. Must not be 0
+ */
+static inline __u64 pcie_gen_rand(__u64 *s)
+{
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+	return *s * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Random number in [0, n)
+ */
+static inline unsigned pcie_gen_below(__u64 *s, unsigned n)
+{
+	return (unsigned) (((pcie_gen_rand(s) >> 32) * n) >> 32);
+}
+
+/**
+ * Max Payload Size Supported by a device model: 0 = 128 B to 2 = 512 B
+ *
+ * Derived from the model seed alone so the planner can find the smallest 
+ * value below each Root Port before any image is generated
+ */
+static unsigned pcie_gen_mpss(struct pcie_gen *g, unsigned model)
+{
+	__u64 m;
+
+	m = g->model[model] ^ 0xD1B54A32D192ED03ULL;
+	return pcie_gen_below(&m, 3);
+}
+
+/**
+ * Plan the bus layout of the current segment
+ */
+static void pcie_gen_plan(struct pcie_gen *g)
+{
+	struct pcie_gen_bus *root, *up, *down, *ep;
+	unsigned r, i, nroot, nport, next, rp, first, mps;
+
+	memset(g->plan, 0, sizeof(g->plan));
+
+	root = &g->plan[0];
+	root->kind = PCIE_GEN_ROOT;
+	nroot = 4 + pcie_gen_below(&g->rng, 12);
+	root->num = 1 + nroot;
+
+	// Each Root Port uses at most 2 + 8 buses so 15 of them always fit
+	next = 1;
+	for (r = 0 ; r < nroot ; r++)
+	{
+		rp = 1 + r;
+		root->sec[rp] = next;
+		first = next;
+		mps = pcie_gen_mpss(g, PCIE_GEN_MODEL_RP);
+
+		if (pcie_gen_below(&g->rng, 2) == 0) {
+			ep = &g->plan[next++];
+			ep->kind = PCIE_GEN_EP;
+			ep->num = 1 + pcie_gen_below(&g->rng, 4);
+			ep->model = PCIE_GEN_MODEL_EP + pcie_gen_below(&g->rng, PCLN_GEN_MODELS - PCIE_GEN_MODEL_EP);
+			mps = PCIE_GEN_MIN(mps, pcie_gen_mpss(g, ep->model));
+		}
+		else {
+			up = &g->plan[next];
+			up->kind = PCIE_GEN_UP;
+			up->num = 1;
+			up->sec[0] = ++next;
+			mps = PCIE_GEN_MIN(mps, pcie_gen_mpss(g, PCIE_GEN_MODEL_UP));
+
+			down = &g->plan[next++];
+			down->kind = PCIE_GEN_DOWN;
+			nport = 2 + pcie_gen_below(&g->rng, 7);
+			down->num = nport;
+			mps = PCIE_GEN_MIN(mps, pcie_gen_mpss(g, PCIE_GEN_MODEL_DOWN));
+
+			for (i = 0 ; i < nport ; i++) {
+				down->sec[i] = next;
+				down->sub[i] = next;
+				ep = &g->plan[next++];
+				ep->kind = PCIE_GEN_EP;
+				ep->num = 1 + pcie_gen_below(&g->rng, 4);
+				ep->model = PCIE_GEN_MODEL_EP + pcie_gen_below(&g->rng, PCLN_GEN_MODELS - PCIE_GEN_MODEL_EP);
+				mps = PCIE_GEN_MIN(mps, pcie_gen_mpss(g, ep->model));
+			}
+			up->sub[0] = next - 1;
+		}
+
+		root->sub[rp] = next - 1;
+
+		// Firmware programs every function below a Root Port with the
+		// smallest Max Payload Size any of them supports
+		for (i = first ; i < next ; i++)
+			g->plan[i].mps = mps;
+	}
+
+	g->bus = 0;
+	g->slot = 0;
+}
+
+/**
+ * Place a Capability at off and link the previous one to it
+ */
+static __u8 *pcie_gen_cap(__u8 *c, unsigned *prev, unsigned off, unsigned id)
+{
+	c[off] = id;
+	c[off + 1] = 0;
+	c[*prev] = off;
+	*prev = off + 1;
+	return &c[off];
+}
+
+/**
+ * Place an Extended Capability at off and link the previous one to it
+ */
+static __u8 *pcie_gen_ecap(__u8 *c, unsigned *prev, unsigned off, unsigned id, unsigned ver)
+{
+	__u32 v;
+
+	v = id | (ver << 16);
+	memcpy(&c[off], &v, 4);
+
+	if (*prev != 0) {
+		memcpy(&v, &c[*prev], 4);
+		v = (v & 0x000FFFFF) | (off << 20);
+		memcpy(&c[*prev], &v, 4);
+	}
+	*prev = off;
+	return &c[off];
+}
+
+/**
+ * Fill in the PCI Express Capability
+ *
+ * @param m 	Model PRNG state. Supported link sizes come from here
+ * @param mpss 	Max Payload Size Supported. See pcie_gen_mpss()
+ * @param mps 	Max Payload Size to program in Device Control. At most mpss
+ */
+static void pcie_gen_exp(struct pcie_gen *g, __u64 *m, __u8 *p, unsigned type, unsigned mpss, unsigned mps)
+{
+	__u16 v16;
+	__u32 v32;
+	unsigned speed, width;
+
+	v16 = 0x2 | (type << 4);
+	memcpy(&p[PCIE_EXP_FLAGS], &v16, 2);
+
+	v32 = mpss | 0x8000;
+	memcpy(&p[PCIE_EXP_DEVCAP], &v32, 4);
+
+	// Max Payload Size and Max Read Request Size in Device Control
+	v16 = (mps << 5) | (pcie_gen_below(m, 4) << 12) | 0x0010;
+	memcpy(&p[PCIE_EXP_DEVCTL], &v16, 2);
+
+	// Link: Gen 3 to Gen 5, x1 to x16, with a per instance Port Number
+	speed = 3 + pcie_gen_below(m, 3);
+	width = 1u << pcie_gen_below(m, 5);
+	v32 = speed | (width << 4) | ((__u32) pcie_gen_below(&g->rng, 256) << 24);
+	memcpy(&p[PCIE_EXP_LNKCAP], &v32, 4);
+
+	// Most links train to their maximum
+	if (pcie_gen_below(&g->rng, 16) == 0) {
+		if (speed > 1 && pcie_gen_below(&g->rng, 2))
+			speed--;
+		else if (width > 1)
+			width >>= 1;
+	}
+	v16 = speed | (width << 4);
+	memcpy(&p[PCIE_EXP_LNKSTA], &v16, 2);
+}
+
+/**
+ * Build the Capability chain: the standard ones for the kind of function plus
+ * up to 3 other IDs from enum _PCAP
+ *
+ * @param m 	Model PRNG state. Everything but the MSI-X enable comes from here
+ * @param mpss 	Max Payload Size Supported. See pcie_gen_mpss()
+ * @param mps 	Max Payload Size to program in Device Control
+ */
+static void pcie_gen_caps(struct pcie_gen *g, __u64 *m, __u8 *c, unsigned type, int bridge, unsigned mpss, unsigned mps)
+{
+	struct pcie_cfg_hdr *ph;
+	unsigned prev, off, id, i, n;
+	__u64 have;
+	__u16 v16;
+	__u32 v32;
+	__u8 *p;
+
+	ph = (struct pcie_cfg_hdr*) c;
+	ph->status |= 0x0010;
+	ph->cap = 0x40;
+
+	// The first link written is the Capabilities Pointer in the header
+	prev = 0x34;
+	off = 0x40;
+	have = (1ULL << PCAP_PM) | (1ULL << PCAP_MSI) | (1ULL << PCAP_EXP) | (1ULL << PCAP_MSIX);
+
+	p = pcie_gen_cap(c, &prev, off, PCAP_PM);
+	v16 = 0x0003;
+	memcpy(&p[2], &v16, 2);
+	off += 0x08;
+
+	// 64-bit maskable MSI
+	p = pcie_gen_cap(c, &prev, off, PCAP_MSI);
+	v16 = 0x0180 | (pcie_gen_below(m, 6) << 1);
+	memcpy(&p[2], &v16, 2);
+	off += 0x18;
+
+	p = pcie_gen_cap(c, &prev, off, PCAP_EXP);
+	pcie_gen_exp(g, m, p, type, mpss, mps);
+	off += PCIE_EXP_LEN;
+
+	// MSI-X with the table in BAR0 and the PBA after it, enabled on most endpoints
+	if (!bridge) {
+		p = pcie_gen_cap(c, &prev, off, PCAP_MSIX);
+		n = 1u << (2 + pcie_gen_below(m, 8));
+		v16 = (n - 1) | ((pcie_gen_below(&g->rng, 4) != 0) << 15);
+		memcpy(&p[2], &v16, 2);
+		v32 = 0x2000;
+		memcpy(&p[4], &v32, 4);
+		v32 = 0x2000 + n * 16;
+		memcpy(&p[8], &v32, 4);
+		off += 0x0C;
+	}
+
+	// Each ID appears once, as it does on real devices
+	n = pcie_gen_below(m, 4);
+	for (i = 0 ; i < n && off + 0x10 <= 0x100 ; i++)
+	{
+		do {
+			id = 1 + pcie_gen_below(m, PCAP_MAX - 1);
+		} while (pcap(id) == NULL || (have & (1ULL << id)));
+		have |= 1ULL << id;
+		pcie_gen_cap(c, &prev, off, id);
+		off += 0x10;
+	}
+}
+
+/**
+ * Build the Extended Capability chain: AER, then the Device Serial Number on
+ * endpoints and ACS on ports, then up to 4 other IDs from enum _PCEC
+ *
+ * @param m 	Model PRNG state. Everything but the serial number comes from here
+ */
+static void pcie_gen_ecaps(struct pcie_gen *g, __u64 *m, __u8 *c, int bridge)
+{
+	unsigned prev, off, id, i, n;
+	__u64 dsn, have;
+	__u8 *p;
+
+	prev = 0;
+	off = 0x100;
+	have = (1ULL << PCEC_AER) | (1ULL << PCEC_DSN) | (1ULL << PCEC_ACS);
+
+	pcie_gen_ecap(c, &prev, off, PCEC_AER, 2);
+	off += 0x48;
+
+	if (!bridge) {
+		p = pcie_gen_ecap(c, &prev, off, PCEC_DSN, 1);
+		dsn = pcie_gen_rand(&g->rng) | 1;
+		memcpy(&p[4], &dsn, 8);
+		off += 0x10;
+	}
+	else {
+		pcie_gen_ecap(c, &prev, off, PCEC_ACS, 1);
+		off += 0x10;
+	}
+
+	n = pcie_gen_below(m, 5);
+	for (i = 0 ; i < n ; i++)
+	{
+		do {
+			id = 1 + pcie_gen_below(m, PCEC_MAX - 1);
+		} while (pcec(id) == NULL || (have & (1ULL << id)));
+		have |= 1ULL << id;
+		pcie_gen_ecap(c, &prev, off, id, 1);
+		off += 0x20;
+	}
+}
+
+/**
+ * Damage the chains of an image in one of the ways seen in the field
+ */
+static void pcie_gen_break(struct pcie_gen *g, __u8 *c)
+{
+	__u32 v;
+
+	switch (pcie_gen_below(&g->rng, 5))
+	{
+		// Capability loop back to the first entry
+		case 0: c[0x41] = 0x40; 						break;
+
+		// Capability pointer into the header
+		case 1: c[0x49] = 0x20; 						break;
+
+		// Extended Capability loop back to 0x100
+		case 2:
+			memcpy(&v, &c[0x100], 4);
+			v = (v & 0x000FFFFF) | (0x100 << 20);
+			memcpy(&c[0x100], &v, 4);
+			break;
+
+		// Extended Capability pointer below 0x100
+		case 3:
+			memcpy(&v, &c[0x100], 4);
+			v = (v & 0x000FFFFF) | (0x0C0 << 20);
+			memcpy(&c[0x100], &v, 4);
+			break;
+
+		// Chain runs into a region that reads as all ones
+		default:
+			memset(&c[0x148], 0xFF, 0x10);
+			break;
+	}
+}
+
+/**
+ * Fill in the fields common to every function
+ *
+ * @param m 	Model PRNG state the IDs come from
+ */
+static void pcie_gen_hdr(__u64 *m, __u8 *c, unsigned base, unsigned sub, unsigned pi, unsigned type)
+{
+	struct pcie_cfg_hdr *ph;
+	__u64 r;
+
+	memset(c, 0, PCLN_CFG);
+	ph = (struct pcie_cfg_hdr*) c;
+
+	r = pcie_gen_rand(m);
+	ph->vendor 		= PCIE_GEN_VENDORS[r % (sizeof(PCIE_GEN_VENDORS) / sizeof(PCIE_GEN_VENDORS[0]))];
+	ph->device 		= r >> 16;
+	ph->command 	= 0x0406 | (type == 1);
+	ph->rev 		= r >> 32;
+	ph->baseclass 	= base;
+	ph->subclass 	= sub;
+	ph->pi 			= pi;
+	ph->cls 		= 0x10;
+	ph->type 		= type;
+}
+
+/**
+ * Generate an endpoint function of model g->model[model]
+ */
+static void pcie_gen_ep(struct pcie_gen *g, __u8 *c, unsigned model, unsigned bus, int mf)
+{
+	struct pcie_cfg_hdr *ph;
+	unsigned base, sub, pi, s, tries;
+	__u64 m, r;
+
+	m = g->model[model];
+
+	// Any Base Class except Bridge, with a Sub Class that has a name
+	do {
+		base = pcie_gen_below(&m, PCBC_MAX);
+	} while (base == PCBC_BRIDGE);
+
+	sub = (pcie_class_name(base, 0x80, 0) != NULL) ? 0x80 : 0x00;
+	for (tries = 0 ; tries < 8 ; tries++) {
+		s = pcie_gen_below(&m, 16);
+		if (pcie_class_name(base, s, 0) != NULL) {
+			sub = s;
+			break;
+		}
+	}
+	pi = (base == PCBC_MSC && sub == 0x08) ? 0x02 : 0x00;
+
+	pcie_gen_hdr(&m, c, base, sub, pi, mf ? 0x80 : 0x00);
+
+	// Memory BARs are placed by firmware so they differ between instances
+	r = pcie_gen_rand(&g->rng);
+	ph = (struct pcie_cfg_hdr*) c;
+	ph->bar0 		= 0x0000000C | ((__u32) r & 0xFFF00000);
+	ph->bar1 		= 0x00000020 + bus;
+	ph->bar2 		= 0x0000000C | ((__u32) (r >> 32) & 0xFFFFC000);
+	ph->bar3 		= 0x00000030 + bus;
+	ph->subvendor 	= ph->vendor;
+	ph->subsystem 	= pcie_gen_rand(&m) >> 48;
+	ph->intpin 		= 1;
+	ph->intline 	= 0xFF;
+
+	pcie_gen_caps(g, &m, c, PCIE_EXP_TYPE_EP, 0, pcie_gen_mpss(g, model), g->plan[bus].mps);
+	pcie_gen_ecaps(g, &m, c, 0);
+}
+
+/**
+ * Generate a PCI-to-PCI bridge of model g->model[model]: Root Port, Upstream
+ * or Downstream Port
+ */
+static void pcie_gen_bridge(struct pcie_gen *g, __u8 *c, unsigned model, unsigned bus, unsigned sec, unsigned sub, unsigned type)
+{
+	struct pcie_cfg_hdr1 *ph;
+	__u64 m;
+
+	m = g->model[model];
+	pcie_gen_hdr(&m, c, PCBC_BRIDGE, 0x04, 0x00, 0x01);
+
+	ph = (struct pcie_cfg_hdr1*) c;
+	ph->pribus 		= bus;
+	ph->secbus 		= sec;
+	ph->subbus 		= sub;
+	ph->membase 	= (sec << 4) & 0xFFF0;
+	ph->memlimit 	= ((sub << 4) | 0x0F) & 0xFFFF;
+	ph->pfbase 		= 0x0001;
+	ph->pflimit 	= 0x0001;
+	ph->intpin 		= 1;
+	ph->intline 	= 0xFF;
+
+	pcie_gen_caps(g, &m, c, type, 1, pcie_gen_mpss(g, model), g->plan[sec].mps);
+	pcie_gen_ecaps(g, &m, c, 1);
+}
+
+/**
+ * Initialize a generator
+ *
+ * @param g 		struct pcie_gen* to initialize
+ * @param seed 		Any value. The same seed and flags give the same images
+ * @param flags 	Bitmask of enum _PCGN
+ */
+void pcie_gen_init(struct pcie_gen *g, __u64 seed, unsigned flags)
+{
+	unsigned i;
+
+	memset(g, 0, sizeof(*g));
+	g->flags = flags;
+	g->bad_rate = PCIE_GEN_BAD_RATE;
+
+	// xorshift must not start at 0
+	g->rng = seed ^ 0x9E3779B97F4A7C15ULL;
+	if (g->rng == 0)
+		g->rng = 1;
+
+	for (i = 0 ; i < PCLN_GEN_MODELS ; i++)
+		g->model[i] = pcie_gen_rand(&g->rng) | 1;
+
+	pcie_gen_plan(g);
+}
+
+/**
+ * Generate the next images in ascending BDF order
+ *
+ * @param g 		struct pcie_gen* initialized with pcie_gen_init()
+ * @param images 	__u8* to room for n images of PCLN_CFG bytes each
+ * @param bdfs 		__u32* array to receive n BDFs. May be NULL
+ * @param n 		Number of images to generate
+ * @return 			Number of images generated. Less than n only after all
+ * 					65536 segments have been used
+ */
+size_t pcie_gen_next(struct pcie_gen *g, __u8 *images, __u32 *bdfs, size_t n)
+{
+	struct pcie_gen_bus *b;
+	unsigned dev, fn;
+	size_t i;
+	__u64 m;
+	__u8 *c;
+
+	for (i = 0 ; i < n ; )
+	{
+		if (g->seg > 0xFFFF)
+			break;
+
+		b = &g->plan[g->bus];
+		if (g->slot >= b->num)
+		{
+			// Move to the next planned bus, or the next segment
+			g->slot = 0;
+			do {
+				g->bus++;
+			} while (g->bus < 256 && g->plan[g->bus].kind == PCIE_GEN_NONE);
+
+			if (g->bus >= 256) {
+				g->seg++;
+				pcie_gen_plan(g);
+			}
+			continue;
+		}
+
+		c = &images[i * PCLN_CFG];
+		dev = g->slot;
+		fn = 0;
+
+		switch (b->kind)
+		{
+			case PCIE_GEN_ROOT:
+				if (g->slot == 0) {
+					m = g->model[PCIE_GEN_MODEL_HOST];
+					pcie_gen_hdr(&m, c, PCBC_BRIDGE, 0x00, 0x00, 0x00);
+					break;
+				}
+				pcie_gen_bridge(g, c, PCIE_GEN_MODEL_RP, g->bus, b->sec[g->slot], b->sub[g->slot], PCIE_EXP_TYPE_RP);
+				break;
+
+			case PCIE_GEN_UP:
+				pcie_gen_bridge(g, c, PCIE_GEN_MODEL_UP, g->bus, b->sec[0], b->sub[0], PCIE_EXP_TYPE_UP);
+				break;
+
+			case PCIE_GEN_DOWN:
+				pcie_gen_bridge(g, c, PCIE_GEN_MODEL_DOWN, g->bus, b->sec[g->slot], b->sub[g->slot], PCIE_EXP_TYPE_DOWN);
+				break;
+
+			default:
+				// Every function of an endpoint is a copy of one model
+				dev = 0;
+				fn = g->slot;
+				pcie_gen_ep(g, c, b->model, g->bus, b->num > 1);
+				break;
+		}
+
+		if ((g->flags & PCGN_BAD) && g->bad_rate > 0 && pcie_gen_below(&g->rng, g->bad_rate) == 0)
+			pcie_gen_break(g, c);
+
+		if (bdfs != NULL)
+			bdfs[i] = PCIE_BDF(g->seg, g->bus, dev, fn);
+
+		g->slot++;
+		i++;
+	}
+
+	return i;
+}
+
+/**
+ * Generate a snapshot file of synthetic images
+ *
+ * Images are generated and written in chunks so memory use does not depend
+ * on num
+ *
+ * @param path 		Path of the file to create. An existing file is replaced
+ * @param g 		struct pcie_gen* initialized with pcie_gen_init()
+ * @param num 		Number of images
+ * @param time 		Capture time stored in the header
+ * @return 			0 upon success, -1 upon error with errno set
+ */
+int pcie_gen_snap(const char *path, struct pcie_gen *g, unsigned num, __u64 time)
+{
+	struct pcie_snap_wr w;
+	__u32 bdfs[PCIE_GEN_CHUNK];
+	__u8 *images;
+	unsigned done, n;
+	int rv, err;
+
+	if (path == NULL || g == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	images = malloc((size_t) PCIE_GEN_CHUNK * PCLN_CFG);
+	if (images == NULL)
+		return -1;
+
+	if (pcie_snap_create(&w, path, num, time) != 0) {
+		free(images);
+		return -1;
+	}
+
+	rv = 0;
+	for (done = 0 ; rv == 0 && done < num ; done += n)
+	{
+		n = (num - done < PCIE_GEN_CHUNK) ? num - done : PCIE_GEN_CHUNK;
+		if (pcie_gen_next(g, images, bdfs, n) != n) {
+			errno = ENOSPC;
+			rv = -1;
+			break;
+		}
+		rv = pcie_snap_append(&w, bdfs, images, n);
+	}
+
+	// Report the first error rather than one from the commit it caused
+	err = errno;
+	if (pcie_snap_commit(&w) != 0 && rv == 0)
+		rv = -1;
+	else if (rv != 0)
+		errno = err;
+
+	free(images);
+	return rv;
+}
@@ -0,0 +1,687 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		ids.c
+ *
+ * @brief 		Code file for the vendor / device name database
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * pcie_ids_compile() turns the pci.ids text file into a binary file that is
+ * used in place from a read only mapping, so opening it costs an open() and an
+ * mmap() and a lookup touches two cache lines of the index and the name.
+ *
+ * Vendors, devices and subsystems share one hash table. It is a minimal
+ * collision free (perfect) hash built with hash and displace: keys are hashed
+ * into buckets of about PCIE_IDS_BUCKET keys, and for each bucket, largest
+ * first, a displacement is searched for that sends all of its keys to free
+ * slots. A lookup hashes the key once, reads the displacement of its bucket,
+ * and compares the key stored in the one slot it can be in.
+ *
+ * Fields are in host byte order. See PCSN_MAGIC in main.h.
+ *
+ * Offset 			Contents
+ * 0 				struct pcie_ids_hdr
+ * bucket_off 		__u32 displacement of each of nbucket buckets
+ * slot_off 		struct pcie_ids_ent[nslot]
+ * name_off 		NUL terminated names, to the end of the file
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* open()
+ */
+#include <fcntl.h>
+
+/* malloc()
+ * calloc()
+ * realloc()
+ * free()
+ * qsort()
+ */
+#include <stdlib.h>
+
+/* memset()
+ * memchr()
+ */
+#include <string.h>
+
+/* mmap()
+ * munmap()
+ */
+#include <sys/mman.h>
+
+/* fstat()
+ */
+#include <sys/stat.h>
+
+/* close()
+ */
+#include <unistd.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_IDS_BUCKET 	4 			//!< Average keys per bucket
+#define PCIE_IDS_DISP_MAX 	(1u << 20) 	//!< Displacements tried per bucket before a new seed is picked
+#define PCIE_IDS_SEEDS 		16 			//!< Seeds tried before giving up
+#define PCIE_IDS_NAME_MASK 	0x3FFFFFFF 	//!< Name offset bits of pcie_ids_ent.name
+#define PCIE_IDS_KIND(e) 	((e)->name >> 30) 	//!< enum _PCNM of a slot
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Name collected by the compiler
+ */
+struct pcie_ids_key
+{
+	__u32 vd; 			//!< Vendor ID << 16 | Device ID
+	__u32 ss; 			//!< Subsystem Vendor ID << 16 | Subsystem ID
+	__u32 name; 		//!< enum _PCNM << 30 | offset of the name
+	__u32 line; 		//!< Line number, so that the first of duplicate entries is kept
+};
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Hash a key
+ */
+static inline __u64 pcie_ids_hash(unsigned kind, __u32 vd, __u32 ss, __u32 seed)
+{
+	return pcie_mix64(pcie_mix64((((__u64) vd << 32) | ss) ^ seed) + (kind + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+/**
+ * Map 32 bits of a hash onto [0, n) without a division
+ */
+static inline __u32 pcie_ids_range(__u64 h, __u32 n)
+{
+	return ((h & 0xFFFFFFFF) * (__u64) n) >> 32;
+}
+
+/**
+ * Bucket of a key hash
+ */
+static inline __u32 pcie_ids_bucket(__u64 h, __u32 nbucket)
+{
+	return pcie_ids_range(h >> 32, nbucket);
+}
+
+/**
+ * Slot of a key hash for a bucket displacement
+ */
+static inline __u32 pcie_ids_slot(__u64 h, __u32 disp, __u32 nslot)
+{
+	return pcie_ids_range(pcie_mix64(h + disp), nslot);
+}
+
+/**
+ * Find a displacement for every bucket so that no two keys share a slot
+ *
+ * The hash is also used for the in memory symbol table of pcie_sym_init().
+ * Keys must be unique; callers fold a seed into the hashes and retry with a
+ * new one on failure. Look up a key with pcie_phf_slot()
+ *
+ * @param h 		__u64* array of n key hashes
+ * @param n 		Number of keys
+ * @param nbucket 	Number of buckets
+ * @param nslot 	Number of slots. At least n
+ * @param disp 		__u32* array of nbucket entries to receive the displacements
+ * @param slot 		__u32* array of n entries to receive the slot of each key
+ * @return 			0 upon success, -1 upon error with errno set: EAGAIN if a
+ * 					bucket could not be placed, ENOMEM upon allocation failure
+ */
+int pcie_phf_build(const __u64 *h, unsigned n, __u32 nbucket, __u32 nslot, __u32 *disp, __u32 *slot)
+{
+	unsigned *mem, *first, *order, *bysize, *size;
+	__u8 *used;
+	unsigned i, j, b, k, max, cnt;
+	__u32 d;
+	int rv;
+
+	mem = calloc(3 * (nbucket + 1) + n + 1, sizeof(*mem));
+	used = calloc(nslot + 1, 1);
+	if (mem == NULL || used == NULL) {
+		free(mem);
+		free(used);
+		return -1;
+	}
+
+	first = mem;
+	size = first + nbucket + 1;
+	bysize = size + nbucket + 1;
+	order = bysize + nbucket + 1;
+
+	// Counting sort of the keys by bucket. first[b] is where bucket b starts
+	for (i = 0 ; i < n ; i++)
+		size[pcie_ids_bucket(h[i], nbucket)]++;
+	for (b = 0 ; b < nbucket ; b++)
+		first[b + 1] = first[b] + size[b];
+	for (i = 0 ; i < n ; i++) {
+		b = pcie_ids_bucket(h[i], nbucket);
+		order[first[b] + --size[b]] = i;
+	}
+
+	// Buckets in order of decreasing size. Large buckets are the hardest to
+	// place so they go first while the table is empty
+	max = 0;
+	for (b = 0 ; b < nbucket ; b++)
+		if (first[b + 1] - first[b] > max)
+			max = first[b + 1] - first[b];
+	cnt = 0;
+	for (k = max ; k > 0 ; k--)
+		for (b = 0 ; b < nbucket ; b++)
+			if (first[b + 1] - first[b] == k)
+				bysize[cnt++] = b;
+
+	memset(disp, 0, nbucket * sizeof(*disp));
+
+	rv = 0;
+	for (j = 0 ; rv == 0 && j < cnt ; j++)
+	{
+		b = bysize[j];
+		for (d = 0 ; d < PCIE_IDS_DISP_MAX ; d++)
+		{
+			// Claim slots as they are found free and release them on a clash
+			for (i = first[b] ; i < first[b + 1] ; i++) {
+				slot[order[i]] = pcie_ids_slot(h[order[i]], d, nslot);
+				if (used[slot[order[i]]])
+					break;
+				used[slot[order[i]]] = 1;
+			}
+			if (i == first[b + 1])
+				break;
+			while (i-- > first[b])
+				used[slot[order[i]]] = 0;
+		}
+
+		if (d == PCIE_IDS_DISP_MAX) {
+			errno = EAGAIN;
+			rv = -1;
+		}
+		disp[b] = d;
+	}
+
+	free(mem);
+	free(used);
+	return rv;
+}
+
+/**
+ * Return the slot of a key hash in a table built by pcie_phf_build()
+ *
+ * @param h 		Key hash, computed as it was for pcie_phf_build()
+ * @param disp 		__u32* displacements filled in by pcie_phf_build()
+ * @param nbucket 	Number of buckets
+ * @param nslot 	Number of slots
+ */
+__u32 pcie_phf_slot(__u64 h, const __u32 *disp, __u32 nbucket, __u32 nslot)
+{
+	return pcie_ids_slot(h, disp[pcie_ids_bucket(h, nbucket)], nslot);
+}
+
+/**
+ * Parse 4 hex digits
+ *
+ * @return 	Pointer past the digits or NULL if there are not 4 of them
+ */
+static const char *pcie_ids_hex(const char *p, const char *end, __u32 *v)
+{
+	unsigned i, c;
+
+	if (end - p < 4)
+		return NULL;
+
+	*v = 0;
+	for (i = 0 ; i < 4 ; i++)
+	{
+		c = (unsigned char) p[i];
+		if (c >= '0' && c <= '9')
+			c -= '0';
+		else if (c >= 'a' && c <= 'f')
+			c -= 'a' - 10;
+		else if (c >= 'A' && c <= 'F')
+			c -= 'A' - 10;
+		else
+			return NULL;
+		*v = (*v << 4) | c;
+	}
+	return p + 4;
+}
+
+/**
+ * qsort() comparison of two names by kind and key, then by line
+ */
+static int pcie_ids_cmp(const void *a, const void *b)
+{
+	const struct pcie_ids_key *x = a;
+	const struct pcie_ids_key *y = b;
+
+	if ((x->name >> 30) != (y->name >> 30))
+		return (x->name >> 30) < (y->name >> 30) ? -1 : 1;
+	if (x->vd != y->vd)
+		return x->vd < y->vd ? -1 : 1;
+	if (x->ss != y->ss)
+		return x->ss < y->ss ? -1 : 1;
+	return (x->line > y->line) - (x->line < y->line);
+}
+
+/**
+ * Parse the vendor section of a pci.ids file
+ *
+ * Lines that do not parse are skipped. Parsing stops at the device class
+ * section, which starts with a "C " line; class names are built into the
+ * library.
+ *
+ * @param names 	struct pcie_sink* memory sink that receives the names
+ * @param out 		Receives a malloc()ed array of keys
+ * @return 			Number of keys, or -1 upon error with errno set
+ */
+static long pcie_ids_parse(const char *p, size_t len, struct pcie_sink *names, struct pcie_ids_key **out)
+{
+	struct pcie_ids_key *k, *tmp;
+	const char *end, *eol, *q, *name;
+	size_t n, max;
+	__u32 v, vendor, device, sv, sd, line;
+	unsigned tabs, kind;
+	int have_vendor, have_device;
+
+	k = NULL;
+	n = max = 0;
+	have_vendor = have_device = 0;
+	vendor = device = 0;
+	end = p + len;
+
+	for (line = 1 ; p < end ; p = eol + 1, line++)
+	{
+		eol = memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+
+		q = eol;
+		while (q > p && (q[-1] == '\r' || q[-1] == ' ' || q[-1] == '\t'))
+			q--;
+		if (q == p || *p == '#')
+			continue;
+
+		for (tabs = 0 ; p + tabs < q && p[tabs] == '\t' ; tabs++)
+			;
+		if (tabs == 0 && q - p >= 2 && p[0] == 'C' && p[1] == ' ')
+			break;
+
+		name = pcie_ids_hex(p + tabs, q, &v);
+		if (name == NULL || tabs > 2)
+			continue;
+
+		if (tabs == 0) {
+			vendor = v;
+			have_vendor = 1;
+			have_device = 0;
+			kind = PCNM_VENDOR;
+			v = vendor << 16;
+			sv = 0;
+		}
+		else if (tabs == 1 && have_vendor) {
+			device = v;
+			have_device = 1;
+			kind = PCNM_DEVICE;
+			v = (vendor << 16) | device;
+			sv = 0;
+		}
+		else if (tabs == 2 && have_device && name < q && *name == ' '
+			&& (name = pcie_ids_hex(name + 1, q, &sd)) != NULL) {
+			kind = PCNM_SUBSYS;
+			sv = (v << 16) | sd;
+			v = (vendor << 16) | device;
+		}
+		else
+			continue;
+
+		while (name < q && (*name == ' ' || *name == '\t'))
+			name++;
+		if (name == q || names->pos > PCIE_IDS_NAME_MASK)
+			continue;
+
+		if (n == max) {
+			max = (max > 0) ? max * 2 : 4096;
+			tmp = realloc(k, max * sizeof(*k));
+			if (tmp == NULL) {
+				free(k);
+				return -1;
+			}
+			k = tmp;
+		}
+
+		k[n].vd = v;
+		k[n].ss = sv;
+		k[n].name = ((__u32) kind << 30) | names->pos;
+		k[n].line = line;
+		n++;
+
+		pcie_sink_write(names, name, q - name);
+		pcie_sink_write(names, "", 1);
+	}
+
+	if (names->err) {
+		free(k);
+		return -1;
+	}
+
+	*out = k;
+	return n;
+}
+
+/**
+ * Build the hash table over a set of unique keys and write the file
+ */
+static int pcie_ids_write(const char *dst, struct pcie_ids_key *k, unsigned n, struct pcie_sink *names)
+{
+	struct pcie_ids_hdr hdr;
+	struct pcie_ids_ent *slot;
+	struct pcie_sink out;
+	__u32 *disp, *pos, nbucket, nslot, seed;
+	__u64 *h;
+	unsigned i;
+	int fd, rv;
+
+	nbucket = n / PCIE_IDS_BUCKET + 1;
+	nslot = n + n / 8 + 1;
+
+	h = malloc((n + 1) * sizeof(*h));
+	pos = malloc((n + 1) * sizeof(*pos));
+	disp = malloc(nbucket * sizeof(*disp));
+	slot = malloc(nslot * sizeof(*slot));
+
+	rv = (h != NULL && pos != NULL && disp != NULL && slot != NULL) ? 0 : -1;
+
+	// A seed fails only when a bucket cannot be placed, which is rare at this load
+	for (seed = 0 ; rv == 0 && seed < PCIE_IDS_SEEDS ; seed++)
+	{
+		for (i = 0 ; i < n ; i++)
+			h[i] = pcie_ids_hash(k[i].name >> 30, k[i].vd, k[i].ss, seed);
+		if (pcie_phf_build(h, n, nbucket, nslot, disp, pos) == 0)
+			break;
+		// Only a bucket that could not be placed is worth another seed
+		if (errno != EAGAIN)
+			rv = -1;
+	}
+	if (rv == 0 && seed == PCIE_IDS_SEEDS) {
+		errno = EAGAIN;
+		rv = -1;
+	}
+
+	if (rv == 0)
+	{
+		for (i = 0 ; i < nslot ; i++) {
+			slot[i].vd = 0;
+			slot[i].ss = 0;
+			slot[i].name = (__u32) PCNM_EMPTY << 30;
+		}
+		for (i = 0 ; i < n ; i++) {
+			slot[pos[i]].vd = k[i].vd;
+			slot[pos[i]].ss = k[i].ss;
+			slot[pos[i]].name = k[i].name;
+		}
+
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.magic 		= PCNM_MAGIC;
+		hdr.version 	= PCNM_VERSION;
+		hdr.hdr_len 	= sizeof(hdr);
+		hdr.num 		= n;
+		hdr.nbucket 	= nbucket;
+		hdr.nslot 		= nslot;
+		hdr.seed 		= seed;
+		hdr.bucket_off 	= sizeof(hdr);
+		hdr.slot_off 	= hdr.bucket_off + (__u64) nbucket * sizeof(*disp);
+		hdr.name_off 	= hdr.slot_off + (__u64) nslot * sizeof(*slot);
+		hdr.file_len 	= hdr.name_off + names->pos;
+
+		fd = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			rv = -1;
+	}
+
+	if (rv == 0)
+	{
+		pcie_sink_fd(&out, fd, NULL, 0);
+		pcie_sink_write(&out, (char*) &hdr, sizeof(hdr));
+		pcie_sink_write(&out, (char*) disp, (size_t) nbucket * sizeof(*disp));
+		pcie_sink_write(&out, (char*) slot, (size_t) nslot * sizeof(*slot));
+		pcie_sink_write(&out, names->buf, names->pos);
+		rv = pcie_sink_free(&out);
+
+		if (close(fd) != 0)
+			rv = -1;
+	}
+
+	free(h);
+	free(pos);
+	free(disp);
+	free(slot);
+	return rv;
+}
+
+/**
+ * Compile a pci.ids file into a name database file
+ *
+ * @param src 	Path of the pci.ids text file
+ * @param dst 	Path of the file to create. An existing file is replaced
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_ids_compile(const char *src, const char *dst)
+{
+	struct pcie_ids_key *k;
+	struct pcie_sink names;
+	struct stat st;
+	void *map;
+	long num;
+	unsigned i, n;
+	int fd, rv;
+
+	if (src == NULL || dst == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = open(src, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	map = NULL;
+	if (st.st_size > 0) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			return -1;
+		}
+	}
+	close(fd);
+
+	pcie_sink_mem(&names);
+	num = pcie_ids_parse(map, st.st_size, &names, &k);
+	if (map != NULL)
+		munmap(map, st.st_size);
+	if (num < 0) {
+		pcie_sink_free(&names);
+		return -1;
+	}
+
+	// Keep the first of any duplicate keys
+	if (num > 1)
+		qsort(k, num, sizeof(*k), pcie_ids_cmp);
+	for (i = n = 0 ; i < (unsigned) num ; i++)
+		if (n == 0 || k[i].vd != k[n - 1].vd || k[i].ss != k[n - 1].ss || (k[i].name >> 30) != (k[n - 1].name >> 30))
+			k[n++] = k[i];
+
+	rv = pcie_ids_write(dst, k, n, &names);
+
+	pcie_sink_free(&names);
+	free(k);
+	return rv;
+}
+
+/**
+ * Open and map a name database file written by pcie_ids_compile()
+ *
+ * The header and the bounds of each section are checked. Nothing is parsed.
+ *
+ * @param db 	struct pcie_ids* to fill in
+ * @param path 	Path of the name database file
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_ids_open(struct pcie_ids *db, const char *path)
+{
+	const struct pcie_ids_hdr *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (db == NULL || path == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(db, 0, sizeof(*db));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	if ((size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	// Names must end in a NUL so that any in range offset is a valid string
+	hdr = map;
+	if (hdr->magic != PCNM_MAGIC
+		|| hdr->version != PCNM_VERSION
+		|| hdr->hdr_len < sizeof(*hdr)
+		|| hdr->file_len > (__u64) st.st_size
+		|| hdr->bucket_off > hdr->file_len
+		|| hdr->nbucket > (hdr->file_len - hdr->bucket_off) / sizeof(__u32)
+		|| hdr->slot_off > hdr->file_len
+		|| hdr->nslot > (hdr->file_len - hdr->slot_off) / sizeof(struct pcie_ids_ent)
+		|| hdr->name_off > hdr->file_len
+		|| (hdr->nslot > 0 && hdr->nbucket == 0)
+		|| (hdr->file_len > hdr->name_off && ((char*) map)[hdr->file_len - 1] != '\0'))
+	{
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	db->map = map;
+	db->len = st.st_size;
+	db->hdr = hdr;
+	db->disp = (const __u32*) ((__u8*) map + hdr->bucket_off);
+	db->slot = (const struct pcie_ids_ent*) ((__u8*) map + hdr->slot_off);
+	db->names = (const char*) map + hdr->name_off;
+	db->names_len = hdr->file_len - hdr->name_off;
+
+	return 0;
+}
+
+/**
+ * Unmap a name database opened with pcie_ids_open()
+ */
+void pcie_ids_close(struct pcie_ids *db)
+{
+	if (db == NULL || db->map == NULL)
+		return;
+
+	munmap(db->map, db->len);
+	memset(db, 0, sizeof(*db));
+}
+
+/**
+ * Look up the name of a key
+ */
+static const char *pcie_ids_get(const struct pcie_ids *db, unsigned kind, __u32 vd, __u32 ss)
+{
+	const struct pcie_ids_ent *e;
+	__u64 h;
+	__u32 off;
+
+	if (db == NULL || db->map == NULL || db->hdr->nslot == 0)
+		return NULL;
+
+	h = pcie_ids_hash(kind, vd, ss, db->hdr->seed);
+	e = &db->slot[pcie_ids_slot(h, db->disp[pcie_ids_bucket(h, db->hdr->nbucket)], db->hdr->nslot)];
+	if (e->vd != vd || e->ss != ss || PCIE_IDS_KIND(e) != kind)
+		return NULL;
+
+	off = e->name & PCIE_IDS_NAME_MASK;
+	if (off >= db->names_len)
+		return NULL;
+
+	return db->names + off;
+}
+
+/**
+ * Return the name of a vendor
+ *
+ * @param db 		struct pcie_ids* opened with pcie_ids_open()
+ * @param vendor 	Vendor ID
+ * @return 			Name, valid until pcie_ids_close(), or NULL if not found
+ */
+const char *pcie_ids_vendor(const struct pcie_ids *db, __u16 vendor)
+{
+	return pcie_ids_get(db, PCNM_VENDOR, (__u32) vendor << 16, 0);
+}
+
+/**
+ * Return the name of a device
+ *
+ * @param db 		struct pcie_ids* opened with pcie_ids_open()
+ * @param vendor 	Vendor ID
+ * @param device 	Device ID
+ * @return 			Name, valid until pcie_ids_close(), or NULL if not found
+ */
+const char *pcie_ids_device(const struct pcie_ids *db, __u16 vendor, __u16 device)
+{
+	return pcie_ids_get(db, PCNM_DEVICE, ((__u32) vendor << 16) | device, 0);
+}
+
+/**
+ * Return the name of a subsystem
+ *
+ * @param db 		struct pcie_ids* opened with pcie_ids_open()
+ * @param vendor 	Vendor ID
+ * @param device 	Device ID
+ * @param subvendor Subsystem Vendor ID
+ * @param subsystem Subsystem ID
+ * @return 			Name, valid until pcie_ids_close(), or NULL if not found
+ */
+const char *pcie_ids_subsys(const struct pcie_ids *db, __u16 vendor, __u16 device, __u16 subvendor, __u16 subsystem)
+{
+	return pcie_ids_get(db, PCNM_SUBSYS, ((__u32) vendor << 16) | device, ((__u32) subvendor << 16) | subsystem);
+}
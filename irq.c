@@ -0,0 +1,282 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		irq.c
+ *
+ * @brief 		Code file for MSI / MSI-X decoding and interrupt vector accounting
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Vector counts come from config space alone, so they can be computed from
+ * snapshots. For MSI-X every entry of the table is counted as allocated once
+ * the Capability is enabled since the per vector mask bits live in BAR memory.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* memset()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_MSI_VECTORS(x) 	(1u << ((x) > 5 ? 5 : (x))) //!< MSI encoded vector count. Reserved values read as 32
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Decode an MSI Capability
+ *
+ * @param m 		struct pcie_msi* to fill in
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @param off 		Offset of the Capability, or 0 to find it
+ * @return 			0 upon success, -1 if the Capability is not present
+ */
+int pcie_msi_decode(struct pcie_msi *m, __u8 *cfgspace, unsigned off)
+{
+	struct pcie_cap_index idx;
+	unsigned bit64, maskable;
+	__u8 *p;
+
+	if (m == NULL || cfgspace == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (off == 0) {
+		pcie_cap_index_build(&idx, cfgspace);
+		off = pcie_cap_find(&idx, PCAP_MSI);
+	}
+	if (off < PCLN_HDR || off > 0x100 - 4) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	p = &cfgspace[off];
+	bit64 = pcie_get_msi_bit64(p);
+	maskable = pcie_get_msi_maskable(p);
+
+	// 10 bytes plus 4 for a 64-bit address plus 10 for the mask and pending bits
+	if (off + 10 + 4 * bit64 + 10 * maskable > 0x100) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	memset(m, 0, sizeof(*m));
+
+	m->off 			= off;
+	m->enable 		= pcie_get_msi_enable(p);
+	m->bit64 		= bit64;
+	m->maskable 	= maskable;
+	m->request 		= PCIE_MSI_VECTORS(pcie_get_msi_request(p));
+	m->allocated 	= PCIE_MSI_VECTORS(pcie_get_msi_allocated(p));
+	m->addr 		= pcie_get_msi_addr(p);
+
+	// Data and mask registers move up by 4 bytes when the address is 64-bit
+	if (bit64) {
+		m->addr |= (__u64) pcie_le32(&p[8]) << 32;
+		p += 4;
+	}
+	m->data = pcie_le16(&p[8]);
+
+	if (maskable) {
+		m->mask = pcie_le32(&p[12]);
+		m->pending = pcie_le32(&p[16]);
+	}
+
+	return 0;
+}
+
+/**
+ * Decode an MSI-X Capability
+ *
+ * @param m 		struct pcie_msix* to fill in
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @param off 		Offset of the Capability, or 0 to find it
+ * @return 			0 upon success, -1 if the Capability is not present
+ */
+int pcie_msix_decode(struct pcie_msix *m, __u8 *cfgspace, unsigned off)
+{
+	struct pcie_cap_index idx;
+	__u8 *p;
+
+	if (m == NULL || cfgspace == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (off == 0) {
+		pcie_cap_index_build(&idx, cfgspace);
+		off = pcie_cap_find(&idx, PCAP_MSIX);
+	}
+	if (off < PCLN_HDR || off > 0x100 - 12) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	p = &cfgspace[off];
+
+	m->off 			= off;
+	m->enable 		= pcie_get_msix_enable(p);
+	m->fmask 		= pcie_get_msix_fmask(p);
+	m->size 		= pcie_get_msix_size(p) + 1;
+	m->table_bir 	= pcie_get_msix_table_bir(p);
+	m->table_off 	= pcie_get_msix_table_off(p) << 3;
+	m->pba_bir 		= pcie_get_msix_pba_bir(p);
+	m->pba_off 		= pcie_get_msix_pba_off(p) << 3;
+
+	return 0;
+}
+
+/**
+ * Account the interrupt vectors of one function
+ *
+ * @param q 		struct pcie_irq* to fill in
+ * @param bdf 		BDF of the function. See PCIE_BDF()
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @return 			0 upon success, -1 if a parameter is NULL
+ */
+int pcie_irq_dev(struct pcie_irq *q, __u32 bdf, __u8 *cfgspace)
+{
+	struct pcie_cap_index idx;
+	struct pcie_msi msi;
+	struct pcie_msix msix;
+	unsigned off_msi, off_msix;
+
+	if (q == NULL || cfgspace == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(q, 0, sizeof(*q));
+	q->bdf = bdf;
+
+	pcie_cap_index_build(&idx, cfgspace);
+	off_msi = pcie_cap_find(&idx, PCAP_MSI);
+	off_msix = pcie_cap_find(&idx, PCAP_MSIX);
+
+	if (off_msix && pcie_msix_decode(&msix, cfgspace, off_msix) == 0) {
+		q->requested = msix.size;
+		if (msix.enable) {
+			q->mode = PCIQ_MSIX;
+			q->allocated = msix.size;
+			return 0;
+		}
+	}
+
+	if (off_msi && pcie_msi_decode(&msi, cfgspace, off_msi) == 0) {
+		if (msi.enable) {
+			q->mode = PCIQ_MSI;
+			q->requested = msi.allocated;
+			q->allocated = msi.allocated;
+			return 0;
+		}
+		if (q->requested == 0)
+			q->requested = msi.request;
+	}
+
+	// Interrupt Pin is read only and the same offset in Type 0 and Type 1 headers
+	if (pcie_get_hdr_intpin(cfgspace) != 0) {
+		if (q->requested == 0)
+			q->requested = 1;
+		if (!pcie_get_cmd_disintx(cfgspace)) {
+			q->mode = PCIQ_INTX;
+			q->allocated = 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Add one function to a set of totals
+ */
+static inline void pcie_irq_add(struct pcie_irq_sum *s, const struct pcie_irq *q)
+{
+	s->devices++;
+	s->mode[q->mode]++;
+	s->requested += q->requested;
+	s->allocated += q->allocated;
+}
+
+/**
+ * Account the interrupt vectors of a batch of images
+ *
+ * Functions are summed per bus in order of first appearance and for the
+ * batch as a whole. A bus that does not fit in bus[] is only counted in the
+ * host totals; 256 entries per segment is always enough.
+ *
+ * @param bdfs 		__u32* array of num BDFs. See PCIE_BDF()
+ * @param images 	__u8* to num contiguous images of PCLN_CFG bytes each
+ * @param num 		Number of images
+ * @param dev 		struct pcie_irq* array of num entries to receive per function
+ * 					accounting. May be NULL
+ * @param bus 		struct pcie_irq_sum* array to receive per bus totals. May be NULL if max is 0
+ * @param max 		Number of entries in bus
+ * @param host 		struct pcie_irq_sum* to receive the batch totals. May be NULL
+ * @return 			Number of entries stored in bus, or -1 upon error with errno set
+ */
+int pcie_irq_acct(__u32 *bdfs, __u8 *images, unsigned num, struct pcie_irq *dev,
+	struct pcie_irq_sum *bus, unsigned max, struct pcie_irq_sum *host)
+{
+	struct pcie_irq q, *pq;
+	struct pcie_irq_sum *s;
+	unsigned i, j, nbus, key;
+	int last;
+
+	if ((num > 0 && (bdfs == NULL || images == NULL)) || (bus == NULL && max > 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (host != NULL)
+		memset(host, 0, sizeof(*host));
+
+	nbus = 0;
+	last = -1;
+	for (i = 0 ; i < num ; i++)
+	{
+		pq = (dev != NULL) ? &dev[i] : &q;
+		pcie_irq_dev(pq, bdfs[i], &images[(size_t) i * PCLN_CFG]);
+
+		if (host != NULL)
+			pcie_irq_add(host, pq);
+
+		// Images are usually grouped by bus so try the last one first
+		key = bdfs[i] >> 8;
+		if (last < 0 || bus[last].bus != key)
+		{
+			for (j = 0 ; j < nbus && bus[j].bus != key ; j++)
+				;
+			if (j == nbus) {
+				if (nbus == max)
+					continue;
+				memset(&bus[nbus], 0, sizeof(*bus));
+				bus[nbus].bus = key;
+				nbus++;
+			}
+			last = j;
+		}
+
+		s = &bus[last];
+		pcie_irq_add(s, pq);
+	}
+
+	return nbus;
+}
@@ -13,22 +13,152 @@
 
 /* INCLUDES ==================================================================*/
 
+/* errno
+ */
+#include <errno.h>
+
 /* printf()
+ * fwrite()
  */
 #include <stdio.h>
 
+/* malloc()
+ * calloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* strlen()
+ */
+#include <string.h>
+
 #include <arrayutils.h>
 
 #include "main.h"
 
 /* MACROS ====================================================================*/
 
-#define MAX_INDENT 32
+#define MAX_INDENT 		32
+#define PCIE_FMT_LABEL 	22 		//!< Width of the label column in formatted output
+#define PCIE_SYM_BUCKET 4 		//!< Average names per bucket of the symbol table
+#define PCIE_SYM_SEEDS 	16 		//!< Seeds tried before pcie_sym_init() gives up
+
+/**
+ * Flag fragments 
+ *
+ * Each flag register is rendered as a short sequence of precomputed string 
+ * fragments, one per nibble or multi-bit field, generated here at compile 
+ * time. PF0/PF1 produce the lspci "-" and "+" forms of a flag name.
+ */
+#define PCIE_FRAG(s) 	{ s, sizeof(s) - 1 }
+#define PF0(s) 			s "- "
+#define PF1(s) 			s "+ "
+
+/**
+ * Expand F for every combination of 1, 2, 4 or 5 bits, bit 0 first
+ */
+#define PCIE_BITS1(F) 	{ F(0), F(1) }
+#define PCIE_BITS2(F) 	{ F(0,0), F(1,0), F(0,1), F(1,1) }
+#define PCIE_BITS4(F) 	{ F(0,0,0,0), F(1,0,0,0), F(0,1,0,0), F(1,1,0,0), \
+						  F(0,0,1,0), F(1,0,1,0), F(0,1,1,0), F(1,1,1,0), \
+						  F(0,0,0,1), F(1,0,0,1), F(0,1,0,1), F(1,1,0,1), \
+						  F(0,0,1,1), F(1,0,1,1), F(0,1,1,1), F(1,1,1,1) }
+#define PCIE_BITS5_(F, e) 	F(0,0,0,0,e), F(1,0,0,0,e), F(0,1,0,0,e), F(1,1,0,0,e), \
+							F(0,0,1,0,e), F(1,0,1,0,e), F(0,1,1,0,e), F(1,1,1,0,e), \
+							F(0,0,0,1,e), F(1,0,0,1,e), F(0,1,0,1,e), F(1,1,0,1,e), \
+							F(0,0,1,1,e), F(1,0,1,1,e), F(0,1,1,1,e), F(1,1,1,1,e)
+#define PCIE_BITS5(F) 	{ PCIE_BITS5_(F, 0), PCIE_BITS5_(F, 1) }
+
+#define PCIE_FLAG_OP(shift, mask, tbl) 	{ shift, mask, tbl }
+#define PCIE_FLAG_OPS(ops) 				ops, sizeof(ops) / sizeof((ops)[0])
+
+/* Command */
+#define CMD_N0(a,b,c,d) 	PCIE_FRAG(PF##a("I/O") PF##b("Mem") PF##c("BusMaster") PF##d("SpecCycle"))
+#define CMD_N1(a,b,c,d) 	PCIE_FRAG(PF##a("MemWINV") PF##b("VGASnoop") PF##c("ParErr") PF##d("Stepping"))
+#define CMD_N2(a,b,c,d) 	PCIE_FRAG(PF##a("SERR") PF##b("FastB2B") PF##c("DisINTx"))
+
+/* Status */
+#define DEVSEL_00 			"fast"
+#define DEVSEL_10 			"medium"
+#define DEVSEL_01 			"slow"
+#define DEVSEL_11 			"??"
+#define STS_N1(a,b,c,d) 	PCIE_FRAG(PF##a("Cap") PF##b("66MHz") PF##c("UDF") PF##d("FastB2B"))
+#define STS_N2(a,b,c,d) 	PCIE_FRAG(PF##a("ParErr") "DEVSEL=" DEVSEL_##b##c " " PF##d(">TAbort"))
+#define STS_N3(a,b,c,d) 	PCIE_FRAG(PF##a("<TAbort") PF##b("<MAbort") PF##c(">SERR") PF##d("<PERR"))
+#define STS_INTX(a) 		PCIE_FRAG(PF##a("INTx"))
+
+/* Power Management Capabilities */
+#define PMC_CLK(a) 			PCIE_FRAG(PF##a("PMEClk"))
+#define PMC_DSI(a) 			PCIE_FRAG(PF##a("DSI"))
+#define PMC_D1D2(a,b) 		PCIE_FRAG(PF##a("D1") PF##b("D2"))
+#define PMS0(s) 			s "-"
+#define PMS1(s) 			s "+"
+#define PMC_PME(a,b,c,d,e) 	PCIE_FRAG("PME(" PMS##a("D0") "," PMS##b("D1") "," PMS##c("D2") "," PMS##d("D3hot") "," PMS##e("D3cold") ") ")
+
+/* Power Management Control / Status */
+#define PMCSR_NSR(a) 		PCIE_FRAG(PF##a("NoSoftRst"))
+#define PMCSR_PMEEN(a) 		PCIE_FRAG(PF##a("PME-Enable"))
+#define PMCSR_PME(a) 		PCIE_FRAG(PF##a("PME"))
+
+/* MSI Message Control */
+#define MSI_EN(a) 			PCIE_FRAG(PF##a("Enable"))
+#define MSI_MASK(a) 		PCIE_FRAG(PF##a("Maskable"))
+#define MSI_64(a) 			PCIE_FRAG(PF##a("64bit"))
 
 /* ENUMERATIONS ==============================================================*/
 
 /* STRUCTS ===================================================================*/
 
+/**
+ * Output buffer used by the formatting functions
+ */
+struct pcie_buf
+{
+	char *buf; 		//!< Output buffer 
+	size_t len; 	//!< Usable size of buf, excluding room for the NULL terminator
+	size_t pos; 	//!< Bytes written so far. May exceed len when output is truncated
+};
+
+/**
+ * Precomputed string fragment 
+ */
+struct pcie_frag
+{
+	const char *s; 		//!< Fragment text, ending in a space
+	size_t len; 		//!< strlen(s)
+};
+
+/**
+ * One step of rendering a flag register: emit tbl[(v >> shift) & mask]
+ */
+struct pcie_flag_op
+{
+	__u8 shift; 					//!< Lowest bit of the field 
+	__u8 mask; 						//!< Field mask after shifting 
+	const struct pcie_frag *tbl; 	//!< Fragment for each field value
+};
+
+/**
+ * Context passed to the formatting callback of pcie_reg_decode() 
+ */
+struct pcie_fmt_ctx
+{
+	struct pcie_buf *b; 	//!< Output buffer
+	unsigned indent; 		//!< Spaces before each line 
+};
+
+/**
+ * Symbol known to the library. Expanded into the pcie_sym table entries
+ */
+struct pcie_sym_def
+{
+	const char *sym; 			//!< Enum symbol 
+	const char *const *str; 	//!< Name of the symbol in its STR_ table
+	__u8 ns; 					//!< enum _PCSY
+	__u32 val; 					//!< Capability ID or Class Code
+	__u32 mask; 				//!< Significant bits of val
+};
+
 /* PROTOTYPES ================================================================*/
 
 /* GLOBAL VARIABLES ==========================================================*/
@@ -39,6 +169,7 @@
  * These are 8-bit IDs 
  */
 const char *STR_PCAP[] = { 
+	NULL, 										// 0x00
 	"PCI Power Management Interface",			// 0x01
 	"Accelerated Graphics Port",      			// 0x02
 	"Vital Product Data",      					// 0x03
@@ -67,6 +198,7 @@ const char *STR_PCAP[] = {
  *
  */
 const char *STR_PCEC[] = {
+	NULL, 													// 0x0000
 	"Advanced Error Reporting",								// 0x0001	
 	"Virtual Channel (VC)",                                 // 0x0002
 	"Device Serial Number",                                 // 0x0003
@@ -78,6 +210,7 @@ const char *STR_PCEC[] = {
 	"Virtual Channel (VC)",                                 // 0x0009
 	"Root Complex Register Block (RCRB) Header",            // 0x000a
 	"Vendor-Specific Extended Capability (VSEC)",           // 0x000b
+	NULL, 													// 0x000c
 	"Access Control Services (ACS)",                        // 0x000d
 	"Alternative Routing-ID Interpretation (ARI)",          // 0x000e
 	"Address Translation Services (ATS)",                   // 0x000f
@@ -85,6 +218,7 @@ const char *STR_PCEC[] = {
 	"Multi-Root I/O Virtualization (MR-IOV) (Deprecated)",  // 0x0011
 	"Multicast",                                            // 0x0012
 	"Page Request Interface (PRI)",                         // 0x0013
+	NULL, 													// 0x0014
 	"Resizable BAR",                                        // 0x0015
 	"Dynamic Power Allocation (DPA)",                       // 0x0016
 	"TPH Requester",                                        // 0x0017
@@ -141,8 +275,8 @@ const char *STR_PCMC[] =
  */
 const char *STR_PCCX[] =
 {
-	"Vendor Specific Interface)",	// 0x00
-	"CXL 2.0 or later"				// 0x01
+	"CXL Memory Device - Vendor Specific Interface",		// 0x00
+	"CXL Memory Device compliant with CXL 2.0 or later"		// 0x01
 };
 
 /**
@@ -264,7 +398,7 @@ const char *STR_PCSP[] =
 	"SD Host Controller", 						// 0x05 
 	"IOMMU", 									// 0x06 
 	"Root Complex Event Collector", 			// 0x07 
-	"Other System Peripheral" 					// 0x08   
+	"Other System Peripheral" 					// 0x80   
 };
 
 /**
@@ -409,7 +543,7 @@ const char *STR_PCDA[] =
 const char *STR_PCPA[] = 
 {
 	"Processing Accelerator - Vendor Specific Interface", 	// 0x00 
-	"SNIA Smart Data Acceleration Interface (SDXI)", 		// 0x00 
+	"SNIA Smart Data Acceleration Interface (SDXI)", 		// 0x01 
 };
 
 /**
@@ -422,9 +556,403 @@ const char *STR_PCNE[] =
 	"Non Essential Instrumentation - Vendor Specific Interface", // 0x00 
 };
 
+/**
+ * String representation of PCI Class Codes (BC)
+ */
+const char *STR_PCBC[] = 
+{
+	"Unclassified Device", 									// 0x00 
+	"Mass Storage Controller", 								// 0x01 
+	"Network Controller", 									// 0x02 
+	"Display Controller", 									// 0x03 
+	"Multimedia Device", 									// 0x04 
+	"Memory Controller", 									// 0x05 
+	"Bridge Device", 										// 0x06 
+	"Simple Communication Controller", 						// 0x07 
+	"Base System Peripheral", 								// 0x08 
+	"Input Device", 										// 0x09 
+	"Docking Station", 										// 0x0A 
+	"Processor", 											// 0x0B 
+	"Serial Bus Controller", 								// 0x0C 
+	"Wireless Controller", 									// 0x0D 
+	"Intelligent I/O Controller", 							// 0x0E 
+	"Satellite Communication Controller", 					// 0x0F 
+	"Encryption/Decryption Controller", 					// 0x10 
+	"Data Acquisition and Signal Processing Controller", 	// 0x11 
+	"Processing Accelerator", 								// 0x12 
+	"Non-Essential Instrumentation", 						// 0x13 
+};
+
+/**
+ * Sub Class names keyed by (Base Class, Sub Class)
+ *
+ * This list is expanded by the X() macros below to generate the dense tables
+ * used by pcie_class_name(). Each Sub Class enum symbol must appear only once.
+ */
+#define PCIE_CLASS_LIST(X) \
+	X(PCBC_MSC, PCMS_SCSI, STR_PCMS[0]) \
+	X(PCBC_MSC, PCMS_IDE, STR_PCMS[1]) \
+	X(PCBC_MSC, PCMS_FLOPPY, STR_PCMS[2]) \
+	X(PCBC_MSC, PCMS_IPI, STR_PCMS[3]) \
+	X(PCBC_MSC, PCMS_RAID, STR_PCMS[4]) \
+	X(PCBC_MSC, PCMS_ATA, STR_PCMS[5]) \
+	X(PCBC_MSC, PCMS_SATA, STR_PCMS[6]) \
+	X(PCBC_MSC, PCMS_SAS, STR_PCMS[7]) \
+	X(PCBC_MSC, PCMS_NVM, STR_PCMS[8]) \
+	X(PCBC_MSC, PCMS_UFS, STR_PCMS[9]) \
+	X(PCBC_MSC, PCMS_OTHER, STR_PCMS[10]) \
+	X(PCBC_NET, PCNC_ETH, STR_PCNC[0]) \
+	X(PCBC_NET, PCNC_TOKEN, STR_PCNC[1]) \
+	X(PCBC_NET, PCNC_FDDI, STR_PCNC[2]) \
+	X(PCBC_NET, PCNC_ATM, STR_PCNC[3]) \
+	X(PCBC_NET, PCNC_ISDN, STR_PCNC[4]) \
+	X(PCBC_NET, PCNC_WORLDFIP, STR_PCNC[5]) \
+	X(PCBC_NET, PCNC_PICMG, STR_PCNC[6]) \
+	X(PCBC_NET, PCNC_IB, STR_PCNC[7]) \
+	X(PCBC_NET, PCNC_HFC, STR_PCNC[8]) \
+	X(PCBC_NET, PCNC_OTHER, STR_PCNC[9]) \
+	X(PCBC_DISPLAY, PCDC_VGA, STR_PCDC[0]) \
+	X(PCBC_DISPLAY, PCDC_XGA, STR_PCDC[1]) \
+	X(PCBC_DISPLAY, PCDC_3D, STR_PCDC[2]) \
+	X(PCBC_DISPLAY, PCDC_OTHER, STR_PCDC[3]) \
+	X(PCBC_MULTIMEDIA, PCUC_VIDEO, STR_PCUC[0]) \
+	X(PCBC_MULTIMEDIA, PCUC_AUDIO, STR_PCUC[1]) \
+	X(PCBC_MULTIMEDIA, PCUC_TELEPHONE, STR_PCUC[2]) \
+	X(PCBC_MULTIMEDIA, PCUC_HD_AUDIO, STR_PCUC[3]) \
+	X(PCBC_MULTIMEDIA, PCUC_OTHER, STR_PCUC[4]) \
+	X(PCBC_MEM_CTRL, PCMC_RAM, STR_PCMC[0]) \
+	X(PCBC_MEM_CTRL, PCMC_FLASH, STR_PCMC[1]) \
+	X(PCBC_MEM_CTRL, PCMC_CXL_MEM, STR_PCMC[2]) \
+	X(PCBC_MEM_CTRL, PCMC_OTHER, STR_PCMC[3]) \
+	X(PCBC_BRIDGE, PCBD_HOST, STR_PCBD[0]) \
+	X(PCBC_BRIDGE, PCBD_ISA, STR_PCBD[1]) \
+	X(PCBC_BRIDGE, PCBD_EISA, STR_PCBD[2]) \
+	X(PCBC_BRIDGE, PCBD_MCA, STR_PCBD[3]) \
+	X(PCBC_BRIDGE, PCBD_PPB, STR_PCBD[4]) \
+	X(PCBC_BRIDGE, PCBD_PCMCIA, STR_PCBD[5]) \
+	X(PCBC_BRIDGE, PCBD_NUBUS, STR_PCBD[6]) \
+	X(PCBC_BRIDGE, PCBD_CARDBUS, STR_PCBD[7]) \
+	X(PCBC_BRIDGE, PCBD_RACEWAY, STR_PCBD[8]) \
+	X(PCBC_BRIDGE, PCBD_STPPB, STR_PCBD[9]) \
+	X(PCBC_BRIDGE, PCBD_IB_PCI, STR_PCBD[10]) \
+	X(PCBC_BRIDGE, PCBD_AS_PCI, STR_PCBD[11]) \
+	X(PCBC_BRIDGE, PCBD_OTHER, STR_PCBD[12]) \
+	X(PCBC_SIMPLE_COMM, PCSC_GENERIC_XT, STR_PCSC[0]) \
+	X(PCBC_SIMPLE_COMM, PCSC_PARALLEL, STR_PCSC[1]) \
+	X(PCBC_SIMPLE_COMM, PCSC_MP_SERIAL, STR_PCSC[2]) \
+	X(PCBC_SIMPLE_COMM, PCSC_MODEM, STR_PCSC[3]) \
+	X(PCBC_SIMPLE_COMM, PCSC_GPIB, STR_PCSC[4]) \
+	X(PCBC_SIMPLE_COMM, PCSC_SMRT_CARD, STR_PCSC[5]) \
+	X(PCBC_SIMPLE_COMM, PCSC_OTHER, STR_PCSC[6]) \
+	X(PCBC_BASE_PERF, PCSP_PCI, STR_PCSP[0]) \
+	X(PCBC_BASE_PERF, PCSP_DMA, STR_PCSP[1]) \
+	X(PCBC_BASE_PERF, PCSP_TIMER, STR_PCSP[2]) \
+	X(PCBC_BASE_PERF, PCSP_RTC, STR_PCSP[3]) \
+	X(PCBC_BASE_PERF, PCSP_HOT_PLUG, STR_PCSP[4]) \
+	X(PCBC_BASE_PERF, PCSP_SD, STR_PCSP[5]) \
+	X(PCBC_BASE_PERF, PCSP_IOMMU, STR_PCSP[6]) \
+	X(PCBC_BASE_PERF, PCSP_RCEC, STR_PCSP[7]) \
+	X(PCBC_BASE_PERF, PCSP_OTHER, STR_PCSP[8]) \
+	X(PCBC_INPUT, PCID_KEYBOARD, STR_PCID[0]) \
+	X(PCBC_INPUT, PCID_PEN, STR_PCID[1]) \
+	X(PCBC_INPUT, PCID_MOUSE, STR_PCID[2]) \
+	X(PCBC_INPUT, PCID_SCANNER, STR_PCID[3]) \
+	X(PCBC_INPUT, PCID_GAME, STR_PCID[4]) \
+	X(PCBC_INPUT, PCID_OTHER, STR_PCID[5]) \
+	X(PCBC_DOCKING, PCDS_GENERIC, STR_PCDS[0]) \
+	X(PCBC_DOCKING, PCDS_OTHER, STR_PCDS[1]) \
+	X(PCBC_PROCESSORS, PCPR_386, STR_PCPR[0]) \
+	X(PCBC_PROCESSORS, PCPR_486, STR_PCPR[1]) \
+	X(PCBC_PROCESSORS, PCPR_PENTIUM, STR_PCPR[2]) \
+	X(PCBC_PROCESSORS, PCPR_ALPHA, STR_PCPR[3]) \
+	X(PCBC_PROCESSORS, PCPR_POWERPC, STR_PCPR[4]) \
+	X(PCBC_PROCESSORS, PCPR_MIPS, STR_PCPR[5]) \
+	X(PCBC_PROCESSORS, PCPR_COPROCESSOR, STR_PCPR[6]) \
+	X(PCBC_PROCESSORS, PCPR_OTHER, STR_PCPR[7]) \
+	X(PCBC_SERIAL_CTRL, PCSB_FIREWIRE, STR_PCSB[0]) \
+	X(PCBC_SERIAL_CTRL, PCSB_ACCESS, STR_PCSB[1]) \
+	X(PCBC_SERIAL_CTRL, PCSB_SSA, STR_PCSB[2]) \
+	X(PCBC_SERIAL_CTRL, PCSB_USB, STR_PCSB[3]) \
+	X(PCBC_SERIAL_CTRL, PCSB_FC, STR_PCSB[4]) \
+	X(PCBC_SERIAL_CTRL, PCSB_SMBUS, STR_PCSB[5]) \
+	X(PCBC_SERIAL_CTRL, PCSB_IB, STR_PCSB[6]) \
+	X(PCBC_SERIAL_CTRL, PCSB_IPMI, STR_PCSB[7]) \
+	X(PCBC_SERIAL_CTRL, PCSB_SERCOS, STR_PCSB[8]) \
+	X(PCBC_SERIAL_CTRL, PCSB_CANBUS, STR_PCSB[9]) \
+	X(PCBC_SERIAL_CTRL, PCSB_I3C, STR_PCSB[10]) \
+	X(PCBC_SERIAL_CTRL, PCSB_OTHER, STR_PCSB[11]) \
+	X(PCBC_WIRELESS, PCWC_IRDA, STR_PCWC[0]) \
+	X(PCBC_WIRELESS, PCWC_IR, STR_PCWC[1]) \
+	X(PCBC_WIRELESS, PCWC_RF, STR_PCWC[2]) \
+	X(PCBC_WIRELESS, PCWC_BT, STR_PCWC[3]) \
+	X(PCBC_WIRELESS, PCWC_BROADBAND, STR_PCWC[4]) \
+	X(PCBC_WIRELESS, PCWC_ETH5G, STR_PCWC[5]) \
+	X(PCBC_WIRELESS, PCWC_ETH2_4G, STR_PCWC[6]) \
+	X(PCBC_WIRELESS, PCWC_CELL, STR_PCWC[7]) \
+	X(PCBC_WIRELESS, PCWC_CELL_ETH, STR_PCWC[8]) \
+	X(PCBC_WIRELESS, PCWC_OTHER, STR_PCWC[9]) \
+	X(PCBC_INTELLIGENT_IO, PCIO_I2O, STR_PCIO[0]) \
+	X(PCBC_SATELLITE, PCSA_TV, STR_PCSA[0]) \
+	X(PCBC_SATELLITE, PCSA_AUDIO, STR_PCSA[1]) \
+	X(PCBC_SATELLITE, PCSA_VOICE, STR_PCSA[2]) \
+	X(PCBC_SATELLITE, PCSA_DATA, STR_PCSA[3]) \
+	X(PCBC_SATELLITE, PCSA_OTHER, STR_PCSA[4]) \
+	X(PCBC_ENCRYPT, PCEN_NET, STR_PCEN[0]) \
+	X(PCBC_ENCRYPT, PCEN_ENT, STR_PCEN[1]) \
+	X(PCBC_ENCRYPT, PCEN_OTHER, STR_PCEN[2]) \
+	X(PCBC_SIG_PROCESS, PCDA_DPIO, STR_PCDA[0]) \
+	X(PCBC_SIG_PROCESS, PCDA_PERF, STR_PCDA[1]) \
+	X(PCBC_SIG_PROCESS, PCDA_SYNC, STR_PCDA[2]) \
+	X(PCBC_SIG_PROCESS, PCDA_MGMT, STR_PCDA[3]) \
+	X(PCBC_SIG_PROCESS, PCDA_OTHER, STR_PCDA[4]) \
+	X(PCBC_PROC_ACCEL, PCPA_ACCEL, STR_PCPA[0]) \
+	X(PCBC_PROC_ACCEL, PCPA_SDXI, STR_PCPA[1]) \
+	X(PCBC_NON_ESSN, PCNE_INST, STR_PCNE[0])
+
+/**
+ * Programming Interface names keyed by (Base Class, Sub Class, Prog IF)
+ */
+#define PCIE_CLASS_PI_LIST(X) \
+	X(PCBC_MEM_CTRL, PCMC_CXL_MEM, PCCX_VS, 	STR_PCCX[0]) \
+	X(PCBC_MEM_CTRL, PCMC_CXL_MEM, PCCX_CXL2_0, STR_PCCX[1])
+
+/**
+ * Row of each Base Class in PCIE_CLASS_SUB[]. Row 0 has no names 
+ */
+#define PCIE_CLASS_ROW(base) 	((base) + 1)
+#define PCIE_CLASS_ROWS 		PCIE_CLASS_ROW(PCBC_MAX)
+
+/**
+ * Slot numbers for every named Sub Class and Programming Interface
+ *
+ * Slot 0 is the unnamed slot and resolves to NULL
+ */
+enum _PCIE_CLASS_SLOT
+{
+	PCIE_CLASS_SLOT_NONE,
+#define X(base, sub, str) PCIE_CLASS_SLOT_##sub,
+	PCIE_CLASS_LIST(X)
+#undef X
+#define X(base, sub, pi, str) PCIE_CLASS_SLOT_##pi,
+	PCIE_CLASS_PI_LIST(X)
+#undef X
+	PCIE_CLASS_SLOT_MAX
+};
+
+/**
+ * Rows of Programming Interface slots. Row 0 has no names 
+ */
+enum _PCIE_CLASS_PIROW
+{
+	PCIE_CLASS_PIROW_NONE,
+	PCIE_CLASS_PIROW_PCMC_CXL_MEM,
+	PCIE_CLASS_PIROW_MAX
+};
+
+static const char *STR_NONE = NULL;
+
+/**
+ * Slot -> name 
+ */
+static const char **const PCIE_CLASS_SLOT[PCIE_CLASS_SLOT_MAX] = 
+{
+	[PCIE_CLASS_SLOT_NONE] = &STR_NONE,
+#define X(base, sub, str) [PCIE_CLASS_SLOT_##sub] = &str,
+	PCIE_CLASS_LIST(X)
+#undef X
+#define X(base, sub, pi, str) [PCIE_CLASS_SLOT_##pi] = &str,
+	PCIE_CLASS_PI_LIST(X)
+#undef X
+};
+
+/**
+ * Base Class -> row in PCIE_CLASS_SUB[]
+ */
+static const __u8 PCIE_CLASS_BASE[256] = 
+{
+	[PCBC_MSC] = PCIE_CLASS_ROW(PCBC_MSC),
+	[PCBC_NET] = PCIE_CLASS_ROW(PCBC_NET),
+	[PCBC_DISPLAY] = PCIE_CLASS_ROW(PCBC_DISPLAY),
+	[PCBC_MULTIMEDIA] = PCIE_CLASS_ROW(PCBC_MULTIMEDIA),
+	[PCBC_MEM_CTRL] = PCIE_CLASS_ROW(PCBC_MEM_CTRL),
+	[PCBC_BRIDGE] = PCIE_CLASS_ROW(PCBC_BRIDGE),
+	[PCBC_SIMPLE_COMM] = PCIE_CLASS_ROW(PCBC_SIMPLE_COMM),
+	[PCBC_BASE_PERF] = PCIE_CLASS_ROW(PCBC_BASE_PERF),
+	[PCBC_INPUT] = PCIE_CLASS_ROW(PCBC_INPUT),
+	[PCBC_DOCKING] = PCIE_CLASS_ROW(PCBC_DOCKING),
+	[PCBC_PROCESSORS] = PCIE_CLASS_ROW(PCBC_PROCESSORS),
+	[PCBC_SERIAL_CTRL] = PCIE_CLASS_ROW(PCBC_SERIAL_CTRL),
+	[PCBC_WIRELESS] = PCIE_CLASS_ROW(PCBC_WIRELESS),
+	[PCBC_INTELLIGENT_IO] = PCIE_CLASS_ROW(PCBC_INTELLIGENT_IO),
+	[PCBC_SATELLITE] = PCIE_CLASS_ROW(PCBC_SATELLITE),
+	[PCBC_ENCRYPT] = PCIE_CLASS_ROW(PCBC_ENCRYPT),
+	[PCBC_SIG_PROCESS] = PCIE_CLASS_ROW(PCBC_SIG_PROCESS),
+	[PCBC_PROC_ACCEL] = PCIE_CLASS_ROW(PCBC_PROC_ACCEL),
+	[PCBC_NON_ESSN] = PCIE_CLASS_ROW(PCBC_NON_ESSN),
+};
+
+/**
+ * [Base Class row][Sub Class] -> slot 
+ */
+static const __u8 PCIE_CLASS_SUB[PCIE_CLASS_ROWS][256] = 
+{
+#define X(base, sub, str) [PCIE_CLASS_ROW(base)][sub] = PCIE_CLASS_SLOT_##sub,
+	PCIE_CLASS_LIST(X)
+#undef X
+};
+
+/**
+ * Slot -> row in PCIE_CLASS_PI[] 
+ */
+static const __u8 PCIE_CLASS_PIROW[PCIE_CLASS_SLOT_MAX] = 
+{
+	[PCIE_CLASS_SLOT_PCMC_CXL_MEM] = PCIE_CLASS_PIROW_PCMC_CXL_MEM,
+};
+
+/**
+ * [Prog IF row][Prog IF] -> slot 
+ */
+static const __u8 PCIE_CLASS_PI[PCIE_CLASS_PIROW_MAX][256] = 
+{
+#define X(base, sub, pi, str) [PCIE_CLASS_PIROW_##sub][pi] = PCIE_CLASS_SLOT_##pi,
+	PCIE_CLASS_PI_LIST(X)
+#undef X
+};
 
+/**
+ * Capabilities, Extended Capabilities and Base Classes with a reverse lookup
+ *
+ * Sub Classes and Programming Interfaces come from PCIE_CLASS_LIST and
+ * PCIE_CLASS_PI_LIST. These three lists are kept by hand next to enum _PCAP,
+ * enum _PCEC and enum _PCBC: an ID added to an enum must also be added here.
+ * The counts are checked below so that a missed entry fails the build.
+ */
+#define PCIE_SYM_CAP_LIST(X) \
+	X(PCAP_PM) \
+	X(PCAP_AGP) \
+	X(PCAP_VPD) \
+	X(PCAP_SLOTID) \
+	X(PCAP_MSI) \
+	X(PCAP_CHSWP) \
+	X(PCAP_PCIX) \
+	X(PCAP_HT) \
+	X(PCAP_VNDR) \
+	X(PCAP_DBG) \
+	X(PCAP_CCRC) \
+	X(PCAP_HOTPLUG) \
+	X(PCAP_SSVID) \
+	X(PCAP_AGP3) \
+	X(PCAP_SECURE) \
+	X(PCAP_EXP) \
+	X(PCAP_MSIX) \
+	X(PCAP_SATA) \
+	X(PCAP_AF) \
+	X(PCAP_EA) \
+	X(PCAP_FPB)
+
+#define PCIE_SYM_ECAP_LIST(X) \
+	X(PCEC_AER) \
+	X(PCEC_VC) \
+	X(PCEC_DSN) \
+	X(PCEC_PB) \
+	X(PCEC_RCLINK) \
+	X(PCEC_RCILINK) \
+	X(PCEC_RCECOLL) \
+	X(PCEC_MFVC) \
+	X(PCEC_VC2) \
+	X(PCEC_RBCB) \
+	X(PCEC_VNDR) \
+	X(PCEC_ACS) \
+	X(PCEC_ARI) \
+	X(PCEC_ATS) \
+	X(PCEC_SRIOV) \
+	X(PCEC_MRIOV) \
+	X(PCEC_MCAST) \
+	X(PCEC_PRI) \
+	X(PCEC_REBAR) \
+	X(PCEC_DPA) \
+	X(PCEC_TPH) \
+	X(PCEC_LTR) \
+	X(PCEC_SECPCI) \
+	X(PCEC_PMUX) \
+	X(PCEC_PASID) \
+	X(PCEC_LNR) \
+	X(PCEC_DPC) \
+	X(PCEC_L1PM) \
+	X(PCEC_PTM) \
+	X(PCEC_M_PCIE) \
+	X(PCEC_FRS) \
+	X(PCEC_RTR) \
+	X(PCEC_DVSEC) \
+	X(PCEC_VF_REBAR) \
+	X(PCEC_DLNK) \
+	X(PCEC_16GT) \
+	X(PCEC_LMR) \
+	X(PCEC_HIER_ID) \
+	X(PCEC_NPEM) \
+	X(PCEC_PL) \
+	X(PCEC_AP) \
+	X(PCEC_SFI) \
+	X(PCEC_SFUNC) \
+	X(PCEC_DOE) \
+	X(PCEC_DEV3) \
+	X(PCEC_IDE) \
+	X(PCEC_64GT) \
+	X(PCEC_FLITLOG) \
+	X(PCEC_FLITPERF) \
+	X(PCEC_FLITEI)
+
+#define PCIE_SYM_BASE_LIST(X) \
+	X(PCBC_NULL) \
+	X(PCBC_MSC) \
+	X(PCBC_NET) \
+	X(PCBC_DISPLAY) \
+	X(PCBC_MULTIMEDIA) \
+	X(PCBC_MEM_CTRL) \
+	X(PCBC_BRIDGE) \
+	X(PCBC_SIMPLE_COMM) \
+	X(PCBC_BASE_PERF) \
+	X(PCBC_INPUT) \
+	X(PCBC_DOCKING) \
+	X(PCBC_PROCESSORS) \
+	X(PCBC_SERIAL_CTRL) \
+	X(PCBC_WIRELESS) \
+	X(PCBC_INTELLIGENT_IO) \
+	X(PCBC_SATELLITE) \
+	X(PCBC_ENCRYPT) \
+	X(PCBC_SIG_PROCESS) \
+	X(PCBC_PROC_ACCEL) \
+	X(PCBC_NON_ESSN)
+
+#define PCIE_SYM_COUNT(sym) + 1
+
+_Static_assert(0 PCIE_SYM_CAP_LIST(PCIE_SYM_COUNT) == PCAP_MAX - 1, "PCIE_SYM_CAP_LIST must list every enum _PCAP ID");
+_Static_assert(0 PCIE_SYM_ECAP_LIST(PCIE_SYM_COUNT) == PCEC_MAX - 3, "PCIE_SYM_ECAP_LIST must list every enum _PCEC ID. 0x0C and 0x14 are not defined");
+_Static_assert(0 PCIE_SYM_BASE_LIST(PCIE_SYM_COUNT) == PCBC_MAX, "PCIE_SYM_BASE_LIST must list every enum _PCBC ID");
 
+/**
+ * Symbols added to a struct pcie_sym by pcie_sym_init(), in order of priority
+ */
+static const struct pcie_sym_def PCIE_SYM_DEFS[] = 
+{
+#define X(sym) { #sym, &STR_PCAP[sym], PCSY_CAP, sym, 0xFF },
+	PCIE_SYM_CAP_LIST(X)
+#undef X
+#define X(sym) { #sym, &STR_PCEC[sym], PCSY_ECAP, sym, 0xFFFF },
+	PCIE_SYM_ECAP_LIST(X)
+#undef X
+#define X(sym) { #sym, &STR_PCBC[sym], PCSY_CLASS, sym << 16, 0xFF0000 },
+	PCIE_SYM_BASE_LIST(X)
+#undef X
+#define X(base, sub, str) { #sub, &str, PCSY_CLASS, (base << 16) | (sub << 8), 0xFFFF00 },
+	PCIE_CLASS_LIST(X)
+#undef X
+#define X(base, sub, pi, str) { #pi, &str, PCSY_CLASS, (base << 16) | (sub << 8) | pi, 0xFFFFFF },
+	PCIE_CLASS_PI_LIST(X)
+#undef X
+};
 
+#define PCIE_SYM_NDEFS 	(sizeof(PCIE_SYM_DEFS) / sizeof(PCIE_SYM_DEFS[0]))
 
 
 
@@ -445,9 +973,160 @@ const char *STR_PCNE[] =
 
 
 
+
+
+
+
+
+static const struct pcie_frag FRAG_CMD_N0[] 	= PCIE_BITS4(CMD_N0);
+static const struct pcie_frag FRAG_CMD_N1[] 	= PCIE_BITS4(CMD_N1);
+static const struct pcie_frag FRAG_CMD_N2[] 	= PCIE_BITS4(CMD_N2);
+static const struct pcie_frag FRAG_STS_N1[] 	= PCIE_BITS4(STS_N1);
+static const struct pcie_frag FRAG_STS_N2[] 	= PCIE_BITS4(STS_N2);
+static const struct pcie_frag FRAG_STS_N3[] 	= PCIE_BITS4(STS_N3);
+static const struct pcie_frag FRAG_STS_INTX[] 	= PCIE_BITS1(STS_INTX);
+static const struct pcie_frag FRAG_PMC_CLK[] 	= PCIE_BITS1(PMC_CLK);
+static const struct pcie_frag FRAG_PMC_DSI[] 	= PCIE_BITS1(PMC_DSI);
+static const struct pcie_frag FRAG_PMC_D1D2[] 	= PCIE_BITS2(PMC_D1D2);
+static const struct pcie_frag FRAG_PMC_PME[] 	= PCIE_BITS5(PMC_PME);
+static const struct pcie_frag FRAG_PMCSR_NSR[] 	= PCIE_BITS1(PMCSR_NSR);
+static const struct pcie_frag FRAG_PMCSR_PMEEN[]= PCIE_BITS1(PMCSR_PMEEN);
+static const struct pcie_frag FRAG_PMCSR_PME[] 	= PCIE_BITS1(PMCSR_PME);
+static const struct pcie_frag FRAG_MSI_EN[] 	= PCIE_BITS1(MSI_EN);
+static const struct pcie_frag FRAG_MSI_MASK[] 	= PCIE_BITS1(MSI_MASK);
+static const struct pcie_frag FRAG_MSI_64[] 	= PCIE_BITS1(MSI_64);
+
+static const struct pcie_frag FRAG_PMC_AUX[] = 
+{
+	PCIE_FRAG("AuxCurrent=0mA "), 	PCIE_FRAG("AuxCurrent=55mA "), 
+	PCIE_FRAG("AuxCurrent=100mA "), PCIE_FRAG("AuxCurrent=160mA "), 
+	PCIE_FRAG("AuxCurrent=220mA "), PCIE_FRAG("AuxCurrent=270mA "), 
+	PCIE_FRAG("AuxCurrent=320mA "), PCIE_FRAG("AuxCurrent=375mA "), 
+};
+
+static const struct pcie_frag FRAG_PMCSR_STATE[] = 
+{
+	PCIE_FRAG("D0 "), PCIE_FRAG("D1 "), PCIE_FRAG("D2 "), PCIE_FRAG("D3hot "),
+};
+
+static const struct pcie_frag FRAG_PMCSR_DSEL[] = 
+{
+	PCIE_FRAG("DSel=0 "), 	PCIE_FRAG("DSel=1 "), 	PCIE_FRAG("DSel=2 "), 	PCIE_FRAG("DSel=3 "), 
+	PCIE_FRAG("DSel=4 "), 	PCIE_FRAG("DSel=5 "), 	PCIE_FRAG("DSel=6 "), 	PCIE_FRAG("DSel=7 "), 
+	PCIE_FRAG("DSel=8 "), 	PCIE_FRAG("DSel=9 "), 	PCIE_FRAG("DSel=10 "), 	PCIE_FRAG("DSel=11 "), 
+	PCIE_FRAG("DSel=12 "), 	PCIE_FRAG("DSel=13 "), 	PCIE_FRAG("DSel=14 "), 	PCIE_FRAG("DSel=15 "), 
+};
+
+static const struct pcie_frag FRAG_PMCSR_DSCALE[] = 
+{
+	PCIE_FRAG("DScale=0 "), PCIE_FRAG("DScale=1 "), PCIE_FRAG("DScale=2 "), PCIE_FRAG("DScale=3 "), 
+};
+
+static const struct pcie_frag FRAG_MSI_ALLOC[] = 
+{
+	PCIE_FRAG("Count=1/"), 	PCIE_FRAG("Count=2/"), 	PCIE_FRAG("Count=4/"), 	PCIE_FRAG("Count=8/"), 
+	PCIE_FRAG("Count=16/"), PCIE_FRAG("Count=32/"), PCIE_FRAG("Count=64/"), PCIE_FRAG("Count=128/"), 
+};
+
+static const struct pcie_frag FRAG_MSI_REQ[] = 
+{
+	PCIE_FRAG("1 "), 	PCIE_FRAG("2 "), 	PCIE_FRAG("4 "), 	PCIE_FRAG("8 "), 
+	PCIE_FRAG("16 "), 	PCIE_FRAG("32 "), 	PCIE_FRAG("64 "), 	PCIE_FRAG("128 "), 
+};
+
+/**
+ * Rendering steps of each flag register, in lspci order 
+ */
+static const struct pcie_flag_op FLAGS_CMD[] = 
+{
+	PCIE_FLAG_OP( 0, 0xF, FRAG_CMD_N0),
+	PCIE_FLAG_OP( 4, 0xF, FRAG_CMD_N1),
+	PCIE_FLAG_OP( 8, 0xF, FRAG_CMD_N2),
+};
+
+static const struct pcie_flag_op FLAGS_STATUS[] = 
+{
+	PCIE_FLAG_OP( 4, 0xF, FRAG_STS_N1),
+	PCIE_FLAG_OP( 8, 0xF, FRAG_STS_N2),
+	PCIE_FLAG_OP(12, 0xF, FRAG_STS_N3),
+	PCIE_FLAG_OP( 3, 0x1, FRAG_STS_INTX),
+};
+
+static const struct pcie_flag_op FLAGS_PMC[] = 
+{
+	PCIE_FLAG_OP( 3, 0x1, FRAG_PMC_CLK),
+	PCIE_FLAG_OP( 5, 0x1, FRAG_PMC_DSI),
+	PCIE_FLAG_OP( 9, 0x3, FRAG_PMC_D1D2),
+	PCIE_FLAG_OP( 6, 0x7, FRAG_PMC_AUX),
+	PCIE_FLAG_OP(11, 0x1F, FRAG_PMC_PME),
+};
+
+static const struct pcie_flag_op FLAGS_PMCSR[] = 
+{
+	PCIE_FLAG_OP( 0, 0x3, FRAG_PMCSR_STATE),
+	PCIE_FLAG_OP( 3, 0x1, FRAG_PMCSR_NSR),
+	PCIE_FLAG_OP( 8, 0x1, FRAG_PMCSR_PMEEN),
+	PCIE_FLAG_OP( 9, 0xF, FRAG_PMCSR_DSEL),
+	PCIE_FLAG_OP(13, 0x3, FRAG_PMCSR_DSCALE),
+	PCIE_FLAG_OP(15, 0x1, FRAG_PMCSR_PME),
+};
+
+static const struct pcie_flag_op FLAGS_MSI_CTRL[] = 
+{
+	PCIE_FLAG_OP( 0, 0x1, FRAG_MSI_EN),
+	PCIE_FLAG_OP( 4, 0x7, FRAG_MSI_ALLOC),
+	PCIE_FLAG_OP( 1, 0x7, FRAG_MSI_REQ),
+	PCIE_FLAG_OP( 8, 0x1, FRAG_MSI_MASK),
+	PCIE_FLAG_OP( 7, 0x1, FRAG_MSI_64),
+};
 
 /* FUNCTIONS =================================================================*/
 
+/**
+ * Return the name of a Sub Class, ignoring the Programming Interface
+ */
+static const char *pcie_class_sub(unsigned base, unsigned sub)
+{
+	if ((base | sub) > 0xFF)
+		return NULL;
+	return *PCIE_CLASS_SLOT[PCIE_CLASS_SUB[PCIE_CLASS_BASE[base]][sub]];
+}
+
+/**
+ * Return the most specific name for a PCI Class Code 
+ *
+ * The Programming Interface name is returned if one is defined, otherwise the 
+ * Sub Class name. After one range check this is a fixed sequence of table 
+ * loads with no branches on the input values.
+ *
+ * @param base 	Base Class Code (enum _PCBC)
+ * @param sub 	Sub Class Code 
+ * @param pi 	Programming Interface
+ * @return 		const char* name or NULL if the Sub Class is not known or a 
+ * 				value is above 0xFF
+ */
+const char *pcie_class_name(unsigned base, unsigned sub, unsigned pi)
+{
+	unsigned slot, pislot;
+
+	if ((base | sub | pi) > 0xFF)
+		return NULL;
+
+	slot = PCIE_CLASS_SUB[PCIE_CLASS_BASE[base]][sub];
+	pislot = PCIE_CLASS_PI[PCIE_CLASS_PIROW[slot]][pi];
+	return *PCIE_CLASS_SLOT[pislot ? pislot : slot];
+}
+
+/**
+ * Return a string representation of enumeration _PCBC
+ */
+const char *pcbc(unsigned u)
+{
+	if (u >= PCBC_MAX)
+		return NULL;
+	return STR_PCBC[u];
+}
+
 /**
  * Return a string representation of enumeration _PCAP
  */
@@ -463,12 +1142,9 @@ const char *pcap(unsigned u)
  */
 const char *pccx(unsigned u)
 {
-	switch (u)
-	{
-		case PCCX_VS:		return STR_PCCX[0];
-		case PCCX_CXL2_0:	return STR_PCCX[1];
-	}
-	return NULL;
+	if (u > 0xFF)
+		return NULL;
+	return *PCIE_CLASS_SLOT[PCIE_CLASS_PI[PCIE_CLASS_PIROW_PCMC_CXL_MEM][u]];
 }
 
 /**
@@ -487,14 +1163,7 @@ const char *pcec(unsigned u)
  */
 const char *pcmc(unsigned u)
 {
-	switch(u)
-	{
-		case PCMC_RAM: 		return STR_PCMC[0]; 
-		case PCMC_FLASH:	return STR_PCMC[1]; 
-		case PCMC_CXL_MEM:	return STR_PCMC[2]; 
-		case PCMC_OTHER:	return STR_PCMC[3]; 
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_MEM_CTRL, u);
 }
 
 /**
@@ -502,115 +1171,47 @@ const char *pcmc(unsigned u)
  */
 const char *pcms(unsigned u)
 {
-	switch (u)
-	{
-		case PCMS_SCSI:		return STR_PCMS[0];
-		case PCMS_IDE:		return STR_PCMS[1];
-		case PCMS_FLOPPY: 	return STR_PCMS[2];
-		case PCMS_IPI:		return STR_PCMS[3];
-		case PCMS_RAID:		return STR_PCMS[4];
-		case PCMS_ATA:		return STR_PCMS[5];
-		case PCMS_SATA:		return STR_PCMS[6];
-		case PCMS_SAS:		return STR_PCMS[7];
-		case PCMS_NVM: 		return STR_PCMS[8];
-		case PCMS_UFS: 		return STR_PCMS[9];
-		case PCMS_OTHER: 	return STR_PCMS[10];
-	}
-	return NULL;
-};
+	return pcie_class_sub(PCBC_MSC, u);
+}
 
 /**
  * Return a string representation of enumeration _PCNC 
  */
 const char *pcnc(unsigned u)
 {
-	switch (u)
-	{
-		case PCNC_ETH:			return STR_PCNC[0];
-		case PCNC_TOKEN:		return STR_PCNC[1];
-		case PCNC_FDDI:			return STR_PCNC[2];
-		case PCNC_ATM:			return STR_PCNC[3];
-		case PCNC_ISDN:			return STR_PCNC[4];
-		case PCNC_WORLDFIP:		return STR_PCNC[5];
-		case PCNC_PICMG:		return STR_PCNC[6];
-		case PCNC_IB:			return STR_PCNC[7];
-		case PCNC_HFC:			return STR_PCNC[8];
-		case PCNC_OTHER:		return STR_PCNC[9];
-	}
-	return NULL;
-};
+	return pcie_class_sub(PCBC_NET, u);
+}
 
 /**
  * Return a string representation of enumeration _PCDC
  */
 const char *pcdc(unsigned u)
 {
-	switch (u)
-	{
-		case PCDC_VGA: 			return STR_PCDC[0];
-		case PCDC_XGA: 			return STR_PCDC[1];
-		case PCDC_3D: 			return STR_PCDC[2];
-		case PCDC_OTHER: 		return STR_PCDC[3];
-	}
-	return NULL;
-};
+	return pcie_class_sub(PCBC_DISPLAY, u);
+}
 
 /**
  * Return a string representation of enumeration _PCUC 
  */
 const char *pcuc(unsigned u)
 {
-	switch (u)
-	{
-		case PCUC_VIDEO: 		return STR_PCUC[0];
-		case PCUC_AUDIO:		return STR_PCUC[1];
-		case PCUC_TELEPHONE:	return STR_PCUC[2];
-		case PCUC_HD_AUDIO: 	return STR_PCUC[3];
-		case PCUC_OTHER: 		return STR_PCUC[4];
-	}
-	return NULL;
-};
+	return pcie_class_sub(PCBC_MULTIMEDIA, u);
+}
 
 /**
  * Return a string representation of enumeration _PCBD
  */
 const char *pcbd(unsigned u)
 {
-	switch (u)
-	{
-		case PCBD_HOST:		return STR_PCBD[0];
-		case PCBD_ISA:		return STR_PCBD[1];
-		case PCBD_EISA:		return STR_PCBD[2];
-		case PCBD_MCA:		return STR_PCBD[3];
-		case PCBD_PPB:		return STR_PCBD[4];
-		case PCBD_PCMCIA:	return STR_PCBD[5];
-		case PCBD_NUBUS:	return STR_PCBD[6];
-		case PCBD_CARDBUS:	return STR_PCBD[7];
-		case PCBD_RACEWAY:	return STR_PCBD[8];
-		case PCBD_STPPB:	return STR_PCBD[9];
-		case PCBD_IB_PCI:	return STR_PCBD[10];
-		case PCBD_AS_PCI:	return STR_PCBD[11];
-		case PCBD_OTHER:	return STR_PCBD[12];
-	}
-	return NULL;
-};
+	return pcie_class_sub(PCBC_BRIDGE, u);
+}
 
 /**
  * Return a string representation of enumeration _PCSC
  */
 const char *pcsc(unsigned u)
 {
-	switch (u)
-	{
-		case PCSC_GENERIC_XT: 	return STR_PCBD[0];
-		case PCSC_PARALLEL:  	return STR_PCBD[1]; 
-		case PCSC_MP_SERIAL:	return STR_PCBD[2];
-		case PCSC_MODEM: 	 	return STR_PCBD[3];
-		case PCSC_GPIB: 		return STR_PCBD[4];
-		case PCSC_SMRT_CARD:	return STR_PCBD[5];
-		case PCSC_OTHER: 	 	return STR_PCBD[6];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_SIMPLE_COMM, u);
 }
 
 
@@ -619,19 +1220,7 @@ const char *pcsc(unsigned u)
  */
 const char *pcsp(unsigned u)
 {
-	switch (u)
-	{
-		case PCSP_PCI:			return STR_PCSP[0];	
-		case PCSP_DMA:			return STR_PCSP[1];	
-		case PCSP_TIMER:		return STR_PCSP[2];	
-		case PCSP_RTC:			return STR_PCSP[3];	
-		case PCSP_HOT_PLUG:		return STR_PCSP[4];	
-		case PCSP_SD:			return STR_PCSP[5];	
-		case PCSP_IOMMU:		return STR_PCSP[6];	
-		case PCSP_RCEC:			return STR_PCSP[7];	
-		case PCSP_OTHER:		return STR_PCSP[8];	
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_BASE_PERF, u);
 }
 
 /**
@@ -639,16 +1228,7 @@ const char *pcsp(unsigned u)
  */
 const char *pcid(unsigned u)
 {
-	switch (u)
-	{
-		case PCID_KEYBOARD:		return STR_PCID[0];
-		case PCID_PEN:			return STR_PCID[1];
-		case PCID_MOUSE:		return STR_PCID[2];
-		case PCID_SCANNER:		return STR_PCID[3];
-		case PCID_GAME:			return STR_PCID[4];
-		case PCID_OTHER:		return STR_PCID[5];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_INPUT, u);
 }
 
 /**
@@ -656,12 +1236,7 @@ const char *pcid(unsigned u)
  */
 const char *pcds(unsigned u)
 {
-	switch (u)
-	{
-		case PCDS_GENERIC: 		return STR_PCDS[0];
-		case PCDS_OTHER:		return STR_PCDS[1];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_DOCKING, u);
 }
 
 /**
@@ -669,18 +1244,7 @@ const char *pcds(unsigned u)
  */
 const char *pcpr(unsigned u)
 {
-	switch (u)
-	{
-		case PCPR_386:				return STR_PCPR[0];
-		case PCPR_486:				return STR_PCPR[1];
-		case PCPR_PENTIUM:			return STR_PCPR[2];
-		case PCPR_ALPHA:			return STR_PCPR[3];
-		case PCPR_POWERPC:			return STR_PCPR[4];
-		case PCPR_MIPS:				return STR_PCPR[5];
-		case PCPR_COPROCESSOR:		return STR_PCPR[6];
-		case PCPR_OTHER:			return STR_PCPR[7];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_PROCESSORS, u);
 }
 
 /**
@@ -688,22 +1252,7 @@ const char *pcpr(unsigned u)
  */
 const char *pcsb(unsigned u)
 {
-	switch (u)
-	{
-		case PCSB_FIREWIRE:		return STR_PCSB[0];
-		case PCSB_ACCESS:		return STR_PCSB[1];
-		case PCSB_SSA:			return STR_PCSB[2];
-		case PCSB_USB:			return STR_PCSB[3];
-		case PCSB_FC:			return STR_PCSB[4];
-		case PCSB_SMBUS:		return STR_PCSB[5];
-		case PCSB_IB:			return STR_PCSB[6];
-		case PCSB_IPMI:			return STR_PCSB[7];
-		case PCSB_SERCOS:		return STR_PCSB[8];
-		case PCSB_CANBUS:		return STR_PCSB[9];
-		case PCSB_I3C:			return STR_PCSB[10];
-		case PCSB_OTHER:		return STR_PCSB[11];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_SERIAL_CTRL, u);
 }
 
 /**
@@ -711,20 +1260,7 @@ const char *pcsb(unsigned u)
  */
 const char *pcwc(unsigned u)
 {
-	switch (u)
-	{
-		case PCWC_IRDA:			return STR_PCWC[0];
-		case PCWC_IR:			return STR_PCWC[1];
-		case PCWC_RF:			return STR_PCWC[2];
-		case PCWC_BT:			return STR_PCWC[3];
-		case PCWC_BROADBAND:	return STR_PCWC[4];
-		case PCWC_ETH5G:		return STR_PCWC[5];
-		case PCWC_ETH2_4G:		return STR_PCWC[6];
-		case PCWC_CELL:			return STR_PCWC[7];
-		case PCWC_CELL_ETH:		return STR_PCWC[8];
-		case PCWC_OTHER:		return STR_PCWC[9];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_WIRELESS, u);
 }
 
 /**
@@ -732,11 +1268,7 @@ const char *pcwc(unsigned u)
  */
 const char *pcio(unsigned u)
 {
-	switch (u)
-	{
-		case PCIO_I2O:	return STR_PCIO[0];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_INTELLIGENT_IO, u);
 }
 
 /**
@@ -744,15 +1276,7 @@ const char *pcio(unsigned u)
  */
 const char *pcsa(unsigned u)
 {
-	switch (u)
-	{
-		case PCSA_TV:		return STR_PCSA[0];
-		case PCSA_AUDIO:	return STR_PCSA[1];
-		case PCSA_VOICE:	return STR_PCSA[2];
-		case PCSA_DATA:		return STR_PCSA[3];
-		case PCSA_OTHER:	return STR_PCSA[4];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_SATELLITE, u);
 }
 
 /**
@@ -760,13 +1284,7 @@ const char *pcsa(unsigned u)
  */
 const char *pcen(unsigned u)
 {
-	switch (u)
-	{
-		case PCEN_NET:		return STR_PCEN[0];
-		case PCEN_ENT:		return STR_PCEN[1];
-		case PCEN_OTHER:	return STR_PCEN[2];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_ENCRYPT, u);
 }
 
 /**
@@ -774,15 +1292,7 @@ const char *pcen(unsigned u)
  */
 const char *pcda(unsigned u)
 {
-	switch (u)
-	{
-		case PCDA_DPIO:		return STR_PCDA[0];
-		case PCDA_PERF:		return STR_PCDA[1];
-		case PCDA_SYNC:		return STR_PCDA[2];
-		case PCDA_MGMT:		return STR_PCDA[3];
-		case PCDA_OTHER:	return STR_PCDA[4];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_SIG_PROCESS, u);
 }
 
 /**
@@ -790,12 +1300,7 @@ const char *pcda(unsigned u)
  */
 const char *pcpa(unsigned u)
 {
-	switch (u)
-	{
-		case PCPA_ACCEL: 	return STR_PCPA[0];
-		case PCPA_SDXI: 	return STR_PCPA[1];
-	}
-	return NULL;
+	return pcie_class_sub(PCBC_PROC_ACCEL, u);
 }
 
 /**
@@ -803,11 +1308,373 @@ const char *pcpa(unsigned u)
  */
 const char *pcne(unsigned u)
 {
-	switch (u)
+	return pcie_class_sub(PCBC_NON_ESSN, u);
+}
+
+/**
+ * Fold the ASCII letters in 8 bytes to lower case
+ *
+ * The high bit of each byte of ge_a and gt_z is set when the byte is at least
+ * 'A' or above 'Z'. Their difference marks the upper case letters, which get
+ * bit 5 set. Bytes of 0x80 and above are left alone
+ */
+static inline __u64 pcie_sym_fold(__u64 x)
+{
+	__u64 lo, ge_a, gt_z;
+
+	lo = x & 0x7F7F7F7F7F7F7F7FULL;
+	ge_a = lo + 0x3F3F3F3F3F3F3F3FULL;
+	gt_z = lo + 0x2525252525252525ULL;
+	return x | (((ge_a ^ gt_z) & ~x & 0x8080808080808080ULL) >> 2);
+}
+
+/**
+ * Load up to 8 bytes of a name, zero filled
+ */
+static inline __u64 pcie_sym_word(const char *p, size_t len)
+{
+	__u64 w = 0;
+
+	if (len >= 8) {
+		memcpy(&w, p, 8);
+		return w;
+	}
+	while (len-- > 0)
+		w = (w << 8) | (unsigned char) p[len];
+	return w;
+}
+
+/**
+ * Hash a name 8 bytes at a time, ignoring case
+ */
+static __u64 pcie_sym_hash(unsigned ns, const char *name, size_t len, __u32 seed)
+{
+	__u64 h;
+	size_t i;
+
+	h = ((__u64) seed << 32) ^ ((__u64) ns << 16) ^ len;
+	for (i = 0 ; i < len ; i += 8) {
+		h = (h ^ pcie_sym_fold(pcie_sym_word(name + i, len - i))) * 0x9E3779B97F4A7C15ULL;
+		h ^= h >> 32;
+	}
+
+	return pcie_mix64(h);
+}
+
+/**
+ * Compare two names of the same length, ignoring case
+ */
+static int pcie_sym_eq(const char *a, const char *b, size_t len)
+{
+	size_t i;
+
+	for (i = 0 ; i < len ; i += 8)
+		if (pcie_sym_fold(pcie_sym_word(a + i, len - i)) != pcie_sym_fold(pcie_sym_word(b + i, len - i)))
+			return 0;
+	return 1;
+}
+
+/**
+ * Add a name to a list of unique entries. Later duplicates are dropped
+ */
+static void pcie_sym_add(struct pcie_sym_ent *e, unsigned *n, const struct pcie_sym_def *d, const char *name)
+{
+	size_t len;
+	unsigned i;
+
+	if (name == NULL)
+		return;
+
+	len = strlen(name);
+	if (len == 0 || len > 0xFFFF)
+		return;
+
+	for (i = 0 ; i < *n ; i++)
+		if (e[i].ns == d->ns && e[i].len == len && pcie_sym_eq(e[i].name, name, len))
+			return;
+
+	e[*n].name = name;
+	e[*n].val = d->val;
+	e[*n].mask = d->mask;
+	e[*n].len = len;
+	e[*n].ns = d->ns;
+	(*n)++;
+}
+
+/**
+ * Build the reverse lookup table from names to IDs
+ *
+ * Every Capability, Extended Capability, Base Class, Sub Class and
+ * Programming Interface known to the library can be found by its enum
+ * mnemonic (PCEC_DOE), by the mnemonic without the prefix for Capabilities
+ * (DOE), and by its name as returned by pcap(), pcec() and the class name
+ * functions. Names are matched without regard to ASCII case. When two
+ * symbols share a name in a namespace the first in enum order wins, e.g.
+ * "Virtual Channel (VC)" is PCEC_VC, not PCEC_VC2.
+ *
+ * The table is a perfect hash so that pcie_sym_find() costs one hash of the
+ * name and one compare. Build it once and share it between threads.
+ *
+ * @param t 	struct pcie_sym* to initialize. Release with pcie_sym_free()
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_sym_init(struct pcie_sym *t)
+{
+	struct pcie_sym_ent *e;
+	__u32 *pos;
+	__u64 *h;
+	unsigned i, n;
+	int rv;
+
+	memset(t, 0, sizeof(*t));
+
+	// At most a mnemonic, a short mnemonic and a name for each symbol
+	e = malloc(3 * PCIE_SYM_NDEFS * sizeof(*e));
+	h = malloc(3 * PCIE_SYM_NDEFS * sizeof(*h));
+	pos = malloc(3 * PCIE_SYM_NDEFS * sizeof(*pos));
+	rv = (e != NULL && h != NULL && pos != NULL) ? 0 : -1;
+
+	n = 0;
+	for (i = 0 ; rv == 0 && i < PCIE_SYM_NDEFS ; i++)
+	{
+		pcie_sym_add(e, &n, &PCIE_SYM_DEFS[i], PCIE_SYM_DEFS[i].sym);
+		if (PCIE_SYM_DEFS[i].ns != PCSY_CLASS)
+			pcie_sym_add(e, &n, &PCIE_SYM_DEFS[i], PCIE_SYM_DEFS[i].sym + 5);
+		pcie_sym_add(e, &n, &PCIE_SYM_DEFS[i], *PCIE_SYM_DEFS[i].str);
+	}
+
+	t->num = n;
+	t->nbucket = n / PCIE_SYM_BUCKET + 1;
+	t->nslot = n + n / 8 + 1;
+	if (rv == 0) {
+		t->disp = malloc(t->nbucket * sizeof(*t->disp));
+		t->slot = calloc(t->nslot, sizeof(*t->slot));
+		rv = (t->disp != NULL && t->slot != NULL) ? 0 : -1;
+	}
+
+	for (t->seed = 0 ; rv == 0 && t->seed < PCIE_SYM_SEEDS ; t->seed++)
 	{
-		case PCNE_INST: 	return STR_PCNE[0];
+		for (i = 0 ; i < n ; i++)
+			h[i] = pcie_sym_hash(e[i].ns, e[i].name, e[i].len, t->seed);
+		if (pcie_phf_build(h, n, t->nbucket, t->nslot, t->disp, pos) == 0)
+			break;
+		// Only a bucket that could not be placed is worth another seed
+		if (errno != EAGAIN)
+			rv = -1;
+	}
+	if (rv == 0 && t->seed == PCIE_SYM_SEEDS) {
+		errno = EAGAIN;
+		rv = -1;
 	}
-	return NULL;
+
+	for (i = 0 ; rv == 0 && i < n ; i++)
+		t->slot[pos[i]] = e[i];
+
+	free(e);
+	free(h);
+	free(pos);
+	if (rv != 0)
+		pcie_sym_free(t);
+	return rv;
+}
+
+/**
+ * Release a table built by pcie_sym_init()
+ */
+void pcie_sym_free(struct pcie_sym *t)
+{
+	if (t == NULL)
+		return;
+
+	free(t->slot);
+	free(t->disp);
+	memset(t, 0, sizeof(*t));
+}
+
+/**
+ * Look up a Capability or Class by mnemonic or name, ignoring case
+ *
+ * @param t 	struct pcie_sym* built by pcie_sym_init()
+ * @param ns 	enum _PCSY namespace to search
+ * @param name 	char* to the name. Need not be NULL terminated
+ * @param len 	Length of name in bytes
+ * @return 		const struct pcie_sym_ent* or NULL if the name is not known
+ */
+const struct pcie_sym_ent *pcie_sym_find(const struct pcie_sym *t, unsigned ns, const char *name, size_t len)
+{
+	const struct pcie_sym_ent *e;
+
+	if (t == NULL || t->slot == NULL || name == NULL)
+		return NULL;
+
+	e = &t->slot[pcie_phf_slot(pcie_sym_hash(ns, name, len, t->seed), t->disp, t->nbucket, t->nslot)];
+	if (e->name == NULL || e->ns != ns || e->len != len || !pcie_sym_eq(e->name, name, len))
+		return NULL;
+
+	return e;
+}
+
+/**
+ * Append a string to a format buffer
+ *
+ * Bytes beyond the end of the buffer are counted but not stored so the caller
+ * can learn the required size, as with snprintf()
+ */
+static void pbuf_str(struct pcie_buf *b, const char *str, size_t n)
+{
+	size_t i;
+
+	for (i = 0 ; i < n && (b->pos + i) < b->len ; i++)
+		b->buf[b->pos + i] = str[i];
+	b->pos += n;
+}
+
+/**
+ * Append spaces to a format buffer
+ */
+static void pbuf_pad(struct pcie_buf *b, unsigned n)
+{
+	static const char space[] = "                                ";
+
+	if (n > MAX_INDENT)
+		n = MAX_INDENT;
+	pbuf_str(b, space, n);
+}
+
+/**
+ * Append an unsigned value to a format buffer as 0x prefixed hex 
+ *
+ * @param digits 	Number of hex digits to print, zero padded 
+ */
+static void pbuf_hex(struct pcie_buf *b, unsigned v, unsigned digits)
+{
+	static const char hex[] = "0123456789abcdef";
+	char tmp[10];
+	unsigned i;
+
+	tmp[0] = '0';
+	tmp[1] = 'x';
+	for (i = 0 ; i < digits ; i++)
+		tmp[1 + digits - i] = hex[(v >> (4 * i)) & 0xF];
+	pbuf_str(b, tmp, digits + 2);
+}
+
+/**
+ * Append an unsigned value to a format buffer in decimal
+ */
+static void pbuf_dec(struct pcie_buf *b, unsigned v)
+{
+	char tmp[10];
+	unsigned i = sizeof(tmp);
+
+	do {
+		tmp[--i] = '0' + (v % 10);
+		v /= 10;
+	} while (v);
+	pbuf_str(b, &tmp[i], sizeof(tmp) - i);
+}
+
+/**
+ * pcie_reg_decode() callback: append one "<indent><label> <value>\n" line 
+ *
+ * Registers without a label are not formatted 
+ */
+static int pbuf_reg(void *arg, const struct pcie_reg *r, __u32 v)
+{
+	struct pcie_fmt_ctx *ctx = arg;
+	size_t n;
+
+	if (r->label == NULL)
+		return 0;
+
+	n = strlen(r->label);
+	pbuf_pad(ctx->b, ctx->indent);
+	pbuf_str(ctx->b, r->label, n);
+	pbuf_pad(ctx->b, (n < PCIE_FMT_LABEL) ? PCIE_FMT_LABEL - n : 1);
+	if (r->digits) 
+		pbuf_hex(ctx->b, v, r->digits);
+	else 
+		pbuf_dec(ctx->b, v);
+	pbuf_str(ctx->b, "\n", 1);
+	return 0;
+}
+
+/**
+ * Format the PCIe Config space header into a caller supplied buffer
+ *
+ * The output is identical to pcie_prnt_cfgspace(). No global state is used so
+ * this may be called concurrently from multiple threads. As with snprintf(), 
+ * the output is truncated to fit and is always NULL terminated when len > 0.  
+ *
+ * @param buf 		char* to the output buffer 
+ * @param len 		Size of the output buffer in bytes
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space 
+ * @param indent  	The number of spaces to indent 
+ * @return 			Number of bytes the full output requires, excluding the NULL 
+ * 					terminator. 0 if cfgspace is NULL
+ */
+size_t pcie_fmt_cfgspace(char *buf, size_t len, __u8 *cfgspace, unsigned indent)
+{
+	struct pcie_fmt_ctx ctx;
+	struct pcie_buf b;
+	unsigned in;
+
+	if (cfgspace == NULL) {
+		if (len > 0)
+			buf[0] = 0;
+		return 0;
+	}
+
+	if (indent > MAX_INDENT) 
+		indent = MAX_INDENT; 
+
+	// Fields are indented 2 more than the title unless that exceeds the max 
+	in = indent;
+	if ( (indent + 2) < MAX_INDENT) 
+		in = indent + 2;
+
+	b.buf = buf;
+	b.len = (len > 0) ? len - 1 : 0;
+	b.pos = 0;
+
+	pbuf_pad(&b, indent);
+	pbuf_str(&b, "PCIe Config Space HDR:\n", 23);
+
+	ctx.b = &b;
+	ctx.indent = in;
+	pcie_reg_decode(pcie_reg_hdr(cfgspace), cfgspace, PCIE_REG_ALL, pbuf_reg, &ctx);
+
+	if (len > 0)
+		buf[(b.pos < b.len) ? b.pos : b.len] = 0;
+
+	return b.pos;
+}
+
+/**
+ * Format the PCIe Config space header and pass it to a writer callback
+ *
+ * The header is rendered into a stack buffer and handed to the writer in a 
+ * single call. Pass pcie_sink_wr and a struct pcie_sink* to write to a sink
+ *
+ * @param fn 		pcie_writer callback to receive the output
+ * @param ctx 		Opaque pointer passed through to the callback
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space 
+ * @param indent  	The number of spaces to indent 
+ * @return 			Return value of the writer callback, -1 if a parameter is NULL
+ */
+int pcie_wr_cfgspace(pcie_writer fn, void *ctx, __u8 *cfgspace, unsigned indent)
+{
+	char buf[PCLN_FMT_HDR];
+	size_t n;
+
+	if (fn == NULL || cfgspace == NULL)
+		return -1;
+
+	n = pcie_fmt_cfgspace(buf, sizeof(buf), cfgspace, indent);
+	if (n >= sizeof(buf))
+		n = sizeof(buf) - 1;
+
+	return fn(ctx, buf, n);
 }
 
 /**
@@ -818,52 +1685,100 @@ const char *pcne(unsigned u)
  */
 void pcie_prnt_cfgspace(__u8 *cfgspace, unsigned indent)
 {
-	struct pcie_cfg_hdr *ph;
-	char space[MAX_INDENT] = "                                ";
+	char buf[PCLN_FMT_HDR];
+	size_t n;
 
 	if (cfgspace == NULL)
 		return;
 
-	if (indent >= MAX_INDENT) 
-		indent = MAX_INDENT; 
-	space[indent] = 0;
+	n = pcie_fmt_cfgspace(buf, sizeof(buf), cfgspace, indent);
+	if (n >= sizeof(buf))
+		n = sizeof(buf) - 1;
+
+	fwrite(buf, 1, n, stdout);
+}
 
-	ph = (struct pcie_cfg_hdr*) cfgspace;
+/**
+ * Render a flag register by copying one precomputed fragment per step 
+ *
+ * The trailing space of the last fragment is dropped. Truncation and the 
+ * return value follow snprintf()
+ */
+static size_t pcie_fmt_flags(char *buf, size_t len, const struct pcie_flag_op *ops, unsigned num, unsigned v)
+{
+	const struct pcie_frag *f;
+	struct pcie_buf b;
+	unsigned i;
 
-	printf("%sPCIe Config Space HDR:\n", 			space);
+	b.buf = buf;
+	b.len = (len > 0) ? len - 1 : 0;
+	b.pos = 0;
 
-	if ( (indent + 2) < MAX_INDENT) 
-	{
-		space[indent] = ' ';
-		space[indent+2] = 0;
+	for (i = 0 ; i < num ; i++) {
+		f = &ops[i].tbl[(v >> ops[i].shift) & ops[i].mask];
+		pbuf_str(&b, f->s, f->len);
 	}
 
-    printf("%sVendor ID             0x%04x\n", 		space, ph->vendor);
-  	printf("%sDevice ID             0x%04x\n", 		space, ph->device);
-  	printf("%sCommand               0x%04x\n", 		space, ph->command);
-  	printf("%sStatus                0x%04x\n", 		space, ph->status);
-  	printf("%sRevision ID           0x%02x\n", 		space, ph->rev);
-  	printf("%sProgramming Interface 0x%02x\n", 		space, ph->pi);
-  	printf("%sSub Class             0x%02x\n", 		space, ph->subclass);
-  	printf("%sBase Class            0x%02x\n", 		space, ph->baseclass);
-  	printf("%sCache Line Size       0x%02x\n", 		space, ph->cls);
-  	printf("%sLatency Timer         0x%02x\n", 		space, ph->timer);
-  	printf("%sHeader Type           0x%02x\n", 		space, ph->type);
-  	printf("%sBIST                  0x%02x\n", 		space, ph->bist);
-  	printf("%sBAR0                  0x%08x\n", 		space, ph->bar0);
-  	printf("%sBAR1                  0x%08x\n", 		space, ph->bar1);
-  	printf("%sBAR2                  0x%08x\n", 		space, ph->bar2);
-  	printf("%sBAR3                  0x%08x\n", 		space, ph->bar3);
-  	printf("%sBAR4                  0x%08x\n", 		space, ph->bar4);
-  	printf("%sBAR5                  0x%08x\n", 		space, ph->bar5);
-  	printf("%sCardbus CIS Ptr       0x%08x\n", 		space, ph->cis);
-	printf("%sSubsystem Vendor ID   0x%04x\n", 		space, ph->subvendor);
-  	printf("%sSubsystem Device ID   0x%04x\n", 		space, ph->subsystem);
-  	printf("%sExpansion ROM Addr    0x%08x\n", 		space, ph->rom);
-  	printf("%sCapabilities Ptr      0x%02x\n", 		space, ph->cap);
-  	printf("%sInterrupt Line        %u\n", 			space, ph->intline);
-  	printf("%sInterrupt Pin         %u\n", 			space, ph->intpin);
-  	printf("%sMinimum Grant         %u\n", 			space, ph->mingnt);
-  	printf("%sMaximum Latency       %u\n", 			space, ph->maxlat);
+	if (b.pos > 0)
+		b.pos--;
+
+	if (len > 0)
+		buf[(b.pos < b.len) ? b.pos : b.len] = 0;
+
+	return b.pos;
+}
+
+/**
+ * Format a Command register as lspci flags 
+ *
+ * e.g. "I/O- Mem+ BusMaster+ SpecCycle- MemWINV- VGASnoop- ParErr- Stepping- SERR+ FastB2B- DisINTx+"
+ *
+ * @param buf 	char* to the output buffer 
+ * @param len 	Size of the output buffer in bytes. PCLN_FMT_FLAGS always fits
+ * @param v 	Register value
+ * @return 		Number of bytes the full output requires, excluding the NULL terminator
+ */
+size_t pcie_fmt_cmd(char *buf, size_t len, __u16 v)
+{
+	return pcie_fmt_flags(buf, len, PCIE_FLAG_OPS(FLAGS_CMD), v);
 }
 
+/**
+ * Format a Status register as lspci flags 
+ *
+ * e.g. "Cap+ 66MHz- UDF- FastB2B- ParErr- DEVSEL=fast >TAbort- <TAbort- <MAbort- >SERR- <PERR- INTx-"
+ */
+size_t pcie_fmt_status(char *buf, size_t len, __u16 v)
+{
+	return pcie_fmt_flags(buf, len, PCIE_FLAG_OPS(FLAGS_STATUS), v);
+}
+
+/**
+ * Format a Power Management Capabilities (PMC) register as lspci flags 
+ *
+ * e.g. "PMEClk- DSI- D1- D2- AuxCurrent=0mA PME(D0+,D1-,D2-,D3hot+,D3cold-)"
+ */
+size_t pcie_fmt_pmc(char *buf, size_t len, __u16 v)
+{
+	return pcie_fmt_flags(buf, len, PCIE_FLAG_OPS(FLAGS_PMC), v);
+}
+
+/**
+ * Format a Power Management Control/Status (PMCSR) register as lspci flags 
+ *
+ * e.g. "D0 NoSoftRst+ PME-Enable- DSel=0 DScale=0 PME-"
+ */
+size_t pcie_fmt_pmcsr(char *buf, size_t len, __u16 v)
+{
+	return pcie_fmt_flags(buf, len, PCIE_FLAG_OPS(FLAGS_PMCSR), v);
+}
+
+/**
+ * Format an MSI Message Control register as lspci flags 
+ *
+ * e.g. "Enable+ Count=1/32 Maskable- 64bit+"
+ */
+size_t pcie_fmt_msi_ctrl(char *buf, size_t len, __u16 v)
+{
+	return pcie_fmt_flags(buf, len, PCIE_FLAG_OPS(FLAGS_MSI_CTRL), v);
+}
@@ -13,22 +13,39 @@
  * PCAP - PCI Capabilities Registers (AP)
  * PCBC - PCI Class Codes (BC)
  * PCBD - PCI Sub Class Code for Bridge Devices (BD) 
+ * PCCH - PCI Decode Cache Results (CH)
+ * PCCL - PCI Columnar Store Columns (CL)
+ * PCCV - PCI Capability Chain Validation Errors (CV)
  * PCCX - PCI Programming Interface for Sub Class: CXL memory (CX)
  * PCDC - PCI Sub Class Code for Dispaly Controllers (DC)
  * PCDS - PCI Sub Class Code for Docking Stations (DS)
  * PCEC - PCI Extended Capabilities Registers - (EC)
+ * PCEM - PCI Config Space Emitter Formats (EM)
  * PCEN - PCI Sub Class Code for Encruyption Controllers (EN)
+ * PCGN - PCI Config Space Generator Flags (GN)
  * PCID - PCI Sub Class Code for Input Device (ID)
+ * PCIF - PCI Capability Index Flags (IF)
+ * PCIQ - PCI Interrupt Modes (IQ)
  * PCIO - PCI Sub Class Code for Intelligent IO Controllers (IO)
+ * PCLK - PCI Express Link Scan Flags (LK)
  * PCMC - PCI Sub Class Code for Memory Controllers (MC)
+ * PCMN - PCI Status Monitor Device State (MN)
  * PCMS - PCI Sub Class Code for Mass Storage Controllers (MS)
  * PCNC - PCI Sub Class Code for Network Controllers (NC)
  * PCNE - PCI Sub Class Code for Non Essential Instrumentation (NE)
+ * PCNM - PCI ID Name Database (NM)
+ * PCPK - PCI Config Space Packed Snapshot file (PK)
  * PCPR - PCI Sub Class Code for Processors (PR)
+ * PCPT - PCI Express Device / Port Types (PT)
+ * PCRA - PCI Register Access Types (RA)
  * PCSA - PCI Sub Class Code for Satellite Controllers (SA)
  * PCSB - PCI Sub Class Code for Serial Bus Controllers (SB)
  * PCSC - PCI Sub Class Code for Simple communication controllers (SC)
+ * PCSK - PCI Output Sink Types (SK)
+ * PCSN - PCI Config Space Snapshot file (SN)
  * PCSP - PCI Sub Class Code for Generic System Peripherals (SP)
+ * PCSY - PCI Symbol Namespaces (SY)
+ * PCTP - PCI Topology Tree Flags (TP)
  * PCUC - PCI Sub Class Code for Multimedia Controllers (UC)
  * PCWC - PCI Sub Class Code for Wireless Controllers (WC)
  */
@@ -37,6 +54,10 @@
 
 /* INCLUDES ==================================================================*/
 
+/* size_t
+ */
+#include <stddef.h>
+
 /* __u8
  * __u16
  */
@@ -46,6 +67,253 @@
 
 #define PCLN_CFG 		4096
 #define PCLN_HDR 		64  
+#define PCLN_CAPS 		48 		//!< Max Capabilities that fit in the 192 B Capability region
+#define PCLN_ECAPS 		64 		//!< Max Extended Capabilities recorded in a struct pcie_cap_index
+#define PCLN_FMT_HDR 	2560 	//!< Buffer size that always holds the output of pcie_fmt_cfgspace()
+#define PCLN_FMT_FLAGS 	128 	//!< Buffer size that always holds the output of the pcie_fmt_<reg>() flag formatters
+#define PCLN_GEN_MODELS 	32 		//!< Device models per struct pcie_gen seed
+
+#define PCIE_CAP_OFFSET_MASK 		0xFC 	//!< Bottom two bits of a Capability pointer are reserved
+#define PCIE_CAP_OFFSET_MASK_EXT 	0xFFC 	//!< Bottom two bits of an Extended Capability pointer are reserved
+#define PCIE_ECAP_START 			0x100 	//!< Offset of the first Extended Capability
+
+#define PCIE_REG_ALL 	(~0ULL) 	//!< Select every register of a set in pcie_reg_decode()
+
+#define PCIE_STATUS_ERRORS 	0xF900 		//!< Status error bits: parerr, sig_tabort, recv_tabort, recv_mabort, sig_sys_err, parity_err
+#define PCIE_MON_STATUS_OFF 0x06 		//!< Offset of the Status register sampled by the monitor
+
+/*
+ * Snapshot, packed snapshot and name database files store every field in the
+ * byte order of the host that wrote them. A file from a host of the other 
+ * byte order fails the magic check when it is opened.
+ */
+#define PCSN_MAGIC 		0x4E534350 	//!< "PCSN" Snapshot file magic number 
+#define PCSN_VERSION 	1 			//!< Snapshot file format version
+
+#define PCPK_MAGIC 		0x4B504350 	//!< "PCPK" Packed snapshot file magic number 
+#define PCPK_VERSION 	1 			//!< Packed snapshot file format version
+
+#define PCNM_MAGIC 		0x4D4E4350 	//!< "PCNM" Name database file magic number 
+#define PCNM_VERSION 	1 			//!< Name database file format version
+
+#define PCIE_COL_PRED_MAX 	16 		//!< Max predicates in one pcie_col_scan()
+
+#define PCIE_HASH_LOAD(n) 	((n) - (n) / 4) 	//!< Max entries of an open addressing table of n slots: 75% load
+
+/**
+ * Pack a PCI Segment, Bus, Device and Function into a 32-bit BDF
+ *
+ * The packed value sorts in the same order as the lspci notation
+ */
+#define PCIE_BDF(seg, bus, dev, fn) 	((((__u32) (seg) & 0xFFFF) << 16) | (((bus) & 0xFF) << 8) | (((dev) & 0x1F) << 3) | ((fn) & 0x7))
+#define PCIE_BDF_SEG(bdf) 				(((bdf) >> 16) & 0xFFFF)
+#define PCIE_BDF_BUS(bdf) 				(((bdf) >> 8) & 0xFF)
+#define PCIE_BDF_DEV(bdf) 				(((bdf) >> 3) & 0x1F)
+#define PCIE_BDF_FN(bdf) 				((bdf) & 0x7)
+
+/**
+ * Mask of the low width bits of a register value. width is 0 to 32
+ */
+#define PCIE_MASK(width) 			((__u32) ((1ULL << (width)) - 1))
+
+/**
+ * Extract bits [lo, lo + width) of a register value. lo is 0 to 31, width is 0 to 32
+ */
+#define PCIE_BITS(v, lo, width) 	(((v) >> (lo)) & PCIE_MASK(width))
+
+/**
+ * Register fields with a generated accessor
+ *
+ * Each entry is X(block, name, off, size, lo, width): bits [lo, lo + width) of
+ * the little endian register of size bits at offset off from the start of the
+ * block. Header blocks start at the beginning of config space, Capability
+ * blocks at the Capability header. Every entry becomes two functions below:
+ *
+ *   __u32 pcie_get_<block>_<name>(const __u8 *base)
+ *   void  pcie_get_<block>_<name>_n(const __u8 *images, size_t num, const __u16 *base, __u32 *out)
+ *
+ * Fields match the structs in this file, which only describe the layout as
+ * seen by a little endian host. The accessors are correct on any host.
+ */
+#define PCIE_ACCESSORS(X) \
+	X(hdr, 		vendor, 		0x00, 16,  0, 16) \
+	X(hdr, 		device, 		0x02, 16,  0, 16) \
+	X(hdr, 		command, 		0x04, 16,  0, 16) \
+	X(hdr, 		status, 		0x06, 16,  0, 16) \
+	X(hdr, 		rev, 			0x08,  8,  0,  8) \
+	X(hdr, 		pi, 			0x09,  8,  0,  8) \
+	X(hdr, 		subclass, 		0x0A,  8,  0,  8) \
+	X(hdr, 		baseclass, 		0x0B,  8,  0,  8) \
+	X(hdr, 		cls, 			0x0C,  8,  0,  8) \
+	X(hdr, 		timer, 			0x0D,  8,  0,  8) \
+	X(hdr, 		type, 			0x0E,  8,  0,  8) \
+	X(hdr, 		bist, 			0x0F,  8,  0,  8) \
+	X(hdr, 		bar0, 			0x10, 32,  0, 32) \
+	X(hdr, 		bar1, 			0x14, 32,  0, 32) \
+	X(hdr, 		bar2, 			0x18, 32,  0, 32) \
+	X(hdr, 		bar3, 			0x1C, 32,  0, 32) \
+	X(hdr, 		bar4, 			0x20, 32,  0, 32) \
+	X(hdr, 		bar5, 			0x24, 32,  0, 32) \
+	X(hdr, 		cis, 			0x28, 32,  0, 32) \
+	X(hdr, 		subvendor, 		0x2C, 16,  0, 16) \
+	X(hdr, 		subsystem, 		0x2E, 16,  0, 16) \
+	X(hdr, 		rom, 			0x30, 32,  0, 32) \
+	X(hdr, 		cap, 			0x34,  8,  0,  8) \
+	X(hdr, 		intline, 		0x3C,  8,  0,  8) \
+	X(hdr, 		intpin, 		0x3D,  8,  0,  8) \
+	X(hdr, 		mingnt, 		0x3E,  8,  0,  8) \
+	X(hdr, 		maxlat, 		0x3F,  8,  0,  8) \
+	X(hdr1, 	pribus, 		0x18,  8,  0,  8) \
+	X(hdr1, 	secbus, 		0x19,  8,  0,  8) \
+	X(hdr1, 	subbus, 		0x1A,  8,  0,  8) \
+	X(hdr1, 	seclat, 		0x1B,  8,  0,  8) \
+	X(hdr1, 	iobase, 		0x1C,  8,  0,  8) \
+	X(hdr1, 	iolimit, 		0x1D,  8,  0,  8) \
+	X(hdr1, 	secstatus, 		0x1E, 16,  0, 16) \
+	X(hdr1, 	membase, 		0x20, 16,  0, 16) \
+	X(hdr1, 	memlimit, 		0x22, 16,  0, 16) \
+	X(hdr1, 	pfbase, 		0x24, 16,  0, 16) \
+	X(hdr1, 	pflimit, 		0x26, 16,  0, 16) \
+	X(hdr1, 	pfbase_hi, 		0x28, 32,  0, 32) \
+	X(hdr1, 	pflimit_hi, 	0x2C, 32,  0, 32) \
+	X(hdr1, 	iobase_hi, 		0x30, 16,  0, 16) \
+	X(hdr1, 	iolimit_hi, 	0x32, 16,  0, 16) \
+	X(hdr1, 	rom, 			0x38, 32,  0, 32) \
+	X(hdr1, 	bridgectl, 		0x3E, 16,  0, 16) \
+	X(hdr2, 	cap, 			0x14,  8,  0,  8) \
+	X(type, 	type, 			0x0E,  8,  0,  7) \
+	X(type, 	mf, 			0x0E,  8,  7,  1) \
+	X(cmd, 		io, 			0x04, 16,  0,  1) \
+	X(cmd, 		mem, 			0x04, 16,  1,  1) \
+	X(cmd, 		busmaster, 		0x04, 16,  2,  1) \
+	X(cmd, 		speccycle, 		0x04, 16,  3,  1) \
+	X(cmd, 		memwine, 		0x04, 16,  4,  1) \
+	X(cmd, 		vgasnoop, 		0x04, 16,  5,  1) \
+	X(cmd, 		parerr, 		0x04, 16,  6,  1) \
+	X(cmd, 		stepping, 		0x04, 16,  7,  1) \
+	X(cmd, 		serr, 			0x04, 16,  8,  1) \
+	X(cmd, 		fastb2b, 		0x04, 16,  9,  1) \
+	X(cmd, 		disintx, 		0x04, 16, 10,  1) \
+	X(status, 	intx, 			0x06, 16,  3,  1) \
+	X(status, 	cap, 			0x06, 16,  4,  1) \
+	X(status, 	mhz, 			0x06, 16,  5,  1) \
+	X(status, 	fastb2b, 		0x06, 16,  7,  1) \
+	X(status, 	parerr, 		0x06, 16,  8,  1) \
+	X(status, 	devsel, 		0x06, 16,  9,  2) \
+	X(status, 	sig_tabort, 	0x06, 16, 11,  1) \
+	X(status, 	recv_tabort, 	0x06, 16, 12,  1) \
+	X(status, 	recv_mabort, 	0x06, 16, 13,  1) \
+	X(status, 	sig_sys_err, 	0x06, 16, 14,  1) \
+	X(status, 	parity_err, 	0x06, 16, 15,  1) \
+	X(cap, 		id, 			0x00,  8,  0,  8) \
+	X(cap, 		next, 			0x01,  8,  0,  8) \
+	X(pmc, 		ver, 			0x02, 16,  0,  3) \
+	X(pmc, 		clock, 			0x02, 16,  3,  1) \
+	X(pmc, 		dsi, 			0x02, 16,  5,  1) \
+	X(pmc, 		aux, 			0x02, 16,  6,  3) \
+	X(pmc, 		d1, 			0x02, 16,  9,  1) \
+	X(pmc, 		d2, 			0x02, 16, 10,  1) \
+	X(pmc, 		pme_sup, 		0x02, 16, 11,  5) \
+	X(pmcsr, 	state, 			0x04, 16,  0,  2) \
+	X(pmcsr, 	no_soft_rst, 	0x04, 16,  3,  1) \
+	X(pmcsr, 	pme_en, 		0x04, 16,  8,  1) \
+	X(pmcsr, 	data_sel, 		0x04, 16,  9,  4) \
+	X(pmcsr, 	data_scale, 	0x04, 16, 13,  2) \
+	X(pmcsr, 	pme_status, 	0x04, 16, 15,  1) \
+	X(bse, 		b2_b3, 			0x06,  8,  6,  1) \
+	X(bse, 		bpcc_en, 		0x06,  8,  7,  1) \
+	X(msi, 		ctrl, 			0x02, 16,  0, 16) \
+	X(msi, 		enable, 		0x02, 16,  0,  1) \
+	X(msi, 		request, 		0x02, 16,  1,  3) \
+	X(msi, 		allocated, 		0x02, 16,  4,  3) \
+	X(msi, 		bit64, 			0x02, 16,  7,  1) \
+	X(msi, 		maskable, 		0x02, 16,  8,  1) \
+	X(msi, 		addr, 			0x04, 32,  0, 32) \
+	X(msix, 	ctrl, 			0x02, 16,  0, 16) \
+	X(msix, 	size, 			0x02, 16,  0, 11) \
+	X(msix, 	fmask, 			0x02, 16, 14,  1) \
+	X(msix, 	enable, 		0x02, 16, 15,  1) \
+	X(msix, 	table_bir, 		0x04, 32,  0,  3) \
+	X(msix, 	table_off, 		0x04, 32,  3, 29) \
+	X(msix, 	pba_bir, 		0x08, 32,  0,  3) \
+	X(msix, 	pba_off, 		0x08, 32,  3, 29) \
+	X(ecap, 	id, 			0x00, 32,  0, 16) \
+	X(ecap, 	ver, 			0x00, 32, 16,  4) \
+	X(ecap, 	next, 			0x00, 32, 20, 12) \
+	X(dsn, 		lo, 			0x04, 32,  0, 32) \
+	X(dsn, 		hi, 			0x08, 32,  0, 32) \
+	X(exp, 		ver, 			0x02, 16,  0,  4) \
+	X(exp, 		type, 			0x02, 16,  4,  4) \
+	X(exp, 		slot, 			0x02, 16,  8,  1) \
+	X(exp, 		irq, 			0x02, 16,  9,  5) \
+	X(exp, 		devcap, 		0x04, 32,  0, 32) \
+	X(exp, 		mps_sup, 		0x04, 32,  0,  3) \
+	X(exp, 		phantom, 		0x04, 32,  3,  2) \
+	X(exp, 		ext_tag_sup, 	0x04, 32,  5,  1) \
+	X(exp, 		flr, 			0x04, 32, 28,  1) \
+	X(exp, 		devctl, 		0x08, 16,  0, 16) \
+	X(exp, 		err_report, 	0x08, 16,  0,  4) \
+	X(exp, 		relaxed, 		0x08, 16,  4,  1) \
+	X(exp, 		mps, 			0x08, 16,  5,  3) \
+	X(exp, 		ext_tag, 		0x08, 16,  8,  1) \
+	X(exp, 		nosnoop, 		0x08, 16, 11,  1) \
+	X(exp, 		mrrs, 			0x08, 16, 12,  3) \
+	X(exp, 		devsta, 		0x0A, 16,  0, 16) \
+	X(exp, 		lnkcap, 		0x0C, 32,  0, 32) \
+	X(exp, 		max_speed, 		0x0C, 32,  0,  4) \
+	X(exp, 		max_width, 		0x0C, 32,  4,  6) \
+	X(exp, 		aspm_sup, 		0x0C, 32, 10,  2) \
+	X(exp, 		dllla_cap, 		0x0C, 32, 20,  1) \
+	X(exp, 		port, 			0x0C, 32, 24,  8) \
+	X(exp, 		lnkctl, 		0x10, 16,  0, 16) \
+	X(exp, 		aspm, 			0x10, 16,  0,  2) \
+	X(exp, 		lnksta, 		0x12, 16,  0, 16) \
+	X(exp, 		speed, 			0x12, 16,  0,  4) \
+	X(exp, 		width, 			0x12, 16,  4,  6) \
+	X(exp, 		training, 		0x12, 16, 11,  1) \
+	X(exp, 		dllla, 			0x12, 16, 13,  1) \
+	X(exp, 		sltcap, 		0x14, 32,  0, 32) \
+	X(exp, 		slot_num, 		0x14, 32, 19, 13) \
+	X(exp, 		sltctl, 		0x18, 16,  0, 16) \
+	X(exp, 		sltsta, 		0x1A, 16,  0, 16) \
+	X(exp, 		rootctl, 		0x1C, 16,  0, 16) \
+	X(exp, 		rootcap, 		0x1E, 16,  0, 16) \
+	X(exp, 		rootsta, 		0x20, 32,  0, 32) \
+	X(exp, 		devcap2, 		0x24, 32,  0, 32) \
+	X(exp, 		devctl2, 		0x28, 16,  0, 16) \
+	X(exp, 		devsta2, 		0x2A, 16,  0, 16) \
+	X(exp, 		lnkcap2, 		0x2C, 32,  0, 32) \
+	X(exp, 		speeds, 		0x2C, 32,  1,  7) \
+	X(exp, 		lnkctl2, 		0x30, 16,  0, 16) \
+	X(exp, 		target_speed, 	0x30, 16,  0,  4) \
+	X(exp, 		lnksta2, 		0x32, 16,  0, 16) \
+	X(sriov, 	cap, 			0x04, 32,  0, 32) \
+	X(sriov, 	ctrl, 			0x08, 16,  0, 16) \
+	X(sriov, 	vf_enable, 		0x08, 16,  0,  1) \
+	X(sriov, 	vf_mse, 		0x08, 16,  3,  1) \
+	X(sriov, 	ari, 			0x08, 16,  4,  1) \
+	X(sriov, 	status, 		0x0A, 16,  0, 16) \
+	X(sriov, 	initial, 		0x0C, 16,  0, 16) \
+	X(sriov, 	total, 			0x0E, 16,  0, 16) \
+	X(sriov, 	num, 			0x10, 16,  0, 16) \
+	X(sriov, 	fdl, 			0x12, 16,  0,  8) \
+	X(sriov, 	offset, 		0x14, 16,  0, 16) \
+	X(sriov, 	stride, 		0x16, 16,  0, 16) \
+	X(sriov, 	vf_device, 		0x1A, 16,  0, 16) \
+	X(sriov, 	page_sizes, 	0x1C, 32,  0, 32) \
+	X(sriov, 	page_size, 		0x20, 32,  0, 32) \
+	X(sriov, 	bar0, 			0x24, 32,  0, 32) \
+	X(sriov, 	bar1, 			0x28, 32,  0, 32) \
+	X(sriov, 	bar2, 			0x2C, 32,  0, 32) \
+	X(sriov, 	bar3, 			0x30, 32,  0, 32) \
+	X(sriov, 	bar4, 			0x34, 32,  0, 32) \
+	X(sriov, 	bar5, 			0x38, 32,  0, 32) \
+	X(sriov, 	migration, 		0x3C, 32,  0, 32) \
+	X(rebar, 	cap, 			0x04, 32,  0, 32) \
+	X(rebar, 	ctrl, 			0x08, 32,  0, 32) \
+	X(rebar, 	idx, 			0x08, 32,  0,  3) \
+	X(rebar, 	nbar, 			0x08, 32,  5,  3) \
+	X(rebar, 	size, 			0x08, 32,  8,  6)
 
 /* ENUMERATIONS ==============================================================*/
 
@@ -141,13 +409,212 @@ enum _PCEC
 	PCEC_MAX
 };
 
+/**
+ * PCI Capability Index Flags (IF)
+ *
+ * Set in pcie_cap_index.flags when a chain could not be fully indexed
+ */
+enum _PCIF
+{
+	PCIF_CAPS_TRUNC 	= 0x01, //!< Capability chain longer than PCLN_CAPS entries
+	PCIF_CAPS_BAD 		= 0x02, //!< Capability chain contains an invalid pointer
+	PCIF_ECAPS_TRUNC 	= 0x04, //!< Extended Capability chain longer than PCLN_ECAPS entries
+	PCIF_ECAPS_BAD 		= 0x08, //!< Extended Capability chain contains an invalid pointer
+};
+
+/**
+ * PCI Capability Chain Validation Errors (CV)
+ *
+ * Returned by pcie_cap_validate(). 0 means both chains end properly
+ */
+enum _PCCV
+{
+	PCCV_CAP_RANGE 		= 0x01, //!< Capability pointer into the header
+	PCCV_CAP_LOOP 		= 0x02, //!< Capability chain visits an entry twice
+	PCCV_ECAP_RANGE 	= 0x04, //!< Extended Capability pointer below 0x100
+	PCCV_ECAP_LOOP 		= 0x08, //!< Extended Capability chain visits an entry twice
+	PCCV_ECAP_LONG 		= 0x10, //!< Extended Capability chain longer than PCLN_ECAPS entries
+	PCCV_ECAP_EMPTY 	= 0x20, //!< Extended Capability pointer to an all 0 or all 1 header
+};
+
+/**
+ * PCI Config Space Emitter Formats (EM)
+ */
+enum _PCEM
+{
+	PCEM_JSON 		= 0, 	//!< JSON text
+	PCEM_CBOR 		= 1, 	//!< CBOR (RFC 8949) binary
+	PCEM_MAX
+};
+
+/**
+ * PCI Status Monitor Device State (MN)
+ *
+ * Reported in pcie_mon_evt.flags. 0 means the device was read normally
+ */
+enum _PCMN
+{
+	PCMN_READ 		= 0x01, //!< The backend failed to read the device 
+	PCMN_GONE 		= 0x02, //!< The device returned all ones, e.g. after surprise removal
+};
+
+/**
+ * PCI Topology Tree Flags (TP)
+ *
+ * Set in pcie_topo.flags when the bus numbers are inconsistent
+ */
+enum _PCTP
+{
+	PCTP_DUP_BUS 	= 0x01, //!< Two bridges claim the same secondary bus. The first in input order wins
+	PCTP_BAD_BUS 	= 0x02, //!< A bridge has a secondary bus at or below its own bus, or an empty range
+};
+
+/**
+ * PCI Config Space Generator Flags (GN)
+ */
+enum _PCGN
+{
+	PCGN_BAD 		= 0x01, //!< Damage the chains of 1 in pcie_gen.bad_rate images
+};
+
+/**
+ * PCI Output Sink Types (SK)
+ */
+enum _PCSK
+{
+	PCSK_FN 		= 0, 	//!< Caller supplied pcie_writer callback
+	PCSK_FD 		= 1, 	//!< Buffered file descriptor
+	PCSK_MEM 		= 2, 	//!< Growable memory buffer
+	PCSK_NULL 		= 3, 	//!< Discards everything. Only counts bytes
+	PCSK_MAX
+};
+
+/**
+ * PCI Interrupt Modes (IQ)
+ */
+enum _PCIQ
+{
+	PCIQ_NONE 		= 0, 	//!< No interrupt mechanism enabled
+	PCIQ_INTX 		= 1, 	//!< Legacy INTx pin
+	PCIQ_MSI 		= 2, 	//!< MSI enabled
+	PCIQ_MSIX 		= 3, 	//!< MSI-X enabled
+	PCIQ_MAX
+};
+
+/**
+ * PCI Decode Cache Results (CH)
+ *
+ * Returned by pcie_dcache_decode() to say how much of the result was reused
+ */
+enum _PCCH
+{
+	PCCH_HIT 		= 0, 	//!< Image unchanged. Previous result returned as is
+	PCCH_HDR 		= 1, 	//!< Only the header changed. The Capability index was reused
+	PCCH_WALK 		= 2, 	//!< Capability chains changed and were walked again
+	PCCH_NEW 		= 3, 	//!< First time the BDF was seen
+	PCCH_MAX
+};
+
+/**
+ * PCI Columnar Store Columns (CL)
+ *
+ * Columns of struct pcie_col that a struct pcie_col_pred can test
+ */
+enum _PCCL
+{
+	PCCL_BDF 		= 0, 	//!< __u32 BDF
+	PCCL_VENDOR 	= 1, 	//!< __u16 Vendor ID
+	PCCL_DEVICE 	= 2, 	//!< __u16 Device ID
+	PCCL_COMMAND 	= 3, 	//!< __u16 Command register
+	PCCL_STATUS 	= 4, 	//!< __u16 Status register
+	PCCL_BASECLASS 	= 5, 	//!< __u8 Base Class Code
+	PCCL_SUBCLASS 	= 6, 	//!< __u8 Sub Class Code
+	PCCL_PI 		= 7, 	//!< __u8 Programming Interface
+	PCCL_TYPE 		= 8, 	//!< __u8 Header Type register
+	PCCL_CAPS 		= 9, 	//!< __u64 bit n set if Capability ID n is present
+	PCCL_ECAPS 		= 10, 	//!< __u64 bit n set if Extended Capability ID n is present
+	PCCL_MAX
+};
+
+/**
+ * PCI ID Name Database Entry Kinds (NM)
+ *
+ * Stored in bits [31:30] of pcie_ids_ent.name
+ */
+enum _PCNM
+{
+	PCNM_VENDOR 	= 0, 	//!< Vendor ID
+	PCNM_DEVICE 	= 1, 	//!< Vendor ID and Device ID
+	PCNM_SUBSYS 	= 2, 	//!< Vendor ID, Device ID, Subsystem Vendor ID and Subsystem ID
+	PCNM_EMPTY 		= 3, 	//!< Unused slot
+	PCNM_MAX
+};
+
+/**
+ * PCI Symbol Namespaces (SY)
+ *
+ * Names are unique within a namespace, see pcie_sym_find()
+ */
+enum _PCSY
+{
+	PCSY_CAP 		= 0, 	//!< Capability mnemonics and names (enum _PCAP)
+	PCSY_ECAP 		= 1, 	//!< Extended Capability mnemonics and names (enum _PCEC)
+	PCSY_CLASS 		= 2, 	//!< Base Class, Sub Class and Programming Interface mnemonics and names
+	PCSY_MAX
+};
+
+/**
+ * PCI Express Device / Port Types (PT)
+ *
+ * Device/Port Type field of the PCI Express Capabilities register
+ */
+enum _PCPT
+{
+	PCPT_EP 		= 0x0, 	//!< PCI Express Endpoint
+	PCPT_LEG_EP 	= 0x1, 	//!< Legacy PCI Express Endpoint
+	PCPT_RP 		= 0x4, 	//!< Root Port of a Root Complex
+	PCPT_UP 		= 0x5, 	//!< Upstream Port of a Switch
+	PCPT_DOWN 		= 0x6, 	//!< Downstream Port of a Switch
+	PCPT_PCIE_PCI 	= 0x7, 	//!< PCI Express to PCI/PCI-X Bridge
+	PCPT_PCI_PCIE 	= 0x8, 	//!< PCI/PCI-X to PCI Express Bridge
+	PCPT_RCIEP 		= 0x9, 	//!< Root Complex Integrated Endpoint
+	PCPT_RCEC 		= 0xA, 	//!< Root Complex Event Collector
+	PCPT_MAX
+};
+
+/**
+ * PCI Express Link Scan Flags (LK)
+ *
+ * Set in pcie_link.flags by pcie_link_scan()
+ */
+enum _PCLK
+{
+	PCLK_SPEED 		= 0x01, //!< Current Link Speed is below the Max Link Speed
+	PCLK_WIDTH 		= 0x02, //!< Negotiated Link Width is below the Max Link Width
+	PCLK_PARTNER 	= 0x04, //!< The link runs at the best speed and width both ends support
+	PCLK_MPS 		= 0x08, //!< Max Payload Size differs from the upstream bridge
+	PCLK_MRRS 		= 0x10, //!< Max Read Request Size is below the Max Payload Size of the path
+};
+
+/**
+ * PCI Register Access Types (RA)
+ */
+enum _PCRA
+{
+	PCRA_RO 		= 0, 	//!< Read Only 
+	PCRA_RW 		= 1, 	//!< Read Write 
+	PCRA_RW1C 		= 2, 	//!< Read, Write 1 to Clear
+	PCRA_RSVD 		= 3, 	//!< Reserved
+	PCRA_MAX
+};
+
 /**
  * PCI Class Codes (BC)
  */
 enum _PCBC 
 {
-	PCBC_NULL			= 0x01, //!< 
-	PCBC_MSC 			= 0x02, //!< Mass Storage Controller
+	PCBC_NULL			= 0x00, //!< Unclassified device
+	PCBC_MSC 			= 0x01, //!< Mass Storage Controller
 	PCBC_NET  			= 0x02, //!< Network controller
 	PCBC_DISPLAY		= 0x03, //!< Display controller
 	PCBC_MULTIMEDIA 	= 0x04, //!< Multimedia device
@@ -166,7 +633,7 @@ enum _PCBC
 	PCBC_SIG_PROCESS	= 0x11, //!< Data acquisition and signal processing controllers
 	PCBC_PROC_ACCEL		= 0x12, //!< Processing accelerators
 	PCBC_NON_ESSN 		= 0x13, //!< Non-Essential Instrumentation
-
+	PCBC_MAX
 };
 
 /**
@@ -473,6 +940,15 @@ enum _PCCX
 
 /* STRUCTS ===================================================================*/
 
+/**
+ * Writer callback used to receive formatted output
+ *
+ * @param ctx 	Opaque pointer supplied by the caller
+ * @param buf 	char* to the formatted output. Not NULL terminated
+ * @param len 	Number of bytes in buf
+ * @return 		0 upon success, non zero to report an error to the caller
+ */
+typedef int (*pcie_writer)(void *ctx, const char *buf, size_t len);
 
 /**
  * PCI Capability Header 
@@ -569,6 +1045,32 @@ struct __attribute__((__packed__)) pcie_cap_msi_ctrl
 	__u16 rsvd  	: 7; //!< 
 };
 
+/**
+ * PCI Capability - MSI-X Message Control
+ */
+struct __attribute__((__packed__)) pcie_cap_msix_ctrl
+{
+	__u16 size 		: 11; //!< Table Size. Number of vectors - 1 (RO)
+	__u16 rsvd 		: 3;  //!< 
+	__u16 fmask 	: 1;  //!< Function Mask. If 1 all vectors are masked (RW)
+	__u16 enable 	: 1;  //!< MSI-X Enable (RW)
+};
+
+/**
+ * PCI Capability - MSI-X
+ *
+ * ID: 0x11. Follows struct pcie_cap. The table and PBA live in the memory 
+ * space of the BAR selected by their BIR fields
+ */
+struct __attribute__((__packed__)) pcie_cap_msix
+{
+	__u16 ctrl; 			//!< struct pcie_cap_msix_ctrl
+	__u32 table_bir : 3; 	//!< BAR Indicator of the MSI-X Table 
+	__u32 table_off : 29; 	//!< Offset of the MSI-X Table in the BAR, in units of 8 bytes
+	__u32 pba_bir 	: 3; 	//!< BAR Indicator of the Pending Bit Array
+	__u32 pba_off 	: 29; 	//!< Offset of the Pending Bit Array in the BAR, in units of 8 bytes
+};
+
 /**
  * PCI Extended Capability Header 
  */
@@ -706,9 +1208,822 @@ struct __attribute__((__packed__)) pcie_cfg_hdr
 	
 };
 
+/**
+ * PCI-to-PCI Bridge Config Space Header (Type 1)
+ *
+ * Shares the first 16 bytes with struct pcie_cfg_hdr. Bus numbers describe 
+ * the range of buses below the bridge: sec is the bus directly behind it and
+ * sub is the highest bus number reachable through it.
+ */
+struct __attribute__((__packed__)) pcie_cfg_hdr1
+{
+	__u16 vendor;		//!< Vendor ID 
+	__u16 device;		//!< Device ID
+	__u16 command;      //!< Command register 
+	__u16 status;		//!< Status register 
+	__u8 rev;			//!< Class Revision ID
+	__u8 pi;			//!< Programming Interface 
+	__u8 subclass;		//!< Sub Class Code 
+	__u8 baseclass;		//!< Base Class Code 
+	__u8 cls;			//!< Cache Line Size 
+	__u8 timer;			//!< PCIe Latency Timer
+	__u8 type;			//!< 1 = PCI-to-PCI Bridge
+	__u8 bist;			//!< Capable & Start bits
+	__u32 bar0;			//!< Base Address Register 0
+	__u32 bar1;			//!< Base Address Register 1
+	__u8 pribus; 		//!< Primary Bus Number. Bus the bridge is on 
+	__u8 secbus; 		//!< Secondary Bus Number. Bus directly behind the bridge
+	__u8 subbus; 		//!< Subordinate Bus Number. Highest bus behind the bridge
+	__u8 seclat; 		//!< Secondary Latency Timer
+	__u8 iobase; 		//!< I/O Base 
+	__u8 iolimit; 		//!< I/O Limit 
+	__u16 secstatus; 	//!< Secondary Status 
+	__u16 membase; 		//!< Memory Base 
+	__u16 memlimit; 	//!< Memory Limit 
+	__u16 pfbase; 		//!< Prefetchable Memory Base 
+	__u16 pflimit; 		//!< Prefetchable Memory Limit 
+	__u32 pfbase_hi; 	//!< Prefetchable Base Upper 32 Bits
+	__u32 pflimit_hi; 	//!< Prefetchable Limit Upper 32 Bits
+	__u16 iobase_hi; 	//!< I/O Base Upper 16 Bits
+	__u16 iolimit_hi; 	//!< I/O Limit Upper 16 Bits
+	__u8 cap;			//!< Capability List Offset to first entry
+	__u32 rsvd : 24;	
+	__u32 rom;			//!< Expansion ROM Base Address
+	__u8 intline;		//!< Interrupt line
+	__u8 intpin;		//!< Interrupt pin 
+	__u16 bridgectl; 	//!< Bridge Control 
+};
+
+/**
+ * Capability Index Entry 
+ */
+struct pcie_cap_ent
+{
+	__u16 id; 		//!< Capability or Extended Capability ID
+	__u16 offset; 	//!< Offset of the Capability header in config space
+	__u8 ver; 		//!< Capability Version (Extended Capabilities only)
+	__u8 dup; 		//!< Index + 1 of the next entry with the same ID. 0=none
+};
+
+/**
+ * Capability Index 
+ *
+ * Built in a single pass over a config space buffer by pcie_cap_index_build().
+ * The cap[] and ecap[] tables map a known ID to its first entry so that 
+ * finding a Capability is a table lookup rather than a walk of the chain.
+ */
+struct pcie_cap_index
+{
+	__u8 cap[PCAP_MAX]; 					//!< Index + 1 of first entry in caps[] for an ID. 0=absent
+	__u8 ecap[PCEC_MAX]; 					//!< Index + 1 of first entry in ecaps[] for an ID. 0=absent
+	__u8 ncap; 								//!< Number of valid entries in caps[]
+	__u8 necap; 							//!< Number of valid entries in ecaps[]
+	__u8 flags; 							//!< Bitmask of enum _PCIF
+	struct pcie_cap_ent caps[PCLN_CAPS]; 	//!< Capabilities in chain order
+	struct pcie_cap_ent ecaps[PCLN_ECAPS]; 	//!< Extended Capabilities in chain order
+};
+
+/**
+ * Result of validating the Capability chains of one image
+ *
+ * Filled in by pcie_cap_validate()
+ */
+struct pcie_cap_check
+{
+	__u32 err; 			//!< Bitmask of enum _PCCV
+	__u16 cap_bad; 		//!< Offset of the Capability with a bad Next pointer. 0 = the Capabilities Pointer
+	__u16 ecap_bad; 	//!< Offset of the Extended Capability with a bad Next pointer
+	__u8 ncap; 			//!< Capabilities visited
+	__u8 necap; 		//!< Extended Capabilities visited
+};
+
+/**
+ * Decoded summary of one config space image 
+ *
+ * Filled in by pcie_decode() and pcie_decode_batch()
+ */
+struct pcie_dec
+{
+	__u16 vendor; 				//!< Vendor ID 
+	__u16 device; 				//!< Device ID
+	__u16 subvendor; 			//!< Subsystem Vendor ID
+	__u16 subsystem; 			//!< Subsystem ID 
+	__u16 command; 				//!< Command register 
+	__u16 status; 				//!< Status register 
+	__u8 rev; 					//!< Class Revision ID
+	__u8 pi; 					//!< Programming Interface 
+	__u8 subclass; 				//!< Sub Class Code 
+	__u8 baseclass; 			//!< Base Class Code 
+	__u8 type; 					//!< Header Type 
+	const char *class_name; 	//!< Result of pcie_class_name(). May be NULL
+	struct pcie_cap_index idx; 	//!< Capability index
+};
+
+/**
+ * Snapshot file header 
+ *
+ * Located at offset 0 of a snapshot file. Fields are in the byte order of the
+ * host that wrote the file
+ */
+struct __attribute__((__packed__)) pcie_snap_hdr
+{
+	__u32 magic; 		//!< PCSN_MAGIC
+	__u16 version; 		//!< PCSN_VERSION
+	__u16 hdr_len; 		//!< Size of this header in bytes
+	__u32 num; 			//!< Number of devices in the snapshot
+	__u32 flags; 		//!< Reserved. Set to 0
+	__u64 index_off; 	//!< File offset of the struct pcie_snap_ent index
+	__u64 data_off; 	//!< File offset of the first image. Multiple of PCLN_CFG
+	__u64 file_len; 	//!< Total length of the file in bytes
+	__u64 time; 		//!< Capture time as supplied by the writer
+	__u8 rsvd[16];
+};
+
+/**
+ * Snapshot file index entry 
+ */
+struct __attribute__((__packed__)) pcie_snap_ent
+{
+	__u32 bdf; 			//!< BDF of the device. See PCIE_BDF()
+	__u32 len; 			//!< Number of valid bytes in the image 
+	__u64 off; 			//!< File offset of the image. Multiple of PCLN_CFG
+};
+
+/**
+ * Open snapshot file 
+ */
+struct pcie_snap
+{
+	void *map; 					//!< Read only mapping of the file
+	size_t len; 				//!< Length of the mapping
+	struct pcie_snap_hdr *hdr; 	//!< File header 
+	struct pcie_snap_ent *ent; 	//!< Index, sorted by ascending BDF
+	unsigned num; 				//!< Number of entries in ent[]
+};
+
+/**
+ * Snapshot file being written in pieces
+ *
+ * Started with pcie_snap_create() and finished with pcie_snap_commit()
+ */
+struct pcie_snap_wr
+{
+	int fd; 			//!< File being written
+	int err; 			//!< 0 or -1 once a write has failed
+	__u8 *meta; 		//!< Header and index, written last
+	__u64 data_off; 	//!< File offset of the first image
+	unsigned num; 		//!< Number of images declared
+	unsigned pos; 		//!< Number of images appended
+};
+
+/**
+ * Packed snapshot file header 
+ *
+ * Located at offset 0 of a packed snapshot file. Fields are in the byte order
+ * of the host that wrote the file
+ */
+struct __attribute__((__packed__)) pcie_pack_hdr
+{
+	__u32 magic; 		//!< PCPK_MAGIC
+	__u16 version; 		//!< PCPK_VERSION
+	__u16 hdr_len; 		//!< Size of this header in bytes
+	__u32 num; 			//!< Number of devices in the snapshot
+	__u32 ntmpl; 		//!< Number of templates
+	__u64 index_off; 	//!< File offset of the struct pcie_pack_ent index
+	__u64 tmpl_off; 	//!< File offset of the first template. Multiple of PCLN_CFG
+	__u64 delta_off; 	//!< File offset of the first delta
+	__u64 file_len; 	//!< Total length of the file in bytes
+	__u64 time; 		//!< Capture time as supplied by the writer
+	__u8 rsvd[8];
+};
+
+/**
+ * Packed snapshot file index entry 
+ */
+struct __attribute__((__packed__)) pcie_pack_ent
+{
+	__u32 bdf; 			//!< BDF of the device. See PCIE_BDF()
+	__u32 tmpl; 		//!< Template the delta applies to
+	__u32 len; 			//!< Length of the delta in bytes. 0 = same as the template
+	__u32 rsvd;
+	__u64 off; 			//!< File offset of the delta
+};
+
+/**
+ * Packed snapshot delta run. Followed by len bytes that replace the template 
+ * bytes at off 
+ */
+struct __attribute__((__packed__)) pcie_pack_run
+{
+	__u16 off; 			//!< Offset in the image
+	__u16 len; 			//!< Number of bytes
+};
+
+/**
+ * Open packed snapshot file 
+ */
+struct pcie_pack
+{
+	void *map; 					//!< Read only mapping of the file
+	size_t len; 				//!< Length of the mapping
+	struct pcie_pack_hdr *hdr; 	//!< File header 
+	struct pcie_pack_ent *ent; 	//!< Index, sorted by ascending BDF
+	unsigned num; 				//!< Number of entries in ent[]
+	unsigned ntmpl; 			//!< Number of templates
+};
+
+/**
+ * Name database file header 
+ *
+ * Located at offset 0 of a file written by pcie_ids_compile(). Fields are in
+ * the byte order of the host that wrote the file
+ */
+struct __attribute__((__packed__)) pcie_ids_hdr
+{
+	__u32 magic; 		//!< PCNM_MAGIC
+	__u16 version; 		//!< PCNM_VERSION
+	__u16 hdr_len; 		//!< Size of this header in bytes
+	__u32 num; 			//!< Number of names
+	__u32 nbucket; 		//!< Number of hash buckets
+	__u32 nslot; 		//!< Number of hash table slots
+	__u32 seed; 		//!< Seed of the key hash
+	__u64 bucket_off; 	//!< File offset of the __u32 displacement of each bucket
+	__u64 slot_off; 	//!< File offset of the struct pcie_ids_ent slots
+	__u64 name_off; 	//!< File offset of the NUL terminated names
+	__u64 file_len; 	//!< Total length of the file in bytes
+	__u8 rsvd[8];
+};
+
+/**
+ * Name database hash table slot 
+ */
+struct __attribute__((__packed__)) pcie_ids_ent
+{
+	__u32 vd; 			//!< Vendor ID << 16 | Device ID. Device ID is 0 for a vendor
+	__u32 ss; 			//!< Subsystem Vendor ID << 16 | Subsystem ID. 0 unless a subsystem
+	__u32 name; 		//!< Bits [29:0]: offset of the name from name_off. Bits [31:30]: enum _PCNM
+};
+
+/**
+ * Open name database 
+ */
+struct pcie_ids
+{
+	void *map; 							//!< Read only mapping of the file
+	size_t len; 						//!< Length of the mapping
+	const struct pcie_ids_hdr *hdr; 	//!< File header 
+	const __u32 *disp; 					//!< Displacement of each bucket
+	const struct pcie_ids_ent *slot; 	//!< Hash table
+	const char *names; 					//!< Name strings
+	size_t names_len; 					//!< Bytes of name strings
+};
+
+/**
+ * Header fields of many functions stored as one array per field
+ *
+ * Row n of every array describes the same function. Filled in by
+ * pcie_col_add() and pcie_col_load()
+ */
+struct pcie_col
+{
+	void *mem; 			//!< Single allocation holding every column
+	size_t num; 		//!< Number of rows
+	size_t cap; 		//!< Rows allocated, a multiple of 64
+	__u32 *bdf; 		//!< PCCL_BDF
+	__u16 *vendor; 		//!< PCCL_VENDOR
+	__u16 *device; 		//!< PCCL_DEVICE
+	__u16 *command; 	//!< PCCL_COMMAND
+	__u16 *status; 		//!< PCCL_STATUS
+	__u8 *baseclass; 	//!< PCCL_BASECLASS
+	__u8 *subclass; 	//!< PCCL_SUBCLASS
+	__u8 *pi; 			//!< PCCL_PI
+	__u8 *type; 		//!< PCCL_TYPE
+	__u64 *caps; 		//!< PCCL_CAPS
+	__u64 *ecaps; 		//!< PCCL_ECAPS
+};
+
+/**
+ * Predicate of pcie_col_scan(): (column & mask) == val, negated if neg is set
+ */
+struct pcie_col_pred
+{
+	__u8 col; 		//!< enum _PCCL
+	__u8 neg; 		//!< 1 to match rows where the test fails
+	__u64 mask; 	//!< Bits of the column to test
+	__u64 val; 		//!< Value of those bits
+};
+
+/**
+ * Decoded PCI Express Capability
+ *
+ * Filled in by pcie_exp_decode(). Registers that the function does not
+ * implement read as 0: link registers of Root Complex Integrated Endpoints
+ * and Event Collectors, slot registers unless slot is set, root registers
+ * except in Root Ports and Event Collectors, and the "2" registers of a
+ * version 1 Capability. Sizes are in bytes and speeds use the Link Speed
+ * encoding, see pcie_exp_speed()
+ */
+struct pcie_exp
+{
+	__u16 off; 			//!< Offset of the Capability in config space
+	__u8 ver; 			//!< Capability Version
+	__u8 type; 			//!< Device/Port Type. enum _PCPT
+	__u8 slot; 			//!< Slot Implemented
+	__u8 irq; 			//!< Interrupt Message Number
+	__u8 link; 			//!< 1 if the function has link registers
+	__u8 flr; 			//!< Function Level Reset capable
+	__u16 mps_sup; 		//!< Max Payload Size Supported
+	__u16 mps; 			//!< Max Payload Size
+	__u16 mrrs; 		//!< Max Read Request Size
+	__u8 relaxed; 		//!< Enable Relaxed Ordering
+	__u8 nosnoop; 		//!< Enable No Snoop
+	__u8 ext_tag; 		//!< Extended Tag Field Enable
+	__u8 err_report; 	//!< Correctable, Non-Fatal, Fatal and Unsupported Request Reporting Enables, bits 0 to 3
+	__u8 max_speed; 	//!< Max Link Speed
+	__u8 max_width; 	//!< Maximum Link Width
+	__u8 speed; 		//!< Current Link Speed
+	__u8 width; 		//!< Negotiated Link Width. 0 if the link is down
+	__u8 speeds; 		//!< Supported Link Speeds Vector: bit n - 1 set if speed n is supported
+	__u8 target_speed; 	//!< Target Link Speed. 0 for a version 1 Capability
+	__u8 aspm_sup; 		//!< ASPM Support: bit 0 L0s, bit 1 L1
+	__u8 aspm; 			//!< ASPM Control: bit 0 L0s, bit 1 L1
+	__u8 port; 			//!< Port Number
+	__u8 training; 		//!< Link Training
+	__u8 dllla; 		//!< Data Link Layer Link Active. Valid if dllla_cap is set in lnkcap
+	__u16 slot_num; 	//!< Physical Slot Number. Valid if slot is set
+	__u32 devcap; 		//!< Device Capabilities register
+	__u16 devctl; 		//!< Device Control register
+	__u16 devsta; 		//!< Device Status register
+	__u32 lnkcap; 		//!< Link Capabilities register
+	__u16 lnkctl; 		//!< Link Control register
+	__u16 lnksta; 		//!< Link Status register
+	__u32 sltcap; 		//!< Slot Capabilities register
+	__u16 sltctl; 		//!< Slot Control register
+	__u16 sltsta; 		//!< Slot Status register
+	__u16 rootctl; 		//!< Root Control register
+	__u16 rootcap; 		//!< Root Capabilities register
+	__u32 rootsta; 		//!< Root Status register
+	__u32 devcap2; 		//!< Device Capabilities 2 register
+	__u16 devctl2; 		//!< Device Control 2 register
+	__u16 devsta2; 		//!< Device Status 2 register
+	__u32 lnkcap2; 		//!< Link Capabilities 2 register
+	__u16 lnkctl2; 		//!< Link Control 2 register
+	__u16 lnksta2; 		//!< Link Status 2 register
+};
+
+/**
+ * Function flagged by pcie_link_scan()
+ */
+struct pcie_link
+{
+	__u32 bdf; 			//!< BDF of the function. See PCIE_BDF()
+	__u32 up; 			//!< BDF of the upstream bridge, or ~0 if it is not in the batch
+	__u8 flags; 		//!< Bitmask of enum _PCLK
+	__u8 type; 			//!< Device/Port Type. enum _PCPT
+	__u8 speed; 		//!< Current Link Speed
+	__u8 max_speed; 	//!< Max Link Speed
+	__u8 width; 		//!< Negotiated Link Width
+	__u8 max_width; 	//!< Maximum Link Width
+	__u8 peer_speed; 	//!< Max Link Speed of the other end of the link. 0 if unknown
+	__u8 peer_width; 	//!< Maximum Link Width of the other end of the link. 0 if unknown
+	__u16 mps; 			//!< Max Payload Size
+	__u16 up_mps; 		//!< Max Payload Size of the upstream bridge. 0 if unknown
+	__u16 mrrs; 		//!< Max Read Request Size
+};
+
+/**
+ * VF BAR decoded by pcie_sriov_decode()
+ *
+ * A 64-bit VF BAR takes two registers. The entry of the upper register has
+ * upper set and nothing else
+ */
+struct pcie_sriov_bar
+{
+	__u64 base; 		//!< Address of the BAR of VF 0. VF n starts at base + n * size
+	__u64 size; 		//!< Size of the BAR of one VF. 0 if unknown
+	__u8 is64; 			//!< 64-bit BAR. The next register holds the upper 32 bits
+	__u8 prefetch; 		//!< Prefetchable
+	__u8 upper; 		//!< Register holds the upper 32 bits of the previous BAR
+};
+
+/**
+ * Decoded SR-IOV Extended Capability
+ *
+ * Filled in by pcie_sriov_decode(). First VF Offset and VF Stride are as
+ * reported for the current NumVFs and ARI Capable Hierarchy settings
+ */
+struct pcie_sriov
+{
+	__u16 off; 			//!< Offset of the Capability in config space
+	__u8 ver; 			//!< Capability Version
+	__u8 vf_enable; 	//!< VF Enable
+	__u8 vf_mse; 		//!< VF Memory Space Enable
+	__u8 ari; 			//!< ARI Capable Hierarchy
+	__u8 fdl; 			//!< Function Dependency Link
+	__u16 initial_vfs; 	//!< InitialVFs
+	__u16 total_vfs; 	//!< TotalVFs
+	__u16 num_vfs; 		//!< NumVFs
+	__u16 offset; 		//!< First VF Offset, in Routing IDs from the PF
+	__u16 stride; 		//!< VF Stride, in Routing IDs
+	__u16 vf_device; 	//!< VF Device ID
+	__u16 rebar_off; 	//!< Offset of the VF Resizable BAR Capability. 0 if not present
+	__u32 cap; 			//!< SR-IOV Capabilities register
+	__u16 ctrl; 		//!< SR-IOV Control register
+	__u16 status; 		//!< SR-IOV Status register
+	__u32 page_sizes; 	//!< Supported Page Sizes: bit n set if 2^(n + 12) bytes is supported
+	__u64 page_size; 	//!< System Page Size in bytes. 0 if none is selected
+	__u32 migration; 	//!< VF Migration State Array Offset register
+	struct pcie_sriov_bar bar[6]; 	//!< VF BAR0 to VF BAR5
+};
+
+/**
+ * Symbol table entry 
+ *
+ * A Class Code matches the entry if (code & mask) == val, with the code laid
+ * out as Base Class << 16 | Sub Class << 8 | Programming Interface. For
+ * Capabilities val is the ID and mask covers all of it.
+ */
+struct pcie_sym_ent
+{
+	const char *name; 	//!< Mnemonic or name, as spelled in the library. NULL if the slot is unused
+	__u32 val; 			//!< Capability ID or Class Code
+	__u32 mask; 		//!< Significant bits of val
+	__u16 len; 			//!< strlen(name)
+	__u8 ns; 			//!< enum _PCSY
+};
+
+/**
+ * Reverse lookup table from names to IDs, built by pcie_sym_init()
+ */
+struct pcie_sym
+{
+	struct pcie_sym_ent *slot; 	//!< Hash table
+	__u32 *disp; 				//!< Displacement of each bucket
+	__u32 nbucket; 				//!< Number of buckets
+	__u32 nslot; 				//!< Number of slots
+	__u32 seed; 				//!< Seed of the name hash
+	unsigned num; 				//!< Number of names
+};
+
+/**
+ * Register Bit Field metadata 
+ */
+struct pcie_field
+{
+	const char *name; 					//!< Field name, matching the struct member in this file
+	__u8 lo; 							//!< Lowest bit of the field 
+	__u8 width; 						//!< Number of bits 
+	__u8 access; 						//!< enum _PCRA
+};
+
+/**
+ * Register metadata 
+ */
+struct pcie_reg
+{
+	const char *name; 					//!< Register name, matching the struct member in this file
+	const char *label; 					//!< Human readable label. NULL if not formatted 
+	__u16 off; 							//!< Offset from the start of the register set 
+	__u8 len; 							//!< Width in bytes 
+	__u8 access; 						//!< enum _PCRA of the register as a whole 
+	__u8 digits; 						//!< Hex digits when formatted. 0 = decimal 
+	__u8 nfield; 						//!< Number of entries in field[]
+	const struct pcie_field *field; 	//!< Bit fields in ascending bit order. NULL if none
+};
+
+/**
+ * Set of registers describing one block, e.g. the header or a Capability 
+ */
+struct pcie_regset
+{
+	const char *name; 					//!< Short name of the block 
+	const struct pcie_reg *reg; 		//!< Registers in ascending offset order 
+	unsigned num; 						//!< Number of entries in reg[]. At most 64 
+};
+
+/**
+ * Callback invoked by pcie_reg_decode() for each selected register
+ *
+ * @param ctx 	Opaque pointer supplied by the caller
+ * @param r 	struct pcie_reg* metadata of the register 
+ * @param v 	Register value 
+ * @return 		0 to continue, non zero to stop decoding
+ */
+typedef int (*pcie_reg_fn)(void *ctx, const struct pcie_reg *r, __u32 v);
+
+/**
+ * Changed register reported by pcie_cfg_diff() 
+ */
+struct pcie_diff
+{
+	__u16 offset; 		//!< Offset of the register in config space
+	__u8 len; 			//!< Width of the register in bytes
+	__u8 ext; 			//!< 1 if the register is in the Extended Capability region
+	__u16 cap_id; 		//!< ID of the Capability containing the register. 0 if none
+	__u16 cap_off; 		//!< Offset of the Capability containing the register. 0 if none
+	const char *name; 	//!< Header field or Capability name. NULL if unknown
+	const struct pcie_reg *reg; //!< Register metadata. NULL if the register is not described
+	__u32 old; 			//!< Register value in the reference image
+	__u32 cur; 			//!< Register value in the compared image
+	__u32 mask; 		//!< Bits that differ
+};
+
+/**
+ * Output sink
+ *
+ * Destination for formatted output. Each sink is used by one thread at a time
+ * and takes no locks, so threads that render in parallel should each have
+ * their own, e.g. one memory sink per worker flushed with pcie_sink_flushv().
+ * A sink can be passed wherever a pcie_writer is expected as pcie_sink_wr and
+ * the sink pointer.
+ */
+struct pcie_sink
+{
+	unsigned type; 		//!< enum _PCSK
+	int err; 			//!< 0 or -1 once a write has failed
+	pcie_writer fn; 	//!< Callback of a PCSK_FN sink
+	void *ctx; 			//!< Opaque pointer passed to fn
+	int fd; 			//!< File descriptor of a PCSK_FD sink
+	char *buf; 			//!< Buffer. Owned by the sink for PCSK_MEM
+	size_t len; 		//!< Size of buf
+	size_t pos; 		//!< Bytes currently in buf
+	size_t total; 		//!< Bytes written to the sink in total
+};
+
+/**
+ * Streaming JSON / CBOR emitter state 
+ *
+ * Initialize with pcie_emit_init(). Memory use is bounded by the caller's buffer
+ */
+struct pcie_emit
+{
+	char *buf; 			//!< Output or staging buffer 
+	size_t len; 		//!< Size of buf
+	size_t pos; 		//!< Bytes currently in buf
+	size_t total; 		//!< Bytes emitted in total, including any that did not fit
+	struct pcie_sink *out; 	//!< Sink buf is flushed to. NULL = buffer only
+	struct pcie_sink fd; 	//!< Unbuffered sink used by pcie_emit_init() for a file descriptor
+	int err; 			//!< 0 or -1 once an error has occurred 
+	unsigned fmt; 		//!< enum _PCEM
+	unsigned depth; 	//!< Current map / array nesting depth
+	__u32 first; 		//!< Bit n set when depth n+1 has had no elements yet
+};
+
+/**
+ * Config space access backend 
+ *
+ * open() resolves a BDF to a handle once; read() then accesses the device 
+ * through that handle with no lookup. close() may be NULL
+ */
+struct pcie_acc_ops
+{
+	const char *name; 	//!< Short name of the backend 
+	int (*open)(void *ctx, __u32 bdf, void **hdl); 									//!< 0 upon success, -1 upon error
+	int (*read)(void *ctx, void *hdl, unsigned off, unsigned len, __u32 *v); 		//!< Read 1, 2 or 4 bytes. 0 upon success, -1 upon error
+	void (*close)(void *ctx, void *hdl);
+};
+
+/**
+ * Context of the PCIE_ACC_MEM backend 
+ */
+struct pcie_acc_mem
+{
+	__u32 *bdfs; 		//!< num BDFs. See PCIE_BDF()
+	__u8 *images; 		//!< num contiguous images of PCLN_CFG bytes each 
+	unsigned num; 		//!< Number of images
+};
+
+/**
+ * Device registered with a Status monitor 
+ */
+struct pcie_mon_dev
+{
+	void *hdl; 			//!< Backend handle 
+	__u32 bdf; 			//!< BDF of the device 
+	__u16 status; 		//!< Last Status register sample 
+	__u8 flags; 		//!< Last device state. Bitmask of enum _PCMN
+};
+
+/**
+ * Status register error bit monitor 
+ *
+ * Initialize with pcie_mon_init() and release with pcie_mon_free()
+ */
+struct pcie_mon
+{
+	const struct pcie_acc_ops *ops; 	//!< Backend 
+	void *ctx; 							//!< Backend context
+	struct pcie_mon_dev *dev; 			//!< Registered devices
+	unsigned num; 						//!< Number of entries in dev[]
+	unsigned max; 						//!< Allocated entries in dev[]
+	unsigned next; 						//!< Entry in dev[] the next poll starts at
+	__u16 mask; 						//!< Status bits that generate events 
+};
+
+/**
+ * Edge event reported by pcie_mon_poll() 
+ */
+struct pcie_mon_evt
+{
+	__u32 bdf; 			//!< BDF of the device 
+	__u16 old; 			//!< Previous Status register sample 
+	__u16 cur; 			//!< Current Status register sample. Equal to old if unreadable
+	__u16 set; 			//!< Masked bits that went from 0 to 1
+	__u16 clr; 			//!< Masked bits that went from 1 to 0
+	__u8 oflags; 		//!< Previous device state. Bitmask of enum _PCMN
+	__u8 flags; 		//!< Current device state. Bitmask of enum _PCMN
+};
+
+/**
+ * Node of a topology tree. One per function 
+ *
+ * parent, child and next are indexes into pcie_topo.node[]. -1 = none
+ */
+struct pcie_topo_node
+{
+	__u8 *cfg; 			//!< Config space image of the function
+	__u32 bdf; 			//!< BDF of the function. See PCIE_BDF()
+	int parent; 		//!< Bridge whose secondary bus this function is on
+	int child; 			//!< First function on the secondary bus of this bridge
+	int next; 			//!< Next function on the same bus, in input order
+	__u16 seg; 			//!< Index into pcie_topo.seg[]
+	__u8 type; 			//!< Header Type without the multi-function bit
+	__u8 sec; 			//!< Secondary Bus Number of a bridge. 0 if none
+	__u8 sub; 			//!< Subordinate Bus Number of a bridge. 0 if none
+};
+
+/**
+ * Bus tables of one PCI Segment in a topology tree 
+ */
+struct pcie_topo_seg
+{
+	unsigned seg; 		//!< PCI Segment number
+	int owner[256]; 	//!< Node index of the bridge that owns each bus. -1 = root bus or unknown
+	int first[256]; 	//!< Node index of the first function on each bus. -1 = none
+};
+
+/**
+ * PCI topology tree 
+ *
+ * Built by pcie_topo_build() and released with pcie_topo_free()
+ */
+struct pcie_topo
+{
+	struct pcie_topo_node *node; 	//!< Nodes in input order 
+	unsigned num; 					//!< Number of entries in node[]
+	struct pcie_topo_seg *seg; 		//!< Bus tables per segment 
+	unsigned nseg; 					//!< Number of entries in seg[]
+	unsigned flags; 				//!< Bitmask of enum _PCTP
+};
+
+/**
+ * Slot of a Device Serial Number index. Also used to return matches
+ */
+struct pcie_dsn_slot
+{
+	__u64 dsn; 			//!< Serial number. 0 = empty slot
+	__u32 snap; 		//!< Caller assigned identifier of the snapshot or host
+	__u32 bdf; 			//!< BDF of the device. See PCIE_BDF()
+};
+
+/**
+ * Device Serial Number index 
+ *
+ * Initialize with pcie_dsn_init() and release with pcie_dsn_free()
+ */
+struct pcie_dsn_index
+{
+	struct pcie_dsn_slot *slot; 	//!< Power of two number of slots
+	__u64 mask; 					//!< Number of slots - 1
+	__u64 num; 						//!< Number of entries inserted
+};
+
+/**
+ * Decode cache entry
+ *
+ * Locates the result of the last decode of one BDF and holds the fingerprints
+ * of the image it was decoded from. Kept small so that a lookup that hits
+ * reads one entry and the image, not the result
+ */
+struct pcie_dcache_ent
+{
+	__u32 bdf; 					//!< BDF. See PCIE_BDF()
+	__u32 dec; 					//!< Index of the result in pcie_dcache.dec
+	__u8 used; 					//!< 1 once the entry holds a device
+	__u8 capptr; 				//!< Capability Pointer the chains were walked from
+	__u64 walked; 				//!< 64 byte blocks read by the Capability walks. Bit n = [n*64, n*64+63]
+	__u64 fp; 					//!< Fingerprint of block 0 and the walked blocks
+	__u64 fp_caps; 				//!< Fingerprint of the walked blocks alone
+};
+
+/**
+ * Decode cache keyed by BDF
+ *
+ * Initialize with pcie_dcache_init() and release with pcie_dcache_free()
+ */
+struct pcie_dcache
+{
+	struct pcie_dcache_ent *ent; 	//!< Power of two number of entries
+	struct pcie_dec *dec; 			//!< Results in the order the BDFs were first seen
+	__u64 mask; 					//!< Number of entries - 1
+	__u64 num; 						//!< Number of entries in use
+	__u64 stat[PCCH_MAX]; 			//!< Lookups by result. Index is enum _PCCH
+};
+
+/**
+ * Decoded MSI Capability 
+ *
+ * Filled in by pcie_msi_decode()
+ */
+struct pcie_msi
+{
+	__u16 off; 			//!< Offset of the Capability in config space
+	__u8 enable; 		//!< MSI Enable 
+	__u8 bit64; 		//!< 64-bit Message Address capable 
+	__u8 maskable; 		//!< Per vector masking capable 
+	__u8 request; 		//!< Number of vectors requested by the function 
+	__u8 allocated; 	//!< Number of vectors allocated by software 
+	__u16 data; 		//!< Message Data 
+	__u64 addr; 		//!< Message Address 
+	__u32 mask; 		//!< Mask Bits. 0 if not maskable
+	__u32 pending; 		//!< Pending Bits. 0 if not maskable
+};
+
+/**
+ * Decoded MSI-X Capability 
+ *
+ * Filled in by pcie_msix_decode(). Per vector mask state is held in the 
+ * MSI-X Table in BAR memory and is not part of config space
+ */
+struct pcie_msix
+{
+	__u16 off; 			//!< Offset of the Capability in config space
+	__u8 enable; 		//!< MSI-X Enable 
+	__u8 fmask; 		//!< Function Mask: all vectors masked
+	__u16 size; 		//!< Number of vectors in the table 
+	__u8 table_bir; 	//!< BAR holding the MSI-X Table 
+	__u8 pba_bir; 		//!< BAR holding the Pending Bit Array 
+	__u32 table_off; 	//!< Byte offset of the MSI-X Table in its BAR 
+	__u32 pba_off; 		//!< Byte offset of the Pending Bit Array in its BAR 
+};
+
+/**
+ * Interrupt vector accounting of one function 
+ */
+struct pcie_irq
+{
+	__u32 bdf; 			//!< BDF of the function. See PCIE_BDF()
+	__u16 requested; 	//!< Vectors the function can use: Multiple Message Enable count in MSI mode, else MSI-X table size, else MSI request, else 1 for INTx
+	__u16 allocated; 	//!< Vectors enabled by software in the active mode
+	__u8 mode; 			//!< Active interrupt mode. enum _PCIQ
+};
+
+/**
+ * Interrupt vector totals of a bus or a host 
+ */
+struct pcie_irq_sum
+{
+	__u32 bus; 			//!< Segment and bus: PCIE_BDF(seg, bus, 0, 0) >> 8. Unused for host totals
+	__u32 devices; 		//!< Number of functions 
+	__u32 mode[PCIQ_MAX]; //!< Number of functions in each enum _PCIQ mode
+	__u64 requested; 	//!< Sum of pcie_irq.requested
+	__u64 allocated; 	//!< Sum of pcie_irq.allocated
+};
+
+/**
+ * Planned contents of one bus of a generated segment
+ */
+struct pcie_gen_bus
+{
+	__u8 kind; 			//!< What lives on the bus. Internal to the generator 
+	__u8 num; 			//!< Number of devices or functions on the bus
+	__u8 model; 		//!< Device model of an endpoint bus. Internal to the generator
+	__u8 mps; 			//!< Max Payload Size programmed on the bus and the bridge above it. Internal to the generator
+	__u8 sec[32]; 		//!< Secondary Bus Number of the bridge in each slot 
+	__u8 sub[32]; 		//!< Subordinate Bus Number of the bridge in each slot 
+};
+
+/**
+ * Synthetic config space generator 
+ *
+ * Initialize with pcie_gen_init()
+ */
+struct pcie_gen
+{
+	__u64 rng; 						//!< PRNG state 
+	unsigned flags; 				//!< Bitmask of enum _PCGN
+	unsigned bad_rate; 				//!< 1 in bad_rate images is damaged with PCGN_BAD 
+	unsigned seg; 					//!< Segment being generated 
+	unsigned bus; 					//!< Bus being generated 
+	unsigned slot; 					//!< Next device or function on the bus 
+	__u64 model[PCLN_GEN_MODELS]; 	//!< PRNG seed of each device model
+	struct pcie_gen_bus plan[256]; 	//!< Layout of the current segment
+};
 
 /* PROTOTYPES ================================================================*/
 
+const char *pcie_class_name(unsigned base, unsigned sub, unsigned pi);
+const char *pcbc(unsigned u);
 const char *pcap(unsigned u);
 const char *pcec(unsigned u);
 const char *pccx(unsigned u);
@@ -733,7 +2048,229 @@ const char *pcpa(unsigned u);
 const char *pcne(unsigned u);
 
 void pcie_prnt_cfgspace(__u8 *cfgspace, unsigned indent);
+size_t pcie_fmt_cfgspace(char *buf, size_t len, __u8 *cfgspace, unsigned indent);
+int pcie_wr_cfgspace(pcie_writer fn, void *ctx, __u8 *cfgspace, unsigned indent);
+size_t pcie_fmt_cmd(char *buf, size_t len, __u16 v);
+size_t pcie_fmt_status(char *buf, size_t len, __u16 v);
+size_t pcie_fmt_pmc(char *buf, size_t len, __u16 v);
+size_t pcie_fmt_pmcsr(char *buf, size_t len, __u16 v);
+size_t pcie_fmt_msi_ctrl(char *buf, size_t len, __u16 v);
+
+void pcie_sink_fn(struct pcie_sink *s, pcie_writer fn, void *ctx);
+void pcie_sink_fd(struct pcie_sink *s, int fd, char *buf, size_t len);
+void pcie_sink_mem(struct pcie_sink *s);
+void pcie_sink_null(struct pcie_sink *s);
+int pcie_sink_write(struct pcie_sink *s, const char *buf, size_t len);
+int pcie_sink_wr(void *sink, const char *buf, size_t len);
+int pcie_sink_flush(struct pcie_sink *s);
+int pcie_sink_flushv(int fd, struct pcie_sink *s, unsigned num);
+int pcie_sink_free(struct pcie_sink *s);
+
+int pcie_cap_index_build(struct pcie_cap_index *idx, __u8 *cfgspace);
+unsigned pcie_cap_validate(__u8 *cfgspace, struct pcie_cap_check *chk);
+size_t pcie_cap_validate_batch(__u8 *images, size_t num, __u32 *err);
+unsigned pcie_cap_find(const struct pcie_cap_index *idx, unsigned id);
+unsigned pcie_ecap_find(const struct pcie_cap_index *idx, unsigned id);
+const struct pcie_cap_ent *pcie_cap_first(const struct pcie_cap_index *idx, unsigned id);
+const struct pcie_cap_ent *pcie_cap_next(const struct pcie_cap_index *idx, const struct pcie_cap_ent *e);
+const struct pcie_cap_ent *pcie_ecap_first(const struct pcie_cap_index *idx, unsigned id);
+const struct pcie_cap_ent *pcie_ecap_next(const struct pcie_cap_index *idx, const struct pcie_cap_ent *e);
+
+int pcie_decode(struct pcie_dec *d, __u8 *cfgspace);
+void pcie_decode_hdr(struct pcie_dec *d, __u8 *cfgspace);
+int pcie_decode_batch(__u8 *images, size_t num, struct pcie_dec *out, unsigned threads);
+
+int pcie_snap_write(const char *path, __u32 *bdfs, __u8 *images, unsigned num, __u64 time);
+int pcie_snap_create(struct pcie_snap_wr *w, const char *path, unsigned num, __u64 time);
+int pcie_snap_append(struct pcie_snap_wr *w, __u32 *bdfs, __u8 *images, unsigned n);
+int pcie_snap_commit(struct pcie_snap_wr *w);
+int pcie_snap_open(struct pcie_snap *snap, const char *path);
+void pcie_snap_close(struct pcie_snap *snap);
+__u8 *pcie_snap_cfg(struct pcie_snap *snap, unsigned i);
+struct pcie_cfg_hdr *pcie_snap_find(struct pcie_snap *snap, __u32 bdf);
+
+int pcie_pack_write(const char *path, __u32 *bdfs, __u8 *images, unsigned num, __u64 time);
+int pcie_pack_snap(const char *path, struct pcie_snap *snap);
+int pcie_pack_open(struct pcie_pack *pk, const char *path);
+void pcie_pack_close(struct pcie_pack *pk);
+int pcie_pack_cfg(struct pcie_pack *pk, unsigned i, __u8 *out);
+int pcie_pack_find(struct pcie_pack *pk, __u32 bdf);
+
+__u64 pcie_cfg_diff_blocks(__u8 *a, __u8 *b);
+int pcie_cfg_diff(__u8 *a, __u8 *b, struct pcie_diff *out, unsigned max);
+
+void pcie_emit_init(struct pcie_emit *e, unsigned fmt, char *buf, size_t len, int fd);
+void pcie_emit_init_sink(struct pcie_emit *e, unsigned fmt, char *buf, size_t len, struct pcie_sink *out);
+int pcie_emit_begin(struct pcie_emit *e);
+int pcie_emit_dev(struct pcie_emit *e, __u32 bdf, __u8 *cfgspace);
+int pcie_emit_end(struct pcie_emit *e);
+int pcie_emit_finish(struct pcie_emit *e);
+
+__u32 pcie_reg_read(const struct pcie_reg *r, __u8 *base);
+__u32 pcie_field_get(const struct pcie_field *f, __u32 v);
+void pcie_field_batch(const __u8 *images, size_t num, const __u16 *base, unsigned off, 
+	unsigned len, unsigned lo, unsigned width, __u32 *out);
+const struct pcie_regset *pcie_reg_hdr(__u8 *cfgspace);
+const struct pcie_reg *pcie_reg_at(const struct pcie_regset *set, unsigned off);
+__u64 pcie_reg_mask(const struct pcie_regset *set, const char *names);
+int pcie_reg_decode(const struct pcie_regset *set, __u8 *base, __u64 select, pcie_reg_fn fn, void *ctx);
+
+int pcie_acc_read(const struct pcie_acc_ops *ops, void *ctx, __u32 bdf, unsigned off, unsigned len, __u32 *v);
+
+void pcie_mon_init(struct pcie_mon *m, const struct pcie_acc_ops *ops, void *ctx, __u16 mask);
+int pcie_mon_add(struct pcie_mon *m, __u32 bdf);
+void pcie_mon_free(struct pcie_mon *m);
+int pcie_mon_poll(struct pcie_mon *m, struct pcie_mon_evt *out, unsigned max);
+
+int pcie_topo_build(struct pcie_topo *t, __u32 *bdfs, __u8 *images, unsigned num);
+void pcie_topo_free(struct pcie_topo *t);
+struct pcie_topo_node *pcie_topo_find(struct pcie_topo *t, __u32 bdf);
+struct pcie_topo_node *pcie_topo_parent(struct pcie_topo *t, struct pcie_topo_node *n);
+struct pcie_topo_node *pcie_topo_child(struct pcie_topo *t, struct pcie_topo_node *n);
+struct pcie_topo_node *pcie_topo_next(struct pcie_topo *t, struct pcie_topo_node *n);
+
+__u64 pcie_dsn(__u8 *cfgspace);
+int pcie_dsn_init(struct pcie_dsn_index *idx, __u64 max);
+void pcie_dsn_free(struct pcie_dsn_index *idx);
+int pcie_dsn_insert(struct pcie_dsn_index *idx, __u64 dsn, __u32 snap, __u32 bdf);
+int pcie_dsn_insert_snap(struct pcie_dsn_index *idx, struct pcie_snap *snap, __u32 id);
+unsigned pcie_dsn_find(const struct pcie_dsn_index *idx, __u64 dsn, struct pcie_dsn_slot *out, unsigned max);
+
+int pcie_msi_decode(struct pcie_msi *m, __u8 *cfgspace, unsigned off);
+int pcie_msix_decode(struct pcie_msix *m, __u8 *cfgspace, unsigned off);
+int pcie_irq_dev(struct pcie_irq *q, __u32 bdf, __u8 *cfgspace);
+int pcie_irq_acct(__u32 *bdfs, __u8 *images, unsigned num, struct pcie_irq *dev, 
+	struct pcie_irq_sum *bus, unsigned max, struct pcie_irq_sum *host);
+
+void pcie_gen_init(struct pcie_gen *g, __u64 seed, unsigned flags);
+size_t pcie_gen_next(struct pcie_gen *g, __u8 *images, __u32 *bdfs, size_t n);
+int pcie_gen_snap(const char *path, struct pcie_gen *g, unsigned num, __u64 time);
+
+int pcie_dcache_init(struct pcie_dcache *c, __u64 max);
+void pcie_dcache_free(struct pcie_dcache *c);
+int pcie_dcache_decode(struct pcie_dcache *c, __u32 bdf, __u8 *cfgspace, const struct pcie_dec **out);
+
+int pcie_ids_compile(const char *src, const char *dst);
+int pcie_ids_open(struct pcie_ids *db, const char *path);
+void pcie_ids_close(struct pcie_ids *db);
+const char *pcie_ids_vendor(const struct pcie_ids *db, __u16 vendor);
+const char *pcie_ids_device(const struct pcie_ids *db, __u16 vendor, __u16 device);
+const char *pcie_ids_subsys(const struct pcie_ids *db, __u16 vendor, __u16 device, __u16 subvendor, __u16 subsystem);
+int pcie_phf_build(const __u64 *h, unsigned n, __u32 nbucket, __u32 nslot, __u32 *disp, __u32 *slot);
+__u32 pcie_phf_slot(__u64 h, const __u32 *disp, __u32 nbucket, __u32 nslot);
+
+int pcie_sym_init(struct pcie_sym *t);
+void pcie_sym_free(struct pcie_sym *t);
+const struct pcie_sym_ent *pcie_sym_find(const struct pcie_sym *t, unsigned ns, const char *name, size_t len);
+
+int pcie_col_init(struct pcie_col *c, size_t max);
+void pcie_col_free(struct pcie_col *c);
+long pcie_col_add(struct pcie_col *c, __u32 bdf, __u8 *cfgspace);
+size_t pcie_col_load(struct pcie_col *c, __u8 *images, const __u32 *bdfs, size_t num);
+long pcie_col_scan(const struct pcie_col *c, const struct pcie_col_pred *p, unsigned npred, __u64 *bits);
+
+int pcie_exp_decode(struct pcie_exp *e, __u8 *cfgspace, unsigned off);
+const char *pcie_exp_speed(unsigned speed);
+long pcie_link_scan(__u32 *bdfs, __u8 *images, unsigned num, struct pcie_link *out, unsigned max);
+long pcie_link_scan_snap(struct pcie_snap *snap, struct pcie_link *out, unsigned max);
+
+int pcie_sriov_decode(struct pcie_sriov *s, __u8 *cfgspace, unsigned off);
+long pcie_sriov_vfs(const struct pcie_sriov *s, __u32 pf, __u32 *out, unsigned max);
+__u64 pcie_sriov_vf_bar(const struct pcie_sriov *s, unsigned vf, unsigned bar);
+__u64 pcie_sriov_footprint(const struct pcie_sriov *s, __u64 *per_vf);
+long pcie_sriov_scan(__u32 *bdfs, __u8 *images, unsigned num, __u32 *out, unsigned max);
+long pcie_sriov_scan_snap(struct pcie_snap *snap, __u32 *out, unsigned max);
 
 /* GLOBAL VARIABLES ==========================================================*/
 
+extern const struct pcie_regset PCIE_REGS_HDR; 	//!< struct pcie_cfg_hdr 
+extern const struct pcie_regset PCIE_REGS_HDR1; //!< struct pcie_cfg_hdr1 
+extern const struct pcie_regset PCIE_REGS_PM; 	//!< PCI Power Management Capability 
+extern const struct pcie_regset PCIE_REGS_MSI; 	//!< MSI Capability 
+extern const struct pcie_regset PCIE_REGS_MSIX; //!< MSI-X Capability 
+extern const struct pcie_regset PCIE_REGS_ECAP; //!< Extended Capability header 
+extern const struct pcie_regset PCIE_REGS_DSN; 	//!< Device Serial Number Extended Capability 
+
+extern const struct pcie_acc_ops PCIE_ACC_MEM; 	//!< Images in memory. ctx is a struct pcie_acc_mem*
+extern const struct pcie_acc_ops PCIE_ACC_SNAP; 	//!< Open snapshot file. ctx is a struct pcie_snap*
+extern const struct pcie_acc_ops PCIE_ACC_SYSFS; 	//!< Linux sysfs. ctx is the devices directory or NULL for the default
+
+/* INLINE FUNCTIONS ==========================================================*/
+
+/**
+ * Mix the bits of a 64-bit value. Finalizer of SplitMix64
+ *
+ * Invertible, so distinct inputs give distinct outputs. Used to spread keys 
+ * over the slots of the hash tables
+ */
+static inline __u64 pcie_mix64(__u64 x)
+{
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/**
+ * Little endian loads of 1, 2 and 4 bytes from any alignment
+ *
+ * Compile to a single load on little endian hosts and a load plus byte swap
+ * on big endian hosts
+ */
+static inline __u32 pcie_le8(const __u8 *p)
+{
+	return p[0];
+}
+
+static inline __u32 pcie_le16(const __u8 *p)
+{
+	__u16 v;
+
+	__builtin_memcpy(&v, p, 2);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap16(v);
+#endif
+	return v;
+}
+
+static inline __u32 pcie_le32(const __u8 *p)
+{
+	__u32 v;
+
+	__builtin_memcpy(&v, p, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+/**
+ * Little endian load of a register of len bytes: 1, 2 or 4
+ */
+static inline __u32 pcie_le(const __u8 *p, unsigned len)
+{
+	switch (len)
+	{
+		case 1: 	return pcie_le8(p);
+		case 2: 	return pcie_le16(p);
+		default: 	return pcie_le32(p);
+	}
+}
+
+#define PCIE_GET(block, name, off, size, lo, width) \
+	static inline __u32 pcie_get_##block##_##name(const __u8 *base) \
+	{ \
+		return PCIE_BITS(pcie_le##size(&base[off]), lo, width); \
+	} \
+	static inline void pcie_get_##block##_##name##_n(const __u8 *images, size_t num, const __u16 *base, __u32 *out) \
+	{ \
+		pcie_field_batch(images, num, base, off, (size) / 8, lo, width, out); \
+	}
+
+PCIE_ACCESSORS(PCIE_GET)
+
+#undef PCIE_GET
+
 #endif //ifndef _PCIE_H
@@ -0,0 +1,205 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		mon.c
+ *
+ * @brief 		Code file for the Status register error bit monitor
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Devices are registered once, which resolves each BDF to a backend handle and
+ * takes the first sample. A poll then costs one 2 byte read and a compare per
+ * device. Only changes in the masked bits, or in whether the device can be
+ * read at all, produce an event.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* free()
+ * realloc()
+ */
+#include <stdlib.h>
+
+/* memset()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_MON_GROW 	64 		//!< Minimum number of device slots added at a time
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Take a sample of the Status register of one device
+ *
+ * @param status 	__u16* set to the Status register. Unchanged if unreadable
+ * @return 			Bitmask of enum _PCMN
+ */
+static inline unsigned pcie_mon_sample(struct pcie_mon *m, struct pcie_mon_dev *d, __u16 *status)
+{
+	__u32 v;
+
+	if (m->ops->read(m->ctx, d->hdl, PCIE_MON_STATUS_OFF, 2, &v) != 0)
+		return PCMN_READ;
+
+	// A function that is gone returns all ones
+	if (v == 0xFFFF)
+		return PCMN_GONE;
+
+	*status = v;
+	return 0;
+}
+
+/**
+ * Initialize a monitor
+ *
+ * @param m 	struct pcie_mon* to initialize
+ * @param ops 	struct pcie_acc_ops* backend used to read the devices
+ * @param ctx 	Backend context
+ * @param mask 	Status register bits to watch, e.g. PCIE_STATUS_ERRORS
+ */
+void pcie_mon_init(struct pcie_mon *m, const struct pcie_acc_ops *ops, void *ctx, __u16 mask)
+{
+	memset(m, 0, sizeof(*m));
+	m->ops = ops;
+	m->ctx = ctx;
+	m->mask = mask;
+}
+
+/**
+ * Register a device with a monitor and take its first sample
+ *
+ * @param m 	struct pcie_mon* initialized with pcie_mon_init()
+ * @param bdf 	BDF of the device. See PCIE_BDF()
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_mon_add(struct pcie_mon *m, __u32 bdf)
+{
+	struct pcie_mon_dev *d;
+	unsigned max;
+
+	if (m == NULL || m->ops == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (m->num == m->max) {
+		max = m->max * 2;
+		if (max < PCIE_MON_GROW)
+			max = PCIE_MON_GROW;
+		d = realloc(m->dev, max * sizeof(*d));
+		if (d == NULL)
+			return -1;
+		m->dev = d;
+		m->max = max;
+	}
+
+	d = &m->dev[m->num];
+	memset(d, 0, sizeof(*d));
+	d->bdf = bdf;
+	if (m->ops->open(m->ctx, bdf, &d->hdl) != 0)
+		return -1;
+
+	d->flags = pcie_mon_sample(m, d, &d->status);
+	m->num++;
+	return 0;
+}
+
+/**
+ * Release the device table and backend handles of a monitor
+ */
+void pcie_mon_free(struct pcie_mon *m)
+{
+	unsigned i;
+
+	if (m == NULL)
+		return;
+
+	if (m->ops != NULL && m->ops->close != NULL)
+		for (i = 0 ; i < m->num ; i++)
+			m->ops->close(m->ctx, m->dev[i].hdl);
+
+	free(m->dev);
+	m->dev = NULL;
+	m->num = 0;
+	m->max = 0;
+	m->next = 0;
+}
+
+/**
+ * Sample every registered device and report edges since the last poll
+ *
+ * When out fills up the remaining devices are not resampled, so any changes
+ * on them are reported by the next poll rather than lost. That poll starts at
+ * the first device left out, so busy devices early in the list cannot starve
+ * the rest.
+ *
+ * @param m 	struct pcie_mon*
+ * @param out 	struct pcie_mon_evt* array to receive events
+ * @param max 	Number of entries in out
+ * @return 		Number of events stored in out, or -1 upon error
+ */
+int pcie_mon_poll(struct pcie_mon *m, struct pcie_mon_evt *out, unsigned max)
+{
+	struct pcie_mon_dev *d;
+	struct pcie_mon_evt *e;
+	unsigned i, k, n, flags;
+	__u16 cur, diff;
+
+	if (m == NULL || (out == NULL && max > 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	n = 0;
+	i = m->next;
+	for (k = 0 ; k < m->num ; k++, i++)
+	{
+		if (i >= m->num)
+			i = 0;
+
+		if (n >= max) {
+			m->next = i;
+			break;
+		}
+
+		d = &m->dev[i];
+		cur = d->status;
+		flags = pcie_mon_sample(m, d, &cur);
+		diff = (cur ^ d->status) & m->mask;
+
+		if (diff == 0 && flags == d->flags)
+			continue;
+
+		e = &out[n++];
+		e->bdf = d->bdf;
+		e->old = d->status;
+		e->cur = cur;
+		e->set = diff & cur;
+		e->clr = diff & d->status;
+		e->oflags = d->flags;
+		e->flags = flags;
+
+		d->status = cur;
+		d->flags = flags;
+	}
+
+	return n;
+}
@@ -0,0 +1,593 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		pack.c
+ *
+ * @brief 		Code file for the packed (template plus delta) snapshot file format
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Fleets hold many functions of the same model whose images differ in only a
+ * few bytes: BARs, bus numbers, serial numbers and status bits. A packed
+ * snapshot groups images by Vendor ID, Device ID, Class Code and Header Type,
+ * stores one template image per group and each device as the runs of bytes
+ * where it differs from its template.
+ *
+ * A template holds the most common value of each byte across its group, found
+ * with a per byte majority vote, so bytes unique to one device never end up in
+ * the template and in every other delta.
+ *
+ * Fields are in host byte order. See PCSN_MAGIC in main.h.
+ *
+ * Offset 			Contents
+ * 0 				struct pcie_pack_hdr
+ * index_off 		struct pcie_pack_ent[num], sorted by ascending BDF
+ * tmpl_off 		ntmpl template images of PCLN_CFG bytes each
+ * delta_off 		Deltas, in index order. A delta is a sequence of
+ * 					struct pcie_pack_run, each followed by its bytes
+ *
+ * tmpl_off is aligned to PCLN_CFG. An image is rebuilt by copying its template
+ * and the runs of its delta, which needs no other entry of the file.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* open()
+ */
+#include <fcntl.h>
+
+/* malloc()
+ * calloc()
+ * free()
+ * qsort()
+ */
+#include <stdlib.h>
+
+/* memset()
+ * memcpy()
+ */
+#include <string.h>
+
+/* mmap()
+ * munmap()
+ */
+#include <sys/mman.h>
+
+/* fstat()
+ */
+#include <sys/stat.h>
+
+/* close()
+ */
+#include <unistd.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_PACK_ALIGN(x) 	(((x) + PCLN_CFG - 1) & ~((__u64) PCLN_CFG - 1))
+#define PCIE_PACK_BLOCK 	64 		//!< Block size of pcie_cfg_diff_blocks()
+#define PCIE_PACK_GAP 		sizeof(struct pcie_pack_run) 	//!< Longest run of equal bytes copied rather than starting a new run
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Slot of the table used to assign images to templates
+ */
+struct pcie_pack_key
+{
+	__u64 key; 			//!< Vendor / Device ID, Class Code and Header Type
+	__u32 tmpl; 		//!< Template number + 1. 0 = empty slot
+};
+
+/**
+ * Image being packed
+ */
+struct pcie_pack_src
+{
+	__u32 bdf; 			//!< BDF of the device
+	__u32 tmpl; 		//!< Template number
+	__u8 *img; 			//!< Image
+};
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * qsort() comparison of two source images by BDF
+ */
+static int pcie_pack_cmp(const void *a, const void *b)
+{
+	const struct pcie_pack_src *x = a;
+	const struct pcie_pack_src *y = b;
+
+	return (x->bdf > y->bdf) - (x->bdf < y->bdf);
+}
+
+/**
+ * Return the template grouping key of an image
+ */
+static __u64 pcie_pack_key(__u8 *img)
+{
+	return ((__u64) pcie_le32(&img[0x00]) << 32)
+		| (pcie_le32(&img[0x08]) & 0xFFFFFF00)
+		| pcie_get_type_type(img);
+}
+
+/**
+ * Assign every image a template number
+ *
+ * @return 	Number of templates, or -1 upon error with errno set
+ */
+static int pcie_pack_group(struct pcie_pack_src *src, unsigned num)
+{
+	struct pcie_pack_key *tab;
+	__u64 key, mask, n, j;
+	unsigned i, ntmpl;
+
+	for (n = 16 ; PCIE_HASH_LOAD(n) < (__u64) num ; n <<= 1)
+		;
+
+	tab = calloc(n, sizeof(*tab));
+	if (tab == NULL)
+		return -1;
+
+	mask = n - 1;
+	ntmpl = 0;
+	for (i = 0 ; i < num ; i++)
+	{
+		key = pcie_pack_key(src[i].img);
+		j = pcie_mix64(key) & mask;
+		while (tab[j].tmpl != 0 && tab[j].key != key)
+			j = (j + 1) & mask;
+
+		if (tab[j].tmpl == 0) {
+			tab[j].key = key;
+			tab[j].tmpl = ++ntmpl;
+		}
+		src[i].tmpl = tab[j].tmpl - 1;
+	}
+
+	free(tab);
+	return ntmpl;
+}
+
+/**
+ * Build the templates: the per byte majority of the images of each group
+ *
+ * The Boyer-Moore vote finds the value held by more than half of the images
+ * when there is one, and some frequent value otherwise. Groups are voted one
+ * at a time so that the tally does not depend on the number of groups.
+ *
+ * @return 	0 upon success, -1 upon error with errno set
+ */
+static int pcie_pack_tmpl(struct pcie_pack_src *src, unsigned num, __u8 *tmpl, unsigned ntmpl)
+{
+	__u32 votes[PCLN_CFG];
+	unsigned *first, *order;
+	unsigned i, j, k;
+	__u8 *t, *img;
+
+	first = calloc(ntmpl + 1, sizeof(*first));
+	order = malloc((num + 1) * sizeof(*order));
+	if (first == NULL || order == NULL) {
+		free(first);
+		free(order);
+		return -1;
+	}
+
+	// Counting sort of the images by group. first[t] is where group t starts
+	for (i = 0 ; i < num ; i++)
+		first[src[i].tmpl + 1]++;
+	for (j = 1 ; j <= ntmpl ; j++)
+		first[j] += first[j - 1];
+	for (i = 0 ; i < num ; i++)
+		order[first[src[i].tmpl]++] = i;
+	for (j = ntmpl ; j > 0 ; j--)
+		first[j] = first[j - 1];
+	first[0] = 0;
+
+	for (j = 0 ; j < ntmpl ; j++)
+	{
+		t = &tmpl[(size_t) j * PCLN_CFG];
+		memcpy(t, src[order[first[j]]].img, PCLN_CFG);
+		for (k = 0 ; k < PCLN_CFG ; k++)
+			votes[k] = 1;
+
+		for (i = first[j] + 1 ; i < first[j + 1] ; i++)
+		{
+			img = src[order[i]].img;
+			for (k = 0 ; k < PCLN_CFG ; k++)
+			{
+				if (t[k] == img[k])
+					votes[k]++;
+				else if (votes[k] == 0) {
+					t[k] = img[k];
+					votes[k] = 1;
+				}
+				else
+					votes[k]--;
+			}
+		}
+	}
+
+	free(first);
+	free(order);
+	return 0;
+}
+
+/**
+ * Write one delta run to a sink
+ */
+static void pcie_pack_run(struct pcie_sink *s, __u8 *img, unsigned start, unsigned end)
+{
+	struct pcie_pack_run run;
+
+	run.off = start;
+	run.len = end - start;
+	pcie_sink_write(s, (char*) &run, sizeof(run));
+	pcie_sink_write(s, (char*) &img[start], run.len);
+}
+
+/**
+ * Write the runs where an image differs from its template to a sink
+ *
+ * Only 64 byte blocks that differ are compared byte by byte. Runs separated
+ * by no more than PCIE_PACK_GAP equal bytes are merged since a new run header
+ * would cost as much as the bytes it skips.
+ */
+static void pcie_pack_delta(struct pcie_sink *s, __u8 *tmpl, __u8 *img)
+{
+	__u64 blocks;
+	unsigned b, i, start, end, open;
+
+	open = 0;
+	start = end = 0;
+	for (blocks = pcie_cfg_diff_blocks(tmpl, img) ; blocks != 0 ; blocks &= blocks - 1)
+	{
+		b = __builtin_ctzll(blocks) * PCIE_PACK_BLOCK;
+		for (i = b ; i < b + PCIE_PACK_BLOCK ; i++)
+		{
+			if (tmpl[i] == img[i])
+				continue;
+
+			if (open && i - end <= PCIE_PACK_GAP) {
+				end = i + 1;
+				continue;
+			}
+
+			if (open)
+				pcie_pack_run(s, img, start, end);
+			start = i;
+			end = i + 1;
+			open = 1;
+		}
+	}
+
+	if (open)
+		pcie_pack_run(s, img, start, end);
+}
+
+/**
+ * Write a packed snapshot file from a set of images
+ */
+static int pcie_pack_build(const char *path, struct pcie_pack_src *src, unsigned num, __u64 time)
+{
+	struct pcie_pack_hdr *hdr;
+	struct pcie_pack_ent *ent;
+	struct pcie_sink delta, out;
+	__u8 *meta, *tmpl;
+	__u64 tmpl_off, delta_off;
+	unsigned i;
+	int ntmpl, fd, rv;
+
+	qsort(src, num, sizeof(*src), pcie_pack_cmp);
+
+	ntmpl = pcie_pack_group(src, num);
+	if (ntmpl < 0)
+		return -1;
+
+	tmpl_off = PCIE_PACK_ALIGN(sizeof(*hdr) + (__u64) num * sizeof(*ent));
+	delta_off = tmpl_off + (__u64) ntmpl * PCLN_CFG;
+
+	meta = calloc(1, tmpl_off);
+	tmpl = malloc((size_t) ntmpl * PCLN_CFG + 1);
+	if (meta == NULL || tmpl == NULL || pcie_pack_tmpl(src, num, tmpl, ntmpl) != 0) {
+		free(meta);
+		free(tmpl);
+		return -1;
+	}
+
+	hdr = (struct pcie_pack_hdr*) meta;
+	ent = (struct pcie_pack_ent*) (meta + sizeof(*hdr));
+
+	pcie_sink_mem(&delta);
+	for (i = 0 ; i < num ; i++)
+	{
+		ent[i].bdf = src[i].bdf;
+		ent[i].tmpl = src[i].tmpl;
+		ent[i].off = delta_off + delta.pos;
+		pcie_pack_delta(&delta, &tmpl[(size_t) src[i].tmpl * PCLN_CFG], src[i].img);
+		ent[i].len = delta_off + delta.pos - ent[i].off;
+	}
+
+	hdr->magic 		= PCPK_MAGIC;
+	hdr->version 	= PCPK_VERSION;
+	hdr->hdr_len 	= sizeof(*hdr);
+	hdr->num 		= num;
+	hdr->ntmpl 		= ntmpl;
+	hdr->index_off 	= sizeof(*hdr);
+	hdr->tmpl_off 	= tmpl_off;
+	hdr->delta_off 	= delta_off;
+	hdr->file_len 	= delta_off + delta.pos;
+	hdr->time 		= time;
+
+	rv = delta.err;
+	fd = -1;
+	if (rv == 0) {
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			rv = -1;
+	}
+	if (rv == 0) {
+		pcie_sink_fd(&out, fd, NULL, 0);
+		pcie_sink_write(&out, (char*) meta, tmpl_off);
+		pcie_sink_write(&out, (char*) tmpl, (size_t) ntmpl * PCLN_CFG);
+		pcie_sink_write(&out, delta.buf, delta.pos);
+		rv = pcie_sink_free(&out);
+	}
+	if (fd >= 0 && close(fd) != 0)
+		rv = -1;
+
+	pcie_sink_free(&delta);
+	free(meta);
+	free(tmpl);
+	return rv;
+}
+
+/**
+ * Write a set of config space images to a packed snapshot file
+ *
+ * The images are written in BDF order regardless of the order in which they
+ * are passed in.
+ *
+ * @param path 		Path of the file to create. An existing file is replaced
+ * @param bdfs 		__u32* array of num BDFs. See PCIE_BDF()
+ * @param images 	__u8* to num contiguous images of PCLN_CFG bytes each
+ * @param num 		Number of images
+ * @param time 		Capture time stored in the header, e.g. seconds since epoch
+ * @return 			0 upon success, -1 upon error with errno set
+ */
+int pcie_pack_write(const char *path, __u32 *bdfs, __u8 *images, unsigned num, __u64 time)
+{
+	struct pcie_pack_src *src;
+	unsigned i;
+	int rv;
+
+	if (path == NULL || (num > 0 && (bdfs == NULL || images == NULL))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	src = malloc((num + 1) * sizeof(*src));
+	if (src == NULL)
+		return -1;
+
+	for (i = 0 ; i < num ; i++) {
+		src[i].bdf = bdfs[i];
+		src[i].img = &images[(size_t) i * PCLN_CFG];
+	}
+
+	rv = pcie_pack_build(path, src, num, time);
+	free(src);
+	return rv;
+}
+
+/**
+ * Pack a snapshot opened with pcie_snap_open()
+ *
+ * @param path 		Path of the file to create. An existing file is replaced
+ * @param snap 		struct pcie_snap* opened with pcie_snap_open()
+ * @return 			0 upon success, -1 upon error with errno set
+ */
+int pcie_pack_snap(const char *path, struct pcie_snap *snap)
+{
+	struct pcie_pack_src *src;
+	unsigned i;
+	int rv;
+
+	if (path == NULL || snap == NULL || snap->map == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	src = malloc((snap->num + 1) * sizeof(*src));
+	if (src == NULL)
+		return -1;
+
+	for (i = 0 ; i < snap->num ; i++)
+	{
+		src[i].bdf = snap->ent[i].bdf;
+		src[i].img = pcie_snap_cfg(snap, i);
+		if (src[i].img == NULL) {
+			free(src);
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	rv = pcie_pack_build(path, src, snap->num, snap->hdr->time);
+	free(src);
+	return rv;
+}
+
+/**
+ * Open and map a packed snapshot file
+ *
+ * Only the header is checked. Index entries and deltas are checked as they
+ * are used.
+ *
+ * @param pk 	struct pcie_pack* to fill in
+ * @param path 	Path of the packed snapshot file
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_pack_open(struct pcie_pack *pk, const char *path)
+{
+	struct pcie_pack_hdr *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (pk == NULL || path == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(pk, 0, sizeof(*pk));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	if ((size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	hdr = map;
+	if (hdr->magic != PCPK_MAGIC
+		|| hdr->version != PCPK_VERSION
+		|| hdr->hdr_len < sizeof(*hdr)
+		|| hdr->file_len > (__u64) st.st_size
+		|| hdr->index_off > hdr->file_len
+		|| hdr->num > (hdr->file_len - hdr->index_off) / sizeof(struct pcie_pack_ent)
+		|| hdr->tmpl_off % PCLN_CFG != 0
+		|| hdr->tmpl_off > hdr->file_len
+		|| hdr->ntmpl > (hdr->file_len - hdr->tmpl_off) / PCLN_CFG)
+	{
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	pk->map = map;
+	pk->len = st.st_size;
+	pk->hdr = hdr;
+	pk->ent = (struct pcie_pack_ent*) ((__u8*) map + hdr->index_off);
+	pk->num = hdr->num;
+	pk->ntmpl = hdr->ntmpl;
+
+	return 0;
+}
+
+/**
+ * Unmap a packed snapshot opened with pcie_pack_open()
+ */
+void pcie_pack_close(struct pcie_pack *pk)
+{
+	if (pk == NULL || pk->map == NULL)
+		return;
+
+	munmap(pk->map, pk->len);
+	memset(pk, 0, sizeof(*pk));
+}
+
+/**
+ * Rebuild the config space image of index entry i
+ *
+ * @param pk 	struct pcie_pack* opened with pcie_pack_open()
+ * @param i 	Index entry number. Entries are in ascending BDF order
+ * @param out 	__u8* to a buffer of PCLN_CFG bytes to receive the image
+ * @return 		0 upon success, -1 if i is out of range or the entry is malformed
+ */
+int pcie_pack_cfg(struct pcie_pack *pk, unsigned i, __u8 *out)
+{
+	struct pcie_pack_ent *e;
+	struct pcie_pack_run run;
+	const __u8 *p, *end;
+
+	if (pk == NULL || pk->map == NULL || out == NULL || i >= pk->num) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Deltas must lie inside the file the header describes
+	e = &pk->ent[i];
+	if (e->tmpl >= pk->ntmpl || e->off > pk->hdr->file_len || e->len > pk->hdr->file_len - e->off) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memcpy(out, (__u8*) pk->map + pk->hdr->tmpl_off + (__u64) e->tmpl * PCLN_CFG, PCLN_CFG);
+
+	p = (__u8*) pk->map + e->off;
+	end = p + e->len;
+	while (p < end)
+	{
+		if ((size_t) (end - p) < sizeof(run)) {
+			errno = EINVAL;
+			return -1;
+		}
+		memcpy(&run, p, sizeof(run));
+		p += sizeof(run);
+
+		if (run.len > end - p || run.off + run.len > PCLN_CFG) {
+			errno = EINVAL;
+			return -1;
+		}
+		memcpy(&out[run.off], p, run.len);
+		p += run.len;
+	}
+
+	return 0;
+}
+
+/**
+ * Find a device in a packed snapshot by BDF
+ *
+ * @param pk 	struct pcie_pack* opened with pcie_pack_open()
+ * @param bdf 	BDF of the device. See PCIE_BDF()
+ * @return 		Index entry number to pass to pcie_pack_cfg(), or -1 if not present
+ */
+int pcie_pack_find(struct pcie_pack *pk, __u32 bdf)
+{
+	unsigned lo, hi, mid;
+
+	lo = 0;
+	hi = pk->num;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (pk->ent[mid].bdf < bdf)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo >= pk->num || pk->ent[lo].bdf != bdf)
+		return -1;
+
+	return lo;
+}
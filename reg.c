@@ -0,0 +1,543 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		reg.c
+ *
+ * @brief 		Code file for PCIe register metadata and the generic decoder
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ * 
+ * Each register set describes one of the structs in main.h. Offsets and widths
+ * of whole registers are taken from the structs with offsetof() and sizeof() 
+ * so the two cannot drift apart. Bit fields cannot be measured that way and 
+ * are listed by bit position. 
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* offsetof()
+ */
+#include <stddef.h>
+
+/* strchr()
+ * strlen()
+ * strncmp()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define ARRAY_LEN(a) 	(sizeof(a) / sizeof((a)[0]))
+
+/**
+ * Bit field of a register 
+ */
+#define PCIE_FIELD(name, lo, width, acc) 	{ #name, lo, width, PCRA_##acc }
+
+/**
+ * Register that is a member of a struct in main.h 
+ *
+ * @param type 		Struct name without the struct keyword
+ * @param member 	Member name. Also used as the register name 
+ * @param label 	Human readable label. NULL to omit from formatted output
+ * @param acc 		Access type of the whole register: RO, RW, RW1C or RSVD
+ * @param digits 	Hex digits when formatted. 0 = decimal 
+ * @param fields 	PCIE_FIELDS(array of struct pcie_field) or PCIE_NOFIELDS
+ */
+#define PCIE_REG(type, member, label, acc, digits, fields) \
+	{ #member, label, offsetof(struct type, member), sizeof(((struct type*) 0)->member), \
+	  PCRA_##acc, digits, fields }
+
+/**
+ * Register with an explicit offset and width, used for bit field members 
+ */
+#define PCIE_REG_AT(name, label, off, len, acc, digits, fields) \
+	{ #name, label, off, len, PCRA_##acc, digits, fields }
+
+/**
+ * Bit field list argument of PCIE_REG() and PCIE_REG_AT()
+ */
+#define PCIE_FIELDS(a) 		ARRAY_LEN(a), a
+#define PCIE_NOFIELDS 		0, NULL
+
+#define PCIE_REGSET(nm, regs) 	{ nm, regs, ARRAY_LEN(regs) }
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * struct pcie_cfg_cmd
+ */
+static const struct pcie_field PCIE_FLD_CMD[] = 
+{
+	PCIE_FIELD(io, 			 0, 1, RW),
+	PCIE_FIELD(mem, 		 1, 1, RW),
+	PCIE_FIELD(busmaster, 	 2, 1, RW),
+	PCIE_FIELD(speccycle, 	 3, 1, RO),
+	PCIE_FIELD(memwine, 	 4, 1, RO),
+	PCIE_FIELD(vgasnoop, 	 5, 1, RO),
+	PCIE_FIELD(parerr, 		 6, 1, RW),
+	PCIE_FIELD(stepping, 	 7, 1, RO),
+	PCIE_FIELD(serr, 		 8, 1, RW),
+	PCIE_FIELD(fastb2b, 	 9, 1, RO),
+	PCIE_FIELD(disintx, 	10, 1, RW),
+	PCIE_FIELD(rsvd2, 		11, 1, RSVD),
+	PCIE_FIELD(rsvd3, 		12, 4, RSVD),
+};
+
+/**
+ * struct pcie_cfg_status
+ */
+static const struct pcie_field PCIE_FLD_STATUS[] = 
+{
+	PCIE_FIELD(rsvd1, 		 0, 3, RSVD),
+	PCIE_FIELD(intx, 		 3, 1, RO),
+	PCIE_FIELD(cap, 		 4, 1, RO),
+	PCIE_FIELD(mhz, 		 5, 1, RO),
+	PCIE_FIELD(rsvd2, 		 6, 1, RSVD),
+	PCIE_FIELD(fastb2b, 	 7, 1, RO),
+	PCIE_FIELD(parerr, 		 8, 1, RW1C),
+	PCIE_FIELD(devsel, 		 9, 2, RO),
+	PCIE_FIELD(sig_tabort, 	11, 1, RW1C),
+	PCIE_FIELD(recv_tabort, 12, 1, RW1C),
+	PCIE_FIELD(recv_mabort, 13, 1, RW1C),
+	PCIE_FIELD(sig_sys_err, 14, 1, RW1C),
+	PCIE_FIELD(parity_err, 	15, 1, RW1C),
+};
+
+/**
+ * struct pcie_cfg_type
+ */
+static const struct pcie_field PCIE_FLD_TYPE[] = 
+{
+	PCIE_FIELD(type, 		 0, 7, RO),
+	PCIE_FIELD(mf, 			 7, 1, RO),
+};
+
+/**
+ * struct pcie_cap_pm_pmc
+ */
+static const struct pcie_field PCIE_FLD_PMC[] = 
+{
+	PCIE_FIELD(ver, 		 0, 3, RO),
+	PCIE_FIELD(clock, 		 3, 1, RO),
+	PCIE_FIELD(rsvd1, 		 4, 1, RSVD),
+	PCIE_FIELD(dsi, 		 5, 1, RO),
+	PCIE_FIELD(aux, 		 6, 3, RO),
+	PCIE_FIELD(d1, 			 9, 1, RO),
+	PCIE_FIELD(d2, 			10, 1, RO),
+	PCIE_FIELD(pme_sup, 	11, 5, RO),
+};
+
+/**
+ * struct pcie_cap_pm_pmcsr
+ */
+static const struct pcie_field PCIE_FLD_PMCSR[] = 
+{
+	PCIE_FIELD(state, 		 0, 2, RW),
+	PCIE_FIELD(rsvd2, 		 2, 1, RSVD),
+	PCIE_FIELD(no_soft_rst,  3, 1, RO),
+	PCIE_FIELD(rsvd3, 		 4, 4, RSVD),
+	PCIE_FIELD(pme_en, 		 8, 1, RW),
+	PCIE_FIELD(data_sel, 	 9, 4, RW),
+	PCIE_FIELD(data_scale, 	13, 2, RO),
+	PCIE_FIELD(pme_status, 	15, 1, RW1C),
+};
+
+/**
+ * struct pcie_cap_pm_bse
+ */
+static const struct pcie_field PCIE_FLD_BSE[] = 
+{
+	PCIE_FIELD(rsvd4, 		 0, 6, RSVD),
+	PCIE_FIELD(b2_b3, 		 6, 1, RO),
+	PCIE_FIELD(bpcc_en, 	 7, 1, RO),
+};
+
+/**
+ * struct pcie_cap_msi_ctrl
+ */
+static const struct pcie_field PCIE_FLD_MSI_CTRL[] = 
+{
+	PCIE_FIELD(enable, 		 0, 1, RW),
+	PCIE_FIELD(request, 	 1, 3, RO),
+	PCIE_FIELD(allocated, 	 4, 3, RW),
+	PCIE_FIELD(bit64, 		 7, 1, RO),
+	PCIE_FIELD(maskable, 	 8, 1, RO),
+	PCIE_FIELD(rsvd, 		 9, 7, RSVD),
+};
+
+/**
+ * struct pcie_cap_msix_ctrl
+ */
+static const struct pcie_field PCIE_FLD_MSIX_CTRL[] = 
+{
+	PCIE_FIELD(size, 		 0, 11, RO),
+	PCIE_FIELD(rsvd, 		11, 3, RSVD),
+	PCIE_FIELD(fmask, 		14, 1, RW),
+	PCIE_FIELD(enable, 		15, 1, RW),
+};
+
+/**
+ * struct pcie_cap_msix table and pba
+ */
+static const struct pcie_field PCIE_FLD_MSIX_TABLE[] = 
+{
+	PCIE_FIELD(bir, 		 0, 3, RO),
+	PCIE_FIELD(off, 		 3, 29, RO),
+};
+
+/**
+ * struct pcie_ecap
+ */
+static const struct pcie_field PCIE_FLD_ECAP[] = 
+{
+	PCIE_FIELD(id, 			 0, 16, RO),
+	PCIE_FIELD(ver, 		16,  4, RO),
+	PCIE_FIELD(next, 		20, 12, RO),
+};
+
+/**
+ * struct pcie_cfg_hdr 
+ */
+static const struct pcie_reg PCIE_REGS_HDR_TBL[] = 
+{
+	PCIE_REG(pcie_cfg_hdr, vendor, 		"Vendor ID", 				RO, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, device, 		"Device ID", 				RO, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, command, 	"Command", 					RW, 	4, PCIE_FIELDS(PCIE_FLD_CMD)),
+	PCIE_REG(pcie_cfg_hdr, status, 		"Status", 					RW1C, 	4, PCIE_FIELDS(PCIE_FLD_STATUS)),
+	PCIE_REG(pcie_cfg_hdr, rev, 		"Revision ID", 				RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, pi, 			"Programming Interface", 	RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, subclass, 	"Sub Class", 				RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, baseclass, 	"Base Class", 				RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, cls, 		"Cache Line Size", 			RW, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, timer, 		"Latency Timer", 			RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, type, 		"Header Type", 				RO, 	2, PCIE_FIELDS(PCIE_FLD_TYPE)),
+	PCIE_REG(pcie_cfg_hdr, bist, 		"BIST", 					RW, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, bar0, 		"BAR0", 					RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, bar1, 		"BAR1", 					RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, bar2, 		"BAR2", 					RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, bar3, 		"BAR3", 					RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, bar4, 		"BAR4", 					RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, bar5, 		"BAR5", 					RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, cis, 		"Cardbus CIS Ptr", 			RO, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, subvendor, 	"Subsystem Vendor ID", 		RO, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, subsystem, 	"Subsystem Device ID", 		RO, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, rom, 		"Expansion ROM Addr", 		RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, cap, 		"Capabilities Ptr", 		RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG_AT(rsvd, 					NULL, 0x35, 3, 				RSVD, 	6, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, rsvd2, 		NULL, 						RSVD, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, intline, 	"Interrupt Line", 			RW, 	0, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, intpin, 		"Interrupt Pin", 			RO, 	0, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, mingnt, 		"Minimum Grant", 			RO, 	0, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr, maxlat, 		"Maximum Latency", 			RO, 	0, PCIE_NOFIELDS),
+};
+
+/**
+ * struct pcie_cfg_hdr1 
+ */
+static const struct pcie_reg PCIE_REGS_HDR1_TBL[] = 
+{
+	PCIE_REG(pcie_cfg_hdr1, vendor, 	"Vendor ID", 				RO, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, device, 	"Device ID", 				RO, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, command, 	"Command", 					RW, 	4, PCIE_FIELDS(PCIE_FLD_CMD)),
+	PCIE_REG(pcie_cfg_hdr1, status, 	"Status", 					RW1C, 	4, PCIE_FIELDS(PCIE_FLD_STATUS)),
+	PCIE_REG(pcie_cfg_hdr1, rev, 		"Revision ID", 				RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, pi, 		"Programming Interface", 	RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, subclass, 	"Sub Class", 				RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, baseclass, 	"Base Class", 				RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, cls, 		"Cache Line Size", 			RW, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, timer, 		"Latency Timer", 			RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, type, 		"Header Type", 				RO, 	2, PCIE_FIELDS(PCIE_FLD_TYPE)),
+	PCIE_REG(pcie_cfg_hdr1, bist, 		"BIST", 					RW, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, bar0, 		"BAR0", 					RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, bar1, 		"BAR1", 					RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, pribus, 	"Primary Bus", 				RW, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, secbus, 	"Secondary Bus", 			RW, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, subbus, 	"Subordinate Bus", 			RW, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, seclat, 	"Secondary Lat Timer", 		RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, iobase, 	"I/O Base", 				RW, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, iolimit, 	"I/O Limit", 				RW, 	2, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, secstatus, 	"Secondary Status", 		RW1C, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, membase, 	"Memory Base", 				RW, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, memlimit, 	"Memory Limit", 			RW, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, pfbase, 	"Prefetchable Base", 		RW, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, pflimit, 	"Prefetchable Limit", 		RW, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, pfbase_hi, 	"Pref Base Upper", 			RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, pflimit_hi, "Pref Limit Upper", 		RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, iobase_hi, 	"I/O Base Upper", 			RW, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, iolimit_hi, "I/O Limit Upper", 			RW, 	4, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, cap, 		"Capabilities Ptr", 		RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG_AT(rsvd, 					NULL, 0x35, 3, 				RSVD, 	6, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, rom, 		"Expansion ROM Addr", 		RW, 	8, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, intline, 	"Interrupt Line", 			RW, 	0, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, intpin, 	"Interrupt Pin", 			RO, 	0, PCIE_NOFIELDS),
+	PCIE_REG(pcie_cfg_hdr1, bridgectl, 	"Bridge Control", 			RW, 	4, PCIE_NOFIELDS),
+};
+
+/**
+ * struct pcie_cap followed by struct pcie_cap_pm 
+ */
+static const struct pcie_reg PCIE_REGS_PM_TBL[] = 
+{
+	PCIE_REG_AT(id, 		"Capability ID", 			0, 1, RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG_AT(next, 		"Next Capability", 			1, 1, RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG_AT(pmc, 		"PM Capabilities", 			2, 2, RO, 	4, PCIE_FIELDS(PCIE_FLD_PMC)),
+	PCIE_REG_AT(pmcsr, 		"PM Control/Status", 		4, 2, RW, 	4, PCIE_FIELDS(PCIE_FLD_PMCSR)),
+	PCIE_REG_AT(bse, 		"Bridge Support Extension", 6, 1, RO, 	2, PCIE_FIELDS(PCIE_FLD_BSE)),
+	PCIE_REG_AT(data, 		"Data", 					7, 1, RO, 	2, PCIE_NOFIELDS),
+};
+
+/**
+ * struct pcie_cap followed by struct pcie_cap_msi_ctrl
+ */
+static const struct pcie_reg PCIE_REGS_MSI_TBL[] = 
+{
+	PCIE_REG_AT(id, 		"Capability ID", 			0, 1, RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG_AT(next, 		"Next Capability", 			1, 1, RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG_AT(ctrl, 		"Message Control", 			2, 2, RW, 	4, PCIE_FIELDS(PCIE_FLD_MSI_CTRL)),
+};
+
+/**
+ * struct pcie_cap followed by struct pcie_cap_msix
+ */
+static const struct pcie_reg PCIE_REGS_MSIX_TBL[] = 
+{
+	PCIE_REG_AT(id, 		"Capability ID", 			0, 1, RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG_AT(next, 		"Next Capability", 			1, 1, RO, 	2, PCIE_NOFIELDS),
+	PCIE_REG_AT(ctrl, 		"Message Control", 			2, 2, RW, 	4, PCIE_FIELDS(PCIE_FLD_MSIX_CTRL)),
+	PCIE_REG_AT(table, 		"Table Offset/BIR", 		4, 4, RO, 	8, PCIE_FIELDS(PCIE_FLD_MSIX_TABLE)),
+	PCIE_REG_AT(pba, 		"PBA Offset/BIR", 			8, 4, RO, 	8, PCIE_FIELDS(PCIE_FLD_MSIX_TABLE)),
+};
+
+/**
+ * struct pcie_ecap followed by struct pcie_ecap_dsn 
+ */
+static const struct pcie_reg PCIE_REGS_DSN_TBL[] = 
+{
+	PCIE_REG_AT(hdr, 		"Extended Capability Header", 0, 4, RO, 8, PCIE_FIELDS(PCIE_FLD_ECAP)),
+	PCIE_REG_AT(lo, 		"Serial Number Low", 		4, 4, RO, 	8, PCIE_NOFIELDS),
+	PCIE_REG_AT(hi, 		"Serial Number High", 		8, 4, RO, 	8, PCIE_NOFIELDS),
+};
+
+/**
+ * struct pcie_ecap 
+ */
+static const struct pcie_reg PCIE_REGS_ECAP_TBL[] = 
+{
+	PCIE_REG_AT(hdr, 		"Extended Capability Header", 0, 4, RO, 8, PCIE_FIELDS(PCIE_FLD_ECAP)),
+};
+
+const struct pcie_regset PCIE_REGS_HDR 	= PCIE_REGSET("hdr", 	PCIE_REGS_HDR_TBL);
+const struct pcie_regset PCIE_REGS_HDR1 = PCIE_REGSET("hdr1", 	PCIE_REGS_HDR1_TBL);
+const struct pcie_regset PCIE_REGS_PM 	= PCIE_REGSET("pm", 	PCIE_REGS_PM_TBL);
+const struct pcie_regset PCIE_REGS_MSI 	= PCIE_REGSET("msi", 	PCIE_REGS_MSI_TBL);
+const struct pcie_regset PCIE_REGS_MSIX = PCIE_REGSET("msix", 	PCIE_REGS_MSIX_TBL);
+const struct pcie_regset PCIE_REGS_ECAP	= PCIE_REGSET("ecap", 	PCIE_REGS_ECAP_TBL);
+const struct pcie_regset PCIE_REGS_DSN 	= PCIE_REGSET("dsn", 	PCIE_REGS_DSN_TBL);
+
+_Static_assert(ARRAY_LEN(PCIE_REGS_HDR_TBL) <= 64, "Register sets are selected with a 64-bit mask");
+_Static_assert(ARRAY_LEN(PCIE_REGS_HDR1_TBL) <= 64, "Register sets are selected with a 64-bit mask");
+_Static_assert(sizeof(struct pcie_cfg_hdr) == PCLN_HDR, "struct pcie_cfg_hdr must be 64 bytes");
+_Static_assert(sizeof(struct pcie_cfg_hdr1) == PCLN_HDR, "struct pcie_cfg_hdr1 must be 64 bytes");
+_Static_assert(sizeof(struct pcie_cfg_cmd) == 2, "struct pcie_cfg_cmd must be 2 bytes");
+_Static_assert(sizeof(struct pcie_cfg_status) == 2, "struct pcie_cfg_status must be 2 bytes");
+_Static_assert(sizeof(struct pcie_cap_pm) == 6, "struct pcie_cap_pm must be 6 bytes");
+_Static_assert(sizeof(struct pcie_cap_msi_ctrl) == 2, "struct pcie_cap_msi_ctrl must be 2 bytes");
+_Static_assert(sizeof(struct pcie_cap_msix_ctrl) == 2, "struct pcie_cap_msix_ctrl must be 2 bytes");
+_Static_assert(sizeof(struct pcie_cap_msix) == 10, "struct pcie_cap_msix must be 10 bytes");
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Read a register value 
+ *
+ * The value is assembled from little endian bytes so this is correct on any 
+ * host byte order 
+ *
+ * @param r 	struct pcie_reg* of the register to read
+ * @param base 	__u8* to the start of the block the register set describes
+ * @return 		Register value 
+ */
+__u32 pcie_reg_read(const struct pcie_reg *r, __u8 *base)
+{
+	__u32 v;
+	unsigned i;
+
+	v = 0;
+	for (i = 0 ; i < r->len ; i++)
+		v |= (__u32) base[r->off + i] << (8 * i);
+	return v;
+}
+
+/**
+ * Extract a bit field from a register value 
+ */
+__u32 pcie_field_get(const struct pcie_field *f, __u32 v)
+{
+	if (f->width >= 32)
+		return v >> f->lo;
+	return (v >> f->lo) & ((1u << f->width) - 1);
+}
+
+/**
+ * Extract one bit field of a register of len bytes from each image
+ *
+ * len is a constant at every call site so each copy has a fixed load width
+ */
+static inline __attribute__((always_inline)) void pcie_field_load(const __u8 *images, size_t num, 
+	const __u16 *base, unsigned off, const unsigned len, unsigned lo, __u32 mask, __u32 *out)
+{
+	size_t i;
+	unsigned b;
+
+	if (base == NULL) {
+		for (i = 0 ; i < num ; i++)
+			out[i] = (pcie_le(&images[i * PCLN_CFG + off], len) >> lo) & mask;
+		return;
+	}
+
+	for (i = 0 ; i < num ; i++)
+	{
+		b = base[i];
+		if (b == 0 || b + off + len > PCLN_CFG)
+			out[i] = 0;
+		else
+			out[i] = (pcie_le(&images[i * PCLN_CFG + b + off], len) >> lo) & mask;
+	}
+}
+
+/**
+ * Extract one bit field from the same register of many images
+ *
+ * This is the body of the generated pcie_get_<block>_<name>_n() accessors.
+ * Registers are PCLN_CFG bytes apart, so each is loaded, shifted and masked on
+ * its own.
+ *
+ * @param images 	__u8* to num contiguous images of PCLN_CFG bytes each
+ * @param num 		Number of images
+ * @param base 		__u16* array of num block offsets, e.g. from pcie_cap_find(),
+ * 					or NULL for header fields. A 0 entry marks an absent block
+ * 					and yields 0, as does a block that would run past the image
+ * @param off 		Offset of the register from the start of the block
+ * @param len 		Width of the register in bytes: 1, 2 or 4
+ * @param lo 		Lowest bit of the field
+ * @param width 	Number of bits: 0 to 32
+ * @param out 		__u32* array of num entries to receive the field values
+ */
+void pcie_field_batch(const __u8 *images, size_t num, const __u16 *base, unsigned off, 
+	unsigned len, unsigned lo, unsigned width, __u32 *out)
+{
+	__u32 mask;
+
+	mask = PCIE_MASK(width);
+
+	switch (len)
+	{
+		case 1: 	pcie_field_load(images, num, base, off, 1, lo, mask, out); break;
+		case 2: 	pcie_field_load(images, num, base, off, 2, lo, mask, out); break;
+		default: 	pcie_field_load(images, num, base, off, 4, lo, mask, out); break;
+	}
+}
+
+/**
+ * Return the header register set that matches the Header Type of an image 
+ *
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space 
+ * @return 			&PCIE_REGS_HDR1 for a PCI-to-PCI Bridge, &PCIE_REGS_HDR otherwise
+ */
+const struct pcie_regset *pcie_reg_hdr(__u8 *cfgspace)
+{
+	if (pcie_get_type_type(cfgspace) == 1)
+		return &PCIE_REGS_HDR1;
+	return &PCIE_REGS_HDR;
+}
+
+/**
+ * Return the register of a set that contains an offset 
+ *
+ * @param set 	struct pcie_regset* to search
+ * @param off 	Offset relative to the start of the register set 
+ * @return 		struct pcie_reg* or NULL if no register contains the offset
+ */
+const struct pcie_reg *pcie_reg_at(const struct pcie_regset *set, unsigned off)
+{
+	unsigned i;
+
+	for (i = 0 ; i < set->num ; i++)
+		if (off >= set->reg[i].off && off < (unsigned) set->reg[i].off + set->reg[i].len)
+			return &set->reg[i];
+	return NULL;
+}
+
+/**
+ * Build a register selection mask from a list of register names 
+ *
+ * @param set 	struct pcie_regset* the names refer to 
+ * @param names Comma separated list of register names, e.g. "vendor,device"
+ * @return 		Mask for pcie_reg_decode(). Unknown names are ignored
+ */
+__u64 pcie_reg_mask(const struct pcie_regset *set, const char *names)
+{
+	const char *end;
+	unsigned i;
+	size_t n;
+	__u64 mask;
+
+	mask = 0;
+	while (names != NULL && *names)
+	{
+		end = strchr(names, ',');
+		n = end ? (size_t) (end - names) : strlen(names);
+
+		for (i = 0 ; i < set->num ; i++)
+			if (strncmp(set->reg[i].name, names, n) == 0 && set->reg[i].name[n] == 0)
+				mask |= 1ULL << i;
+
+		names = end ? end + 1 : NULL;
+	}
+	return mask;
+}
+
+/**
+ * Decode the selected registers of a register set 
+ *
+ * This is the single loop that drives formatting, diffing and serialization.
+ * Registers not present in select are skipped without being read. 
+ *
+ * @param set 		struct pcie_regset* describing the block 
+ * @param base 		__u8* to the start of the block, e.g. config space or a Capability
+ * @param select 	Bitmask of register indexes to decode. PCIE_REG_ALL for all 
+ * @param fn 		Callback invoked once per selected register in offset order
+ * @param ctx 		Opaque pointer passed through to the callback
+ * @return 			0 upon success, -1 if a parameter is NULL, or the first non zero 
+ * 					callback return value
+ */
+int pcie_reg_decode(const struct pcie_regset *set, __u8 *base, __u64 select, pcie_reg_fn fn, void *ctx)
+{
+	unsigned i;
+	int rv;
+
+	if (set == NULL || base == NULL || fn == NULL)
+		return -1;
+
+	for (i = 0 ; i < set->num && select ; i++, select >>= 1)
+	{
+		if (!(select & 1))
+			continue;
+
+		rv = fn(ctx, &set->reg[i], pcie_reg_read(&set->reg[i], base));
+		if (rv != 0)
+			return rv;
+	}
+	return 0;
+}
@@ -0,0 +1,344 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		sink.c
+ *
+ * @brief 		Code file for output sinks
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * A sink is the destination of formatted output. The built in kinds are:
+ *
+ * PCSK_FN 		Hands every write to a caller supplied pcie_writer
+ * PCSK_FD 		Copies writes into a caller supplied buffer and writes it to a
+ * 				file descriptor when full, together with the write that did not
+ * 				fit, in one writev()
+ * PCSK_MEM 	Appends to a buffer that grows as needed. The output stays in
+ * 				s->buf until the caller consumes it or flushes it with
+ * 				pcie_sink_flushv()
+ * PCSK_NULL 	Discards everything. Useful to measure output size or cost
+ *
+ * Errors are sticky: once a write fails every later write fails too, so a
+ * caller may check only the final return value.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* realloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memset()
+ * memcpy()
+ */
+#include <string.h>
+
+/* writev()
+ * struct iovec
+ */
+#include <sys/uio.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_SINK_MEM_MIN 	4096 	//!< First allocation of a memory sink
+#define PCIE_SINK_IOV 		64 		//!< iovecs passed to one writev() by pcie_sink_flushv(). IOV_MAX is 1024 on Linux
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Write a set of buffers to a file descriptor, retrying partial writes
+ *
+ * iov is modified as the buffers are consumed
+ *
+ * @return 	0 upon success, -1 upon error with errno set
+ */
+static int pcie_sink_writev(int fd, struct iovec *iov, int n)
+{
+	ssize_t rv;
+	size_t done;
+
+	while (n > 0)
+	{
+		rv = writev(fd, iov, n);
+		if (rv < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		// Skip the buffers written in full and trim the first partial one
+		done = rv;
+		while (n > 0 && done >= iov->iov_len) {
+			done -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n > 0) {
+			iov->iov_base = (char*) iov->iov_base + done;
+			iov->iov_len -= done;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Initialize a sink that passes every write to a pcie_writer callback
+ *
+ * @param s 	struct pcie_sink* to initialize
+ * @param fn 	pcie_writer callback
+ * @param ctx 	Opaque pointer passed through to the callback
+ */
+void pcie_sink_fn(struct pcie_sink *s, pcie_writer fn, void *ctx)
+{
+	memset(s, 0, sizeof(*s));
+	s->type = PCSK_FN;
+	s->fn = fn;
+	s->ctx = ctx;
+	s->fd = -1;
+}
+
+/**
+ * Initialize a buffered file descriptor sink
+ *
+ * Output is held in buf until it fills or pcie_sink_flush() is called
+ *
+ * @param s 	struct pcie_sink* to initialize
+ * @param fd 	File descriptor to write to. Not closed by the sink
+ * @param buf 	char* to a caller supplied buffer, or NULL for unbuffered writes
+ * @param len 	Size of buf in bytes
+ */
+void pcie_sink_fd(struct pcie_sink *s, int fd, char *buf, size_t len)
+{
+	memset(s, 0, sizeof(*s));
+	s->type = PCSK_FD;
+	s->fd = fd;
+	s->buf = buf;
+	s->len = (buf != NULL) ? len : 0;
+}
+
+/**
+ * Initialize a growable memory sink. Release with pcie_sink_free()
+ *
+ * @param s 	struct pcie_sink* to initialize
+ */
+void pcie_sink_mem(struct pcie_sink *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->type = PCSK_MEM;
+	s->fd = -1;
+}
+
+/**
+ * Initialize a sink that discards its input
+ *
+ * @param s 	struct pcie_sink* to initialize
+ */
+void pcie_sink_null(struct pcie_sink *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->type = PCSK_NULL;
+	s->fd = -1;
+}
+
+/**
+ * Make room for n more bytes in a memory sink
+ */
+static int pcie_sink_grow(struct pcie_sink *s, size_t n)
+{
+	size_t len;
+	char *buf;
+
+	len = (s->len > 0) ? s->len : PCIE_SINK_MEM_MIN;
+	while (len - s->pos < n) {
+		if (len > ((size_t) -1) / 2) {
+			errno = ENOMEM;
+			return -1;
+		}
+		len *= 2;
+	}
+
+	buf = realloc(s->buf, len);
+	if (buf == NULL)
+		return -1;
+
+	s->buf = buf;
+	s->len = len;
+	return 0;
+}
+
+/**
+ * Write bytes to a sink
+ *
+ * @param s 	struct pcie_sink* initialized with one of the pcie_sink_<type>() functions
+ * @param buf 	char* to the bytes to write. Need not be NULL terminated
+ * @param len 	Number of bytes in buf
+ * @return 		0 upon success, -1 if this or an earlier write failed
+ */
+int pcie_sink_write(struct pcie_sink *s, const char *buf, size_t len)
+{
+	struct iovec iov[2];
+
+	s->total += len;
+	if (s->err || len == 0)
+		return s->err;
+
+	switch (s->type)
+	{
+		case PCSK_FN:
+			if (s->fn(s->ctx, buf, len) != 0)
+				s->err = -1;
+			break;
+
+		case PCSK_FD:
+			if (len <= s->len - s->pos) {
+				memcpy(s->buf + s->pos, buf, len);
+				s->pos += len;
+				break;
+			}
+			iov[0].iov_base = s->buf;
+			iov[0].iov_len = s->pos;
+			iov[1].iov_base = (char*) buf;
+			iov[1].iov_len = len;
+			if (pcie_sink_writev(s->fd, (s->pos > 0) ? iov : &iov[1], (s->pos > 0) ? 2 : 1) != 0)
+				s->err = -1;
+			s->pos = 0;
+			break;
+
+		case PCSK_MEM:
+			if (len > s->len - s->pos && pcie_sink_grow(s, len) != 0) {
+				s->err = -1;
+				break;
+			}
+			memcpy(s->buf + s->pos, buf, len);
+			s->pos += len;
+			break;
+
+		case PCSK_NULL:
+			break;
+
+		default:
+			errno = EINVAL;
+			s->err = -1;
+			break;
+	}
+	return s->err;
+}
+
+/**
+ * pcie_writer adaptor so that a sink can be passed to pcie_wr_cfgspace() and
+ * any other function that takes a writer
+ *
+ * @param sink 	struct pcie_sink*
+ */
+int pcie_sink_wr(void *sink, const char *buf, size_t len)
+{
+	return pcie_sink_write(sink, buf, len);
+}
+
+/**
+ * Write out any output held by a file descriptor sink
+ *
+ * Memory sinks keep their contents; see pcie_sink_flushv()
+ *
+ * @return 	0 upon success, -1 if this or an earlier write failed
+ */
+int pcie_sink_flush(struct pcie_sink *s)
+{
+	struct iovec iov;
+
+	if (s->err || s->type != PCSK_FD || s->pos == 0)
+		return s->err;
+
+	iov.iov_base = s->buf;
+	iov.iov_len = s->pos;
+	if (pcie_sink_writev(s->fd, &iov, 1) != 0)
+		s->err = -1;
+	s->pos = 0;
+	return s->err;
+}
+
+/**
+ * Write the buffered output of several sinks to a file descriptor, in order
+ *
+ * Intended for workers that each render into their own memory sink: the
+ * results are written with as few writev() calls as possible, with no copy
+ * and no lock held while rendering. The buffers are emptied but kept for
+ * reuse. Sinks without buffered output are skipped.
+ *
+ * @param fd 	File descriptor to write to
+ * @param s 	struct pcie_sink* array of num PCSK_MEM or PCSK_FD sinks
+ * @param num 	Number of sinks
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_sink_flushv(int fd, struct pcie_sink *s, unsigned num)
+{
+	struct iovec iov[PCIE_SINK_IOV];
+	unsigned i, start;
+	int n;
+
+	if (s == NULL && num > 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (start = 0 ; start < num ; start = i)
+	{
+		n = 0;
+		for (i = start ; i < num && n < PCIE_SINK_IOV ; i++)
+		{
+			if (s[i].pos == 0)
+				continue;
+			iov[n].iov_base = s[i].buf;
+			iov[n].iov_len = s[i].pos;
+			n++;
+		}
+
+		if (pcie_sink_writev(fd, iov, n) != 0)
+			return -1;
+
+		while (start < i)
+			s[start++].pos = 0;
+	}
+	return 0;
+}
+
+/**
+ * Release a sink
+ *
+ * Flushes a file descriptor sink and frees the buffer of a memory sink
+ *
+ * @return 	0 upon success, -1 if this or an earlier write failed
+ */
+int pcie_sink_free(struct pcie_sink *s)
+{
+	int rv;
+
+	if (s == NULL)
+		return 0;
+
+	rv = pcie_sink_flush(s);
+	if (s->type == PCSK_MEM)
+		free(s->buf);
+
+	s->buf = NULL;
+	s->len = 0;
+	s->pos = 0;
+	return rv;
+}
@@ -0,0 +1,455 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		snapshot.c
+ *
+ * @brief 		Code file for the PCIe Config space snapshot file format
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ * 
+ * A snapshot file has the following layout. Fields are stored in the byte 
+ * order of the host that wrote the file. A file from a host of the other byte 
+ * order fails the magic check in pcie_snap_open(). 
+ *
+ * Offset 			Contents
+ * 0 				struct pcie_snap_hdr 
+ * index_off 		struct pcie_snap_ent[num], sorted by ascending BDF 
+ * data_off 		num config space images of PCLN_CFG bytes each, in index order
+ *
+ * data_off and every image are aligned to PCLN_CFG so that an image can be
+ * used directly from a mapping of the file.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* open()
+ */
+#include <fcntl.h>
+
+/* malloc()
+ * free()
+ * qsort()
+ */
+#include <stdlib.h>
+
+/* memset()
+ * memcpy()
+ */
+#include <string.h>
+
+/* mmap()
+ * munmap()
+ */
+#include <sys/mman.h>
+
+/* fstat()
+ */
+#include <sys/stat.h>
+
+/* close()
+ * lseek()
+ * write()
+ */
+#include <unistd.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_SNAP_ALIGN(x) 	(((x) + PCLN_CFG - 1) & ~((__u64) PCLN_CFG - 1))
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * qsort() comparison of two index entries by BDF 
+ */
+static int pcie_snap_cmp(const void *a, const void *b)
+{
+	const struct pcie_snap_ent *x = a;
+	const struct pcie_snap_ent *y = b;
+
+	return (x->bdf > y->bdf) - (x->bdf < y->bdf);
+}
+
+/**
+ * Write all of a buffer to a file descriptor 
+ */
+static int pcie_snap_wr(int fd, const void *buf, size_t len)
+{
+	const __u8 *p = buf;
+	ssize_t rv;
+
+	while (len > 0) 
+	{
+		rv = write(fd, p, len);
+		if (rv < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p += rv;
+		len -= rv;
+	}
+	return 0;
+}
+
+/**
+ * Write a set of config space images to a snapshot file 
+ *
+ * The images are written in BDF order regardless of the order in which they
+ * are passed in. 
+ *
+ * @param path 		Path of the file to create. An existing file is replaced
+ * @param bdfs 		__u32* array of num BDFs. See PCIE_BDF()
+ * @param images 	__u8* to num contiguous images of PCLN_CFG bytes each 
+ * @param num 		Number of images
+ * @param time 		Capture time stored in the header, e.g. seconds since epoch
+ * @return 			0 upon success, -1 upon error with errno set
+ */
+int pcie_snap_write(const char *path, __u32 *bdfs, __u8 *images, unsigned num, __u64 time)
+{
+	struct pcie_snap_hdr *hdr;
+	struct pcie_snap_ent *ent;
+	__u8 *meta;
+	__u64 index_len, data_off;
+	unsigned i, src;
+	int fd, rv;
+
+	if (path == NULL || (num > 0 && (bdfs == NULL || images == NULL))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	index_len = (__u64) num * sizeof(*ent);
+	data_off = PCIE_SNAP_ALIGN(sizeof(*hdr) + index_len);
+
+	// Header and index are built in one buffer padded out to the first image
+	meta = calloc(1, data_off);
+	if (meta == NULL)
+		return -1;
+
+	hdr = (struct pcie_snap_hdr*) meta;
+	ent = (struct pcie_snap_ent*) (meta + sizeof(*hdr));
+
+	// Sort by BDF keeping the source image number in off until it is assigned
+	for (i = 0 ; i < num ; i++) {
+		ent[i].bdf = bdfs[i];
+		ent[i].len = PCLN_CFG;
+		ent[i].off = i;
+	}
+	qsort(ent, num, sizeof(*ent), pcie_snap_cmp);
+
+	hdr->magic 		= PCSN_MAGIC;
+	hdr->version 	= PCSN_VERSION;
+	hdr->hdr_len 	= sizeof(*hdr);
+	hdr->num 		= num;
+	hdr->index_off 	= sizeof(*hdr);
+	hdr->data_off 	= data_off;
+	hdr->file_len 	= data_off + (__u64) num * PCLN_CFG;
+	hdr->time 		= time;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		free(meta);
+		return -1;
+	}
+
+	// The image order is needed after the offsets are filled in so write the 
+	// images first and the header and index last
+	rv = 0;
+	if (lseek(fd, data_off, SEEK_SET) < 0)
+		rv = -1;
+	for (i = 0 ; rv == 0 && i < num ; i++) {
+		src = ent[i].off;
+		ent[i].off = data_off + (__u64) i * PCLN_CFG;
+		rv = pcie_snap_wr(fd, &images[(size_t) src * PCLN_CFG], PCLN_CFG);
+	}
+	if (rv == 0 && lseek(fd, 0, SEEK_SET) < 0)
+		rv = -1;
+	if (rv == 0)
+		rv = pcie_snap_wr(fd, meta, data_off);
+
+	free(meta);
+
+	if (close(fd) != 0)
+		rv = -1;
+	return rv;
+}
+
+/**
+ * Start writing a snapshot file of a known number of images 
+ *
+ * Images are then added in ascending BDF order with pcie_snap_append() so that
+ * a snapshot larger than memory can be written in pieces. 
+ *
+ * @param w 		struct pcie_snap_wr* to initialize
+ * @param path 		Path of the file to create. An existing file is replaced
+ * @param num 		Number of images that will be appended
+ * @param time 		Capture time stored in the header, e.g. seconds since epoch
+ * @return 			0 upon success, -1 upon error with errno set
+ */
+int pcie_snap_create(struct pcie_snap_wr *w, const char *path, unsigned num, __u64 time)
+{
+	struct pcie_snap_hdr *hdr;
+
+	if (w == NULL || path == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(w, 0, sizeof(*w));
+	w->num = num;
+	w->data_off = PCIE_SNAP_ALIGN(sizeof(*hdr) + (__u64) num * sizeof(struct pcie_snap_ent));
+
+	w->meta = calloc(1, w->data_off);
+	if (w->meta == NULL)
+		return -1;
+
+	hdr = (struct pcie_snap_hdr*) w->meta;
+	hdr->magic 		= PCSN_MAGIC;
+	hdr->version 	= PCSN_VERSION;
+	hdr->hdr_len 	= sizeof(*hdr);
+	hdr->num 		= num;
+	hdr->index_off 	= sizeof(*hdr);
+	hdr->data_off 	= w->data_off;
+	hdr->file_len 	= w->data_off + (__u64) num * PCLN_CFG;
+	hdr->time 		= time;
+
+	w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (w->fd < 0 || lseek(w->fd, w->data_off, SEEK_SET) < 0) {
+		if (w->fd >= 0)
+			close(w->fd);
+		free(w->meta);
+		w->meta = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Append images to a snapshot file started with pcie_snap_create()
+ *
+ * @param w 		struct pcie_snap_wr*
+ * @param bdfs 		__u32* array of n BDFs, ascending and above any appended before
+ * @param images 	__u8* to n contiguous images of PCLN_CFG bytes each 
+ * @param n 		Number of images
+ * @return 			0 upon success, -1 upon error with errno set
+ */
+int pcie_snap_append(struct pcie_snap_wr *w, __u32 *bdfs, __u8 *images, unsigned n)
+{
+	struct pcie_snap_ent *ent;
+	unsigned i;
+
+	if (w == NULL || w->meta == NULL || (n > 0 && (bdfs == NULL || images == NULL))) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (w->err != 0 || n > w->num - w->pos) {
+		errno = (w->err != 0) ? EIO : ENOSPC;
+		return -1;
+	}
+
+	ent = (struct pcie_snap_ent*) (w->meta + sizeof(struct pcie_snap_hdr));
+	for (i = 0 ; i < n ; i++)
+	{
+		if (w->pos + i > 0 && bdfs[i] <= ent[w->pos + i - 1].bdf) {
+			errno = EINVAL;
+			return -1;
+		}
+		ent[w->pos + i].bdf = bdfs[i];
+		ent[w->pos + i].len = PCLN_CFG;
+		ent[w->pos + i].off = w->data_off + (__u64) (w->pos + i) * PCLN_CFG;
+	}
+
+	if (pcie_snap_wr(w->fd, images, (size_t) n * PCLN_CFG) != 0) {
+		w->err = -1;
+		return -1;
+	}
+
+	w->pos += n;
+	return 0;
+}
+
+/**
+ * Write the header and index and close a snapshot file 
+ *
+ * @param w 	struct pcie_snap_wr*
+ * @return 		0 upon success, -1 upon error or if fewer images were appended 
+ * 				than declared to pcie_snap_create()
+ */
+int pcie_snap_commit(struct pcie_snap_wr *w)
+{
+	int rv;
+
+	if (w == NULL || w->meta == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	rv = w->err;
+	if (rv == 0 && w->pos != w->num) {
+		errno = EINVAL;
+		rv = -1;
+	}
+	if (rv == 0 && lseek(w->fd, 0, SEEK_SET) < 0)
+		rv = -1;
+	if (rv == 0)
+		rv = pcie_snap_wr(w->fd, w->meta, w->data_off);
+
+	if (close(w->fd) != 0)
+		rv = -1;
+	free(w->meta);
+	memset(w, 0, sizeof(*w));
+	w->fd = -1;
+	return rv;
+}
+
+/**
+ * Open and map a snapshot file 
+ *
+ * Only the header is checked. Nothing is parsed or copied; index entries and
+ * images are used in place from the read only mapping. 
+ *
+ * @param snap 	struct pcie_snap* to fill in 
+ * @param path 	Path of the snapshot file
+ * @return 		0 upon success, -1 upon error with errno set
+ */
+int pcie_snap_open(struct pcie_snap *snap, const char *path)
+{
+	struct pcie_snap_hdr *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (snap == NULL || path == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(snap, 0, sizeof(*snap));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	if ((size_t) st.st_size < sizeof(*hdr)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	hdr = map;
+	if (hdr->magic != PCSN_MAGIC 
+		|| hdr->version != PCSN_VERSION 
+		|| hdr->hdr_len < sizeof(*hdr)
+		|| hdr->file_len > (__u64) st.st_size
+		|| hdr->index_off > hdr->file_len
+		|| hdr->num > (hdr->file_len - hdr->index_off) / sizeof(struct pcie_snap_ent)
+		|| hdr->data_off > hdr->file_len
+		|| hdr->data_off % PCLN_CFG != 0)
+	{
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	snap->map = map;
+	snap->len = st.st_size;
+	snap->hdr = hdr;
+	snap->ent = (struct pcie_snap_ent*) ((__u8*) map + hdr->index_off);
+	snap->num = hdr->num;
+
+	return 0;
+}
+
+/**
+ * Unmap a snapshot opened with pcie_snap_open()
+ */
+void pcie_snap_close(struct pcie_snap *snap)
+{
+	if (snap == NULL || snap->map == NULL)
+		return;
+
+	munmap(snap->map, snap->len);
+	memset(snap, 0, sizeof(*snap));
+}
+
+/**
+ * Return a pointer to the config space image of index entry i 
+ *
+ * @param snap 	struct pcie_snap* opened with pcie_snap_open()
+ * @param i 	Index entry number. Entries are in ascending BDF order
+ * @return 		__u8* into the mapping, or NULL if i or the entry is out of range 
+ * 				or the entry is not an aligned image in the data area
+ */
+__u8 *pcie_snap_cfg(struct pcie_snap *snap, unsigned i)
+{
+	struct pcie_snap_ent *e;
+	__u64 len;
+
+	if (snap == NULL || i >= snap->num)
+		return NULL;
+
+	e = &snap->ent[i];
+	len = snap->hdr->file_len;
+	if (len < PCLN_CFG 
+		|| e->off > len - PCLN_CFG
+		|| e->off < snap->hdr->data_off
+		|| e->off % PCLN_CFG != 0)
+		return NULL;
+
+	return (__u8*) snap->map + e->off;
+}
+
+/**
+ * Find a device in a snapshot by BDF 
+ *
+ * @param snap 	struct pcie_snap* opened with pcie_snap_open()
+ * @param bdf 	BDF of the device. See PCIE_BDF()
+ * @return 		struct pcie_cfg_hdr* into the mapping, or NULL if not present
+ */
+struct pcie_cfg_hdr *pcie_snap_find(struct pcie_snap *snap, __u32 bdf)
+{
+	unsigned lo, hi, mid;
+
+	lo = 0;
+	hi = snap->num;
+	while (lo < hi) 
+	{
+		mid = lo + (hi - lo) / 2;
+		if (snap->ent[mid].bdf < bdf)
+			lo = mid + 1;
+		else 
+			hi = mid;
+	}
+
+	if (lo >= snap->num || snap->ent[lo].bdf != bdf)
+		return NULL;
+
+	return (struct pcie_cfg_hdr*) pcie_snap_cfg(snap, lo);
+}
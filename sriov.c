@@ -0,0 +1,331 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		sriov.c
+ *
+ * @brief 		Code file for the SR-IOV Extended Capability
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * The Virtual Functions of a Physical Function are located from the PF config
+ * space alone. VF n has Routing ID PF + First VF Offset + n * VF Stride, which
+ * may carry into the following bus numbers, and the BAR of VF n starts at the
+ * VF BAR base + n * the size of one VF BAR.
+ *
+ * VF BAR sizes are not held in config space. The sizing write / read back
+ * sequence would change the device, so only sizes reported by a VF Resizable
+ * BAR Capability are filled in. Other sizes may be set by the caller, e.g.
+ * from the PF IOV resources the OS reports, before pcie_sriov_footprint() or
+ * pcie_sriov_vf_bar() are used.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* memset()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define PCIE_SRIOV_LEN 			0x40 		//!< Length of the SR-IOV Capability including the header
+#define PCIE_SRIOV_BARS 		6 			//!< Number of VF BARs
+#define PCIE_SRIOV_BAR_64 		0x4 		//!< VF BAR bits [2:1]: 64-bit decoder
+#define PCIE_SRIOV_BAR_PREFETCH 0x8 		//!< VF BAR bit 3: prefetchable
+#define PCIE_SRIOV_BAR_MASK 	0xFull 		//!< VF BAR bits that are not part of the address
+#define PCIE_REBAR_LEN 			0x0C 		//!< Length of a Resizable BAR Capability with one BAR
+#define PCIE_REBAR_ENTRY 		0x08 		//!< Length of the Capability / Control pair of one BAR
+#define PCIE_REBAR_SIZE_MAX 	43 			//!< Largest BAR Size encoding that fits in 64 bits
+#define PCIE_RID_MAX 			0xFFFF 		//!< Largest Routing ID
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Fill in the VF BAR sizes reported by a VF Resizable BAR Capability
+ */
+static void pcie_sriov_rebar(struct pcie_sriov *s, __u8 *cfgspace)
+{
+	unsigned i, n, idx, size;
+	__u8 *p;
+
+	if (s->rebar_off < PCIE_ECAP_START || s->rebar_off > PCLN_CFG - PCIE_REBAR_LEN)
+		return;
+
+	p = &cfgspace[s->rebar_off];
+	n = pcie_get_rebar_nbar(p);
+	for (i = 0 ; i < n && i < PCIE_SRIOV_BARS ; i++)
+	{
+		if (s->rebar_off + PCIE_REBAR_LEN + i * PCIE_REBAR_ENTRY > PCLN_CFG)
+			break;
+
+		idx = pcie_get_rebar_idx(&p[i * PCIE_REBAR_ENTRY]);
+		size = pcie_get_rebar_size(&p[i * PCIE_REBAR_ENTRY]);
+		if (idx >= PCIE_SRIOV_BARS || s->bar[idx].upper || size > PCIE_REBAR_SIZE_MAX)
+			continue;
+
+		// BAR Size 0 is 1 MB
+		s->bar[idx].size = 1ull << (size + 20);
+	}
+}
+
+/**
+ * Decode an SR-IOV Extended Capability
+ *
+ * @param s 		struct pcie_sriov* to fill in
+ * @param cfgspace 	__u8* to a buffer with the PCIe cfg space (PCLN_CFG bytes)
+ * @param off 		Offset of the Capability, or 0 to find it
+ * @return 			0 upon success, -1 if the Capability is not present
+ */
+int pcie_sriov_decode(struct pcie_sriov *s, __u8 *cfgspace, unsigned off)
+{
+	struct pcie_cap_index idx;
+	unsigned i;
+	__u32 lo, hi, sps;
+	__u8 *p;
+
+	if (s == NULL || cfgspace == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	pcie_cap_index_build(&idx, cfgspace);
+	if (off == 0)
+		off = pcie_ecap_find(&idx, PCEC_SRIOV);
+	if (off < PCIE_ECAP_START || off > PCLN_CFG - PCIE_SRIOV_LEN) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	p = &cfgspace[off];
+
+	memset(s, 0, sizeof(*s));
+
+	s->off 			= off;
+	s->ver 			= pcie_get_ecap_ver(p);
+	s->cap 			= pcie_get_sriov_cap(p);
+	s->ctrl 		= pcie_get_sriov_ctrl(p);
+	s->status 		= pcie_get_sriov_status(p);
+	s->vf_enable 	= pcie_get_sriov_vf_enable(p);
+	s->vf_mse 		= pcie_get_sriov_vf_mse(p);
+	s->ari 			= pcie_get_sriov_ari(p);
+	s->fdl 			= pcie_get_sriov_fdl(p);
+	s->initial_vfs 	= pcie_get_sriov_initial(p);
+	s->total_vfs 	= pcie_get_sriov_total(p);
+	s->num_vfs 		= pcie_get_sriov_num(p);
+	s->offset 		= pcie_get_sriov_offset(p);
+	s->stride 		= pcie_get_sriov_stride(p);
+	s->vf_device 	= pcie_get_sriov_vf_device(p);
+	s->page_sizes 	= pcie_get_sriov_page_sizes(p);
+	s->migration 	= pcie_get_sriov_migration(p);
+	s->rebar_off 	= pcie_ecap_find(&idx, PCEC_VF_REBAR);
+
+	// Exactly one bit should be set. Take the smallest if software set more
+	sps = pcie_get_sriov_page_size(p);
+	if (sps != 0)
+		s->page_size = 4096ull << __builtin_ctz(sps);
+
+	// VF BARs are memory BARs only, so bit 0 carries no meaning
+	for (i = 0 ; i < PCIE_SRIOV_BARS ; i++)
+	{
+		if (s->bar[i].upper)
+			continue;
+
+		lo = pcie_le32(&p[0x24 + i * 4]);
+		s->bar[i].base = lo & ~PCIE_SRIOV_BAR_MASK;
+		s->bar[i].prefetch = (lo & PCIE_SRIOV_BAR_PREFETCH) != 0;
+		if ((lo & 0x6) == PCIE_SRIOV_BAR_64 && i + 1 < PCIE_SRIOV_BARS)
+		{
+			hi = pcie_le32(&p[0x24 + (i + 1) * 4]);
+			s->bar[i].base |= (__u64) hi << 32;
+			s->bar[i].is64 = 1;
+			s->bar[i + 1].upper = 1;
+		}
+	}
+
+	pcie_sriov_rebar(s, cfgspace);
+
+	return 0;
+}
+
+/**
+ * Compute the BDFs of the VFs of a PF
+ *
+ * The NumVFs VFs the current settings describe are returned whether or not
+ * VF Enable is set
+ *
+ * @param s 	struct pcie_sriov* decoded from the config space of the PF
+ * @param pf 	BDF of the PF. See PCIE_BDF()
+ * @param out 	__u32* array of max entries to receive the VF BDFs in VF
+ * 				order. May be NULL if max is 0
+ * @param max 	Number of entries in out
+ * @return 		Number of VFs, which may be more than max, or -1 upon error
+ * 				with errno set. EINVAL if the offset and stride are zero or
+ * 				place a VF past the last bus
+ */
+long pcie_sriov_vfs(const struct pcie_sriov *s, __u32 pf, __u32 *out, unsigned max)
+{
+	unsigned i, rid, n;
+
+	if (s == NULL || (out == NULL && max > 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	n = s->num_vfs;
+	if (n == 0)
+		return 0;
+
+	rid = (pf & PCIE_RID_MAX) + s->offset;
+	if (s->offset == 0 || (n > 1 && s->stride == 0)
+		|| rid + (n - 1) * s->stride > PCIE_RID_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// The segment does not change. Routing IDs carry from devfn into the bus
+	for (i = 0 ; i < n && i < max ; i++)
+		out[i] = (pf & ~PCIE_RID_MAX) | (rid + i * s->stride);
+
+	return n;
+}
+
+/**
+ * Return the address of a BAR of one VF
+ *
+ * @param s 	struct pcie_sriov* decoded from the config space of the PF
+ * @param vf 	VF number, 0 to NumVFs - 1
+ * @param bar 	VF BAR number, 0 to 5
+ * @return 		Address or 0 if the VF or BAR does not exist or its size is
+ * 				unknown
+ */
+__u64 pcie_sriov_vf_bar(const struct pcie_sriov *s, unsigned vf, unsigned bar)
+{
+	if (s == NULL || vf >= s->num_vfs || bar >= PCIE_SRIOV_BARS)
+		return 0;
+	if (s->bar[bar].upper || s->bar[bar].size == 0 || s->bar[bar].base == 0)
+		return 0;
+	return s->bar[bar].base + vf * s->bar[bar].size;
+}
+
+/**
+ * Return the memory the VF BARs of a PF decode
+ *
+ * BARs with an unknown size count as 0 bytes
+ *
+ * @param s 		struct pcie_sriov* decoded from the config space of the PF
+ * @param per_vf 	__u64* to receive the size of the BARs of one VF. May be NULL
+ * @return 			Size of the BARs of all NumVFs VFs in bytes
+ */
+__u64 pcie_sriov_footprint(const struct pcie_sriov *s, __u64 *per_vf)
+{
+	__u64 sum;
+	unsigned i;
+
+	sum = 0;
+	if (s != NULL)
+		for (i = 0 ; i < PCIE_SRIOV_BARS ; i++)
+			if (!s->bar[i].upper)
+				sum += s->bar[i].size;
+
+	if (per_vf != NULL)
+		*per_vf = sum;
+	return (s != NULL) ? sum * s->num_vfs : 0;
+}
+
+/**
+ * Compute the BDFs of the enabled VFs of every PF in a batch
+ *
+ * PFs without VF Enable set and PFs whose offset and stride are invalid are
+ * skipped. See pcie_sriov_vfs()
+ *
+ * @param bdfs 		__u32* array of num BDFs. See PCIE_BDF()
+ * @param images 	__u8* to num contiguous images of PCLN_CFG bytes each
+ * @param num 		Number of images
+ * @param out 		__u32* array of max entries to receive the VF BDFs, grouped
+ * 					by PF in input order. May be NULL if max is 0
+ * @param max 		Number of entries in out
+ * @return 			Number of VFs, which may be more than max, or -1 upon error
+ * 					with errno set
+ */
+long pcie_sriov_scan(__u32 *bdfs, __u8 *images, unsigned num, __u32 *out, unsigned max)
+{
+	struct pcie_sriov s;
+	unsigned i;
+	long cnt, n;
+
+	if ((num > 0 && (bdfs == NULL || images == NULL)) || (out == NULL && max > 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	cnt = 0;
+	for (i = 0 ; i < num ; i++)
+	{
+		if (pcie_sriov_decode(&s, &images[(size_t) i * PCLN_CFG], 0) != 0 || !s.vf_enable)
+			continue;
+
+		if (cnt < max)
+			n = pcie_sriov_vfs(&s, bdfs[i], &out[cnt], max - cnt);
+		else
+			n = pcie_sriov_vfs(&s, bdfs[i], NULL, 0);
+
+		if (n > 0)
+			cnt += n;
+	}
+
+	return cnt;
+}
+
+/**
+ * Compute the BDFs of the enabled VFs of every PF in a snapshot
+ *
+ * @param snap 	struct pcie_snap* opened with pcie_snap_open()
+ * @param out 	__u32* array of max entries. May be NULL if max is 0
+ * @param max 	Number of entries in out
+ * @return 		Number of VFs or -1 upon error with errno set
+ */
+long pcie_sriov_scan_snap(struct pcie_snap *snap, __u32 *out, unsigned max)
+{
+	struct pcie_sriov s;
+	__u8 *cfg;
+	unsigned i;
+	long cnt, n;
+
+	if (snap == NULL || (out == NULL && max > 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	cnt = 0;
+	for (i = 0 ; i < snap->num ; i++)
+	{
+		cfg = pcie_snap_cfg(snap, i);
+		if (cfg == NULL || pcie_sriov_decode(&s, cfg, 0) != 0 || !s.vf_enable)
+			continue;
+
+		if (cnt < max)
+			n = pcie_sriov_vfs(&s, snap->ent[i].bdf, &out[cnt], max - cnt);
+		else
+			n = pcie_sriov_vfs(&s, snap->ent[i].bdf, NULL, 0);
+
+		if (n > 0)
+			cnt += n;
+	}
+
+	return cnt;
+}
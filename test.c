@@ -0,0 +1,1329 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		test.c
+ *
+ * @brief 		Regression tests for the PCI Utility Functions library
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Usage: testsuite [filter]
+ *
+ * Each test builds its input images by hand or from a small pcie_gen corpus,
+ * so every run uses the same images. The file format tests write a valid
+ * file, then patch single header or index fields in place to check that the
+ * parsers reject them. Only tests whose name contains filter are run. The
+ * exit status is the number of failed tests.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* open()
+ */
+#include <fcntl.h>
+
+/* offsetof()
+ */
+#include <stddef.h>
+
+/* printf()
+ * fprintf()
+ * snprintf()
+ * fopen()
+ * fread()
+ * fputs()
+ * fclose()
+ */
+#include <stdio.h>
+
+/* calloc()
+ * malloc()
+ * free()
+ * mkstemp()
+ */
+#include <stdlib.h>
+
+/* memset()
+ * memcpy()
+ * memcmp()
+ * strcmp()
+ * strcpy()
+ * strstr()
+ * strlen()
+ */
+#include <string.h>
+
+/* close()
+ * pread()
+ * pwrite()
+ * unlink()
+ */
+#include <unistd.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+#define TEST_IMAGES 	8 			//!< Number of images in the corpus
+#define TEST_SEED 		0x5043 		//!< Corpus seed
+
+/**
+ * Fail the running test if cond is false
+ */
+#define TEST_CHECK(cond) 												\
+	do { 																\
+		if (!(cond)) { 													\
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			return -1; 													\
+		} 																\
+	} while (0)
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * State shared by all tests
+ */
+struct test_ctx
+{
+	__u8 images[TEST_IMAGES * PCLN_CFG]; 	//!< Corpus of TEST_IMAGES images
+	__u32 bdfs[TEST_IMAGES]; 				//!< BDF of each image, ascending
+	char path[32]; 							//!< Temporary file for the file format tests
+};
+
+/**
+ * One test
+ */
+struct test
+{
+	const char *name; 					//!< Name used in the report and by the filter
+	int (*fn)(struct test_ctx *c); 		//!< Return 0 if the test passed
+};
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Fill in the header of a hand built image
+ *
+ * A bridge (type 1) gets the secondary and subordinate bus numbers, anything
+ * else ignores them
+ */
+static void test_dev(__u8 *img, unsigned type, unsigned sec, unsigned sub)
+{
+	memset(img, 0, PCLN_CFG);
+	img[0x00] = 0x86;
+	img[0x01] = 0x80;
+	img[0x0E] = type;
+	if (type == 1) {
+		img[0x0B] = PCBC_BRIDGE;
+		img[0x0A] = PCBD_PPB;
+		img[0x19] = sec;
+		img[0x1A] = sub;
+	}
+}
+
+/**
+ * Add a Capability to a hand built image
+ *
+ * The Capability is linked in at the head of the chain
+ */
+static void test_cap(__u8 *img, unsigned off, unsigned id)
+{
+	img[0x06] |= 0x10;
+	img[off] = id;
+	img[off + 1] = img[0x34];
+	img[0x34] = off;
+}
+
+/**
+ * Add a version 1 PCI Express Capability at 0x40 of a hand built image
+ *
+ * mps and mrrs are encoded sizes (0 = 128 bytes). max and cur hold the Link
+ * Speed in bits [3:0] and the Link Width in bits [9:4]
+ */
+static void test_exp(__u8 *img, unsigned type, unsigned mps, unsigned mrrs, unsigned max, unsigned cur)
+{
+	test_cap(img, 0x40, PCAP_EXP);
+	img[0x42] = (type << 4) | 1;
+	img[0x44] = 5;
+	img[0x48] = mps << 5;
+	img[0x49] = mrrs << 4;
+	img[0x4C] = max & 0xFF;
+	img[0x4D] = max >> 8;
+	img[0x52] = cur & 0xFF;
+	img[0x53] = cur >> 8;
+}
+
+/**
+ * Functions hang off the bridge whose secondary bus they are on, in input
+ * order, and bridges with impossible bus numbers are flagged
+ */
+static int test_topo_tree(struct test_ctx *c)
+{
+	struct pcie_topo t;
+	struct pcie_topo_node *n;
+	__u8 img[5 * PCLN_CFG];
+	__u32 bdfs[5];
+
+	(void) c;
+
+	// Root port 00:01.0 -> switch 01:00.0 -> endpoint 02:00.0. Endpoints 00:02.0 and 02:00.1
+	bdfs[0] = PCIE_BDF(0, 0, 1, 0); 	test_dev(&img[0 * PCLN_CFG], 1, 1, 2);
+	bdfs[1] = PCIE_BDF(0, 1, 0, 0); 	test_dev(&img[1 * PCLN_CFG], 1, 2, 2);
+	bdfs[2] = PCIE_BDF(0, 2, 0, 0); 	test_dev(&img[2 * PCLN_CFG], 0, 0, 0);
+	bdfs[3] = PCIE_BDF(0, 0, 2, 0); 	test_dev(&img[3 * PCLN_CFG], 0, 0, 0);
+	bdfs[4] = PCIE_BDF(0, 2, 0, 1); 	test_dev(&img[4 * PCLN_CFG], 0, 0, 0);
+
+	TEST_CHECK(pcie_topo_build(&t, bdfs, img, 5) == 0);
+	TEST_CHECK(t.flags == 0);
+
+	n = pcie_topo_find(&t, PCIE_BDF(0, 2, 0, 1));
+	TEST_CHECK(n != NULL && n->cfg == &img[4 * PCLN_CFG]);
+	n = pcie_topo_parent(&t, n);
+	TEST_CHECK(n != NULL && n->bdf == bdfs[1] && n->sec == 2 && n->sub == 2);
+	n = pcie_topo_parent(&t, n);
+	TEST_CHECK(n != NULL && n->bdf == bdfs[0]);
+	TEST_CHECK(pcie_topo_parent(&t, n) == NULL);
+
+	// Children of the switch in input order
+	n = pcie_topo_child(&t, pcie_topo_find(&t, bdfs[1]));
+	TEST_CHECK(n != NULL && n->bdf == bdfs[2]);
+	n = pcie_topo_next(&t, n);
+	TEST_CHECK(n != NULL && n->bdf == bdfs[4]);
+	TEST_CHECK(pcie_topo_next(&t, n) == NULL);
+
+	// Root bus: the root port then the endpoint
+	n = pcie_topo_find(&t, bdfs[3]);
+	TEST_CHECK(n != NULL && pcie_topo_parent(&t, n) == NULL && pcie_topo_child(&t, n) == NULL);
+	TEST_CHECK(pcie_topo_find(&t, PCIE_BDF(0, 3, 0, 0)) == NULL);
+	pcie_topo_free(&t);
+
+	// A bridge whose secondary bus is its own bus owns nothing
+	img[1 * PCLN_CFG + 0x19] = 1;
+	TEST_CHECK(pcie_topo_build(&t, bdfs, img, 5) == 0);
+	TEST_CHECK(t.flags == PCTP_BAD_BUS);
+	TEST_CHECK(pcie_topo_parent(&t, pcie_topo_find(&t, bdfs[2])) == NULL);
+	pcie_topo_free(&t);
+
+	// Two bridges claiming bus 2
+	img[1 * PCLN_CFG + 0x19] = 2;
+	img[0 * PCLN_CFG + 0x19] = 2;
+	TEST_CHECK(pcie_topo_build(&t, bdfs, img, 5) == 0);
+	TEST_CHECK(t.flags & PCTP_DUP_BUS);
+	pcie_topo_free(&t);
+	return 0;
+}
+
+/**
+ * The active mode wins and vectors are summed per bus and for the host
+ */
+static int test_irq_acct(struct test_ctx *c)
+{
+	struct pcie_irq dev[5];
+	struct pcie_irq_sum bus[2], host;
+	struct pcie_msi msi;
+	__u8 img[5 * PCLN_CFG], *p;
+	__u32 bdfs[5];
+
+	(void) c;
+
+	// MSI-X enabled with 16 vectors, MSI present but disabled
+	bdfs[0] = PCIE_BDF(0, 1, 0, 0);
+	p = &img[0 * PCLN_CFG];
+	test_dev(p, 0, 0, 0);
+	test_cap(p, 0x40, PCAP_MSI);
+	p[0x42] = 3 << 1;
+	test_cap(p, 0x50, PCAP_MSIX);
+	p[0x52] = 15;
+	p[0x53] = 0x80;
+
+	// MSI enabled: 8 vectors requested, 4 allocated, 64-bit address
+	bdfs[1] = PCIE_BDF(0, 2, 0, 0);
+	p = &img[1 * PCLN_CFG];
+	test_dev(p, 0, 0, 0);
+	test_cap(p, 0x40, PCAP_MSI);
+	p[0x42] = 0x80 | (2 << 4) | (3 << 1) | 0x01;
+	p[0x44] = 0xEE;
+	p[0x48] = 0x01;
+	p[0x4C] = 0x41;
+
+	// INTx, then INTx disabled in the Command register
+	bdfs[2] = PCIE_BDF(0, 1, 0, 1);
+	p = &img[2 * PCLN_CFG];
+	test_dev(p, 0, 0, 0);
+	p[0x3D] = 1;
+	bdfs[3] = PCIE_BDF(0, 1, 0, 2);
+	p = &img[3 * PCLN_CFG];
+	test_dev(p, 0, 0, 0);
+	p[0x3D] = 1;
+	p[0x05] = 0x04;
+
+	// MSI enabled with 2 vectors, MSI-X present with 32 vectors but disabled
+	bdfs[4] = PCIE_BDF(0, 2, 0, 1);
+	p = &img[4 * PCLN_CFG];
+	test_dev(p, 0, 0, 0);
+	test_cap(p, 0x40, PCAP_MSI);
+	p[0x42] = (1 << 4) | (3 << 1) | 0x01;
+	test_cap(p, 0x50, PCAP_MSIX);
+	p[0x52] = 31;
+
+	// Data moves up by 4 bytes with a 64-bit address
+	TEST_CHECK(pcie_msi_decode(&msi, &img[1 * PCLN_CFG], 0) == 0);
+	TEST_CHECK(msi.off == 0x40 && msi.bit64 && msi.addr == 0x1000000EEULL && msi.data == 0x41);
+
+	TEST_CHECK(pcie_irq_acct(bdfs, img, 5, dev, bus, 2, &host) == 2);
+
+	TEST_CHECK(dev[0].mode == PCIQ_MSIX && dev[0].requested == 16 && dev[0].allocated == 16);
+	TEST_CHECK(dev[1].mode == PCIQ_MSI && dev[1].requested == 4 && dev[1].allocated == 4);
+	TEST_CHECK(dev[2].mode == PCIQ_INTX && dev[2].requested == 1 && dev[2].allocated == 1);
+	TEST_CHECK(dev[3].mode == PCIQ_NONE && dev[3].requested == 1 && dev[3].allocated == 0);
+	TEST_CHECK(dev[3].bdf == bdfs[3]);
+	TEST_CHECK(dev[4].mode == PCIQ_MSI && dev[4].requested == 2 && dev[4].allocated == 2);
+
+	TEST_CHECK(bus[0].bus == bdfs[0] >> 8 && bus[0].devices == 3);
+	TEST_CHECK(bus[0].requested == 18 && bus[0].allocated == 17);
+	TEST_CHECK(bus[1].bus == bdfs[1] >> 8 && bus[1].devices == 2 && bus[1].mode[PCIQ_MSI] == 2);
+	TEST_CHECK(bus[1].requested == 6 && bus[1].allocated == 6);
+	TEST_CHECK(host.devices == 5 && host.requested == 24 && host.allocated == 23);
+	TEST_CHECK(host.mode[PCIQ_NONE] == 1 && host.mode[PCIQ_INTX] == 1);
+	TEST_CHECK(host.mode[PCIQ_MSI] == 2 && host.mode[PCIQ_MSIX] == 1);
+
+	// A bus that does not fit is only counted in the host totals
+	TEST_CHECK(pcie_irq_acct(bdfs, img, 5, NULL, bus, 1, &host) == 1);
+	TEST_CHECK(bus[0].devices == 3 && host.devices == 5);
+	return 0;
+}
+
+/**
+ * pcie_writer that always fails
+ */
+static int test_wr_fail(void *ctx, const char *buf, size_t len)
+{
+	(void) ctx;
+	(void) buf;
+	(void) len;
+	return -1;
+}
+
+/**
+ * Buffered, memory, null and callback sinks write what they are given, in
+ * order, and errors are sticky
+ */
+static int test_sink(struct test_ctx *c)
+{
+	struct pcie_sink s, mem[3];
+	char buf[8], out[32], big[5000];
+	FILE *fp;
+	size_t n;
+	int fd;
+
+	// A memory sink grows past its first allocation
+	memset(big, 'x', sizeof(big));
+	pcie_sink_mem(&s);
+	TEST_CHECK(pcie_sink_write(&s, "abc", 3) == 0);
+	TEST_CHECK(pcie_sink_write(&s, big, sizeof(big)) == 0);
+	TEST_CHECK(s.pos == 3 + sizeof(big) && s.total == s.pos && s.len >= s.pos);
+	TEST_CHECK(memcmp(s.buf, "abcxx", 5) == 0);
+	TEST_CHECK(pcie_sink_free(&s) == 0 && s.buf == NULL);
+
+	// A write that does not fit goes out together with the buffered bytes
+	fd = open(c->path, O_WRONLY | O_TRUNC);
+	TEST_CHECK(fd >= 0);
+	pcie_sink_fd(&s, fd, buf, sizeof(buf));
+	TEST_CHECK(pcie_sink_write(&s, "1234", 4) == 0 && s.pos == 4);
+	TEST_CHECK(pcie_sink_write(&s, "56789", 5) == 0 && s.pos == 0);
+	TEST_CHECK(pcie_sink_wr(&s, "ab", 2) == 0 && s.pos == 2);
+	TEST_CHECK(pcie_sink_flush(&s) == 0 && s.pos == 0 && s.total == 11);
+
+	// Worker sinks are written in order and emptied, empty ones are skipped
+	pcie_sink_mem(&mem[0]);
+	pcie_sink_mem(&mem[1]);
+	pcie_sink_mem(&mem[2]);
+	pcie_sink_write(&mem[0], "xy", 2);
+	pcie_sink_write(&mem[2], "z", 1);
+	TEST_CHECK(pcie_sink_flushv(fd, mem, 3) == 0);
+	TEST_CHECK(mem[0].pos == 0 && mem[2].pos == 0 && mem[0].buf != NULL);
+	pcie_sink_free(&mem[0]);
+	pcie_sink_free(&mem[1]);
+	pcie_sink_free(&mem[2]);
+	pcie_sink_free(&s);
+	close(fd);
+
+	fp = fopen(c->path, "rb");
+	TEST_CHECK(fp != NULL);
+	n = fread(out, 1, sizeof(out), fp);
+	fclose(fp);
+	TEST_CHECK(n == 14 && memcmp(out, "123456789abxyz", 14) == 0);
+
+	// A null sink only counts
+	pcie_sink_null(&s);
+	TEST_CHECK(pcie_sink_write(&s, big, sizeof(big)) == 0 && s.total == sizeof(big));
+
+	// Once a write fails every later write fails
+	pcie_sink_fn(&s, test_wr_fail, NULL);
+	TEST_CHECK(pcie_sink_write(&s, "a", 1) == -1);
+	TEST_CHECK(pcie_sink_write(&s, "b", 1) == -1 && s.total == 2);
+	TEST_CHECK(pcie_sink_free(&s) == -1);
+	return 0;
+}
+
+/**
+ * Look up a NULL terminated name
+ */
+static const struct pcie_sym_ent *test_sym(struct pcie_sym *t, unsigned ns, const char *name)
+{
+	return pcie_sym_find(t, ns, name, strlen(name));
+}
+
+/**
+ * Mnemonics, short mnemonics and names are found in their namespace in any
+ * case, and nothing else is
+ */
+static int test_sym_find(struct test_ctx *c)
+{
+	struct pcie_sym t;
+	const struct pcie_sym_ent *e;
+
+	(void) c;
+
+	TEST_CHECK(pcie_sym_init(&t) == 0);
+
+	e = test_sym(&t, PCSY_ECAP, "PCEC_DOE");
+	TEST_CHECK(e != NULL && e->val == PCEC_DOE && e->mask == 0xFFFF && e->ns == PCSY_ECAP);
+	TEST_CHECK(pcie_sym_find(&t, PCSY_ECAP, "PCEC_DOEX", 8) == e);
+	e = test_sym(&t, PCSY_ECAP, "doe");
+	TEST_CHECK(e != NULL && e->val == PCEC_DOE && e->len == 3);
+	e = test_sym(&t, PCSY_ECAP, "DATA object EXCHANGE");
+	TEST_CHECK(e != NULL && e->val == PCEC_DOE && strcmp(e->name, "Data Object Exchange") == 0);
+
+	// The first symbol wins a shared name
+	e = test_sym(&t, PCSY_ECAP, "Virtual Channel (VC)");
+	TEST_CHECK(e != NULL && e->val == PCEC_VC);
+
+	e = test_sym(&t, PCSY_CAP, "msi");
+	TEST_CHECK(e != NULL && e->val == PCAP_MSI && e->mask == 0xFF);
+
+	// Each Class level matches the bits it names
+	e = test_sym(&t, PCSY_CLASS, "pcbc_bridge");
+	TEST_CHECK(e != NULL && e->val == PCBC_BRIDGE << 16 && e->mask == 0xFF0000);
+	e = test_sym(&t, PCSY_CLASS, "PCBD_PPB");
+	TEST_CHECK(e != NULL && e->val == ((PCBC_BRIDGE << 16) | (PCBD_PPB << 8)) && e->mask == 0xFFFF00);
+
+	// Misses: wrong namespace, prefix of a name, unknown and empty names
+	TEST_CHECK(test_sym(&t, PCSY_CAP, "PCEC_DOE") == NULL);
+	TEST_CHECK(test_sym(&t, PCSY_ECAP, "PCEC_DO") == NULL);
+	TEST_CHECK(test_sym(&t, PCSY_ECAP, "nope") == NULL);
+	TEST_CHECK(test_sym(&t, PCSY_CLASS, "") == NULL);
+	TEST_CHECK(test_sym(&t, PCSY_MAX, "PCEC_DOE") == NULL);
+
+	pcie_sym_free(&t);
+	return 0;
+}
+
+/**
+ * Reference for pcie_col_scan(): test one row against one predicate
+ */
+static int test_col_match(const struct pcie_col *t, size_t n, const struct pcie_col_pred *p)
+{
+	__u64 v;
+
+	switch (p->col)
+	{
+		case PCCL_BDF: 			v = t->bdf[n]; 			break;
+		case PCCL_VENDOR: 		v = t->vendor[n]; 		break;
+		case PCCL_DEVICE: 		v = t->device[n]; 		break;
+		case PCCL_COMMAND: 		v = t->command[n]; 		break;
+		case PCCL_STATUS: 		v = t->status[n]; 		break;
+		case PCCL_BASECLASS: 	v = t->baseclass[n]; 	break;
+		case PCCL_SUBCLASS: 	v = t->subclass[n]; 	break;
+		case PCCL_PI: 			v = t->pi[n]; 			break;
+		case PCCL_TYPE: 		v = t->type[n]; 		break;
+		case PCCL_CAPS: 		v = t->caps[n]; 		break;
+		default: 				v = t->ecaps[n]; 		break;
+	}
+	return ((v & p->mask) == p->val) != p->neg;
+}
+
+/**
+ * Every kernel width agrees with a row by row reference, including the rows
+ * of a partial last block
+ */
+static int test_col_scan(struct test_ctx *c)
+{
+	static const struct pcie_col_pred PRED[] =
+	{
+		{ PCCL_BASECLASS, 0, 0xFF, PCBC_BRIDGE },
+		{ PCCL_COMMAND, 1, 0x0004, 0 },
+		{ PCCL_BDF, 0, 0xFF00, 0x0200 },
+		{ PCCL_CAPS, 0, 1ULL << PCAP_MSI, 1ULL << PCAP_MSI },
+		{ PCCL_ECAPS, 1, 1ULL << PCEC_AER, 1ULL << PCEC_AER },
+		{ PCCL_VENDOR, 0, 0xFFFF, 0x1022 },
+	};
+	static const unsigned SETS[][3] =
+	{
+		// First predicate and count of each scan
+		{ 0, 1 }, { 1, 1 }, { 2, 1 }, { 3, 1 }, { 4, 1 }, { 5, 1 },
+		{ 0, 2 }, { 0, 4 }, { 2, 3 }, { 1, 5 },
+	};
+	struct pcie_col t;
+	__u8 img[PCLN_CFG];
+	__u64 bits[3];
+	size_t n, i;
+	unsigned j;
+	long cnt, ref;
+	int m;
+
+	(void) c;
+
+	// 150 rows: two full blocks and 22 rows of a third
+	TEST_CHECK(pcie_col_init(&t, 150) == 0);
+	for (n = 0 ; n < 150 ; n++)
+	{
+		test_dev(img, 0, 0, 0);
+		img[0x00] = (n % 3) ? 0x86 : 0x22;
+		img[0x01] = (n % 3) ? 0x80 : 0x10;
+		img[0x04] = n & 0x07;
+		img[0x0B] = (n % 5) ? 0x01 : PCBC_BRIDGE;
+		if (n % 7 == 0)
+			test_cap(img, 0x40, PCAP_MSI);
+		if (n % 11 == 0) {
+			img[0x100] = PCEC_AER;
+			img[0x102] = 0x01;
+		}
+		TEST_CHECK(pcie_col_add(&t, PCIE_BDF(0, n / 32, n % 32, 0), img) == (long) n);
+	}
+
+	for (i = 0 ; i < sizeof(SETS) / sizeof(SETS[0]) ; i++)
+	{
+		memset(bits, 0xA5, sizeof(bits));
+		cnt = pcie_col_scan(&t, &PRED[SETS[i][0]], SETS[i][1], bits);
+
+		ref = 0;
+		for (n = 0 ; n < t.num ; n++)
+		{
+			m = 1;
+			for (j = 0 ; j < SETS[i][1] ; j++)
+				m &= test_col_match(&t, n, &PRED[SETS[i][0] + j]);
+			ref += m;
+			TEST_CHECK(((bits[n / 64] >> (n % 64)) & 1) == (__u64) m);
+		}
+		TEST_CHECK(cnt == ref && cnt > 0);
+		TEST_CHECK((bits[2] >> 22) == 0);
+	}
+
+	// Bridges on bus 2 with Bus Master enabled and an MSI Capability: row 70
+	TEST_CHECK(pcie_col_scan(&t, PRED, 4, bits) == 1);
+	TEST_CHECK(bits[0] == 0 && bits[1] == 1ULL << (70 - 64) && bits[2] == 0);
+
+	// No predicates: every row, no padding rows
+	TEST_CHECK(pcie_col_scan(&t, NULL, 0, bits) == 150);
+	TEST_CHECK(bits[0] == ~0ULL && bits[2] == (1ULL << 22) - 1);
+
+	pcie_col_free(&t);
+	return 0;
+}
+
+/**
+ * Links below their own maximum are flagged, with PCLK_PARTNER when the peer
+ * is the limit, and payload settings are compared with the upstream bridge
+ */
+static int test_link_scan(struct test_ctx *c)
+{
+	struct pcie_link l[8];
+	__u8 img[7 * PCLN_CFG];
+	__u32 bdfs[7];
+
+	(void) c;
+
+	// Root port 00:01.0 at Gen4 x8 with an x8 endpoint 01:00.0 and a link that is down
+	bdfs[0] = PCIE_BDF(0, 0, 1, 0);
+	test_dev(&img[0 * PCLN_CFG], 1, 1, 1);
+	test_exp(&img[0 * PCLN_CFG], PCPT_RP, 1, 2, 0x104, 0x084);
+	bdfs[1] = PCIE_BDF(0, 1, 0, 0);
+	test_dev(&img[1 * PCLN_CFG], 0, 0, 0);
+	test_exp(&img[1 * PCLN_CFG], PCPT_EP, 1, 0, 0x084, 0x084);
+	bdfs[2] = PCIE_BDF(0, 1, 0, 1);
+	test_dev(&img[2 * PCLN_CFG], 0, 0, 0);
+	test_exp(&img[2 * PCLN_CFG], PCPT_EP, 1, 2, 0x084, 0x000);
+
+	// Root port 00:02.0 and endpoint 02:00.0, both x4 capable, trained down to Gen1
+	bdfs[3] = PCIE_BDF(0, 0, 2, 0);
+	test_dev(&img[3 * PCLN_CFG], 1, 2, 2);
+	test_exp(&img[3 * PCLN_CFG], PCPT_RP, 1, 2, 0x044, 0x041);
+	bdfs[4] = PCIE_BDF(0, 2, 0, 0);
+	test_dev(&img[4 * PCLN_CFG], 0, 0, 0);
+	test_exp(&img[4 * PCLN_CFG], PCPT_EP, 0, 0, 0x044, 0x041);
+
+	// Integrated endpoint and a function without the Capability
+	bdfs[5] = PCIE_BDF(0, 0, 3, 0);
+	test_dev(&img[5 * PCLN_CFG], 0, 0, 0);
+	test_exp(&img[5 * PCLN_CFG], PCPT_RCIEP, 1, 2, 0, 0);
+	bdfs[6] = PCIE_BDF(0, 0, 4, 0);
+	test_dev(&img[6 * PCLN_CFG], 0, 0, 0);
+
+	TEST_CHECK(pcie_link_scan(bdfs, img, 7, l, 8) == 4);
+
+	// The root port is wider than its peer
+	TEST_CHECK(l[0].bdf == bdfs[0] && l[0].flags == (PCLK_WIDTH | PCLK_PARTNER));
+	TEST_CHECK(l[0].width == 8 && l[0].max_width == 16 && l[0].peer_width == 8 && l[0].up == ~0u);
+
+	// Reads are split below the 256 byte payload of the path
+	TEST_CHECK(l[1].bdf == bdfs[1] && l[1].flags == PCLK_MRRS);
+	TEST_CHECK(l[1].up == bdfs[0] && l[1].mps == 256 && l[1].up_mps == 256 && l[1].mrrs == 128);
+
+	TEST_CHECK(l[2].bdf == bdfs[3] && l[2].flags == PCLK_SPEED && l[2].peer_speed == 4);
+	TEST_CHECK(l[3].bdf == bdfs[4] && l[3].flags == (PCLK_SPEED | PCLK_MPS));
+	TEST_CHECK(l[3].speed == 1 && l[3].max_speed == 4 && l[3].up_mps == 256 && l[3].mps == 128);
+
+	// The count does not depend on the room in out
+	TEST_CHECK(pcie_link_scan(bdfs, img, 7, l, 1) == 4 && l[0].bdf == bdfs[0]);
+	return 0;
+}
+
+/**
+ * VF Routing IDs follow First VF Offset and VF Stride and carry into the
+ * device and bus numbers
+ */
+static int test_sriov_vfs(struct test_ctx *c)
+{
+	struct pcie_sriov s;
+	__u8 img[2 * PCLN_CFG], *p;
+	__u32 bdfs[2], vfs[64];
+	unsigned n;
+
+	(void) c;
+
+	// PF 3b:00.0 with 40 VFs at offset 0x80 and stride 2, VFs enabled
+	bdfs[0] = PCIE_BDF(0, 0x3b, 0, 0);
+	p = &img[0 * PCLN_CFG];
+	test_dev(p, 0, 0, 0);
+	p[0x100] = PCEC_SRIOV;
+	p[0x102] = 0x01;
+	p[0x108] = 0x01;
+	p[0x10C] = 64;
+	p[0x10E] = 64;
+	p[0x110] = 40;
+	p[0x114] = 0x80;
+	p[0x116] = 2;
+
+	TEST_CHECK(pcie_sriov_decode(&s, p, 0) == 0);
+	TEST_CHECK(s.off == 0x100 && s.vf_enable && s.total_vfs == 64 && s.num_vfs == 40);
+	TEST_CHECK(s.offset == 0x80 && s.stride == 2 && s.rebar_off == 0);
+
+	TEST_CHECK(pcie_sriov_vfs(&s, bdfs[0], vfs, 64) == 40);
+	TEST_CHECK(vfs[0] == PCIE_BDF(0, 0x3b, 0x10, 0));
+	TEST_CHECK(vfs[1] == PCIE_BDF(0, 0x3b, 0x10, 2));
+	TEST_CHECK(vfs[4] == PCIE_BDF(0, 0x3b, 0x11, 0));
+	TEST_CHECK(vfs[39] == PCIE_BDF(0, 0x3b, 0x19, 6));
+	for (n = 1 ; n < 40 ; n++)
+		TEST_CHECK(vfs[n] == vfs[n - 1] + 2);
+
+	// A disabled PF in the same batch is skipped
+	bdfs[1] = PCIE_BDF(0, 0x3b, 0, 1);
+	memcpy(&img[1 * PCLN_CFG], p, PCLN_CFG);
+	img[1 * PCLN_CFG + 0x108] = 0;
+	memset(vfs, 0, sizeof(vfs));
+	TEST_CHECK(pcie_sriov_scan(bdfs, img, 2, vfs, 64) == 40);
+	TEST_CHECK(vfs[39] == PCIE_BDF(0, 0x3b, 0x19, 6) && vfs[40] == 0);
+
+	// Routing IDs carry into the bus number, the segment is kept
+	s.offset = 0x100;
+	TEST_CHECK(pcie_sriov_vfs(&s, PCIE_BDF(2, 0x3b, 0, 0), vfs, 64) == 40);
+	TEST_CHECK(vfs[0] == PCIE_BDF(2, 0x3c, 0, 0) && vfs[39] == PCIE_BDF(2, 0x3c, 0x09, 6));
+
+	// Offset 0 and VFs past the last bus are invalid
+	s.offset = 0;
+	TEST_CHECK(pcie_sriov_vfs(&s, bdfs[0], vfs, 64) == -1);
+	s.offset = 0x80;
+	TEST_CHECK(pcie_sriov_vfs(&s, PCIE_BDF(0, 0xFF, 0x10, 0), vfs, 64) == -1);
+	return 0;
+}
+
+/**
+ * Overwrite size bytes at offset off of the file at path with the low bytes
+ * of val in host byte order
+ */
+static int test_patch(const char *path, __u64 off, __u64 val, size_t size)
+{
+	union { __u64 u64; __u32 u32; __u16 u16; } u;
+	ssize_t n;
+	int fd;
+
+	switch (size)
+	{
+		case 2: u.u16 = val; 	break;
+		case 4: u.u32 = val; 	break;
+		default: u.u64 = val; 	break;
+	}
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	n = pwrite(fd, &u, size, off);
+	close(fd);
+	return (n == (ssize_t) size) ? 0 : -1;
+}
+
+/**
+ * Truncate the file at path to len bytes of zeros
+ */
+static int test_short(const char *path, size_t len)
+{
+	__u8 buf[64];
+	ssize_t n;
+	int fd;
+
+	memset(buf, 0, sizeof(buf));
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		return -1;
+	n = write(fd, buf, len < sizeof(buf) ? len : sizeof(buf));
+	close(fd);
+	return (n < 0) ? -1 : 0;
+}
+
+/**
+ * Return 0 if pcie_snap_open() rejects the file at path with EINVAL
+ */
+static int test_snap_reject(const char *path)
+{
+	struct pcie_snap snap;
+
+	errno = 0;
+	if (pcie_snap_open(&snap, path) == 0) {
+		pcie_snap_close(&snap);
+		return -1;
+	}
+	return (errno == EINVAL) ? 0 : -1;
+}
+
+/**
+ * A snapshot reads back the images and BDFs it was written with
+ */
+static int test_snap_valid(struct test_ctx *c)
+{
+	struct pcie_snap snap;
+	unsigned i;
+
+	TEST_CHECK(pcie_snap_write(c->path, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(pcie_snap_open(&snap, c->path) == 0);
+	TEST_CHECK(snap.num == TEST_IMAGES);
+	for (i = 0 ; i < TEST_IMAGES ; i++) {
+		TEST_CHECK(pcie_snap_cfg(&snap, i) != NULL);
+		TEST_CHECK(memcmp(pcie_snap_cfg(&snap, i), &c->images[i * PCLN_CFG], PCLN_CFG) == 0);
+		TEST_CHECK((__u8*) pcie_snap_find(&snap, c->bdfs[i]) == pcie_snap_cfg(&snap, i));
+	}
+	TEST_CHECK(pcie_snap_cfg(&snap, TEST_IMAGES) == NULL);
+	pcie_snap_close(&snap);
+	return 0;
+}
+
+/**
+ * Snapshot headers that are truncated or point outside the file are rejected
+ */
+static int test_snap_hdr(struct test_ctx *c)
+{
+	const char *p = c->path;
+
+	TEST_CHECK(test_short(p, 16) == 0);
+	TEST_CHECK(test_snap_reject(p) == 0);
+
+	// A zeroed header has no magic
+	TEST_CHECK(test_short(p, sizeof(struct pcie_snap_hdr)) == 0);
+	TEST_CHECK(test_snap_reject(p) == 0);
+
+	// File shorter than file_len
+	TEST_CHECK(pcie_snap_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_snap_hdr, file_len), ~0ULL, 8) == 0);
+	TEST_CHECK(test_snap_reject(p) == 0);
+
+	// index_off + num * sizeof(ent) wraps to a small value
+	TEST_CHECK(pcie_snap_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_snap_hdr, index_off), ~0ULL - 0x0F, 8) == 0);
+	TEST_CHECK(test_snap_reject(p) == 0);
+
+	// Index runs past the end of the file
+	TEST_CHECK(pcie_snap_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_snap_hdr, num), 0xFFFFFFFF, 4) == 0);
+	TEST_CHECK(test_snap_reject(p) == 0);
+
+	// Aligned data area past the end of the file
+	TEST_CHECK(pcie_snap_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_snap_hdr, data_off), 0xFFFFFFFFFFFFF000ULL, 8) == 0);
+	TEST_CHECK(test_snap_reject(p) == 0);
+
+	// Unaligned data area
+	TEST_CHECK(pcie_snap_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_snap_hdr, data_off), PCLN_CFG + 4, 8) == 0);
+	TEST_CHECK(test_snap_reject(p) == 0);
+	return 0;
+}
+
+/**
+ * Snapshot index entries that do not name an aligned image in the data area
+ * return NULL and leave the other entries usable
+ */
+static int test_snap_ent(struct test_ctx *c)
+{
+	struct pcie_snap snap;
+	__u64 ent, off;
+
+	ent = sizeof(struct pcie_snap_hdr);
+	off = offsetof(struct pcie_snap_ent, off);
+	TEST_CHECK(pcie_snap_write(c->path, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+
+	// off + PCLN_CFG wraps to 0
+	TEST_CHECK(test_patch(c->path, ent + 0 * sizeof(struct pcie_snap_ent) + off, 0xFFFFFFFFFFFFF000ULL, 8) == 0);
+	// Unaligned
+	TEST_CHECK(test_patch(c->path, ent + 1 * sizeof(struct pcie_snap_ent) + off, PCLN_CFG + 1, 8) == 0);
+	// Header and index instead of an image
+	TEST_CHECK(test_patch(c->path, ent + 2 * sizeof(struct pcie_snap_ent) + off, 0, 8) == 0);
+
+	TEST_CHECK(pcie_snap_open(&snap, c->path) == 0);
+	TEST_CHECK(pcie_snap_cfg(&snap, 0) == NULL);
+	TEST_CHECK(pcie_snap_cfg(&snap, 1) == NULL);
+	TEST_CHECK(pcie_snap_cfg(&snap, 2) == NULL);
+	TEST_CHECK(pcie_snap_find(&snap, c->bdfs[2]) == NULL);
+	TEST_CHECK(memcmp(pcie_snap_cfg(&snap, 3), &c->images[3 * PCLN_CFG], PCLN_CFG) == 0);
+	pcie_snap_close(&snap);
+	return 0;
+}
+
+/**
+ * Return 0 if pcie_pack_open() rejects the file at path with EINVAL
+ */
+static int test_pack_reject(const char *path)
+{
+	struct pcie_pack pk;
+
+	errno = 0;
+	if (pcie_pack_open(&pk, path) == 0) {
+		pcie_pack_close(&pk);
+		return -1;
+	}
+	return (errno == EINVAL) ? 0 : -1;
+}
+
+/**
+ * A packed snapshot rebuilds the images it was written with
+ */
+static int test_pack_valid(struct test_ctx *c)
+{
+	struct pcie_pack pk;
+	__u8 img[PCLN_CFG];
+	unsigned i;
+	int k;
+
+	TEST_CHECK(pcie_pack_write(c->path, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(pcie_pack_open(&pk, c->path) == 0);
+	TEST_CHECK(pk.num == TEST_IMAGES);
+	for (i = 0 ; i < TEST_IMAGES ; i++) {
+		k = pcie_pack_find(&pk, c->bdfs[i]);
+		TEST_CHECK(k >= 0 && pcie_pack_cfg(&pk, k, img) == 0);
+		TEST_CHECK(memcmp(img, &c->images[i * PCLN_CFG], PCLN_CFG) == 0);
+	}
+	TEST_CHECK(pcie_pack_cfg(&pk, TEST_IMAGES, img) != 0);
+	pcie_pack_close(&pk);
+	return 0;
+}
+
+/**
+ * Packed snapshot headers that are truncated or point outside the file are
+ * rejected
+ */
+static int test_pack_hdr(struct test_ctx *c)
+{
+	const char *p = c->path;
+
+	TEST_CHECK(test_short(p, 16) == 0);
+	TEST_CHECK(test_pack_reject(p) == 0);
+
+	// A zeroed header has no magic
+	TEST_CHECK(test_short(p, sizeof(struct pcie_pack_hdr)) == 0);
+	TEST_CHECK(test_pack_reject(p) == 0);
+
+	// File shorter than file_len
+	TEST_CHECK(pcie_pack_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_pack_hdr, file_len), ~0ULL, 8) == 0);
+	TEST_CHECK(test_pack_reject(p) == 0);
+
+	// index_off + num * sizeof(ent) wraps to a small value
+	TEST_CHECK(pcie_pack_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_pack_hdr, index_off), ~0ULL - 0x0F, 8) == 0);
+	TEST_CHECK(test_pack_reject(p) == 0);
+
+	// Index runs past the end of the file
+	TEST_CHECK(pcie_pack_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_pack_hdr, num), 0xFFFFFFFF, 4) == 0);
+	TEST_CHECK(test_pack_reject(p) == 0);
+
+	// tmpl_off + ntmpl * PCLN_CFG wraps to a small value
+	TEST_CHECK(pcie_pack_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_pack_hdr, tmpl_off), 0xFFFFFFFFFFFFF000ULL, 8) == 0);
+	TEST_CHECK(test_pack_reject(p) == 0);
+
+	// Templates run past the end of the file
+	TEST_CHECK(pcie_pack_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_pack_hdr, ntmpl), 0xFFFFFFFF, 4) == 0);
+	TEST_CHECK(test_pack_reject(p) == 0);
+
+	// Unaligned templates
+	TEST_CHECK(pcie_pack_write(p, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+	TEST_CHECK(test_patch(p, offsetof(struct pcie_pack_hdr, tmpl_off), PCLN_CFG + 4, 8) == 0);
+	TEST_CHECK(test_pack_reject(p) == 0);
+	return 0;
+}
+
+/**
+ * Packed snapshot index entries that do not name a template and a delta
+ * inside the file fail and leave the other entries usable
+ */
+static int test_pack_ent(struct test_ctx *c)
+{
+	struct pcie_pack pk;
+	__u8 img[PCLN_CFG];
+	__u64 ent;
+	unsigned i;
+
+	ent = sizeof(struct pcie_pack_hdr);
+	TEST_CHECK(pcie_pack_write(c->path, c->bdfs, c->images, TEST_IMAGES, 0) == 0);
+
+	// off + len wraps to a small value
+	TEST_CHECK(test_patch(c->path, ent + 0 * sizeof(struct pcie_pack_ent) + offsetof(struct pcie_pack_ent, off), ~0ULL - 0x0F, 8) == 0);
+	TEST_CHECK(test_patch(c->path, ent + 0 * sizeof(struct pcie_pack_ent) + offsetof(struct pcie_pack_ent, len), 0x20, 4) == 0);
+	// Delta runs past the end of the file
+	TEST_CHECK(test_patch(c->path, ent + 1 * sizeof(struct pcie_pack_ent) + offsetof(struct pcie_pack_ent, len), 0xFFFFFFFF, 4) == 0);
+	// No such template
+	TEST_CHECK(test_patch(c->path, ent + 2 * sizeof(struct pcie_pack_ent) + offsetof(struct pcie_pack_ent, tmpl), 0xFFFFFFFF, 4) == 0);
+
+	TEST_CHECK(pcie_pack_open(&pk, c->path) == 0);
+	TEST_CHECK(pcie_pack_cfg(&pk, 0, img) != 0 && errno == EINVAL);
+	TEST_CHECK(pcie_pack_cfg(&pk, 1, img) != 0 && errno == EINVAL);
+	TEST_CHECK(pcie_pack_cfg(&pk, 2, img) != 0 && errno == EINVAL);
+	TEST_CHECK(pcie_pack_cfg(&pk, 3, img) == 0);
+	for (i = 0 ; i < TEST_IMAGES && c->bdfs[i] != pk.ent[3].bdf ; i++)
+		;
+	TEST_CHECK(i < TEST_IMAGES && memcmp(img, &c->images[i * PCLN_CFG], PCLN_CFG) == 0);
+	pcie_pack_close(&pk);
+	return 0;
+}
+
+/**
+ * Compile a small pci.ids file into a name database at dst
+ */
+static int test_ids_db(struct test_ctx *c, char *dst, size_t len)
+{
+	FILE *f;
+	int rv;
+
+	f = fopen(c->path, "w");
+	if (f == NULL)
+		return -1;
+	fputs("# Test\n"
+		"8086  Intel Corporation\n"
+		"\t1234  Test Device\n"
+		"\t\t8086 0001  Test Subsystem\n"
+		"1af4  Red Hat, Inc.\n", f);
+	fclose(f);
+
+	snprintf(dst, len, "%s.db", c->path);
+	rv = pcie_ids_compile(c->path, dst);
+	if (rv != 0)
+		unlink(dst);
+	return rv;
+}
+
+/**
+ * Return 0 if pcie_ids_open() rejects the file at path with EINVAL
+ */
+static int test_ids_reject(const char *path)
+{
+	struct pcie_ids db;
+
+	errno = 0;
+	if (pcie_ids_open(&db, path) == 0) {
+		pcie_ids_close(&db);
+		return -1;
+	}
+	return (errno == EINVAL) ? 0 : -1;
+}
+
+/**
+ * A name database returns the names it was compiled from
+ */
+static int test_ids_valid(struct test_ctx *c)
+{
+	struct pcie_ids db;
+	const char *s;
+	char dst[64];
+	int rv;
+
+	TEST_CHECK(test_ids_db(c, dst, sizeof(dst)) == 0);
+	rv = pcie_ids_open(&db, dst);
+	unlink(dst);
+	TEST_CHECK(rv == 0);
+
+	s = pcie_ids_vendor(&db, 0x8086);
+	TEST_CHECK(s != NULL && strcmp(s, "Intel Corporation") == 0);
+	s = pcie_ids_device(&db, 0x8086, 0x1234);
+	TEST_CHECK(s != NULL && strcmp(s, "Test Device") == 0);
+	s = pcie_ids_subsys(&db, 0x8086, 0x1234, 0x8086, 0x0001);
+	TEST_CHECK(s != NULL && strcmp(s, "Test Subsystem") == 0);
+	s = pcie_ids_vendor(&db, 0x1AF4);
+	TEST_CHECK(s != NULL && strcmp(s, "Red Hat, Inc.") == 0);
+	TEST_CHECK(pcie_ids_vendor(&db, 0x10DE) == NULL);
+	TEST_CHECK(pcie_ids_device(&db, 0x1AF4, 0x1234) == NULL);
+	pcie_ids_close(&db);
+	return 0;
+}
+
+/**
+ * Return 0 if a name database with one header field patched is rejected
+ */
+static int test_ids_bad(struct test_ctx *c, __u64 off, __u64 val, size_t size)
+{
+	char dst[64];
+	int rv;
+
+	if (test_ids_db(c, dst, sizeof(dst)) != 0)
+		return -1;
+	rv = test_patch(dst, off, val, size);
+	if (rv == 0)
+		rv = test_ids_reject(dst);
+	unlink(dst);
+	return rv;
+}
+
+/**
+ * Name database headers that are truncated or point outside the file are
+ * rejected
+ */
+static int test_ids_hdr(struct test_ctx *c)
+{
+	TEST_CHECK(test_short(c->path, sizeof(struct pcie_ids_hdr)) == 0);
+	TEST_CHECK(test_ids_reject(c->path) == 0);
+
+	// File shorter than file_len
+	TEST_CHECK(test_ids_bad(c, offsetof(struct pcie_ids_hdr, file_len), ~0ULL, 8) == 0);
+	// bucket_off + nbucket * 4 wraps to a small value
+	TEST_CHECK(test_ids_bad(c, offsetof(struct pcie_ids_hdr, bucket_off), ~0ULL - 1, 8) == 0);
+	// Buckets run past the end of the file
+	TEST_CHECK(test_ids_bad(c, offsetof(struct pcie_ids_hdr, nbucket), 0xFFFFFFFF, 4) == 0);
+	// slot_off + nslot * sizeof(ent) wraps to a small value
+	TEST_CHECK(test_ids_bad(c, offsetof(struct pcie_ids_hdr, slot_off), ~0ULL - 1, 8) == 0);
+	// Slots run past the end of the file
+	TEST_CHECK(test_ids_bad(c, offsetof(struct pcie_ids_hdr, nslot), 0xFFFFFFFF, 4) == 0);
+	return 0;
+}
+
+/**
+ * A key set that cannot be placed fails with EAGAIN so that callers know to
+ * try another seed
+ */
+static int test_phf_place(struct test_ctx *c)
+{
+	__u64 h[2] = { 0x5043, 0x5043 };
+	__u32 disp[1], slot[2];
+
+	(void) c;
+	errno = 0;
+	TEST_CHECK(pcie_phf_build(h, 2, 1, 4, disp, slot) == -1);
+	TEST_CHECK(errno == EAGAIN);
+	TEST_CHECK(pcie_phf_build(h, 1, 1, 4, disp, slot) == 0);
+	return 0;
+}
+
+/**
+ * Return the report for config space offset off, or NULL if there is none
+ */
+static const struct pcie_diff *test_diff_at(const struct pcie_diff *d, int num, unsigned off)
+{
+	int i;
+
+	for (i = 0 ; i < num ; i++)
+		if (off >= d[i].offset && off < (unsigned) d[i].offset + d[i].len)
+			return &d[i];
+	return NULL;
+}
+
+/**
+ * Changed bytes are attributed to a Capability only inside its layout and 
+ * before the next Capability. Values of a 3 byte register do not include the 
+ * byte after it
+ */
+static int test_diff_locate(struct test_ctx *c)
+{
+	static const unsigned offs[] = { 0x44, 0x4C, 0x52, 0x5C, 0x104, 0x110 };
+	const struct pcie_diff *r;
+	struct pcie_diff d[16];
+	__u8 a[PCLN_CFG], b[PCLN_CFG];
+	unsigned i;
+	int num;
+
+	(void) c;
+	memset(a, 0, PCLN_CFG);
+
+	a[0x06] = 0x10; 				// Capabilities List
+	a[0x34] = 0x40;
+	a[0x40] = PCAP_PM; 		a[0x41] = 0x50;
+	a[0x50] = PCAP_MSI; 	a[0x51] = 0x00; 	// 32-bit, not maskable: 10 bytes
+	a[0x100] = PCEC_DSN; 	a[0x102] = 0x01; 	// Version 1, last in chain
+	a[0x38] = 0x5A; 							// Follows the reserved bytes 0x35 - 0x37
+
+	memcpy(b, a, PCLN_CFG);
+	for (i = 0 ; i < sizeof(offs) / sizeof(offs[0]) ; i++)
+		b[offs[i]] = 0xA5;
+	b[0x36] = 0xA5;
+
+	num = pcie_cfg_diff(a, b, d, 16);
+	TEST_CHECK(num == 7);
+
+	r = test_diff_at(d, num, 0x36);
+	TEST_CHECK(r != NULL && r->offset == 0x35 && r->len == 3);
+	TEST_CHECK(r->old == 0 && r->cur == 0xA500 && r->mask == 0xA500);
+
+	r = test_diff_at(d, num, 0x44);
+	TEST_CHECK(r != NULL && r->cap_id == PCAP_PM && r->cap_off == 0x40);
+	r = test_diff_at(d, num, 0x4C);
+	TEST_CHECK(r != NULL && r->cap_id == 0 && r->offset == 0x4C && r->len == 4);
+	r = test_diff_at(d, num, 0x52);
+	TEST_CHECK(r != NULL && r->cap_id == PCAP_MSI && r->offset == 0x52 && r->len == 2);
+	TEST_CHECK(r->old == 0 && r->cur == 0xA5);
+	r = test_diff_at(d, num, 0x5C);
+	TEST_CHECK(r != NULL && r->cap_id == 0 && r->ext == 0);
+	r = test_diff_at(d, num, 0x104);
+	TEST_CHECK(r != NULL && r->cap_id == PCEC_DSN && r->ext == 1 && r->cap_off == 0x100);
+	r = test_diff_at(d, num, 0x110);
+	TEST_CHECK(r != NULL && r->cap_id == 0 && r->ext == 1);
+	TEST_CHECK(r->offset == 0x110 && r->cur == 0xA5);
+	return 0;
+}
+
+/**
+ * An emitter with a file descriptor and no staging buffer writes the same 
+ * bytes as one with a buffer 
+ */
+static int test_emit_nobuf(struct test_ctx *c)
+{
+	static char want[16384], got[16384];
+	struct pcie_emit e;
+	unsigned fmt;
+	ssize_t n;
+	int fd;
+
+	for (fmt = 0 ; fmt < PCEM_MAX ; fmt++)
+	{
+		pcie_emit_init(&e, fmt, want, sizeof(want), -1);
+		pcie_emit_begin(&e);
+		pcie_emit_dev(&e, c->bdfs[0], c->images);
+		TEST_CHECK(pcie_emit_end(&e) == 0);
+
+		fd = open(c->path, O_RDWR | O_TRUNC);
+		TEST_CHECK(fd >= 0);
+		pcie_emit_init(&e, fmt, NULL, 0, fd);
+		pcie_emit_begin(&e);
+		pcie_emit_dev(&e, c->bdfs[0], c->images);
+		TEST_CHECK(pcie_emit_end(&e) == 0);
+		n = pread(fd, got, sizeof(got), 0);
+		close(fd);
+		TEST_CHECK(n > 0 && (size_t) n == e.total);
+		TEST_CHECK(memcmp(want, got, n) == 0);
+	}
+	return 0;
+}
+
+/**
+ * A device that changes on every poll does not starve the others when out 
+ * only has room for one event 
+ */
+static int test_mon_rotate(struct test_ctx *c)
+{
+	struct pcie_acc_mem mem;
+	struct pcie_mon_evt evt;
+	struct pcie_mon m;
+	__u8 *status;
+	unsigned i;
+
+	mem.bdfs = c->bdfs;
+	mem.images = c->images;
+	mem.num = 4;
+
+	pcie_mon_init(&m, &PCIE_ACC_MEM, &mem, 0xFFFF);
+	for (i = 0 ; i < 4 ; i++)
+		TEST_CHECK(pcie_mon_add(&m, c->bdfs[i]) == 0);
+
+	// Change every device, then keep changing device 0 before each poll
+	for (i = 0 ; i < 4 ; i++)
+		c->images[i * PCLN_CFG + 0x07] ^= 0x80;
+	status = &c->images[0x07];
+	for (i = 1 ; i < 4 ; i++) {
+		TEST_CHECK(pcie_mon_poll(&m, &evt, 1) == 1);
+		*status ^= 0x40;
+	}
+	TEST_CHECK(pcie_mon_poll(&m, &evt, 1) == 1);
+	TEST_CHECK(evt.bdf == c->bdfs[3]);
+
+	pcie_mon_free(&m);
+	for (i = 0 ; i < 4 ; i++)
+		c->images[i * PCLN_CFG + 0x07] ^= 0x80;
+	*status ^= 0x40;
+	return 0;
+}
+
+/**
+ * Return 0 if a cached result is what pcie_decode() gives for the image
+ */
+static int test_dcache_same(const struct pcie_dec *d, __u8 *cfgspace)
+{
+	struct pcie_dec ref;
+
+	memset(&ref, 0, sizeof(ref));
+	pcie_decode(&ref, cfgspace);
+	TEST_CHECK(d->vendor == ref.vendor && d->device == ref.device);
+	TEST_CHECK(d->command == ref.command && d->status == ref.status);
+	TEST_CHECK(d->subvendor == ref.subvendor && d->subsystem == ref.subsystem);
+	TEST_CHECK(memcmp(&d->idx, &ref.idx, sizeof(ref.idx)) == 0);
+	return 0;
+}
+
+/**
+ * The decode cache reuses as much of a result as the changed bytes allow and
+ * always returns what a full decode would
+ */
+static int test_dcache_inval(struct test_ctx *c)
+{
+	struct pcie_cap_index idx;
+	struct pcie_dcache dc;
+	const struct pcie_dec *d;
+	__u8 img[PCLN_CFG];
+	unsigned i, j;
+
+	// An image with at least two entries in each chain
+	for (i = 0 ; i < TEST_IMAGES ; i++) {
+		pcie_cap_index_build(&idx, &c->images[i * PCLN_CFG]);
+		if (pcie_get_type_type(&c->images[i * PCLN_CFG]) != 2 && idx.ncap >= 2 && idx.necap >= 2)
+			break;
+	}
+	TEST_CHECK(i < TEST_IMAGES);
+	memcpy(img, &c->images[i * PCLN_CFG], PCLN_CFG);
+
+	TEST_CHECK(pcie_dcache_init(&dc, 4) == 0);
+	TEST_CHECK(pcie_dcache_decode(&dc, c->bdfs[i], img, &d) == PCCH_NEW);
+	TEST_CHECK(pcie_dcache_decode(&dc, c->bdfs[i], img, &d) == PCCH_HIT);
+	TEST_CHECK(test_dcache_same(d, img) == 0);
+
+	// Interrupt Disable in the Command register
+	img[0x05] ^= 0x04;
+	TEST_CHECK(pcie_dcache_decode(&dc, c->bdfs[i], img, &d) == PCCH_HDR);
+	TEST_CHECK(test_dcache_same(d, img) == 0);
+	TEST_CHECK(pcie_dcache_decode(&dc, c->bdfs[i], img, &d) == PCCH_HIT);
+
+	// A block no walk reads: the last 64 bytes unless an Extended Capability is there
+	for (j = 0 ; j < idx.necap && idx.ecaps[j].offset < PCLN_CFG - 64 ; j++)
+		;
+	if (j == idx.necap) {
+		img[PCLN_CFG - 1] ^= 0xFF;
+		TEST_CHECK(pcie_dcache_decode(&dc, c->bdfs[i], img, &d) == PCCH_HIT);
+	}
+
+	// Version of the first Extended Capability
+	img[idx.ecaps[0].offset + 2] ^= 0x01;
+	TEST_CHECK(pcie_dcache_decode(&dc, c->bdfs[i], img, &d) == PCCH_WALK);
+	TEST_CHECK(test_dcache_same(d, img) == 0);
+
+	// Capability Pointer past the first Capability
+	img[0x34] = idx.caps[1].offset;
+	TEST_CHECK(pcie_dcache_decode(&dc, c->bdfs[i], img, &d) == PCCH_WALK);
+	TEST_CHECK(test_dcache_same(d, img) == 0);
+	TEST_CHECK(d->idx.ncap == idx.ncap - 1);
+
+	TEST_CHECK(pcie_dcache_decode(&dc, c->bdfs[i], img, &d) == PCCH_HIT);
+	TEST_CHECK(dc.stat[PCCH_WALK] == 2 && dc.stat[PCCH_HDR] == 1);
+	pcie_dcache_free(&dc);
+	return 0;
+}
+
+static const struct test TESTS[] =
+{
+	{ "topo_tree", 		test_topo_tree },
+	{ "irq_acct", 		test_irq_acct },
+	{ "sink", 			test_sink },
+	{ "sym_find", 		test_sym_find },
+	{ "col_scan", 		test_col_scan },
+	{ "link_scan", 		test_link_scan },
+	{ "sriov_vfs", 		test_sriov_vfs },
+	{ "snap_valid", 	test_snap_valid },
+	{ "snap_hdr", 		test_snap_hdr },
+	{ "snap_ent", 		test_snap_ent },
+	{ "pack_valid", 	test_pack_valid },
+	{ "pack_hdr", 		test_pack_hdr },
+	{ "pack_ent", 		test_pack_ent },
+	{ "ids_valid", 		test_ids_valid },
+	{ "ids_hdr", 		test_ids_hdr },
+	{ "phf_place", 		test_phf_place },
+	{ "diff_locate", 	test_diff_locate },
+	{ "emit_nobuf", 	test_emit_nobuf },
+	{ "mon_rotate", 	test_mon_rotate },
+	{ "dcache_inval", 	test_dcache_inval },
+};
+
+int main(int argc, char **argv)
+{
+	struct test_ctx *c;
+	struct pcie_gen *g;
+	const char *filter;
+	unsigned i, run, failed;
+	int fd;
+
+	filter = (argc > 1) ? argv[1] : NULL;
+
+	c = calloc(1, sizeof(*c));
+	g = malloc(sizeof(*g));
+	if (c == NULL || g == NULL) {
+		fprintf(stderr, "Unable to allocate the test corpus\n");
+		return 1;
+	}
+
+	pcie_gen_init(g, TEST_SEED, 0);
+	pcie_gen_next(g, c->images, c->bdfs, TEST_IMAGES);
+	free(g);
+
+	strcpy(c->path, "/tmp/pcie_test_XXXXXX");
+	fd = mkstemp(c->path);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to create a temporary file\n");
+		free(c);
+		return 1;
+	}
+	close(fd);
+
+	run = failed = 0;
+	for (i = 0 ; i < sizeof(TESTS) / sizeof(TESTS[0]) ; i++)
+	{
+		if (filter != NULL && strstr(TESTS[i].name, filter) == NULL)
+			continue;
+		run++;
+		if (TESTS[i].fn(c) != 0) {
+			failed++;
+			printf("%-20s FAIL\n", TESTS[i].name);
+		}
+		else
+			printf("%-20s ok\n", TESTS[i].name);
+	}
+
+	printf("%u of %u tests passed\n", run - failed, run);
+	unlink(c->path);
+	free(c);
+	return failed;
+}
@@ -0,0 +1,239 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		topo.c
+ *
+ * @brief 		Code file for building the PCI topology tree from config space images
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Oct 2026
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * The tree is derived entirely from the bus numbers in the images. Each
+ * PCI-to-PCI bridge owns the bus named by its Secondary Bus Number, and every
+ * function on that bus is a child of the bridge.
+ *
+ * A single pass over the images records, per segment, the bridge that owns
+ * each bus and the list of functions on each bus. A second pass over the
+ * compact node array then resolves every parent and first child with one
+ * table lookup each. Nothing is sorted and no path is walked.
+ */
+
+/* INCLUDES ==================================================================*/
+
+/* errno
+ */
+#include <errno.h>
+
+/* malloc()
+ * realloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memset()
+ */
+#include <string.h>
+
+#include "main.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Return the bus tables of a segment, adding them if needed
+ *
+ * @return 	Index into t->seg[] or -1 upon error
+ */
+static int pcie_topo_seg(struct pcie_topo *t, unsigned seg, int hint)
+{
+	struct pcie_topo_seg *s;
+	unsigned i;
+
+	// Hosts have very few segments and images are usually grouped by segment
+	if (hint >= 0 && t->seg[hint].seg == seg)
+		return hint;
+
+	for (i = 0 ; i < t->nseg ; i++)
+		if (t->seg[i].seg == seg)
+			return i;
+
+	s = realloc(t->seg, (t->nseg + 1) * sizeof(*s));
+	if (s == NULL)
+		return -1;
+	t->seg = s;
+
+	s = &t->seg[t->nseg];
+	s->seg = seg;
+	for (i = 0 ; i < 256 ; i++) {
+		s->owner[i] = -1;
+		s->first[i] = -1;
+	}
+	return t->nseg++;
+}
+
+/**
+ * Build the topology tree of a set of config space images
+ *
+ * The tree refers to the images in place, so they must outlive it.
+ *
+ * @param t 		struct pcie_topo* to fill in. Release with pcie_topo_free()
+ * @param bdfs 		__u32* array of num BDFs. See PCIE_BDF()
+ * @param images 	__u8* to num contiguous images of PCLN_CFG bytes each
+ * @param num 		Number of images
+ * @return 			0 upon success, -1 upon error with errno set
+ */
+int pcie_topo_build(struct pcie_topo *t, __u32 *bdfs, __u8 *images, unsigned num)
+{
+	struct pcie_topo_node *n;
+	struct pcie_topo_seg *s;
+	unsigned sec, sub;
+	__u8 *p;
+	int i, si;
+
+	if (t == NULL || (num > 0 && (bdfs == NULL || images == NULL))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(t, 0, sizeof(*t));
+
+	t->node = malloc((num > 0 ? num : 1) * sizeof(*t->node));
+	if (t->node == NULL)
+		return -1;
+	t->num = num;
+
+	// Walk backwards so that each per bus list ends up in input order
+	si = -1;
+	for (i = (int) num - 1 ; i >= 0 ; i--)
+	{
+		n = &t->node[i];
+		p = &images[(size_t) i * PCLN_CFG];
+
+		si = pcie_topo_seg(t, PCIE_BDF_SEG(bdfs[i]), si);
+		if (si < 0) {
+			pcie_topo_free(t);
+			return -1;
+		}
+		s = &t->seg[si];
+
+		n->cfg = p;
+		n->bdf = bdfs[i];
+		n->seg = si;
+		n->type = pcie_get_type_type(p);
+		n->parent = -1;
+		n->child = -1;
+		n->next = s->first[PCIE_BDF_BUS(n->bdf)];
+		s->first[PCIE_BDF_BUS(n->bdf)] = i;
+
+		n->sec = 0;
+		n->sub = 0;
+		if (n->type != 1)
+			continue;
+
+		sec = pcie_get_hdr1_secbus(p);
+		sub = pcie_get_hdr1_subbus(p);
+		n->sec = sec;
+		n->sub = sub;
+
+		// An unconfigured bridge or one that points at or above itself owns nothing
+		if (sec <= PCIE_BDF_BUS(n->bdf) || sub < sec) {
+			t->flags |= PCTP_BAD_BUS;
+			n->sec = 0;
+			n->sub = 0;
+			continue;
+		}
+
+		if (s->owner[sec] >= 0)
+			t->flags |= PCTP_DUP_BUS;
+		s->owner[sec] = i;
+	}
+
+	for (i = 0 ; i < (int) num ; i++)
+	{
+		n = &t->node[i];
+		s = &t->seg[n->seg];
+		n->parent = s->owner[PCIE_BDF_BUS(n->bdf)];
+		if (n->sec != 0)
+			n->child = s->first[n->sec];
+	}
+
+	return 0;
+}
+
+/**
+ * Release a topology tree
+ */
+void pcie_topo_free(struct pcie_topo *t)
+{
+	if (t == NULL)
+		return;
+
+	free(t->node);
+	free(t->seg);
+	memset(t, 0, sizeof(*t));
+}
+
+/**
+ * Find the node of a BDF
+ *
+ * Only the functions on the same bus are compared
+ *
+ * @return 	struct pcie_topo_node* or NULL if the BDF is not in the tree
+ */
+struct pcie_topo_node *pcie_topo_find(struct pcie_topo *t, __u32 bdf)
+{
+	unsigned i;
+	int j;
+
+	for (i = 0 ; i < t->nseg ; i++)
+	{
+		if (t->seg[i].seg != PCIE_BDF_SEG(bdf))
+			continue;
+
+		for (j = t->seg[i].first[PCIE_BDF_BUS(bdf)] ; j >= 0 ; j = t->node[j].next)
+			if (t->node[j].bdf == bdf)
+				return &t->node[j];
+		break;
+	}
+	return NULL;
+}
+
+/**
+ * Return the bridge a node sits behind
+ *
+ * @return 	struct pcie_topo_node* or NULL if the node is on a root bus
+ */
+struct pcie_topo_node *pcie_topo_parent(struct pcie_topo *t, struct pcie_topo_node *n)
+{
+	return (n->parent >= 0) ? &t->node[n->parent] : NULL;
+}
+
+/**
+ * Return the first function on the secondary bus of a bridge
+ *
+ * @return 	struct pcie_topo_node* or NULL if the node has no children
+ */
+struct pcie_topo_node *pcie_topo_child(struct pcie_topo *t, struct pcie_topo_node *n)
+{
+	return (n->child >= 0) ? &t->node[n->child] : NULL;
+}
+
+/**
+ * Return the next function on the same bus
+ *
+ * @return 	struct pcie_topo_node* or NULL if this is the last one
+ */
+struct pcie_topo_node *pcie_topo_next(struct pcie_topo *t, struct pcie_topo_node *n)
+{
+	return (n->next >= 0) ? &t->node[n->next] : NULL;
+}